@@ -0,0 +1,526 @@
+#include "bench.h"
+#include "flat_hash_map.h"
+#include "math_util.h"
+#include "property_writer.h"
+#include "ref_counted.h"
+#include "rtti.h"
+#include "slot_map.h"
+#include "small_vector.h"
+#include "string_utils.h"
+#include "trace.h"
+#include "utf8.h"
+
+#include <algorithm>
+#include <list>
+#include <memory>
+#include <random>
+#include <unordered_map>
+
+BENCHMARK(StringID_Intern) {
+    for (auto _ : state) {
+        bench::DoNotOptimize(StringID("BenchmarkStringID"));
+    }
+}
+
+BENCHMARK(StringID_Literal) {
+    for (auto _ : state) {
+        bench::DoNotOptimize("BenchmarkStringID"_sid);
+    }
+}
+
+BENCHMARK_PARAMS(StringID_LexicalSort, 64, 1024) {
+    std::vector<StringID> ids;
+    std::mt19937 rng(0);
+    for (int64_t i = 0; i < state.Param(); ++i) {
+        ids.emplace_back(std::format("bench_string_{}", rng()));
+    }
+    std::vector<StringID> sorted;
+    state.SetItemsPerIter(ids.size());
+    for (auto _ : state) {
+        state.PauseTiming();
+        sorted = ids;
+        state.ResumeTiming();
+        std::ranges::sort(sorted, StringID::LexicalLessPred());
+        bench::DoNotOptimize(sorted);
+    }
+}
+
+BENCHMARK(Trace_ScopeDisabled) {
+    for (auto _ : state) {
+        TRACE_SCOPE("Bench");
+    }
+}
+
+BENCHMARK(Trace_Scope) {
+    trace::Start();
+    for (auto _ : state) {
+        TRACE_SCOPE("Bench");
+    }
+    trace::Stop();
+    trace::Clear();
+}
+
+namespace {
+
+class BenchEvent {
+    DEFINE_ROOT_CLASS_META(BenchEvent)
+public:
+    virtual ~BenchEvent() = default;
+};
+
+class BenchInputEvent : public BenchEvent {
+    DEFINE_CLASS_META(BenchInputEvent, BenchEvent)
+};
+
+class BenchMouseEvent : public BenchInputEvent {
+    DEFINE_CLASS_META(BenchMouseEvent, BenchInputEvent)
+};
+
+class BenchMouseButtonEvent : public BenchMouseEvent {
+    DEFINE_CLASS_META(BenchMouseButtonEvent, BenchMouseEvent)
+};
+
+class BenchMouseScrollEvent : public BenchMouseEvent {
+    DEFINE_CLASS_META(BenchMouseScrollEvent, BenchMouseEvent)
+};
+
+class BenchDrawEvent : public BenchEvent {
+    DEFINE_CLASS_META(BenchDrawEvent, BenchEvent)
+};
+
+std::vector<std::unique_ptr<BenchEvent>> MakeBenchEvents() {
+    std::vector<std::unique_ptr<BenchEvent>> events;
+    std::mt19937 rng(0);
+    for (int i = 0; i < 1024; ++i) {
+        switch (rng() % 3) {
+            case 0: events.push_back(std::make_unique<BenchMouseButtonEvent>()); break;
+            case 1: events.push_back(std::make_unique<BenchMouseScrollEvent>()); break;
+            case 2: events.push_back(std::make_unique<BenchDrawEvent>()); break;
+        }
+    }
+    return events;
+}
+
+// The check before class ranges: walks the super chain
+template <class ClassType>
+bool IsAByWalk(const BenchEvent& event) {
+    for (const ClassMeta* meta = event.GetClass(); meta; meta = meta->Super) {
+        if (meta == ClassType::GetStaticClass()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+}  // namespace
+
+// Dispatches events like the ui: each handler casts the event
+BENCHMARK(Rtti_EventDispatch) {
+    const auto events = MakeBenchEvents();
+    state.SetItemsPerIter(events.size());
+    for (auto _ : state) {
+        uint32_t numHandled = 0;
+        for (const auto& event : events) {
+            numHandled += event->As<BenchDrawEvent>() != nullptr;
+            numHandled += event->As<BenchMouseEvent>() != nullptr;
+            numHandled += event->As<BenchInputEvent>() != nullptr;
+        }
+        bench::DoNotOptimize(numHandled);
+    }
+}
+
+BENCHMARK(Rtti_EventDispatchSuperWalk) {
+    const auto events = MakeBenchEvents();
+    state.SetItemsPerIter(events.size());
+    for (auto _ : state) {
+        uint32_t numHandled = 0;
+        for (const auto& event : events) {
+            numHandled += IsAByWalk<BenchDrawEvent>(*event);
+            numHandled += IsAByWalk<BenchMouseEvent>(*event);
+            numHandled += IsAByWalk<BenchInputEvent>(*event);
+        }
+        bench::DoNotOptimize(numHandled);
+    }
+}
+
+namespace {
+
+template <class Base>
+struct BenchRefCounted : public Base {
+    BenchRefCounted() : Base(0) {}
+};
+
+template <class Base>
+void RefCountedCopyBenchmark(bench::State& state) {
+    auto object = MakeRefCounted<BenchRefCounted<Base>>();
+    for (auto _ : state) {
+        RefCountedPtr<BenchRefCounted<Base>> copy = object;
+        bench::DoNotOptimize(copy);
+    }
+}
+
+}  // namespace
+
+BENCHMARK(RefCountedPtr_CopyAtomic) {
+    RefCountedCopyBenchmark<RefCountedBase>(state);
+}
+
+BENCHMARK(RefCountedPtr_CopySingleThread) {
+    RefCountedCopyBenchmark<SingleThreadRefCountedBase>(state);
+}
+
+namespace {
+
+// Identifiers like in a shader symbol table
+std::vector<std::string> MakeBenchIdentifiers(size_t count) {
+    std::vector<std::string> names;
+    std::mt19937 rng(0);
+    for (size_t i = 0; i < count; ++i) {
+        names.push_back(std::format("identifier_{}", rng() % 100000));
+    }
+    return names;
+}
+
+template <class Map>
+void MapFindBenchmark(bench::State& state) {
+    const auto names = MakeBenchIdentifiers((size_t)state.Param());
+    Map map;
+    for (const auto& name : names) {
+        map.emplace(std::string_view(name), nullptr);
+    }
+    // Lookups from a different buffer like tokens of a source
+    std::vector<std::string> queries = names;
+    std::shuffle(queries.begin(), queries.end(), std::mt19937(1));
+    state.SetItemsPerIter(queries.size());
+    for (auto _ : state) {
+        size_t numFound = 0;
+        for (const auto& query : queries) {
+            numFound += map.find(std::string_view(query)) != map.end();
+        }
+        bench::DoNotOptimize(numFound);
+    }
+}
+
+template <class Map>
+void MapInsertBenchmark(bench::State& state) {
+    const auto count = (uint32_t)state.Param();
+    state.SetItemsPerIter(count);
+    for (auto _ : state) {
+        Map map;
+        for (uint32_t i = 0; i < count; ++i) {
+            map.emplace(i * 0x9E3779B1u, i);
+        }
+        bench::DoNotOptimize(map);
+    }
+}
+
+// A tree node with a few children like a widget
+template <class Vector>
+void ChildListBenchmark(bench::State& state) {
+    const auto count = (int)state.Param();
+    for (auto _ : state) {
+        Vector children;
+        for (int i = 0; i < count; ++i) {
+            children.push_back(&children);
+        }
+        bench::DoNotOptimize(children);
+    }
+}
+
+}  // namespace
+
+BENCHMARK_PARAMS(FlatHashMap_FindString, 64, 4096) {
+    MapFindBenchmark<FlatHashMap<std::string_view, void*>>(state);
+}
+
+BENCHMARK_PARAMS(UnorderedMap_FindString, 64, 4096) {
+    MapFindBenchmark<std::unordered_map<std::string_view, void*>>(state);
+}
+
+BENCHMARK_PARAMS(FlatHashMap_InsertInt, 64, 4096) {
+    MapInsertBenchmark<FlatHashMap<uint32_t, uint32_t>>(state);
+}
+
+BENCHMARK_PARAMS(UnorderedMap_InsertInt, 64, 4096) {
+    MapInsertBenchmark<std::unordered_map<uint32_t, uint32_t>>(state);
+}
+
+BENCHMARK_PARAMS(SmallVector_ChildList, 2, 8) {
+    ChildListBenchmark<SmallVector<void*, 4>>(state);
+}
+
+BENCHMARK_PARAMS(Vector_ChildList, 2, 8) {
+    ChildListBenchmark<std::vector<void*>>(state);
+}
+
+namespace {
+
+// Localized text: mostly ASCII markup with runs of 2 and 3 byte chars
+std::string MakeBenchUtf8Text(bool ascii) {
+    const std::string_view words[] = {
+        "<span class=\"title\">", "Hello world ", "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82 ",
+        "\xE4\xBD\xA0\xE5\xA5\xBD\xE4\xB8\x96\xE7\x95\x8C ", "</span>\n"};
+    std::string text;
+    std::mt19937 rng(0);
+    while (text.size() < 64 * 1024) {
+        text += words[rng() % (ascii ? 2 : std::size(words))];
+    }
+    return text;
+}
+
+// Param selects cpu::SimdLevel
+void Utf8Benchmark(bench::State& state, bool ascii, bool transcode) {
+    const cpu::SimdLevel level =
+        cpu::SetSimdLevel((cpu::SimdLevel)state.Param());
+    const std::string text = MakeBenchUtf8Text(ascii);
+    std::u16string out(text.size(), u'\0');
+    state.SetBytesPerIter(text.size());
+    for (auto _ : state) {
+        if (transcode) {
+            bench::DoNotOptimize(utf8::ToUtf16(text, out.data()));
+        } else {
+            bench::DoNotOptimize(utf8::IsValid(text));
+        }
+    }
+    cpu::SetSimdLevel(level);
+}
+
+}  // namespace
+
+BENCHMARK_PARAMS(Utf8_ValidateAscii, 0, 1, 2) {
+    Utf8Benchmark(state, true, false);
+}
+
+BENCHMARK_PARAMS(Utf8_ValidateMixed, 0, 1, 2) {
+    Utf8Benchmark(state, false, false);
+}
+
+BENCHMARK_PARAMS(Utf8_ToUtf16Ascii, 0, 1, 2) {
+    Utf8Benchmark(state, true, true);
+}
+
+BENCHMARK_PARAMS(Utf8_ToUtf16Mixed, 0, 1, 2) {
+    Utf8Benchmark(state, false, true);
+}
+
+namespace {
+
+struct BenchWidget {
+    uint32_t index = 0;
+    uint32_t parent = 0;
+};
+
+// Panels with 10 children each, in the depth first order of the events
+void AddBenchWidgets(std::vector<BenchWidget>& widgets, uint32_t parent,
+                     uint32_t depth, uint32_t count) {
+    for (uint32_t i = 0; i < 10 && widgets.size() < count; ++i) {
+        const auto index = (uint32_t)widgets.size();
+        widgets.push_back({index, parent});
+        if (depth) {
+            AddBenchWidgets(widgets, index, depth - 1, count);
+        }
+    }
+}
+
+std::vector<BenchWidget> MakeBenchWidgetTree(uint32_t count) {
+    std::vector<BenchWidget> widgets;
+    widgets.reserve(count);
+    widgets.push_back({0, 0});
+    while (widgets.size() < count) {
+        AddBenchWidgets(widgets, 0, 5, count);
+    }
+    return widgets;
+}
+
+// Pushes the widgets the way Widget::OnEvent(DebugLogEvent) does
+void SerializeBenchWidgets(PropertyArchive& ar,
+                           const std::vector<BenchWidget>& widgets) {
+    for (const auto& widget : widgets) {
+        // Ids start at 1 as 0 is the parent of a root
+        const uint32_t parent = widget.index ? widget.parent + 1 : 0;
+        ar.PushObject("Button", widget.index + 1, parent);
+        ar.PushStringProperty("text", "Click me");
+        ar.PushProperty("index", widget.index);
+        ar.PushProperty("opacity", 0.5f);
+    }
+}
+
+}  // namespace
+
+// Old path: the tree is built and then printed
+BENCHMARK_PARAMS(PropertyArchive_TreeJson, 1000, 100000) {
+    const auto widgets = MakeBenchWidgetTree((uint32_t)state.Param());
+    state.SetItemsPerIter(widgets.size());
+    for (auto _ : state) {
+        PropertyArchive ar;
+        SerializeBenchWidgets(ar, widgets);
+        std::string out;
+        BufferedWriter buffer(BufferedWriter::ToString(&out));
+        JsonPropertyWriter writer(&buffer);
+        ar.VisitRecursively([&](PropertyArchive::Object& object) {
+            writer.OpenObject(object.debugName_, object.objectID_);
+            for (auto& property : object.properties_) {
+                writer.Property(property.Name, property.Value, false);
+            }
+            writer.CloseObject();
+            return true;
+        });
+        bench::DoNotOptimize(out);
+    }
+}
+
+BENCHMARK_PARAMS(PropertyArchive_StreamJson, 1000, 100000) {
+    const auto widgets = MakeBenchWidgetTree((uint32_t)state.Param());
+    state.SetItemsPerIter(widgets.size());
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        BufferedWriter buffer(
+            [&](std::string_view data) { bytes += data.size(); });
+        JsonPropertyWriter writer(&buffer);
+        PropertyArchive ar(&writer);
+        SerializeBenchWidgets(ar, widgets);
+    }
+    bench::DoNotOptimize(bytes);
+}
+
+BENCHMARK_PARAMS(PropertyArchive_StreamBinary, 1000, 100000) {
+    const auto widgets = MakeBenchWidgetTree((uint32_t)state.Param());
+    state.SetItemsPerIter(widgets.size());
+    uint64_t bytes = 0;
+    for (auto _ : state) {
+        BufferedWriter buffer(
+            [&](std::string_view data) { bytes += data.size(); });
+        BinaryPropertyWriter writer(&buffer);
+        PropertyArchive ar(&writer);
+        SerializeBenchWidgets(ar, widgets);
+    }
+    bench::DoNotOptimize(bytes);
+}
+
+namespace {
+
+// Widgets of a large list: rows of 4 items
+std::vector<Rect> MakeBenchRects(size_t count) {
+    std::vector<Rect> rects;
+    rects.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        const float2 origin((float)(i % 4) * 100.f, (float)(i / 4) * 20.f);
+        rects.emplace_back(origin, float2(96.f, 18.f));
+    }
+    return rects;
+}
+
+struct ScopedBatchLevel {
+    explicit ScopedBatchLevel(int64_t level)
+        : prev(cpu::SetSimdLevel((cpu::SimdLevel)level)) {}
+    ~ScopedBatchLevel() { cpu::SetSimdLevel(prev); }
+    cpu::SimdLevel prev;
+};
+
+}  // namespace
+
+// One Rect::Contains per widget like the hit test
+BENCHMARK(Rect_HitTest) {
+    const auto rects = MakeBenchRects(4096);
+    const float2 point(150.f, 10.f);
+    state.SetItemsPerIter(rects.size());
+    for (auto _ : state) {
+        size_t found = math::kNotFound;
+        for (size_t i = rects.size(); i; --i) {
+            if (rects[i - 1].Contains(point)) {
+                found = i - 1;
+                break;
+            }
+        }
+        bench::DoNotOptimize(found);
+    }
+}
+
+// Param selects cpu::SimdLevel
+BENCHMARK_PARAMS(RectBatch_HitTest, 0, 1, 2) {
+    ScopedBatchLevel level(state.Param());
+    const RectBatch rects(MakeBenchRects(4096));
+    const float2 point(150.f, 10.f);
+    state.SetItemsPerIter(rects.Size());
+    for (auto _ : state) {
+        bench::DoNotOptimize(math::FindLastContaining(rects, point));
+    }
+}
+
+BENCHMARK(Rect_ClipTranslate) {
+    auto rects = MakeBenchRects(4096);
+    const Rect clipRect(0.f, 100.f, 300.f, 2000.f);
+    state.SetItemsPerIter(rects.size());
+    for (auto _ : state) {
+        for (Rect& rect : rects) {
+            rect.Translate(0.5f, -0.5f);
+            rect = Rect(math::Max(rect.min.x, clipRect.min.x),
+                        math::Max(rect.min.y, clipRect.min.y),
+                        math::Min(rect.max.x, clipRect.max.x),
+                        math::Min(rect.max.y, clipRect.max.y));
+        }
+        bench::DoNotOptimize(rects);
+    }
+}
+
+BENCHMARK_PARAMS(RectBatch_ClipTranslate, 0, 1, 2) {
+    ScopedBatchLevel level(state.Param());
+    RectBatch rects(MakeBenchRects(4096));
+    const Rect clipRect(0.f, 100.f, 300.f, 2000.f);
+    state.SetItemsPerIter(rects.Size());
+    for (auto _ : state) {
+        math::Translate(rects, float2(0.5f, -0.5f));
+        math::Clip(rects, clipRect);
+        bench::DoNotOptimize(rects);
+    }
+}
+
+namespace {
+
+// Timers added and removed by handle like the tooltips and popups do
+struct BenchTimer {
+    void* object = nullptr;
+    uint64_t periodMs = 0;
+};
+
+}  // namespace
+
+BENCHMARK_PARAMS(SlotMap_Churn, 16, 1024) {
+    const auto count = (size_t)state.Param();
+    SlotMap<BenchTimer> timers;
+    std::vector<SlotHandle> handles;
+    for (size_t i = 0; i < count; ++i) {
+        handles.push_back(timers.insert({}));
+    }
+    std::mt19937 rng(0);
+    state.SetItemsPerIter(count);
+    for (auto _ : state) {
+        for (size_t i = 0; i < count; ++i) {
+            SlotHandle& handle = handles[rng() % count];
+            timers.erase(handle);
+            handle = timers.insert({});
+        }
+        bench::DoNotOptimize(timers);
+    }
+}
+
+// Search by the address like the previous timer list
+BENCHMARK_PARAMS(List_Churn, 16, 1024) {
+    const auto count = (size_t)state.Param();
+    std::list<BenchTimer> timers;
+    std::vector<BenchTimer*> handles;
+    for (size_t i = 0; i < count; ++i) {
+        handles.push_back(&timers.emplace_back());
+    }
+    std::mt19937 rng(0);
+    state.SetItemsPerIter(count);
+    for (auto _ : state) {
+        for (size_t i = 0; i < count; ++i) {
+            BenchTimer*& handle = handles[rng() % count];
+            timers.erase(std::ranges::find_if(
+                timers, [&](BenchTimer& timer) { return &timer == handle; }));
+            handle = &timers.emplace_back();
+        }
+        bench::DoNotOptimize(timers);
+    }
+}
@@ -1,8 +1,458 @@
 #include "bench.h"
+#include "error.h"
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <ctime>
+#else
 #include <Windows.h>
+#endif
+
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <deque>
+#include <format>
+#include <limits>
+#include <unordered_map>
 
 namespace bench {
 
+namespace {
+
+// Scale factor of MAD to estimate the standard deviation
+constexpr double kMadToSigma = 1.4826;
+constexpr double kOutlierSigmas = 3.;
+constexpr uint64_t kMaxItersPerSample = 1'000'000'000;
+
+double Percentile(std::span<const double> sorted, double p) {
+    if (sorted.empty()) {
+        return 0.;
+    }
+    const double pos = p * (double)(sorted.size() - 1);
+    const size_t index = (size_t)pos;
+    if (index + 1 >= sorted.size()) {
+        return sorted.back();
+    }
+    const double frac = pos - (double)index;
+    return sorted[index] + (sorted[index + 1] - sorted[index]) * frac;
+}
+
+std::deque<Registration>& GetRegistry() {
+    // deque keeps the references returned by Register() valid
+    static std::deque<Registration> registry;
+    return registry;
+}
+
+void AppendJsonString(std::string& out, std::string_view str) {
+    out += '"';
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        }
+        out += c;
+    }
+    out += '"';
+}
+
+// Minimal reader of the ToJson() output: an array of flat objects
+// with string and number values
+class JsonReader {
+public:
+    using Object = std::unordered_map<std::string, std::string>;
+
+    JsonReader(std::string_view json) : json_(json) {}
+
+    // Returns false at the end of the array
+    bool NextObject(Object& out) {
+        out.clear();
+        if (!SkipTo('{')) {
+            return false;
+        }
+        ++pos_;
+        while (true) {
+            SkipWhitespace();
+            if (pos_ >= json_.size()) {
+                return false;
+            }
+            if (json_[pos_] == '}') {
+                ++pos_;
+                return true;
+            }
+            if (json_[pos_] == ',') {
+                ++pos_;
+                continue;
+            }
+            std::string key;
+            if (!ReadString(key) || !SkipTo(':')) {
+                return false;
+            }
+            ++pos_;
+            SkipWhitespace();
+            std::string value;
+            if (pos_ < json_.size() && json_[pos_] == '"') {
+                if (!ReadString(value)) {
+                    return false;
+                }
+            } else {
+                const size_t end = json_.find_first_of(",}", pos_);
+                if (end == json_.npos) {
+                    return false;
+                }
+                value = json_.substr(pos_, end - pos_);
+                while (!value.empty() && std::isspace((uint8_t)value.back())) {
+                    value.pop_back();
+                }
+                pos_ = end;
+            }
+            out[key] = value;
+        }
+    }
+
+private:
+    void SkipWhitespace() {
+        while (pos_ < json_.size() && std::isspace((uint8_t)json_[pos_])) {
+            ++pos_;
+        }
+    }
+
+    bool SkipTo(char c) {
+        pos_ = json_.find(c, pos_);
+        return pos_ != json_.npos;
+    }
+
+    bool ReadString(std::string& out) {
+        SkipWhitespace();
+        if (pos_ >= json_.size() || json_[pos_] != '"') {
+            return false;
+        }
+        for (++pos_; pos_ < json_.size(); ++pos_) {
+            char c = json_[pos_];
+            if (c == '"') {
+                ++pos_;
+                return true;
+            }
+            if (c == '\\' && pos_ + 1 < json_.size()) {
+                c = json_[++pos_];
+            }
+            out += c;
+        }
+        return false;
+    }
+
+private:
+    std::string_view json_;
+    size_t pos_ = 0;
+};
+
+double ParseDouble(const JsonReader::Object& object, const std::string& key) {
+    const auto it = object.find(key);
+    if (it == object.end()) {
+        return 0.;
+    }
+    double value = 0.;
+    std::from_chars(it->second.data(), it->second.data() + it->second.size(),
+                    value);
+    return value;
+}
+
+#if defined(__linux__)
+perf_event_attr MakePerfEventAttr(PerfCounters::Counter counter) {
+    perf_event_attr attr{};
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    switch (counter) {
+        case PerfCounters::Counter::Cycles:
+            attr.config = PERF_COUNT_HW_CPU_CYCLES;
+            break;
+        case PerfCounters::Counter::Instructions:
+            attr.config = PERF_COUNT_HW_INSTRUCTIONS;
+            break;
+        case PerfCounters::Counter::CacheMisses:
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+            break;
+        case PerfCounters::Counter::BranchMisses:
+            attr.config = PERF_COUNT_HW_BRANCH_MISSES;
+            break;
+        case PerfCounters::Counter::TLBMisses:
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_DTLB |
+                          (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+            break;
+    }
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    // To scale the value if the counter was multiplexed
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return attr;
+}
+#endif
+
+}  // namespace
+
+std::string_view PerfCounters::GetName(Counter counter) {
+    switch (counter) {
+        case Counter::Cycles: return "cycles";
+        case Counter::Instructions: return "instructions";
+        case Counter::CacheMisses: return "cache_misses";
+        case Counter::BranchMisses: return "branch_misses";
+        case Counter::TLBMisses: return "tlb_misses";
+    }
+    return "";
+}
+
+PerfCounters::PerfCounters() {
+    fds_.fill(-1);
+#if defined(__linux__)
+    for (size_t i = 0; i < kNumCounters; ++i) {
+        perf_event_attr attr = MakePerfEventAttr((Counter)i);
+        // The calling thread on any cpu
+        fds_[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#if defined(__linux__)
+    for (int fd : fds_) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::IsAnyAvailable() const {
+    return std::ranges::any_of(fds_, [](int fd) { return fd >= 0; });
+}
+
+PerfCounters::Values PerfCounters::Read() const {
+    Values values{};
+#if defined(__linux__)
+    for (size_t i = 0; i < kNumCounters; ++i) {
+        if (fds_[i] < 0) {
+            continue;
+        }
+        // value, time enabled, time running
+        uint64_t data[3] = {};
+        if (read(fds_[i], data, sizeof(data)) != sizeof(data) || data[2] == 0) {
+            continue;
+        }
+        values[i] = (double)data[0] * ((double)data[1] / (double)data[2]);
+    }
+#endif
+    return values;
+}
+
+TimeStats ComputeTimeStats(std::vector<double> samples,
+                           uint32_t* outNumOutliers) {
+    TimeStats stats{};
+    if (outNumOutliers) {
+        *outNumOutliers = 0;
+    }
+    if (samples.empty()) {
+        return stats;
+    }
+    std::ranges::sort(samples);
+    const size_t n = samples.size();
+    stats.min = samples.front();
+    stats.max = samples.back();
+    stats.median = Percentile(samples, 0.5);
+    stats.p90 = Percentile(samples, 0.9);
+    stats.p99 = Percentile(samples, 0.99);
+
+    std::vector<double> deviations(n);
+    for (size_t i = 0; i < n; ++i) {
+        deviations[i] = std::abs(samples[i] - stats.median);
+    }
+    std::ranges::sort(deviations);
+    stats.mad = Percentile(deviations, 0.5);
+
+    // Nonparametric 95% interval of the median from order statistics:
+    // ranks n/2 -+ 1.96 * sqrt(n) / 2
+    const double halfWidth = 0.98 * std::sqrt((double)n);
+    const double lower = std::floor((double)n / 2. - halfWidth);
+    const double upper = std::ceil((double)n / 2. + halfWidth);
+    stats.medianLower = samples[(size_t)std::clamp(lower, 0., (double)n - 1)];
+    stats.medianUpper = samples[(size_t)std::clamp(upper, 0., (double)n - 1)];
+
+    // The average of samples within 3 sigmas of the median
+    const double maxDeviation = kOutlierSigmas * kMadToSigma * stats.mad;
+    uint32_t numInliers = 0;
+    double inliersTotal = 0;
+    for (double sample : samples) {
+        stats.total += sample;
+        if (stats.mad == 0. || std::abs(sample - stats.median) <= maxDeviation) {
+            inliersTotal += sample;
+            ++numInliers;
+        }
+    }
+    stats.average = stats.total / (double)n;
+    stats.trimmedMean = inliersTotal / numInliers;
+    if (outNumOutliers) {
+        *outNumOutliers = (uint32_t)n - numInliers;
+    }
+    return stats;
+}
+
+void State::StartTiming() {
+    DASSERT(!running_);
+    running_ = true;
+    if (perfCounters_) {
+        startCounters_ = perfCounters_->Read();
+    }
+    startWall_ = Benchmark::GetWallTimeSecondsDouble();
+    startCPU_ = Benchmark::GetCPUTimeSecondsDouble();
+}
+
+void State::StopTiming() {
+    if (!running_) {
+        return;
+    }
+    const double endWall = Benchmark::GetWallTimeSecondsDouble();
+    const double endCPU = Benchmark::GetCPUTimeSecondsDouble();
+    wallTime_ += std::max(endWall - startWall_, 0.);
+    cpuTime_ += std::max(endCPU - startCPU_, 0.);
+    if (perfCounters_) {
+        const PerfCounters::Values endCounters = perfCounters_->Read();
+        for (size_t i = 0; i < endCounters.size(); ++i) {
+            counters_[i] += std::max(endCounters[i] - startCounters_[i], 0.);
+        }
+    }
+    running_ = false;
+}
+
+void State::PauseTiming() {
+    StopTiming();
+}
+
+void State::ResumeTiming() {
+    StartTiming();
+}
+
+Benchmark::Sample Benchmark::RunSample(uint64_t iters,
+                                       const PerfCounters* counters) {
+    State state(iters, param_, counters);
+    func_(state);
+    state.StopTiming();
+    bytesPerIter_ = state.bytesPerIter_;
+    itemsPerIter_ = state.itemsPerIter_;
+    return {state.wallTime_, state.cpuTime_, state.counters_};
+}
+
+uint64_t Benchmark::Calibrate(double minSampleTime) {
+    uint64_t iters = 1;
+    while (iters < kMaxItersPerSample) {
+        const double time = RunSample(iters).wallTime;
+        if (time >= minSampleTime) {
+            break;
+        }
+        // Aim a bit higher to not stop just below the target
+        const double scale = time > 0. ? 1.4 * minSampleTime / time : 10.;
+        iters = (uint64_t)std::clamp((double)iters * scale, (double)iters + 1,
+                                     (double)iters * 10.);
+    }
+    return std::min(iters, kMaxItersPerSample);
+}
+
+void Benchmark::Run(uint32_t iters) {
+    DASSERT(func_);
+    iters = std::max(iters, 1U);
+    constexpr auto kWarmUpIters = 1;
+    for (uint32_t i = 0; i < kWarmUpIters; ++i) {
+        RunSample(1);
+    }
+    std::vector<Sample> samples;
+    samples.reserve(iters);
+    for (uint32_t i = 0; i < iters; ++i) {
+        samples.push_back(RunSample(1));
+    }
+    ComputeStats(samples, 1);
+}
+
+void Benchmark::Run(const Options& options) {
+    DASSERT(func_);
+    for (uint32_t i = 0; i < options.numWarmUpSamples; ++i) {
+        RunSample(1);
+    }
+    const uint64_t itersPerSample = Calibrate(options.minSampleTime);
+    const uint32_t numSamples = std::max(options.numSamples, kMinSamples);
+
+    std::optional<PerfCounters> perfCounters;
+    if (options.collectCounters) {
+        perfCounters.emplace();
+    }
+    const PerfCounters* counters =
+        perfCounters && perfCounters->IsAnyAvailable() ? &*perfCounters
+                                                       : nullptr;
+    const double startTime = GetWallTimeSecondsDouble();
+
+    std::vector<Sample> samples;
+    samples.reserve(numSamples);
+    while (samples.size() < numSamples) {
+        samples.push_back(RunSample(itersPerSample, counters));
+        if (samples.size() >= kMinSamples &&
+            GetWallTimeSecondsDouble() - startTime > options.maxTime) {
+            break;
+        }
+    }
+    ComputeStats(samples, itersPerSample, counters);
+}
+
+void Benchmark::ComputeStats(const std::vector<Sample>& samples,
+                             uint64_t itersPerSample,
+                             const PerfCounters* counters) {
+    std::vector<double> wallTimes;
+    std::vector<double> cpuTimes;
+    wallTimes.reserve(samples.size());
+    cpuTimes.reserve(samples.size());
+    for (const Sample& sample : samples) {
+        wallTimes.push_back(sample.wallTime / (double)itersPerSample);
+        cpuTimes.push_back(sample.cpuTime / (double)itersPerSample);
+    }
+    stats_ = {};
+    stats_.numSamples = (uint32_t)samples.size();
+    stats_.itersPerSample = itersPerSample;
+    stats_.numIters = stats_.numSamples * itersPerSample;
+    stats_.wallTime = ComputeTimeStats(std::move(wallTimes), &stats_.numOutliers);
+    stats_.cpuTime = ComputeTimeStats(std::move(cpuTimes));
+    if (stats_.wallTime.median > 0.) {
+        stats_.bytesPerSecond = (double)bytesPerIter_ / stats_.wallTime.median;
+        stats_.itemsPerSecond = (double)itemsPerIter_ / stats_.wallTime.median;
+    }
+    if (!counters) {
+        return;
+    }
+    std::vector<double> values(samples.size());
+    for (size_t i = 0; i < PerfCounters::kNumCounters; ++i) {
+        if (!counters->IsAvailable((PerfCounters::Counter)i)) {
+            continue;
+        }
+        for (size_t j = 0; j < samples.size(); ++j) {
+            values[j] = samples[j].counters[i] / (double)itersPerSample;
+        }
+        std::ranges::sort(values);
+        stats_.counters[i] = Percentile(values, 0.5);
+    }
+    const auto cycles = stats_.GetCounter(PerfCounters::Counter::Cycles);
+    const auto instructions =
+        stats_.GetCounter(PerfCounters::Counter::Instructions);
+    if (cycles && instructions && *cycles > 0.) {
+        stats_.ipc = *instructions / *cycles;
+    }
+}
+
+#if defined(__linux__)
+double Benchmark::GetCPUTimeSecondsDouble() {
+    timespec time{};
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+#else
 double Benchmark::GetCPUTimeSecondsDouble() {
     FILETIME creationTime;
     FILETIME exitTime;
@@ -20,5 +470,167 @@ double Benchmark::GetCPUTimeSecondsDouble() {
             static_cast<double>(user.QuadPart)) *
             1e-7;
 }
+#endif
+
+Registration& Register(std::string_view name, BenchmarkFunc func) {
+    return GetRegistry().emplace_back(name, func);
+}
+
+std::vector<Result> RunAll(const RunOptions& options) {
+    std::vector<Result> results;
+    const auto run = [&](const Registration& registration, std::string name,
+                         int64_t param) {
+        if (!options.filter.empty() &&
+            name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        Benchmark benchmark;
+        benchmark.SetMain(registration.GetFunc());
+        benchmark.SetParam(param);
+        Benchmark::Options benchOptions =
+            options.options.value_or(registration.GetOptions());
+        benchOptions.collectCounters |= options.collectCounters;
+        benchmark.Run(benchOptions);
+        Result& result = results.emplace_back(std::move(name), benchmark.GetStats());
+        if (options.onResult) {
+            options.onResult(result);
+        }
+    };
+    for (const Registration& registration : GetRegistry()) {
+        if (registration.GetParams().empty()) {
+            run(registration, registration.GetName(), 0);
+            continue;
+        }
+        for (int64_t param : registration.GetParams()) {
+            run(registration, std::format("{}/{}", registration.GetName(), param),
+                param);
+        }
+    }
+    return results;
+}
+
+std::string ToJson(std::span<const Result> results) {
+    constexpr double kNs = 1e9;
+    std::string out = "[\n";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        const Benchmark::Stats& stats = result.stats;
+        out += "  {\"name\": ";
+        AppendJsonString(out, result.name);
+        out += std::format(
+            ", \"iterations\": {}, \"samples\": {}, \"outliers\": {}, "
+            "\"median_ns\": {}, \"mad_ns\": {}, \"mean_ns\": {}, "
+            "\"trimmed_mean_ns\": {}, \"min_ns\": {}, \"max_ns\": {}, "
+            "\"p90_ns\": {}, \"p99_ns\": {}, "
+            "\"median_lower_ns\": {}, \"median_upper_ns\": {}, "
+            "\"cpu_median_ns\": {}, \"bytes_per_second\": {}, "
+            "\"items_per_second\": {}",
+            stats.numIters, stats.numSamples, stats.numOutliers,
+            stats.wallTime.median * kNs, stats.wallTime.mad * kNs,
+            stats.wallTime.average * kNs, stats.wallTime.trimmedMean * kNs,
+            stats.wallTime.min * kNs, stats.wallTime.max * kNs,
+            stats.wallTime.p90 * kNs, stats.wallTime.p99 * kNs,
+            stats.wallTime.medianLower * kNs, stats.wallTime.medianUpper * kNs,
+            stats.cpuTime.median * kNs,
+            stats.bytesPerSecond, stats.itemsPerSecond);
+        // Only the collected counters
+        for (size_t j = 0; j < PerfCounters::kNumCounters; ++j) {
+            if (stats.counters[j]) {
+                out += std::format(", \"{}\": {}",
+                                   PerfCounters::GetName((PerfCounters::Counter)j),
+                                   *stats.counters[j]);
+            }
+        }
+        if (stats.ipc > 0.) {
+            out += std::format(", \"ipc\": {}", stats.ipc);
+        }
+        out += i + 1 < results.size() ? "},\n" : "}\n";
+    }
+    out += "]\n";
+    return out;
+}
+
+std::string ToCsv(std::span<const Result> results) {
+    constexpr double kNs = 1e9;
+    std::string out =
+        "name,iterations,samples,outliers,median_ns,mad_ns,mean_ns,"
+        "trimmed_mean_ns,min_ns,max_ns,p90_ns,p99_ns,median_lower_ns,"
+        "median_upper_ns,cpu_median_ns,"
+        "bytes_per_second,items_per_second";
+    for (size_t i = 0; i < PerfCounters::kNumCounters; ++i) {
+        out += std::format(",{}", PerfCounters::GetName((PerfCounters::Counter)i));
+    }
+    out += ",ipc\n";
+    for (const Result& result : results) {
+        const Benchmark::Stats& stats = result.stats;
+        out += std::format(
+            "\"{}\",{},{},{},{},{},{},{},{},{},{},{},{},{},{},{},{}",
+            result.name, stats.numIters, stats.numSamples, stats.numOutliers,
+            stats.wallTime.median * kNs, stats.wallTime.mad * kNs,
+            stats.wallTime.average * kNs, stats.wallTime.trimmedMean * kNs,
+            stats.wallTime.min * kNs, stats.wallTime.max * kNs,
+            stats.wallTime.p90 * kNs, stats.wallTime.p99 * kNs,
+            stats.wallTime.medianLower * kNs, stats.wallTime.medianUpper * kNs,
+            stats.cpuTime.median * kNs,
+            stats.bytesPerSecond, stats.itemsPerSecond);
+        // Empty cells for unavailable counters
+        for (const std::optional<double>& counter : stats.counters) {
+            out += counter ? std::format(",{}", *counter) : ",";
+        }
+        out += stats.ipc > 0. ? std::format(",{}\n", stats.ipc) : ",\n";
+    }
+    return out;
+}
+
+std::vector<Comparison> Compare(std::span<const Result> results,
+                                std::string_view baselineJson,
+                                double threshold) {
+    struct Baseline {
+        double median;
+        double lower;
+        double upper;
+    };
+    std::unordered_map<std::string, Baseline> baselines;
+    JsonReader reader(baselineJson);
+    JsonReader::Object object;
+    while (reader.NextObject(object)) {
+        const auto it = object.find("name");
+        if (it == object.end()) {
+            continue;
+        }
+        baselines[it->second] = {ParseDouble(object, "median_ns"),
+                                 ParseDouble(object, "median_lower_ns"),
+                                 ParseDouble(object, "median_upper_ns")};
+    }
+
+    constexpr double kNs = 1e9;
+    std::vector<Comparison> out;
+    out.reserve(results.size());
+    for (const Result& result : results) {
+        const TimeStats& stats = result.stats.wallTime;
+        Comparison& comparison = out.emplace_back();
+        comparison.name = result.name;
+        comparison.current = stats.median * kNs;
+
+        const auto it = baselines.find(result.name);
+        if (it == baselines.end() || it->second.median <= 0.) {
+            comparison.verdict = Comparison::Verdict::New;
+            continue;
+        }
+        const Baseline& baseline = it->second;
+        comparison.baseline = baseline.median;
+        comparison.change = comparison.current / baseline.median - 1.;
+        comparison.verdict = Comparison::Verdict::Same;
+        if (std::abs(comparison.change) <= threshold) {
+            continue;
+        }
+        if (stats.medianLower * kNs > baseline.upper) {
+            comparison.verdict = Comparison::Verdict::Slower;
+        } else if (stats.medianUpper * kNs < baseline.lower) {
+            comparison.verdict = Comparison::Verdict::Faster;
+        }
+    }
+    return out;
+}
 
-} // namespace bench
+}  // namespace bench
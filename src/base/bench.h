@@ -1,67 +1,235 @@
+#pragma once
+#include <array>
+#include <atomic>
 #include <chrono>
 #include <functional>
+#include <optional>
+#include <span>
+#include <string>
+#include <vector>
 
 namespace bench {
 
-// Simple benchmark runner
+// Prevents the compiler from optimizing away |value|
+// by escaping its address through a volatile store
+namespace internal {
+inline const volatile void* volatile gSink = nullptr;
+}  // namespace internal
+
+template <class T>
+inline void DoNotOptimize(const T& value) {
+    internal::gSink = &value;
+    std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+// Statistics of the time of a single iteration in seconds
+struct TimeStats {
+    // Sum of all samples
+    double total;
+    double average;
+    // Mean of the samples without outliers
+    double trimmedMean;
+    double min;
+    double max;
+    double median;
+    // Median absolute deviation
+    double mad;
+    double p90;
+    double p99;
+    // 95% confidence interval of the median
+    double medianLower;
+    double medianUpper;
+};
+
+// Computes statistics of per iteration times
+// Outliers are the samples further than 3 MADs from the median
+TimeStats ComputeTimeStats(std::vector<double> samples,
+                           uint32_t* outNumOutliers = nullptr);
+
+// Hardware counters of the calling thread
+// Available only on Linux through perf_event_open and only if the kernel
+// allows it (perf_event_paranoid <= 2 or CAP_PERFMON)
+class PerfCounters {
+public:
+    enum class Counter {
+        Cycles,
+        Instructions,
+        CacheMisses,
+        BranchMisses,
+        TLBMisses,
+    };
+
+    static constexpr size_t kNumCounters = 5;
+
+    using Values = std::array<double, kNumCounters>;
+
+    static std::string_view GetName(Counter counter);
+
+public:
+    // Starts counting
+    PerfCounters();
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    bool IsAvailable(Counter counter) const {
+        return fds_[(size_t)counter] >= 0;
+    }
+
+    bool IsAnyAvailable() const;
+
+    // Returns counts since the construction
+    // Scaled if the kernel multiplexed the counters, 0 if unavailable
+    Values Read() const;
+
+private:
+    std::array<int, kNumCounters> fds_;
+};
+
+// Passed to a benchmark function
+// Measures the time of the loop:
+//   for (auto _ : state) {
+//       DoNotOptimize(Work());
+//   }
+class State {
+public:
+    State(uint64_t numIters, int64_t param, const PerfCounters* counters = nullptr)
+        : numIters_(numIters), param_(param), perfCounters_(counters) {}
+
+    uint64_t NumIters() const { return numIters_; }
+    // A value from BENCHMARK_PARAMS()
+    int64_t Param() const { return param_; }
+
+    // Reported as throughput
+    void SetBytesPerIter(uint64_t bytes) { bytesPerIter_ = bytes; }
+    void SetItemsPerIter(uint64_t items) { itemsPerIter_ = items; }
+
+    // Excludes code inside the loop from the measurement
+    void PauseTiming();
+    void ResumeTiming();
+
+    struct Iterator {
+        struct Value {};
+
+        Value operator*() const { return {}; }
+        Iterator& operator++() {
+            --itersLeft;
+            return *this;
+        }
+        bool operator!=(const Iterator&) {
+            if (itersLeft != 0) [[likely]] {
+                return true;
+            }
+            state->StopTiming();
+            return false;
+        }
+
+        uint64_t itersLeft;
+        State* state;
+    };
+
+    Iterator begin() {
+        StartTiming();
+        return {numIters_, this};
+    }
+    Iterator end() { return {0, this}; }
+
+private:
+    friend class Benchmark;
+
+    void StartTiming();
+    void StopTiming();
+
+private:
+    uint64_t numIters_ = 0;
+    int64_t param_ = 0;
+    uint64_t bytesPerIter_ = 0;
+    uint64_t itemsPerIter_ = 0;
+    bool running_ = false;
+    double startWall_ = 0;
+    double startCPU_ = 0;
+    double wallTime_ = 0;
+    double cpuTime_ = 0;
+    const PerfCounters* perfCounters_ = nullptr;
+    PerfCounters::Values startCounters_{};
+    PerfCounters::Values counters_{};
+};
+
+// Benchmark runner
 class Benchmark {
 public:
     struct Stats {
-        uint32_t numIters;
-        struct {
-            double total;
-            double average;
-            double min;
-            double max;
-        } wallTime;
+        // Measured iterations
+        uint64_t numIters;
+        uint32_t numSamples;
+        uint64_t itersPerSample;
+        uint32_t numOutliers;
+        // Per iteration
+        TimeStats wallTime;
         // NOTE: Cpu time on Windows has 15ms granularity
-        struct {
-            double total;
-            double average;
-            double min;
-            double max;
-        } cpuTime;
+        TimeStats cpuTime;
+        // Per second, 0 if not set by the benchmark
+        double bytesPerSecond;
+        double itemsPerSecond;
+        // Medians per iteration of the hardware counters,
+        // empty if not collected or unavailable
+        std::array<std::optional<double>, PerfCounters::kNumCounters> counters;
+        // Instructions per cycle, 0 if unavailable
+        double ipc;
+
+        std::optional<double> GetCounter(PerfCounters::Counter counter) const {
+            return counters[(size_t)counter];
+        }
     };
 
+    struct Options {
+        // Iterations per sample are calibrated to run at least this long
+        double minSampleTime = 0.005;
+        uint32_t numSamples = 30;
+        uint32_t numWarmUpSamples = 1;
+        // Stops sampling after this time, but takes at least kMinSamples
+        double maxTime = 5.;
+        // Collects hardware counters if available
+        bool collectCounters = false;
+    };
+
+    static constexpr uint32_t kMinSamples = 5;
+
 public:
-    void SetMain(const std::function<void()>& func) { func_ = func; }
-
-    void Run(uint32_t iters) {
-        iters = std::max(iters, 1U);
-        stats_.numIters = iters;
-        constexpr auto kWarmUpIters = 1;
-        stats_.wallTime.min = std::numeric_limits<double>::max();
-        stats_.cpuTime.min = std::numeric_limits<double>::max();
-
-        for (uint32_t i = 0; i < iters + kWarmUpIters; ++i) {
-            const double startWall = GetWallTimeSecondsDouble();
-            const double startCPU = GetCPUTimeSecondsDouble();
-            func_();
-            const double endWall = GetWallTimeSecondsDouble();
-            const double timeWall = std::max(endWall - startWall, 0.);
-
-            const double endCPU = GetCPUTimeSecondsDouble();
-            const double timeCPU = std::max(endCPU - startCPU, 0.);
-
-            if (i >= kWarmUpIters) {
-                stats_.wallTime.total += timeWall;
-                stats_.wallTime.min = std::min(stats_.wallTime.min, timeWall);
-                stats_.wallTime.max = std::max(stats_.wallTime.max, timeWall);
-
-                if (timeCPU > 0.) {
-                    stats_.cpuTime.total += timeCPU;
-                    stats_.cpuTime.min = std::min(stats_.cpuTime.min, timeCPU);
-                    stats_.cpuTime.max = std::max(stats_.cpuTime.max, timeCPU);
-                }
+    void SetMain(const std::function<void()>& func) {
+        func_ = [func](State& state) {
+            for (auto _ : state) {
+                func();
             }
-        }
-        stats_.wallTime.average = stats_.wallTime.total / stats_.numIters;
-        stats_.cpuTime.average = stats_.cpuTime.total / stats_.numIters;
+        };
     }
 
+    void SetMain(const std::function<void(State&)>& func) { func_ = func; }
+    // Passed to State::Param()
+    void SetParam(int64_t param) { param_ = param; }
+
+    // Runs exactly |iters| samples of one iteration after one warm-up
+    void Run(uint32_t iters);
+
+    // Calibrates the number of iterations per sample and runs
+    void Run(const Options& options);
+
     Stats GetStats() const { return stats_; }
 
 private:
+    struct Sample {
+        double wallTime;
+        double cpuTime;
+        PerfCounters::Values counters;
+    };
+
+    Sample RunSample(uint64_t iters, const PerfCounters* counters = nullptr);
+    uint64_t Calibrate(double minSampleTime);
+    void ComputeStats(const std::vector<Sample>& samples,
+                      uint64_t itersPerSample,
+                      const PerfCounters* counters = nullptr);
+
     static double GetWallTimeSecondsDouble() {
         using Seconds =
             std::chrono::duration<double, std::chrono::seconds::period>;
@@ -73,10 +241,124 @@ private:
     static double GetCPUTimeSecondsDouble();
 
 private:
+    friend class State;
+
     Stats stats_{};
-    std::function<void()> func_;
+    std::function<void(State&)> func_;
+    int64_t param_ = 0;
+    uint64_t bytesPerIter_ = 0;
+    uint64_t itemsPerIter_ = 0;
+};
+
+using BenchmarkFunc = void (*)(State&);
+
+// A benchmark registered with BENCHMARK()
+class Registration {
+public:
+    Registration(std::string_view name, BenchmarkFunc func)
+        : name_(name), func_(func) {}
+
+    // Runs the benchmark once per parameter
+    Registration& Params(std::initializer_list<int64_t> params) {
+        params_ = params;
+        return *this;
+    }
+
+    Registration& SetOptions(const Benchmark::Options& options) {
+        options_ = options;
+        return *this;
+    }
+
+    const std::string& GetName() const { return name_; }
+    BenchmarkFunc GetFunc() const { return func_; }
+    std::span<const int64_t> GetParams() const { return params_; }
+    const Benchmark::Options& GetOptions() const { return options_; }
+
+private:
+    std::string name_;
+    BenchmarkFunc func_;
+    std::vector<int64_t> params_;
+    Benchmark::Options options_;
+};
+
+Registration& Register(std::string_view name, BenchmarkFunc func);
+
+// Result of a registered benchmark
+struct Result {
+    // Name or name/param
+    std::string name;
+    Benchmark::Stats stats;
 };
 
+struct RunOptions {
+    // Runs only benchmarks which names contain the filter
+    std::string filter;
+    // Overrides per benchmark options
+    std::optional<Benchmark::Options> options;
+    // Collects hardware counters in all benchmarks
+    bool collectCounters = false;
+    // Prints progress
+    std::function<void(const Result&)> onResult;
+};
+
+// Runs all registered benchmarks
+std::vector<Result> RunAll(const RunOptions& options);
+
+// Writes results as a json array of objects or as a csv table
+// Times are in nanoseconds per iteration
+std::string ToJson(std::span<const Result> results);
+std::string ToCsv(std::span<const Result> results);
+
+struct Comparison {
+    enum class Verdict {
+        Same,
+        Faster,
+        Slower,
+        // Not found in the baseline
+        New,
+    };
+
+    std::string name;
+    // Median time in nanoseconds
+    double baseline;
+    double current;
+    // current / baseline - 1
+    double change;
+    Verdict verdict;
+};
+
+// Compares medians with a baseline previously written by ToJson()
+// A change is significant if it's larger than |threshold| and the
+// confidence intervals of the medians don't overlap
+std::vector<Comparison> Compare(std::span<const Result> results,
+                                std::string_view baselineJson,
+                                double threshold);
+
+}  // namespace bench
+
+// Defines and registers a benchmark function:
+//   BENCHMARK(MyBench) {
+//       for (auto _ : state) { ... }
+//   }
+#define BENCHMARK(NAME)                                       \
+    static void NAME(bench::State& state);                    \
+    static const bench::Registration& _benchRegistration_##NAME = \
+        bench::Register(#NAME, &NAME);                        \
+    static void NAME(bench::State& state)
+
+// Same as BENCHMARK() but runs once for each parameter
+//   BENCHMARK_PARAMS(MyBench, 8, 64, 512) {
+//       std::vector<int> v(state.Param());
+//       ...
+//   }
+#define BENCHMARK_PARAMS(NAME, ...)                           \
+    static void NAME(bench::State& state);                    \
+    static const bench::Registration& _benchRegistration_##NAME = \
+        bench::Register(#NAME, &NAME).Params({__VA_ARGS__});  \
+    static void NAME(bench::State& state)
+
+namespace bench {
+
 // Simple timer
 class Timer {
 public:
@@ -1,9 +1,12 @@
 #pragma once
 #include "base/math_util.h"
+#include "base/mem_tracker.h"
 
 // Bump allocator
 // Only allocates memory
 // Memory is freed at at once on destruction
+// Pages are reported to the memory tag of the scope the allocator is
+// created in
 class BumpAllocator {
 public:
     constexpr static unsigned kDefaultPageSize = 64 * 1024;
@@ -18,8 +21,9 @@ public:
         if(alignedPtr != ptr_) {
             allocSize += alignedPtr - ptr_;
         }
-        // TODO: Handle dedicated allocation
-        DASSERT(allocSize <= pageSize_);
+        if(size + alignment > pageSize_) {
+            return AllocateDedicated(size, alignment);
+        }
         if(alignedPtr + allocSize > end_) {
             AllocatePage(pageSize_);
             alignedPtr = AlignUp(ptr_, alignment);
@@ -41,6 +45,9 @@ public:
 
     void* GetHeadForTesting() const { return head_; }
 
+    // Size of the pages including the unused space
+    size_t GetAllocatedBytes() const { return allocatedBytes_; }
+
 public:
     BumpAllocator(size_t pageSize = kDefaultPageSize)
         : pageSize_(std::bit_ceil(pageSize))
@@ -48,7 +55,9 @@ public:
         , ptr_(0)
         , end_(0) {}
 
-    BumpAllocator(BumpAllocator&&) = default;
+    BumpAllocator(BumpAllocator&& rhs) : BumpAllocator(rhs.pageSize_) {
+        swap(rhs);
+    }
 
     BumpAllocator& operator=(BumpAllocator&& rhs) {
         BumpAllocator(std::move(rhs)).swap(*this);
@@ -60,6 +69,8 @@ public:
         std::swap(pageSize_, rhs.pageSize_);
         std::swap(ptr_, rhs.ptr_);
         std::swap(end_, rhs.end_);
+        std::swap(allocatedBytes_, rhs.allocatedBytes_);
+        std::swap(tag_, rhs.tag_);
     }
 
     ~BumpAllocator() {
@@ -70,6 +81,9 @@ public:
             page = next;
         }
         head_ = nullptr;
+        if (allocatedBytes_) {
+            mem::RecordFree(allocatedBytes_, tag_);
+        }
     }
 
 private:
@@ -79,6 +93,7 @@ private:
 
     void AllocatePage(size_t size) {
         auto* mem = new char[size + sizeof(Page)];
+        RecordPage(size + sizeof(Page));
         auto* page = reinterpret_cast<Page*>(mem);
         page->next = head_;
         head_ = page;
@@ -86,9 +101,60 @@ private:
         end_ = ptr_ + size;
     }
 
+    // Allocations larger than a page get their own page
+    // Linked behind the head so the current page is still used
+    void* AllocateDedicated(size_t size, size_t alignment) {
+        auto* mem = new char[size + alignment + sizeof(Page)];
+        RecordPage(size + alignment + sizeof(Page));
+        auto* page = reinterpret_cast<Page*>(mem);
+        page->next = head_->next;
+        head_->next = page;
+        return (void*)AlignUp((uintptr_t)mem + sizeof(Page), alignment);
+    }
+
+    // The pages are freed at once and reported as a single free
+    void RecordPage(size_t size) {
+        mem::RecordAlloc(size, tag_);
+        allocatedBytes_ += size;
+    }
+
 private:
     size_t pageSize_;
     Page* head_;
     uintptr_t ptr_;
     uintptr_t end_;
+    size_t allocatedBytes_ = 0;
+    mem::Tag tag_ = mem::GetCurrentTag();
+};
+
+// Std allocator adapter for containers which live in an arena
+// Deallocation is a no-op, the memory is freed with the arena:
+//   BumpAllocator arena;
+//   using NodeAlloc = ArenaAllocator<Node*>;
+//   SmallVector<Node*, 4, NodeAlloc> children{NodeAlloc(arena)};
+template<class T>
+class ArenaAllocator {
+public:
+    using value_type = T;
+
+    ArenaAllocator(BumpAllocator& arena) : arena_(&arena) {}
+
+    template<class U>
+    ArenaAllocator(const ArenaAllocator<U>& rhs) : arena_(rhs.GetArena()) {}
+
+    T* allocate(size_t count) {
+        return static_cast<T*>(arena_->Allocate(count * sizeof(T), alignof(T)));
+    }
+
+    void deallocate(T*, size_t) {}
+
+    BumpAllocator* GetArena() const { return arena_; }
+
+    template<class U>
+    bool operator==(const ArenaAllocator<U>& rhs) const {
+        return arena_ == rhs.GetArena();
+    }
+
+private:
+    BumpAllocator* arena_;
 };
\ No newline at end of file
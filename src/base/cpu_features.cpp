@@ -0,0 +1,73 @@
+#include "cpu_features.h"
+
+#include <algorithm>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define CPU_X64
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#include <immintrin.h>
+#endif
+
+namespace cpu {
+
+namespace {
+
+SimdLevel DetectSimdLevel() {
+#ifdef CPU_X64
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    const int maxLeaf = info[0];
+    __cpuid(info, 1);
+    // The os saves the ymm registers
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (maxLeaf >= 7 && osxsave && avx && (_xgetbv(0) & 0x6) == 0x6) {
+        __cpuidex(info, 7, 0);
+        if (info[1] & (1 << 5)) {
+            return SimdLevel::AVX2;
+        }
+    }
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        return SimdLevel::AVX2;
+    }
+#endif
+    // Part of x64
+    return SimdLevel::SSE2;
+#else
+    return SimdLevel::Scalar;
+#endif
+}
+
+}  // namespace
+
+SimdLevel GetSupportedSimdLevel() {
+    static const SimdLevel level = DetectSimdLevel();
+    return level;
+}
+
+SimdLevel detail::InitSimdLevel() {
+    int level = -1;
+    // Could be overridden by another thread in between
+    if (gSimdLevel.compare_exchange_strong(level,
+                                           (int)GetSupportedSimdLevel(),
+                                           std::memory_order_relaxed)) {
+        return GetSupportedSimdLevel();
+    }
+    return (SimdLevel)level;
+}
+
+SimdLevel SetSimdLevel(SimdLevel level) {
+    level = std::min(level, GetSupportedSimdLevel());
+    const int prev =
+        detail::gSimdLevel.exchange((int)level, std::memory_order_relaxed);
+    return prev >= 0 ? (SimdLevel)prev : GetSupportedSimdLevel();
+}
+
+}  // namespace cpu
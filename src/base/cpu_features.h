@@ -0,0 +1,35 @@
+#pragma once
+#include <atomic>
+
+// Instruction sets of the runtime dispatched kernels, see utf8.cpp,
+// math_batch.cpp and wgsl/lexer_scan.cpp. All of them select the kernels
+// of GetSimdLevel()
+namespace cpu {
+
+enum class SimdLevel {
+    Scalar,
+    SSE2,
+    AVX2,
+};
+
+// Best level supported by the cpu and the os, detected once
+SimdLevel GetSupportedSimdLevel();
+
+namespace detail {
+// Constant initialized, so the kernels could run in static initializers
+// The level is -1 until the first use
+inline constinit std::atomic<int> gSimdLevel = -1;
+SimdLevel InitSimdLevel();
+}  // namespace detail
+
+// Used level, the supported one unless overridden
+inline SimdLevel GetSimdLevel() {
+    const int level = detail::gSimdLevel.load(std::memory_order_relaxed);
+    return level >= 0 ? (SimdLevel)level : detail::InitSimdLevel();
+}
+
+// Overrides the used level, clamped to the supported one
+// Returns the previous level. Used by tests and benchmarks
+SimdLevel SetSimdLevel(SimdLevel level);
+
+}  // namespace cpu
@@ -0,0 +1,756 @@
+#pragma once
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <emmintrin.h>
+#define FLAT_HASH_SSE2
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+#include "base/error.h"
+
+// Open addressing hash map and set
+// Slots are stored inline in a flat array with a parallel array of control
+// bytes. A control byte holds 7 bits of the hash of a full slot or marks it
+// empty or deleted. Lookups compare a group of 16 control bytes at once and
+// only touch the slots whose control bytes match:
+//   FlatHashMap<std::string, int> map;
+//   map["one"] = 1;
+//   if (auto it = map.find(std::string_view("one")); it != map.end()) { ... }
+//
+// Unlike std::unordered_map, rehashing and erasing move the elements,
+// so pointers and iterators are invalidated by any insertion.
+// The value type is std::pair<Key, Value>, the key must not be modified.
+// With a transparent hash and equality (the default for strings)
+// lookup accepts any type comparable to the key without conversion.
+// Any std allocator is supported, e.g. ArenaAllocator from bump_alloc.h
+
+// Default hash, transparent for strings
+template <class Key>
+struct FlatHash : std::hash<Key> {};
+
+struct FlatStringHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+    size_t operator()(const std::string& str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+    size_t operator()(const char* str) const {
+        return std::hash<std::string_view>{}(str);
+    }
+};
+
+template <>
+struct FlatHash<std::string> : FlatStringHash {};
+
+template <>
+struct FlatHash<std::string_view> : FlatStringHash {};
+
+namespace flat_hash_detail {
+
+using Ctrl = int8_t;
+
+// Full slots store the lower 7 bits of the hash
+inline constexpr Ctrl kEmpty = -128;
+inline constexpr Ctrl kDeleted = -2;
+
+inline constexpr size_t kGroupWidth = 16;
+
+// Identity hashes like std::hash<int> leave the high bits empty
+// Mixes them with a 64x64->128 multiplication
+inline size_t MixHash(size_t hash) {
+    constexpr uint64_t kMul = 0x9E3779B97F4A7C15ull;
+#if defined(__SIZEOF_INT128__)
+    const __uint128_t r = (__uint128_t)hash * kMul;
+    return (size_t)((uint64_t)r ^ (uint64_t)(r >> 64));
+#elif defined(_M_X64)
+    uint64_t high;
+    const uint64_t low = _umul128(hash, kMul, &high);
+    return (size_t)(low ^ high);
+#else
+    const uint64_t r = (uint64_t)hash * kMul;
+    return (size_t)(r ^ (r >> 32));
+#endif
+}
+
+inline size_t H1(size_t hash) { return hash >> 7; }
+inline Ctrl H2(size_t hash) { return (Ctrl)(hash & 0x7F); }
+
+// Bitmask of the matching control bytes in a group
+class BitMask {
+public:
+    explicit BitMask(uint32_t mask) : mask_(mask) {}
+
+    explicit operator bool() const { return mask_ != 0; }
+
+    uint32_t Lowest() const { return (uint32_t)std::countr_zero(mask_); }
+
+    BitMask& operator++() {
+        mask_ &= mask_ - 1;
+        return *this;
+    }
+
+    // Range-for over the matching indices
+    BitMask begin() const { return *this; }
+    BitMask end() const { return BitMask(0); }
+    uint32_t operator*() const { return Lowest(); }
+    bool operator!=(const BitMask& rhs) const { return mask_ != rhs.mask_; }
+
+private:
+    uint32_t mask_;
+};
+
+// 16 control bytes compared in parallel
+class Group {
+public:
+#ifdef FLAT_HASH_SSE2
+    explicit Group(const Ctrl* ctrl)
+        : ctrl_(_mm_loadu_si128(reinterpret_cast<const __m128i*>(ctrl))) {}
+
+    BitMask Match(Ctrl h2) const {
+        const __m128i match = _mm_set1_epi8(h2);
+        return BitMask(
+            (uint32_t)_mm_movemask_epi8(_mm_cmpeq_epi8(match, ctrl_)));
+    }
+
+    BitMask MatchEmpty() const { return Match(kEmpty); }
+
+    // Both empty and deleted have the sign bit set
+    BitMask MatchEmptyOrDeleted() const {
+        return BitMask((uint32_t)_mm_movemask_epi8(ctrl_));
+    }
+
+private:
+    __m128i ctrl_;
+#else
+    explicit Group(const Ctrl* ctrl) { std::memcpy(ctrl_, ctrl, kGroupWidth); }
+
+    BitMask Match(Ctrl h2) const {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < kGroupWidth; ++i) {
+            mask |= (uint32_t)(ctrl_[i] == h2) << i;
+        }
+        return BitMask(mask);
+    }
+
+    BitMask MatchEmpty() const { return Match(kEmpty); }
+
+    BitMask MatchEmptyOrDeleted() const {
+        uint32_t mask = 0;
+        for (uint32_t i = 0; i < kGroupWidth; ++i) {
+            mask |= (uint32_t)(ctrl_[i] < 0) << i;
+        }
+        return BitMask(mask);
+    }
+
+private:
+    Ctrl ctrl_[kGroupWidth];
+#endif
+};
+
+template <class Key>
+struct SetPolicy {
+    using key_type = Key;
+    using value_type = Key;
+
+    static const Key& GetKey(const value_type& value) { return value; }
+};
+
+template <class Key, class Value>
+struct MapPolicy {
+    using key_type = Key;
+    using value_type = std::pair<Key, Value>;
+
+    static const Key& GetKey(const value_type& value) { return value.first; }
+};
+
+template <class Hash, class Eq>
+concept Transparent = requires {
+    typename Hash::is_transparent;
+    typename Eq::is_transparent;
+};
+
+// Shared implementation of FlatHashMap and FlatHashSet
+// The capacity is a power of two and a multiple of the group width.
+// Groups are probed with triangular steps which visit every group once.
+template <class Policy, class Hash, class Eq, class Alloc>
+class FlatHashTable {
+public:
+    using key_type = typename Policy::key_type;
+    using value_type = typename Policy::value_type;
+    using size_type = size_t;
+    using hasher = Hash;
+    using key_equal = Eq;
+    using allocator_type = Alloc;
+
+private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+    using SlotAlloc = typename AllocTraits::template rebind_alloc<value_type>;
+    using SlotAllocTraits = std::allocator_traits<SlotAlloc>;
+    using CtrlAlloc = typename AllocTraits::template rebind_alloc<Ctrl>;
+
+public:
+    // Lookup accepts any key type if the functors are transparent
+    static constexpr bool kIsTransparent = Transparent<Hash, Eq>;
+
+private:
+    static constexpr size_t kMinCapacity = kGroupWidth;
+
+public:
+    template <bool IsConst>
+    class Iterator {
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename Policy::value_type;
+        using difference_type = ptrdiff_t;
+        using reference =
+            std::conditional_t<IsConst, const value_type&, value_type&>;
+        using pointer =
+            std::conditional_t<IsConst, const value_type*, value_type*>;
+
+        Iterator() = default;
+
+        // iterator -> const_iterator
+        operator Iterator<true>() const { return {ctrl_, slot_, end_}; }
+
+        reference operator*() const { return *slot_; }
+        pointer operator->() const { return slot_; }
+
+        Iterator& operator++() {
+            ++ctrl_;
+            ++slot_;
+            SkipEmpty();
+            return *this;
+        }
+
+        Iterator operator++(int) {
+            Iterator tmp = *this;
+            ++*this;
+            return tmp;
+        }
+
+        bool operator==(const Iterator& rhs) const {
+            return ctrl_ == rhs.ctrl_;
+        }
+
+    private:
+        friend class FlatHashTable;
+        template <bool>
+        friend class Iterator;
+
+        Iterator(const Ctrl* ctrl, pointer slot, const Ctrl* end)
+            : ctrl_(ctrl), slot_(slot), end_(end) {}
+
+        void SkipEmpty() {
+            while (ctrl_ != end_ && *ctrl_ < 0) {
+                ++ctrl_;
+                ++slot_;
+            }
+        }
+
+    private:
+        const Ctrl* ctrl_ = nullptr;
+        pointer slot_ = nullptr;
+        const Ctrl* end_ = nullptr;
+    };
+
+    using iterator = Iterator<false>;
+    using const_iterator = Iterator<true>;
+
+public:
+    FlatHashTable() = default;
+
+    explicit FlatHashTable(const Alloc& alloc) : alloc_(alloc) {}
+
+    FlatHashTable(std::initializer_list<value_type> init,
+                  const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        reserve(init.size());
+        for (const value_type& value : init) {
+            insert(value);
+        }
+    }
+
+    FlatHashTable(const FlatHashTable& rhs)
+        : hash_(rhs.hash_),
+          eq_(rhs.eq_),
+          alloc_(SlotAllocTraits::select_on_container_copy_construction(
+              rhs.alloc_)) {
+        reserve(rhs.size());
+        for (const value_type& value : rhs) {
+            InsertUnique(value);
+        }
+    }
+
+    FlatHashTable(FlatHashTable&& rhs) noexcept
+        : hash_(std::move(rhs.hash_)),
+          eq_(std::move(rhs.eq_)),
+          alloc_(std::move(rhs.alloc_)),
+          ctrl_(std::exchange(rhs.ctrl_, EmptyGroup())),
+          slots_(std::exchange(rhs.slots_, nullptr)),
+          size_(std::exchange(rhs.size_, 0)),
+          capacity_(std::exchange(rhs.capacity_, 0)),
+          growthLeft_(std::exchange(rhs.growthLeft_, 0)) {}
+
+    FlatHashTable& operator=(const FlatHashTable& rhs) {
+        if (this != &rhs) {
+            FlatHashTable tmp(rhs);
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    FlatHashTable& operator=(FlatHashTable&& rhs) noexcept {
+        if (this != &rhs) {
+            FlatHashTable tmp(std::move(rhs));
+            swap(tmp);
+        }
+        return *this;
+    }
+
+    ~FlatHashTable() { Destroy(); }
+
+    void swap(FlatHashTable& rhs) noexcept {
+        std::swap(hash_, rhs.hash_);
+        std::swap(eq_, rhs.eq_);
+        std::swap(alloc_, rhs.alloc_);
+        std::swap(ctrl_, rhs.ctrl_);
+        std::swap(slots_, rhs.slots_);
+        std::swap(size_, rhs.size_);
+        std::swap(capacity_, rhs.capacity_);
+        std::swap(growthLeft_, rhs.growthLeft_);
+    }
+
+    iterator begin() {
+        iterator it(ctrl_, slots_, ctrl_ + capacity_);
+        it.SkipEmpty();
+        return it;
+    }
+    iterator end() { return {ctrl_ + capacity_, nullptr, ctrl_ + capacity_}; }
+
+    const_iterator begin() const {
+        return const_cast<FlatHashTable*>(this)->begin();
+    }
+    const_iterator end() const {
+        return const_cast<FlatHashTable*>(this)->end();
+    }
+
+    size_t size() const { return size_; }
+    bool empty() const { return size_ == 0; }
+    size_t capacity() const { return capacity_; }
+
+    allocator_type get_allocator() const { return allocator_type(alloc_); }
+
+    // Destroys the elements, keeps the memory
+    void clear() {
+        if (capacity_ == 0) {
+            return;
+        }
+        if constexpr (!std::is_trivially_destructible_v<value_type>) {
+            for (size_t i = 0; i < capacity_; ++i) {
+                if (ctrl_[i] >= 0) {
+                    SlotAllocTraits::destroy(alloc_, slots_ + i);
+                }
+            }
+        }
+        std::memset(ctrl_, (uint8_t)kEmpty, capacity_);
+        size_ = 0;
+        growthLeft_ = MaxLoad(capacity_);
+    }
+
+    // Allocates space for at least 'count' elements without rehashing
+    void reserve(size_t count) {
+        if (count > size_ + growthLeft_) {
+            Rehash(CapacityFor(count));
+        }
+    }
+
+    iterator find(const key_type& key) { return FindImpl(key); }
+
+    template <class K>
+        requires kIsTransparent
+    iterator find(const K& key) {
+        return FindImpl(key);
+    }
+
+    const_iterator find(const key_type& key) const {
+        return const_cast<FlatHashTable*>(this)->FindImpl(key);
+    }
+
+    template <class K>
+        requires kIsTransparent
+    const_iterator find(const K& key) const {
+        return const_cast<FlatHashTable*>(this)->FindImpl(key);
+    }
+
+    bool contains(const key_type& key) const {
+        return FindIndex(key, HashKey(key)) != kNotFound;
+    }
+
+    template <class K>
+        requires kIsTransparent
+    bool contains(const K& key) const {
+        return FindIndex(key, HashKey(key)) != kNotFound;
+    }
+
+    size_t count(const key_type& key) const { return contains(key) ? 1 : 0; }
+
+    template <class K>
+        requires kIsTransparent
+    size_t count(const K& key) const {
+        return contains(key) ? 1 : 0;
+    }
+
+    std::pair<iterator, bool> insert(const value_type& value) {
+        return EmplaceImpl(Policy::GetKey(value), value);
+    }
+
+    std::pair<iterator, bool> insert(value_type&& value) {
+        return EmplaceImpl(Policy::GetKey(value), std::move(value));
+    }
+
+    template <class It>
+    void insert(It first, It last) {
+        for (; first != last; ++first) {
+            insert(*first);
+        }
+    }
+
+    // Constructs the value first to get the key, prefer try_emplace for maps
+    template <class... Args>
+    std::pair<iterator, bool> emplace(Args&&... args) {
+        value_type value(std::forward<Args>(args)...);
+        return EmplaceImpl(Policy::GetKey(value), std::move(value));
+    }
+
+    size_t erase(const key_type& key) { return EraseImpl(key); }
+
+    template <class K>
+        requires kIsTransparent
+    size_t erase(const K& key) {
+        return EraseImpl(key);
+    }
+
+    // Returns the iterator following the erased one
+    iterator erase(const_iterator pos) {
+        DASSERT(pos != end());
+        const size_t index = (size_t)(pos.ctrl_ - ctrl_);
+        EraseAt(index);
+        iterator next(ctrl_ + index, slots_ + index, ctrl_ + capacity_);
+        ++next;
+        return next;
+    }
+
+    iterator erase(iterator pos) { return erase(const_iterator(pos)); }
+
+    // Maximum number of elements before the table grows
+    static size_t MaxLoad(size_t capacity) { return capacity - capacity / 8; }
+
+protected:
+    static constexpr size_t kNotFound = ~size_t(0);
+
+    template <class K>
+    size_t HashKey(const K& key) const {
+        return MixHash(hash_(key));
+    }
+
+    template <class K>
+    iterator FindImpl(const K& key) {
+        const size_t index = FindIndex(key, HashKey(key));
+        return index != kNotFound ? IteratorAt(index) : end();
+    }
+
+    template <class K>
+    size_t EraseImpl(const K& key) {
+        const size_t index = FindIndex(key, HashKey(key));
+        if (index == kNotFound) {
+            return 0;
+        }
+        EraseAt(index);
+        return 1;
+    }
+
+    template <class K>
+    size_t FindIndex(const K& key, size_t hash) const {
+        if (capacity_ == 0) {
+            return kNotFound;
+        }
+        const Ctrl h2 = H2(hash);
+        const size_t groupMask = capacity_ / kGroupWidth - 1;
+        size_t group = H1(hash) & groupMask;
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * kGroupWidth;
+            const Group g(ctrl_ + base);
+            for (uint32_t i : g.Match(h2)) {
+                if (eq_(Policy::GetKey(slots_[base + i]), key)) {
+                    return base + i;
+                }
+            }
+            if (g.MatchEmpty()) {
+                return kNotFound;
+            }
+            group = (group + step) & groupMask;
+            DASSERT(step <= groupMask + 1);
+        }
+    }
+
+    // Returns the first empty or deleted slot in the probe sequence
+    size_t FindInsertIndex(size_t hash) const {
+        const size_t groupMask = capacity_ / kGroupWidth - 1;
+        size_t group = H1(hash) & groupMask;
+        for (size_t step = 1;; ++step) {
+            const size_t base = group * kGroupWidth;
+            if (const BitMask mask = Group(ctrl_ + base).MatchEmptyOrDeleted()) {
+                return base + mask.Lowest();
+            }
+            group = (group + step) & groupMask;
+            DASSERT(step <= groupMask + 1);
+        }
+    }
+
+    // Inserts a key known to be absent
+    // Returns the index of the slot to construct the value at
+    size_t PrepareInsert(size_t hash) {
+        if (capacity_ == 0) {
+            Rehash(kMinCapacity);
+        }
+        size_t index = FindInsertIndex(hash);
+        if (growthLeft_ == 0 && ctrl_[index] != kDeleted) {
+            // Drop the tombstones if they take a lot of the table
+            // otherwise grow
+            if (size_ <= MaxLoad(capacity_) / 2) {
+                Rehash(capacity_);
+            } else {
+                Rehash(capacity_ * 2);
+            }
+            index = FindInsertIndex(hash);
+        }
+        if (ctrl_[index] == kEmpty) {
+            --growthLeft_;
+        }
+        ctrl_[index] = H2(hash);
+        ++size_;
+        return index;
+    }
+
+    template <class K, class... Args>
+    std::pair<iterator, bool> EmplaceImpl(const K& key, Args&&... args) {
+        const size_t hash = HashKey(key);
+        if (const size_t index = FindIndex(key, hash); index != kNotFound) {
+            return {IteratorAt(index), false};
+        }
+        const size_t index = PrepareInsert(hash);
+        SlotAllocTraits::construct(alloc_, slots_ + index,
+                                   std::forward<Args>(args)...);
+        return {IteratorAt(index), true};
+    }
+
+    void InsertUnique(const value_type& value) {
+        const size_t index = PrepareInsert(HashKey(Policy::GetKey(value)));
+        SlotAllocTraits::construct(alloc_, slots_ + index, value);
+    }
+
+    void EraseAt(size_t index) {
+        SlotAllocTraits::destroy(alloc_, slots_ + index);
+        --size_;
+        // Probing stops at a group with an empty slot so if the group
+        // already has one, no probe sequence passes through this slot
+        const size_t base = index & ~(kGroupWidth - 1);
+        if (Group(ctrl_ + base).MatchEmpty()) {
+            ctrl_[index] = kEmpty;
+            ++growthLeft_;
+        } else {
+            ctrl_[index] = kDeleted;
+        }
+    }
+
+    iterator IteratorAt(size_t index) {
+        return {ctrl_ + index, slots_ + index, ctrl_ + capacity_};
+    }
+
+    static size_t CapacityFor(size_t count) {
+        size_t capacity = kMinCapacity;
+        while (MaxLoad(capacity) < count) {
+            capacity *= 2;
+        }
+        return capacity;
+    }
+
+    void Rehash(size_t newCapacity) {
+        DASSERT(std::has_single_bit(newCapacity) &&
+                newCapacity >= kMinCapacity);
+        DASSERT(MaxLoad(newCapacity) >= size_);
+        Ctrl* oldCtrl = ctrl_;
+        value_type* oldSlots = slots_;
+        const size_t oldCapacity = capacity_;
+
+        CtrlAlloc ctrlAlloc(alloc_);
+        ctrl_ = std::allocator_traits<CtrlAlloc>::allocate(ctrlAlloc,
+                                                           newCapacity);
+        slots_ = SlotAllocTraits::allocate(alloc_, newCapacity);
+        std::memset(ctrl_, (uint8_t)kEmpty, newCapacity);
+        capacity_ = newCapacity;
+        growthLeft_ = MaxLoad(newCapacity) - size_;
+
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldCtrl[i] < 0) {
+                continue;
+            }
+            value_type& value = oldSlots[i];
+            const size_t hash = HashKey(Policy::GetKey(value));
+            const size_t index = FindInsertIndex(hash);
+            ctrl_[index] = H2(hash);
+            SlotAllocTraits::construct(alloc_, slots_ + index,
+                                       std::move(value));
+            SlotAllocTraits::destroy(alloc_, oldSlots + i);
+        }
+        if (oldCapacity != 0) {
+            Deallocate(oldCtrl, oldSlots, oldCapacity);
+        }
+    }
+
+    void Destroy() {
+        if (capacity_ == 0) {
+            return;
+        }
+        clear();
+        Deallocate(ctrl_, slots_, capacity_);
+        ctrl_ = EmptyGroup();
+        slots_ = nullptr;
+        capacity_ = 0;
+        growthLeft_ = 0;
+    }
+
+    void Deallocate(Ctrl* ctrl, value_type* slots, size_t capacity) {
+        CtrlAlloc ctrlAlloc(alloc_);
+        std::allocator_traits<CtrlAlloc>::deallocate(ctrlAlloc, ctrl, capacity);
+        SlotAllocTraits::deallocate(alloc_, slots, capacity);
+    }
+
+    // Shared by empty tables so iteration needs no special case
+    static Ctrl* EmptyGroup() {
+        alignas(16) static Ctrl kEmptyGroup[kGroupWidth] = {
+            kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty,
+            kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty, kEmpty};
+        return kEmptyGroup;
+    }
+
+protected:
+    [[no_unique_address]] Hash hash_;
+    [[no_unique_address]] Eq eq_;
+    [[no_unique_address]] SlotAlloc alloc_;
+    Ctrl* ctrl_ = EmptyGroup();
+    value_type* slots_ = nullptr;
+    size_t size_ = 0;
+    size_t capacity_ = 0;
+    // Empty slots which could be filled before the table grows
+    size_t growthLeft_ = 0;
+};
+
+}  // namespace flat_hash_detail
+
+template <class Key,
+          class Hash = FlatHash<Key>,
+          class Eq = std::equal_to<>,
+          class Alloc = std::allocator<Key>>
+class FlatHashSet
+    : public flat_hash_detail::
+          FlatHashTable<flat_hash_detail::SetPolicy<Key>, Hash, Eq, Alloc> {
+    using Base = flat_hash_detail::
+        FlatHashTable<flat_hash_detail::SetPolicy<Key>, Hash, Eq, Alloc>;
+
+public:
+    using Base::Base;
+};
+
+template <class Key,
+          class Value,
+          class Hash = FlatHash<Key>,
+          class Eq = std::equal_to<>,
+          class Alloc = std::allocator<std::pair<Key, Value>>>
+class FlatHashMap
+    : public flat_hash_detail::FlatHashTable<
+          flat_hash_detail::MapPolicy<Key, Value>, Hash, Eq, Alloc> {
+    using Base = flat_hash_detail::FlatHashTable<
+        flat_hash_detail::MapPolicy<Key, Value>, Hash, Eq, Alloc>;
+
+public:
+    using mapped_type = Value;
+    using typename Base::iterator;
+    using typename Base::key_type;
+
+    using Base::Base;
+
+    // Constructs the value only if the key is absent
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(const Key& key, Args&&... args) {
+        return this->EmplaceImpl(key, std::piecewise_construct,
+                                 std::forward_as_tuple(key),
+                                 std::forward_as_tuple(
+                                     std::forward<Args>(args)...));
+    }
+
+    template <class... Args>
+    std::pair<iterator, bool> try_emplace(Key&& key, Args&&... args) {
+        return this->EmplaceImpl(key, std::piecewise_construct,
+                                 std::forward_as_tuple(std::move(key)),
+                                 std::forward_as_tuple(
+                                     std::forward<Args>(args)...));
+    }
+
+    template <class V>
+    std::pair<iterator, bool> insert_or_assign(const Key& key, V&& value) {
+        auto res = try_emplace(key, std::forward<V>(value));
+        if (!res.second) {
+            res.first->second = std::forward<V>(value);
+        }
+        return res;
+    }
+
+    Value& operator[](const Key& key) { return try_emplace(key).first->second; }
+    Value& operator[](Key&& key) {
+        return try_emplace(std::move(key)).first->second;
+    }
+
+    Value& at(const Key& key) { return AtImpl(key); }
+
+    template <class K>
+        requires Base::kIsTransparent
+    Value& at(const K& key) {
+        return AtImpl(key);
+    }
+
+    const Value& at(const Key& key) const {
+        return const_cast<FlatHashMap*>(this)->AtImpl(key);
+    }
+
+    template <class K>
+        requires Base::kIsTransparent
+    const Value& at(const K& key) const {
+        return const_cast<FlatHashMap*>(this)->AtImpl(key);
+    }
+
+private:
+    template <class K>
+    Value& AtImpl(const K& key) {
+        auto it = this->FindImpl(key);
+        if (it == this->end()) {
+            throw std::out_of_range("FlatHashMap::at");
+        }
+        return it->second;
+    }
+};
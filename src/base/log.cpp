@@ -1,113 +1,365 @@
 #include "log.h"
+#include "log_buffer.h"
+#include "log_file.h"
+#include <algorithm>
+#include <bit>
 #include <deque>
 #include <filesystem>
-#include <fstream>
 #include <iostream>
 #include <semaphore>
 
+#include "math_util.h"
 #include "threading.h"
 
 namespace logging {
 
 constexpr auto kBufferSize = 100;
-static Level glevel = Level::All;
+// Size of the per-thread ring buffer for binary records
+constexpr size_t kThreadBufferSize = 256 * 1024;
+// How often the logger thread polls the binary buffers
+constexpr auto kPollInterval = std::chrono::milliseconds(5);
+static std::atomic<Level> glevel = Level::All;
 
 void LogProc();
 
 struct Context {
     std::string logDir;
+    Mode mode;
+    FileSinkOptions fileOptions;
     std::thread thread;
-    std::binary_semaphore sema;
+    std::counting_semaphore<> sema;
+    // Set when the semaphore is released, limits the number of releases
+    std::atomic_bool bWakePending;
     std::atomic_bool bShouldExit;
     std::atomic_bool bFlushFile;
     std::deque<Record> queue;
+    // Binary mode buffers of all threads
+    std::vector<ThreadBuffer*> buffers;
     std::mutex lock;
 };
 Context* ctx = nullptr;
 
-void Init(const std::string& logDirectory) {
+// Trivially destructible, so they are still valid in the thread local
+// destructors that run after the owner's one
+thread_local ThreadBuffer* tlsBuffer = nullptr;
+thread_local bool tlsExited = false;
+
+// Owned by a producer thread. The logger thread deletes the buffer
+// after the owner has exited and the buffer is drained
+struct ThreadBufferOwner {
+    ThreadBuffer* buffer = nullptr;
+
+    ~ThreadBufferOwner() {
+        if (buffer) {
+            tlsBuffer = nullptr;
+            tlsExited = true;
+            buffer->Close();
+        }
+    }
+};
+thread_local ThreadBufferOwner tlsBufferOwner;
+
+void Wake() {
+    if (!ctx->bWakePending.exchange(true, std::memory_order_acq_rel)) {
+        ctx->sema.release();
+    }
+}
+
+void Init(const std::string& logDirectory, Mode mode) {
+    Init(logDirectory, mode, FileSinkOptions());
+}
+
+void Init(const std::string& logDirectory,
+          Mode mode,
+          const FileSinkOptions& fileOptions) {
     if (ctx)
         return;
     ctx = new Context{
         .logDir = logDirectory,
-        .thread = std::thread(LogProc),
-        .sema = std::binary_semaphore(0),
+        .mode = mode,
+        .fileOptions = fileOptions,
+        .sema = std::counting_semaphore<>(0),
+        .bWakePending = false,
         .bShouldExit = false,
         .bFlushFile = false,
     };
+    ctx->thread = std::thread(LogProc);
 }
 
 bool IsInitialized() {
     return ctx != nullptr;
 }
 
+bool IsBinaryMode() {
+    return ctx->mode == Mode::Binary;
+}
+
 void Shutdown() {
-    if (!ctx)
+    if (!ctx || !ctx->thread.joinable())
         return;
     ctx->bFlushFile.store(true, std::memory_order::relaxed);
-    ctx->bShouldExit.store(true, std::memory_order::relaxed);
-    ctx->sema.release();
+    ctx->bShouldExit.store(true, std::memory_order::release);
+    Wake();
     ctx->thread.join();
 }
 
 void Flush() {
     ctx->bFlushFile.store(true, std::memory_order::relaxed);
-    ctx->sema.release();
+    Wake();
+}
+
+// Resolved call sites and module levels
+struct FilterRegistry {
+    std::mutex lock;
+    std::vector<const Site*> sites;
+    std::vector<std::pair<std::string, Level>> modules;
+};
+
+FilterRegistry& GetFilterRegistry() {
+    // Never destroyed, could be used from static destructors
+    static auto* registry = new FilterRegistry;
+    return *registry;
+}
+
+// Ignores the kind of separators
+bool PathContains(std::string_view path, std::string_view module) {
+    const auto normalize = [](char c) { return c == '\\' ? '/' : c; };
+    return !std::ranges::search(path, module, {}, normalize, normalize).empty();
+}
+
+// Should be called under the registry lock
+Level ComputeLevel(const FilterRegistry& registry, const Site& site) {
+    Level level = glevel.load(std::memory_order_relaxed);
+    size_t matchSize = 0;
+    for (const auto& [module, moduleLevel] : registry.modules) {
+        if (module.size() >= matchSize && PathContains(site.file, module)) {
+            level = moduleLevel;
+            matchSize = module.size();
+        }
+    }
+    return level;
+}
+
+void UpdateFilters(FilterRegistry& registry) {
+    for (const Site* site : registry.sites) {
+        site->filter->Set(ComputeLevel(registry, *site));
+    }
 }
 
 void SetLevel(Level level) {
-    glevel = level;
+    auto& registry = GetFilterRegistry();
+    std::scoped_lock _{registry.lock};
+    glevel.store(level, std::memory_order_relaxed);
+    UpdateFilters(registry);
+}
+
+void SetModuleLevel(std::string_view module, Level level) {
+    auto& registry = GetFilterRegistry();
+    std::scoped_lock _{registry.lock};
+    auto it = std::ranges::find(registry.modules, module,
+                                [](const auto& entry) { return entry.first; });
+    if (it != registry.modules.end()) {
+        it->second = level;
+    } else {
+        registry.modules.emplace_back(module, level);
+    }
+    UpdateFilters(registry);
+}
+
+void ClearModuleLevel(std::string_view module) {
+    auto& registry = GetFilterRegistry();
+    std::scoped_lock _{registry.lock};
+    std::erase_if(registry.modules,
+                  [&](const auto& entry) { return entry.first == module; });
+    UpdateFilters(registry);
 }
 
 bool ShouldLog(Level level) {
-    return level <= glevel;
+    return level <= glevel.load(std::memory_order_relaxed);
+}
+
+bool ResolveFilter(const Site& site) {
+    auto& registry = GetFilterRegistry();
+    std::scoped_lock _{registry.lock};
+    if (!site.filter->IsResolved()) {
+        registry.sites.push_back(&site);
+        site.filter->Set(ComputeLevel(registry, site));
+    }
+    return site.filter->Passes(site.level);
 }
 
 void DoLog(Record&& record) {
+    const Level level = record.level;
     {
         std::scoped_lock _{ctx->lock};
         ctx->queue.push_back(std::move(record));
     }
-    if (record.level == Level::Fatal) {
+    if (level == Level::Fatal) {
         // Block until flushed
         Shutdown();
         return;
     }
-    ctx->sema.release();
+    Wake();
+}
+
+namespace detail {
+
+std::byte* BeginRecord(const Site& site, FormatFn format, size_t argsSize) {
+    ThreadBuffer* buffer = tlsBuffer;
+    if (!buffer) [[unlikely]] {
+        // Logged by a thread local destructor after the buffer is closed,
+        // the logger thread could have deleted it already
+        if (tlsExited) {
+            return nullptr;
+        }
+        buffer = new ThreadBuffer(kThreadBufferSize);
+        tlsBuffer = buffer;
+        tlsBufferOwner.buffer = buffer;
+        std::scoped_lock _{ctx->lock};
+        ctx->buffers.push_back(buffer);
+    }
+    std::byte* data = buffer->Reserve(sizeof(RecordHeader) + argsSize);
+    if (!data) {
+        return nullptr;
+    }
+    auto* header = reinterpret_cast<RecordHeader*>(data);
+    header->size = (uint32_t)AlignUp(sizeof(RecordHeader) + argsSize, kRecordAlign);
+    header->isPadding = false;
+    header->site = &site;
+    header->format = format;
+    header->timestamp =
+        std::chrono::high_resolution_clock::now().time_since_epoch().count();
+    return reinterpret_cast<std::byte*>(header + 1);
+}
+
+void EndRecord() {
+    if (tlsBuffer->Commit()) {
+        Wake();
+    }
+}
+
+}  // namespace detail
+
+// Collects lines from all sources and writes them in one batch
+// ordered by time
+class LineBatch {
+public:
+    void AddText(const Record& rec) {
+        const size_t offset = scratch_.size();
+        std::format_to(std::back_inserter(scratch_), "{}:{} [{}]: {}\n",
+                       rec.file, rec.line, to_string(rec.level), rec.message);
+        AddLine(rec.timePoint.time_since_epoch().count(), offset);
+    }
+
+    void AddBinary(const RecordHeader& header, const std::byte* args) {
+        const size_t offset = scratch_.size();
+        const Site& site = *header.site;
+        std::format_to(std::back_inserter(scratch_), "{}:{} [{}]: ",
+                       site.file, site.line, to_string(site.level));
+        header.format(site.format, args, scratch_);
+        scratch_.push_back('\n');
+        AddLine(header.timestamp, offset);
+    }
+
+    void AddDropped(uint64_t numDropped) {
+        const size_t offset = scratch_.size();
+        std::format_to(std::back_inserter(scratch_),
+                       "[{}]: {} records were dropped, the buffer is full\n",
+                       to_string(Level::Warning), numDropped);
+        AddLine(std::chrono::high_resolution_clock::now().time_since_epoch().count(),
+                offset);
+    }
+
+    bool Empty() const { return lines_.empty(); }
+
+    // Returns sorted lines
+    std::string_view Finalize() {
+        std::ranges::stable_sort(lines_, {}, &Line::timestamp);
+        batch_.clear();
+        for (const Line& line : lines_) {
+            batch_.append(scratch_, line.offset, line.size);
+        }
+        scratch_.clear();
+        lines_.clear();
+        return batch_;
+    }
+
+private:
+    void AddLine(time_point::rep timestamp, size_t offset) {
+        lines_.push_back({timestamp, offset, scratch_.size() - offset});
+    }
+
+private:
+    struct Line {
+        time_point::rep timestamp;
+        size_t offset;
+        size_t size;
+    };
+    std::vector<Line> lines_;
+    std::string scratch_;
+    std::string batch_;
+};
+
+// Drains the text queue and binary buffers into the batch
+void CollectRecords(LineBatch& batch) {
+    std::deque<Record> queue;
+    std::vector<ThreadBuffer*> buffers;
+    {
+        std::scoped_lock _(ctx->lock);
+        queue.swap(ctx->queue);
+        buffers = ctx->buffers;
+    }
+    for (const Record& rec : queue) {
+        batch.AddText(rec);
+    }
+    for (ThreadBuffer* buffer : buffers) {
+        // Check before consuming, the owner could exit in between
+        const bool closed = buffer->IsClosed();
+        buffer->Consume([&](const RecordHeader& header, const std::byte* args) {
+            batch.AddBinary(header, args);
+        });
+        if (const uint64_t numDropped = buffer->TakeDropped()) {
+            batch.AddDropped(numDropped);
+        }
+        if (closed) {
+            std::scoped_lock _(ctx->lock);
+            std::erase(ctx->buffers, buffer);
+            delete buffer;
+        }
+    }
 }
 
 void LogProc() {
-    auto logFilename = std::string(ctx->logDir).append("\\log.txt");
-    std::ofstream logFile(logFilename);
-    if (logFile.fail()) {
+    FileSink logFile(ctx->logDir, ctx->fileOptions);
+    if (!logFile.IsOpen()) {
         std::abort();
     }
 
-    LOGF(Verbose, "Log file {} has been opened.", logFilename);
+    LOGF(Verbose, "Log file {} has been opened.",
+         logFile.GetCurrentPath().string());
 
     // Start processing loop.
+    LineBatch batch;
     while (true) {
-        ctx->sema.acquire();
-
-        while (true) {
-            Record rec;
-            {
-                std::scoped_lock _(ctx->lock);
-                if (ctx->queue.empty())
-                    break;
-                rec = ctx->queue.front();
-                ctx->queue.pop_front();
-            }
-            auto msg = std::format("{}:{} [{}]: {}", rec.file, rec.line,
-                                   to_string(rec.level), rec.message);
-            logFile << msg << '\n';
-            std::cout << msg << std::endl;
+        // Binary records don't wake up the thread, poll them
+        (void)ctx->sema.try_acquire_for(kPollInterval);
+        ctx->bWakePending.store(false, std::memory_order_release);
+        // Read before collecting so that the records logged before Shutdown()
+        // are written
+        const bool shouldExit = ctx->bShouldExit.load(std::memory_order_acquire);
+
+        CollectRecords(batch);
+        if (!batch.Empty()) {
+            const std::string_view lines = batch.Finalize();
+            logFile.Write(lines);
+            std::cout.write(lines.data(), lines.size());
+            std::cout.flush();
         }
         if (ctx->bFlushFile.load(std::memory_order::relaxed)) {
-            logFile.flush();
+            logFile.Flush();
             ctx->bFlushFile.store(false, std::memory_order::relaxed);
         }
-        if (ctx->bShouldExit.load(std::memory_order::relaxed)) {
+        if (shouldExit) {
             break;
         }
     }
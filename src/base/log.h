@@ -1,7 +1,10 @@
 #pragma once
+#include <atomic>
 #include <chrono>
+#include <cstring>
 #include <stacktrace>
 #include <string>
+#include <tuple>
 
 void PrintToCerr(const std::string& str);
 
@@ -31,8 +34,65 @@ inline const char* to_string(Level level) {
     return "Unknown";
 }
 
+enum class Mode : uint8_t {
+    // Messages are formatted on the calling thread and queued
+    Text,
+    // Only a call site and raw arguments are copied into a per-thread ring
+    // buffer. Formatting is done on the logger thread. If the buffer is full
+    // the record is dropped, producers never block
+    Binary,
+};
+
+// Records above this level are compiled out
+// Set with -DLOG_COMPILE_LEVEL=<Level>, e.g. -DLOG_COMPILE_LEVEL=Warning
+#ifndef LOG_COMPILE_LEVEL
+#define LOG_COMPILE_LEVEL Verbose
+#endif
+
+constexpr Level kCompileLevel = Level::LOG_COMPILE_LEVEL;
+
+// Fatal records are never compiled out
+constexpr bool IsCompiledIn(Level level) {
+    return level <= kCompileLevel || level == Level::Fatal;
+}
+
 using time_point = std::chrono::high_resolution_clock::time_point;
 
+// Runtime level of a single call site
+// Resolved on the first call from the global and module levels and updated
+// by SetLevel() and SetModuleLevel()
+// Constant initialized, so the check is a single relaxed load
+class SiteFilter {
+public:
+    constexpr SiteFilter() : level_(kUnresolved) {}
+
+    // Passes if not resolved yet
+    bool Passes(Level level) const {
+        return level <= level_.load(std::memory_order_relaxed);
+    }
+
+    bool IsResolved() const {
+        return level_.load(std::memory_order_relaxed) != kUnresolved;
+    }
+
+    void Set(Level level) { level_.store(level, std::memory_order_relaxed); }
+
+private:
+    static constexpr Level kUnresolved = Level::_Count;
+    std::atomic<Level> level_;
+};
+
+// Static data of a log call site, defined by the LOG macros
+// Binary records store a pointer to it instead of copying the strings
+struct Site {
+    Level level;
+    std::string_view file;
+    uint32_t line;
+    std::string_view func;
+    std::string_view format;
+    SiteFilter* filter;
+};
+
 struct Record {
     Level level;
     std::string_view file;
@@ -44,28 +104,147 @@ struct Record {
     // TODO add thread id
 };
 
+struct FileSinkOptions;
+
 // Creates a logger thread and a file in the logDirectory
-void Init(const std::string& logDirectory);
+void Init(const std::string& logDirectory, Mode mode = Mode::Text);
+void Init(const std::string& logDirectory,
+          Mode mode,
+          const FileSinkOptions& fileOptions);
 bool IsInitialized();
+bool IsBinaryMode();
 void Shutdown();
 void Flush();
+// Sets the global level. Overridden by module levels
 void SetLevel(Level level);
+// Sets a level of all call sites in files which path contains |module|
+// The longest match wins. E.g. SetModuleLevel("gpu/shader/wgsl", Level::Info)
+void SetModuleLevel(std::string_view module, Level level);
+void ClearModuleLevel(std::string_view module);
 bool ShouldLog(Level level);
+// Computes the level of a call site on the first call
+// Returns true if the site passes
+bool ResolveFilter(const Site& site);
 void DoLog(Record&& record);
 
+namespace detail {
+
+// Formats a binary record |args| with |format| and appends to |out|
+using FormatFn = void (*)(std::string_view format,
+                          const std::byte* args,
+                          std::string& out);
+
+// Reserves space for a record in the thread's buffer
+// Returns a pointer to the arguments area or nullptr if the buffer is full
+// or the thread is exiting
+std::byte* BeginRecord(const Site& site, FormatFn format, size_t argsSize);
+void EndRecord();
+
+// Arguments copied as a length and characters
+template <class T>
+constexpr bool kIsStringArg =
+    std::is_same_v<T, std::string> || std::is_same_v<T, std::string_view> ||
+    std::is_same_v<T, const char*> || std::is_same_v<T, char*>;
+
+// Arguments copied as is
+template <class T>
+constexpr bool kIsRawArg =
+    std::is_arithmetic_v<T> || std::is_enum_v<T> ||
+    std::is_null_pointer_v<T> || (std::is_pointer_v<T> && !kIsStringArg<T>);
+
+// Decoded arguments format the same as the originals with any spec
+// A record with other arguments is formatted on the calling thread
+template <class T>
+constexpr bool kIsDeferredArg = kIsRawArg<T> || kIsStringArg<T>;
+
+template <class T>
+using Decoded = std::conditional_t<kIsRawArg<T>, T, std::string_view>;
+
+template <class T>
+size_t EncodedSize(const T& arg) {
+    if constexpr (kIsRawArg<T>) {
+        return sizeof(T);
+    } else {
+        return sizeof(uint32_t) + std::string_view(arg).size();
+    }
+}
+
+template <class T>
+void Encode(std::byte*& data, const T& arg) {
+    if constexpr (kIsRawArg<T>) {
+        std::memcpy(data, &arg, sizeof(T));
+        data += sizeof(T);
+    } else {
+        const std::string_view str(arg);
+        const auto size = (uint32_t)str.size();
+        std::memcpy(data, &size, sizeof(size));
+        std::memcpy(data + sizeof(size), str.data(), size);
+        data += sizeof(size) + size;
+    }
+}
+
+template <class T>
+Decoded<T> Decode(const std::byte*& data) {
+    if constexpr (kIsRawArg<T>) {
+        T value;
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return value;
+    } else {
+        uint32_t size;
+        std::memcpy(&size, data, sizeof(size));
+        const auto* str = reinterpret_cast<const char*>(data + sizeof(size));
+        data += sizeof(size) + size;
+        return std::string_view(str, size);
+    }
+}
+
+template <class... Args>
+void FormatRecord(std::string_view format,
+                  const std::byte* data,
+                  std::string& out) {
+    // Braced init evaluates left to right
+    std::tuple<Decoded<Args>...> args{Decode<Args>(data)...};
+    std::apply(
+        [&](auto&... args) {
+            std::vformat_to(std::back_inserter(out), format,
+                            std::make_format_args(args...));
+        },
+        args);
+}
+
+// A record formatted by the caller, the format of the site is not used
+inline void FormatMessage(std::string_view,
+                          const std::byte* data,
+                          std::string& out) {
+    out += Decode<std::string_view>(data);
+}
+
+template <class... Args>
+void WriteRecord(const Site& site, FormatFn format, const Args&... args) {
+    const size_t argsSize = (EncodedSize(args) + ... + 0);
+    std::byte* data = BeginRecord(site, format, argsSize);
+    if (!data) {
+        return;
+    }
+    (Encode(data, args), ...);
+    EndRecord();
+}
+
+}  // namespace detail
+
+
+namespace detail {
 
 template <typename... ArgTypes>
-inline void Logf(std::string_view file,
-                 uint32_t line,
-                 std::string_view func,
-                 Level level,
-                 const std::format_string<ArgTypes...> fmt,
-                 ArgTypes... args) {
+inline void LogText(std::string_view file,
+                    uint32_t line,
+                    std::string_view func,
+                    Level level,
+                    const std::format_string<ArgTypes...> fmt,
+                    ArgTypes... args) {
     // If not initialized (in tests) just print to cerr
     if (!IsInitialized()) {
-        if (!ShouldLog(level)) {
-            return;
-        }
         // Print location for errors and crashes
         if (level < Level::Warning) {
             PrintToCerr(std::format("[{}] {}({}) in {}:", to_string(level),
@@ -81,9 +260,6 @@ inline void Logf(std::string_view file,
         }
         return;
     }
-    if (!ShouldLog(level)) {
-        return;
-    }
     DoLog(Record{.level = level,
                  .file = file,
                  .func = func,
@@ -93,27 +269,75 @@ inline void Logf(std::string_view file,
                  .message = std::format(fmt, std::forward<ArgTypes>(args)...)});
 }
 
+}  // namespace detail
+
+template <typename... ArgTypes>
+inline void Logf(std::string_view file,
+                 uint32_t line,
+                 std::string_view func,
+                 Level level,
+                 const std::format_string<ArgTypes...> fmt,
+                 ArgTypes... args) {
+    if (!ShouldLog(level)) {
+        return;
+    }
+    detail::LogText(file, line, func, level, fmt,
+                    std::forward<ArgTypes>(args)...);
+}
+
+// Called by the LOG macros after the site filter has passed
+template <typename... ArgTypes>
+inline void Logf(const Site& site,
+                 const std::format_string<ArgTypes...> fmt,
+                 ArgTypes... args) {
+    // Fatal errors are always formatted and flushed synchronously
+    if (site.level != Level::Fatal && IsInitialized() && IsBinaryMode()) {
+        if constexpr ((detail::kIsDeferredArg<ArgTypes> && ...)) {
+            detail::WriteRecord(site, &detail::FormatRecord<ArgTypes...>,
+                                args...);
+        } else {
+            // The decoded string of an argument would be formatted with the
+            // spec of the original type, format with the full specs here
+            detail::WriteRecord(
+                site, &detail::FormatMessage,
+                std::format(fmt, std::forward<ArgTypes>(args)...));
+        }
+        return;
+    }
+    detail::LogText(site.file, site.line, site.func, site.level, fmt,
+                    std::forward<ArgTypes>(args)...);
+}
+
 }  // namespace logging
 
-#define LOGF(level, fmt, ...)                                              \
-    logging::Logf(__FILE__, __LINE__, __FUNCTION__, logging::Level::level, \
-                  fmt, __VA_ARGS__);
+// Disabled levels are compiled out. Enabled levels are checked against
+// the site filter before the arguments are evaluated
+#define LOG_IMPL(level, fmt, ...)                                             \
+    do {                                                                      \
+        if constexpr (logging::IsCompiledIn(level)) {                         \
+            static constinit logging::SiteFilter _logFilter;                  \
+            static constexpr logging::Site _logSite{                          \
+                level, __FILE__, __LINE__, __FUNCTION__, fmt, &_logFilter};   \
+            if (_logFilter.Passes(level) &&                                   \
+                (_logFilter.IsResolved() ||                                   \
+                 logging::ResolveFilter(_logSite))) {                         \
+                logging::Logf(_logSite, fmt, __VA_ARGS__);                    \
+            }                                                                 \
+        }                                                                     \
+    } while (false)
+
+#define LOGF(level, fmt, ...) \
+    LOG_IMPL(logging::Level::level, fmt, __VA_ARGS__)
 
-#define LOG_VERBOSE(fmt, ...)                                                \
-    logging::Logf(__FILE__, __LINE__, __FUNCTION__, logging::Level::Verbose, \
-                  fmt, __VA_ARGS__);
+#define LOG_VERBOSE(fmt, ...) \
+    LOG_IMPL(logging::Level::Verbose, fmt, __VA_ARGS__)
 
-#define LOG_INFO(fmt, ...)                                                     \
-    logging::Logf(__FILE__, __LINE__, __FUNCTION__, logging::Level::Info, fmt, \
-                  __VA_ARGS__);
+#define LOG_INFO(fmt, ...) LOG_IMPL(logging::Level::Info, fmt, __VA_ARGS__)
 
-#define LOG_WARNING(fmt, ...)                                                \
-    logging::Logf(__FILE__, __LINE__, __FUNCTION__, logging::Level::Warning, \
-                  fmt, __VA_ARGS__);
+#define LOG_WARNING(fmt, ...) \
+    LOG_IMPL(logging::Level::Warning, fmt, __VA_ARGS__)
 
-#define LOG_ERROR(fmt, ...)                                                \
-    logging::Logf(__FILE__, __LINE__, __FUNCTION__, logging::Level::Error, \
-                  fmt, __VA_ARGS__);
+#define LOG_ERROR(fmt, ...) LOG_IMPL(logging::Level::Error, fmt, __VA_ARGS__)
 
 // Simple formatter cout print w/o location
 template <class... Types>
@@ -0,0 +1,106 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <memory>
+
+#include "log.h"
+#include "math_util.h"
+
+namespace logging {
+
+// Header of a binary record in the ThreadBuffer followed by the arguments
+struct RecordHeader {
+    // Full size of the record, including the header
+    uint32_t size;
+    // Skip to the beginning of the buffer
+    uint32_t isPadding;
+    const Site* site;
+    detail::FormatFn format;
+    time_point::rep timestamp;
+};
+constexpr size_t kRecordAlign = alignof(RecordHeader);
+
+// Single producer single consumer ring buffer of binary records
+// The producer is the owning thread, the consumer is the logger thread
+// Records are contiguous, if a record doesn't fit at the end a padding
+// record is written and the buffer wraps
+class ThreadBuffer {
+public:
+    explicit ThreadBuffer(size_t capacity)
+        : data_(new RecordHeader[capacity / sizeof(RecordHeader)])
+        , capacity_(capacity) {
+        DASSERT(std::has_single_bit(capacity));
+    }
+
+    // Returns nullptr if there is not enough space
+    std::byte* Reserve(size_t size) {
+        size = AlignUp(size, kRecordAlign);
+        uint64_t pos = writePos_.load(std::memory_order_relaxed);
+        const size_t tail = capacity_ - (pos & (capacity_ - 1));
+        const size_t required = size <= tail ? size : size + tail;
+        if (pos + required - cachedReadPos_ > capacity_) {
+            cachedReadPos_ = readPos_.load(std::memory_order_acquire);
+            if (pos + required - cachedReadPos_ > capacity_) {
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+                return nullptr;
+            }
+        }
+        if (size > tail) {
+            auto* padding = reinterpret_cast<RecordHeader*>(At(pos));
+            padding->size = (uint32_t)tail;
+            padding->isPadding = true;
+            pos += tail;
+        }
+        pendingPos_ = pos + size;
+        return At(pos);
+    }
+
+    // Makes the last reserved record visible to the consumer
+    // Returns true if the buffer is more than half full
+    bool Commit() {
+        writePos_.store(pendingPos_, std::memory_order_release);
+        return pendingPos_ - cachedReadPos_ > capacity_ / 2;
+    }
+
+    template <class Fn>
+    void Consume(Fn&& fn) {
+        const uint64_t end = writePos_.load(std::memory_order_acquire);
+        uint64_t pos = readPos_.load(std::memory_order_relaxed);
+        while (pos != end) {
+            const auto* header = reinterpret_cast<const RecordHeader*>(At(pos));
+            if (!header->isPadding) {
+                fn(*header, reinterpret_cast<const std::byte*>(header + 1));
+            }
+            pos += header->size;
+        }
+        readPos_.store(pos, std::memory_order_release);
+    }
+
+    uint64_t TakeDropped() {
+        return dropped_.exchange(0, std::memory_order_relaxed);
+    }
+
+    // The owning thread has exited
+    void Close() { closed_.store(true, std::memory_order_release); }
+    bool IsClosed() const { return closed_.load(std::memory_order_acquire); }
+
+private:
+    std::byte* At(uint64_t pos) {
+        return reinterpret_cast<std::byte*>(data_.get()) +
+               (pos & (capacity_ - 1));
+    }
+
+private:
+    std::unique_ptr<RecordHeader[]> data_;
+    const size_t capacity_;
+    // Producer
+    alignas(64) std::atomic<uint64_t> writePos_ = 0;
+    uint64_t cachedReadPos_ = 0;
+    uint64_t pendingPos_ = 0;
+    std::atomic<uint64_t> dropped_ = 0;
+    // Consumer
+    alignas(64) std::atomic<uint64_t> readPos_ = 0;
+    std::atomic_bool closed_ = false;
+};
+
+}  // namespace logging
@@ -0,0 +1,248 @@
+#include "log_file.h"
+#include "error.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace logging {
+
+constexpr std::string_view kSegmentExtension = ".txt";
+constexpr std::string_view kCompressedExtension = ".xpress";
+constexpr size_t kTrimBlockSize = 64 * 1024;
+
+namespace {
+
+// Truncates zeros left at the end of a preallocated segment after a crash
+void TrimSegment(const fs::path& path) {
+    std::error_code ec;
+    const uint64_t size = fs::file_size(path, ec);
+    if (ec) {
+        return;
+    }
+    uint64_t end = size;
+    {
+        std::ifstream file(path, std::ios::binary);
+        std::vector<char> block(kTrimBlockSize);
+        while (end > 0 && file) {
+            const uint64_t begin = end > block.size() ? end - block.size() : 0;
+            file.seekg((std::streamoff)begin);
+            file.read(block.data(), (std::streamsize)(end - begin));
+            const auto blockEnd = block.begin() + (end - begin);
+            const auto it = std::find_if(std::make_reverse_iterator(blockEnd),
+                                         block.rend(),
+                                         [](char c) { return c != 0; });
+            if (it != block.rend()) {
+                end = begin + (it.base() - block.begin());
+                break;
+            }
+            end = begin;
+        }
+    }
+    if (end != size) {
+        fs::resize_file(path, end, ec);
+    }
+}
+
+}  // namespace
+
+FileSink::FileSink(const fs::path& dir, const FileSinkOptions& options)
+    : dir_(dir), options_(options) {
+    DASSERT(options_.segmentSize > 0 && options_.maxSegments > 0);
+    std::error_code ec;
+    fs::create_directories(dir_, ec);
+    // Continue after the last segment of the previous run
+    uint64_t lastIndex = 0;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        lastIndex = std::max(lastIndex, ParseSegmentIndex(entry.path()));
+    }
+    if (lastIndex != 0 && fs::exists(GetSegmentPath(lastIndex), ec)) {
+        TrimSegment(GetSegmentPath(lastIndex));
+    }
+    segmentIndex_ = lastIndex + 1;
+    if (options_.compressClosed) {
+        compressThread_ = std::thread(&FileSink::CompressProc, this);
+    }
+    OpenSegment();
+    DeleteOldSegments();
+}
+
+FileSink::~FileSink() {
+    CloseSegment();
+    if (compressThread_.joinable()) {
+        {
+            std::scoped_lock _(compressLock_);
+            bStopCompress_ = true;
+        }
+        compressCond_.notify_one();
+        compressThread_.join();
+    }
+}
+
+void FileSink::Write(std::string_view data) {
+    while (!data.empty()) {
+        if (NeedsRotation(data.size())) {
+            Rotate();
+        }
+        if (!IsOpen()) {
+            return;
+        }
+        const size_t size =
+            (size_t)std::min<uint64_t>(data.size(), segment_.size - written_);
+        std::memcpy((char*)segment_.data + written_, data.data(), size);
+        written_ += size;
+        data.remove_prefix(size);
+    }
+}
+
+void FileSink::Flush() {
+    if (IsOpen()) {
+        windows::FlushMappedFile(segment_);
+    }
+}
+
+bool FileSink::NeedsRotation(size_t size) const {
+    if (!IsOpen()) {
+        return true;
+    }
+    if (written_ == 0) {
+        return false;
+    }
+    if (written_ + size > segment_.size) {
+        return true;
+    }
+    return options_.maxSegmentAge.count() > 0 &&
+           Clock::now() - openTime_ >= options_.maxSegmentAge;
+}
+
+void FileSink::Rotate() {
+    if (IsOpen()) {
+        CloseSegment();
+        ++segmentIndex_;
+    }
+    if (OpenSegment()) {
+        DeleteOldSegments();
+    }
+}
+
+bool FileSink::OpenSegment() {
+    const fs::path path = GetSegmentPath(segmentIndex_);
+    if (!windows::CreateMappedFile(path.wstring().c_str(), options_.segmentSize,
+                                   segment_)) {
+        PrintToCerr(std::format("Cannot create a log file {}", path.string()));
+        return false;
+    }
+    written_ = 0;
+    openTime_ = Clock::now();
+    return true;
+}
+
+void FileSink::CloseSegment() {
+    if (!IsOpen()) {
+        return;
+    }
+    windows::CloseMappedFile(segment_, written_);
+    if (options_.compressClosed) {
+        {
+            std::scoped_lock _(compressLock_);
+            compressQueue_.push_back(GetSegmentPath(segmentIndex_));
+        }
+        compressCond_.notify_one();
+    }
+}
+
+void FileSink::DeleteOldSegments() {
+    std::error_code ec;
+    std::vector<std::pair<uint64_t, fs::path>> segments;
+    for (const auto& entry : fs::directory_iterator(dir_, ec)) {
+        if (const uint64_t index = ParseSegmentIndex(entry.path())) {
+            segments.emplace_back(index, entry.path());
+        }
+    }
+    if (segments.size() <= options_.maxSegments) {
+        return;
+    }
+    std::ranges::sort(segments);
+    const size_t numToDelete = segments.size() - options_.maxSegments;
+    for (size_t i = 0; i < numToDelete; ++i) {
+        // Could be opened by the compressor, skipped until the next rotation
+        fs::remove(segments[i].second, ec);
+    }
+}
+
+fs::path FileSink::GetSegmentPath(uint64_t index) const {
+    return dir_ / std::format("{}_{:06}{}", options_.baseName, index,
+                              kSegmentExtension);
+}
+
+uint64_t FileSink::ParseSegmentIndex(const fs::path& path) const {
+    std::string name = path.filename().string();
+    if (name.ends_with(kCompressedExtension)) {
+        name.resize(name.size() - kCompressedExtension.size());
+    }
+    if (!name.starts_with(options_.baseName) ||
+        !name.ends_with(kSegmentExtension)) {
+        return 0;
+    }
+    const std::string_view str =
+        std::string_view(name).substr(options_.baseName.size());
+    if (str.size() <= kSegmentExtension.size() + 1 || str.front() != '_') {
+        return 0;
+    }
+    const std::string_view digits =
+        str.substr(1, str.size() - kSegmentExtension.size() - 1);
+    uint64_t index = 0;
+    const auto [ptr, err] =
+        std::from_chars(digits.data(), digits.data() + digits.size(), index);
+    if (err != std::errc() || ptr != digits.data() + digits.size()) {
+        return 0;
+    }
+    return index;
+}
+
+void FileSink::CompressProc() {
+    while (true) {
+        fs::path path;
+        {
+            std::unique_lock lock(compressLock_);
+            compressCond_.wait(lock, [this] {
+                return bStopCompress_ || !compressQueue_.empty();
+            });
+            if (compressQueue_.empty()) {
+                return;
+            }
+            path = std::move(compressQueue_.front());
+            compressQueue_.pop_front();
+        }
+        std::string data;
+        {
+            std::ifstream file(path, std::ios::binary);
+            if (!file) {
+                continue;
+            }
+            data.assign(std::istreambuf_iterator<char>(file), {});
+        }
+        std::vector<uint8_t> compressed;
+        if (!windows::CompressBuffer(data.data(), data.size(), compressed)) {
+            continue;
+        }
+        fs::path compressedPath = path;
+        compressedPath += kCompressedExtension;
+        {
+            std::ofstream file(compressedPath, std::ios::binary);
+            file.write((const char*)compressed.data(),
+                       (std::streamsize)compressed.size());
+            if (!file) {
+                continue;
+            }
+        }
+        std::error_code ec;
+        fs::remove(path, ec);
+    }
+}
+
+}  // namespace logging
@@ -0,0 +1,80 @@
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <filesystem>
+#include <mutex>
+#include <string_view>
+#include <thread>
+
+#include "win_minimal.h"
+
+namespace logging {
+
+struct FileSinkOptions {
+    std::string baseName = "log";
+    // Segment files are preallocated to this size and truncated when closed
+    uint64_t segmentSize = 16 * 1024 * 1024;
+    // The oldest segments are deleted when exceeded
+    uint32_t maxSegments = 8;
+    // Rotate when the segment is older. 0 to disable
+    std::chrono::seconds maxSegmentAge = std::chrono::hours(24);
+    // Compress closed segments on a background thread
+    bool compressClosed = false;
+};
+
+// Writes into a ring of memory mapped segment files:
+//   <dir>/log_000001.txt, <dir>/log_000002.txt, ...
+// Written pages are owned by the OS, so the data survives a crash of the
+// process. Flush() also makes it durable against a crash of the system
+class FileSink {
+public:
+    FileSink(const std::filesystem::path& dir, const FileSinkOptions& options);
+    ~FileSink();
+
+    FileSink(const FileSink&) = delete;
+    FileSink& operator=(const FileSink&) = delete;
+
+    bool IsOpen() const { return segment_.data != nullptr; }
+
+    void Write(std::string_view data);
+    void Flush();
+
+    std::filesystem::path GetCurrentPath() const {
+        return GetSegmentPath(segmentIndex_);
+    }
+
+private:
+    bool OpenSegment();
+    void CloseSegment();
+    void Rotate();
+    bool NeedsRotation(size_t size) const;
+    // Deletes the oldest segments over the limit
+    void DeleteOldSegments();
+
+    std::filesystem::path GetSegmentPath(uint64_t index) const;
+    // Returns the index of a segment file or 0
+    uint64_t ParseSegmentIndex(const std::filesystem::path& path) const;
+
+    void CompressProc();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    std::filesystem::path dir_;
+    FileSinkOptions options_;
+
+    windows::MappedFile segment_;
+    uint64_t segmentIndex_ = 0;
+    uint64_t written_ = 0;
+    Clock::time_point openTime_;
+
+    // Closed segments to compress
+    std::thread compressThread_;
+    std::mutex compressLock_;
+    std::condition_variable compressCond_;
+    std::deque<std::filesystem::path> compressQueue_;
+    bool bStopCompress_ = false;
+};
+
+}  // namespace logging
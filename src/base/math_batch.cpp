@@ -0,0 +1,289 @@
+#include "math_util.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define MATH_X64
+#include <immintrin.h>
+#endif
+
+namespace math {
+
+namespace {
+
+static_assert(sizeof(float2) == 2 * sizeof(float));
+
+float* AsFloats(std::span<float2> points) {
+    return reinterpret_cast<float*>(points.data());
+}
+
+}  // namespace
+
+namespace scalar {
+
+void Contains(const RectBatch& rects, float2 point, bool* out) {
+    for (size_t i = 0; i < rects.Size(); ++i) {
+        out[i] = rects.Get(i).Contains(point);
+    }
+}
+
+size_t FindLastContaining(const RectBatch& rects, float2 point) {
+    for (size_t i = rects.Size(); i; --i) {
+        if (rects.Get(i - 1).Contains(point)) {
+            return i - 1;
+        }
+    }
+    return kNotFound;
+}
+
+void Intersects(const RectBatch& rects, const Rect& rect, bool* out) {
+    for (size_t i = 0; i < rects.Size(); ++i) {
+        out[i] = rects.Get(i).Intersects(rect);
+    }
+}
+
+// The arrays are processed one by one, which the compilers vectorize
+void Clip(RectBatch& rects, const Rect& clipRect) {
+    for (size_t i = 0; i < rects.Size(); ++i) {
+        rects.MinX()[i] = Max(rects.MinX()[i], clipRect.min.x);
+        rects.MinY()[i] = Max(rects.MinY()[i], clipRect.min.y);
+        rects.MaxX()[i] = Min(rects.MaxX()[i], clipRect.max.x);
+        rects.MaxY()[i] = Min(rects.MaxY()[i], clipRect.max.y);
+    }
+}
+
+Rect Union(const RectBatch& rects) {
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    Rect out(kInf, kInf, -kInf, -kInf);
+    for (size_t i = 0; i < rects.Size(); ++i) {
+        const Rect rect = rects.Get(i);
+        out.min.x = Min(rect.min.x, out.min.x);
+        out.min.y = Min(rect.min.y, out.min.y);
+        out.max.x = Max(rect.max.x, out.max.x);
+        out.max.y = Max(rect.max.y, out.max.y);
+    }
+    return out;
+}
+
+void TranslateRects(RectBatch& rects, float2 offset) {
+    for (size_t i = 0; i < rects.Size(); ++i) {
+        rects.MinX()[i] += offset.x;
+        rects.MinY()[i] += offset.y;
+        rects.MaxX()[i] += offset.x;
+        rects.MaxY()[i] += offset.y;
+    }
+}
+
+void RoundRects(RectBatch& rects) {
+    for (float* array :
+         {rects.MinX(), rects.MinY(), rects.MaxX(), rects.MaxY()}) {
+        for (size_t i = 0; i < rects.Size(); ++i) {
+            array[i] = std::floor(array[i]);
+        }
+    }
+}
+
+void TranslatePoints(std::span<float2> points, float2 offset) {
+    for (float2& point : points) {
+        point += offset;
+    }
+}
+
+void RoundPoints(std::span<float2> points) {
+    for (float2& point : points) {
+        point = {std::floor(point.x), std::floor(point.y)};
+    }
+}
+
+void ClampPoints(std::span<float2> points, float2 min, float2 max) {
+    for (float2& point : points) {
+        point = Clamp(point, min, max);
+    }
+}
+
+}  // namespace scalar
+
+#ifdef MATH_X64
+
+namespace sse2 {
+
+struct Simd {
+    using V = __m128;
+
+    static constexpr size_t kWidth = 4;
+
+    static V Load(const float* in) { return _mm_loadu_ps(in); }
+    static void Store(float* out, V value) { _mm_storeu_ps(out, value); }
+    static V Set(float value) { return _mm_set1_ps(value); }
+    static V SetPair(float x, float y) { return _mm_setr_ps(x, y, x, y); }
+
+    static V Add(V a, V b) { return _mm_add_ps(a, b); }
+    static V Min(V a, V b) { return _mm_min_ps(a, b); }
+    static V Max(V a, V b) { return _mm_max_ps(a, b); }
+    static V Less(V a, V b) { return _mm_cmplt_ps(a, b); }
+    static V Greater(V a, V b) { return _mm_cmpgt_ps(a, b); }
+    static V And(V a, V b) { return _mm_and_ps(a, b); }
+    static V Or(V a, V b) { return _mm_or_ps(a, b); }
+
+    static V Select(V mask, V a, V b) {
+        return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b));
+    }
+
+    static uint32_t MoveMask(V mask) {
+        return (uint32_t)_mm_movemask_ps(mask);
+    }
+
+    // No round instruction before SSE4.1: truncates and steps down the
+    // negative fractions. Floats from 2^23 up, inf and nan are whole
+    static V Floor(V value) {
+        const V sign = _mm_set1_ps(-0.f);
+        const V isFraction = _mm_cmplt_ps(_mm_andnot_ps(sign, value),
+                                          _mm_set1_ps(8388608.f));
+        V truncated = _mm_cvtepi32_ps(_mm_cvttps_epi32(value));
+        truncated = _mm_sub_ps(
+            truncated,
+            _mm_and_ps(_mm_cmpgt_ps(truncated, value), _mm_set1_ps(1.f)));
+        // Keeps -0 like std::floor
+        truncated = _mm_or_ps(truncated, _mm_and_ps(value, sign));
+        return Select(isFraction, truncated, value);
+    }
+};
+
+#include "math_batch_kernels.inl"
+
+}  // namespace sse2
+
+// MSVC emits any intrinsic, other compilers need the target enabled
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx"))), \
+                             apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx")
+#endif
+
+namespace avx {
+
+struct Simd {
+    using V = __m256;
+
+    static constexpr size_t kWidth = 8;
+
+    static V Load(const float* in) { return _mm256_loadu_ps(in); }
+    static void Store(float* out, V value) { _mm256_storeu_ps(out, value); }
+    static V Set(float value) { return _mm256_set1_ps(value); }
+
+    static V SetPair(float x, float y) {
+        return _mm256_setr_ps(x, y, x, y, x, y, x, y);
+    }
+
+    static V Add(V a, V b) { return _mm256_add_ps(a, b); }
+    static V Min(V a, V b) { return _mm256_min_ps(a, b); }
+    static V Max(V a, V b) { return _mm256_max_ps(a, b); }
+    static V Less(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static V Greater(V a, V b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static V And(V a, V b) { return _mm256_and_ps(a, b); }
+    static V Or(V a, V b) { return _mm256_or_ps(a, b); }
+    static V Select(V mask, V a, V b) { return _mm256_blendv_ps(b, a, mask); }
+
+    static uint32_t MoveMask(V mask) {
+        return (uint32_t)_mm256_movemask_ps(mask);
+    }
+
+    static V Floor(V value) { return _mm256_floor_ps(value); }
+};
+
+#include "math_batch_kernels.inl"
+
+}  // namespace avx
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif  // MATH_X64
+
+namespace {
+
+struct Kernels {
+    void (*contains)(const RectBatch&, float2, bool*);
+    size_t (*findLastContaining)(const RectBatch&, float2);
+    void (*intersects)(const RectBatch&, const Rect&, bool*);
+    void (*clip)(RectBatch&, const Rect&);
+    Rect (*unite)(const RectBatch&);
+    void (*translateRects)(RectBatch&, float2);
+    void (*roundRects)(RectBatch&);
+    void (*translatePoints)(std::span<float2>, float2);
+    void (*roundPoints)(std::span<float2>);
+    void (*clampPoints)(std::span<float2>, float2, float2);
+};
+
+#define MATH_KERNELS(NS)                                                    \
+    Kernels{&NS::Contains,       &NS::FindLastContaining,                   \
+            &NS::Intersects,     &NS::Clip,                                 \
+            &NS::Union,          &NS::TranslateRects,                       \
+            &NS::RoundRects,     &NS::TranslatePoints,                      \
+            &NS::RoundPoints,    &NS::ClampPoints}
+
+// Indexed by cpu::SimdLevel, AVX2 cpus run the AVX kernels
+const Kernels kKernels[] = {
+    MATH_KERNELS(scalar),
+#ifdef MATH_X64
+    MATH_KERNELS(sse2),
+    MATH_KERNELS(avx),
+#endif
+};
+
+#undef MATH_KERNELS
+
+const Kernels& GetKernels() {
+    return kKernels[(size_t)cpu::GetSimdLevel()];
+}
+
+}  // namespace
+
+void Contains(const RectBatch& rects, float2 point, bool* out) {
+    GetKernels().contains(rects, point, out);
+}
+
+size_t FindLastContaining(const RectBatch& rects, float2 point) {
+    return GetKernels().findLastContaining(rects, point);
+}
+
+void Intersects(const RectBatch& rects, const Rect& rect, bool* out) {
+    GetKernels().intersects(rects, rect, out);
+}
+
+void Clip(RectBatch& rects, const Rect& clipRect) {
+    GetKernels().clip(rects, clipRect);
+}
+
+Rect Union(const RectBatch& rects) {
+    return GetKernels().unite(rects);
+}
+
+void Translate(RectBatch& rects, float2 offset) {
+    GetKernels().translateRects(rects, offset);
+}
+
+void Round(RectBatch& rects) {
+    GetKernels().roundRects(rects);
+}
+
+void Translate(std::span<float2> points, float2 offset) {
+    GetKernels().translatePoints(points, offset);
+}
+
+void Round(std::span<float2> points) {
+    GetKernels().roundPoints(points);
+}
+
+void Clamp(std::span<float2> points, float2 min, float2 max) {
+    GetKernels().clampPoints(points, min, max);
+}
+
+}  // namespace math
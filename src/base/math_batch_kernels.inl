@@ -0,0 +1,181 @@
+// Batch geometry kernels shared by the instruction sets
+// Included by math_batch.cpp into a namespace which defines a Simd policy:
+//   V, kWidth          Vector of kWidth floats
+//   Load, Store        Unaligned
+//   Set(f)             Broadcast
+//   SetPair(x, y)      x, y, x, y... for the interleaved points
+//   Less, Greater      Lane masks
+//   Select(m, a, b)    m ? a : b
+//   Min(a, b)          a < b ? a : b, same as math::Min
+//   Max(a, b)          a > b ? a : b, same as math::Max
+//   Floor, MoveMask
+// The rect arrays are padded to a multiple of RectBatch::kPadding, which
+// is a multiple of kWidth, so blocks never need a tail.
+// Compiled for the target of the including namespace.
+
+static_assert(RectBatch::kPadding % Simd::kWidth == 0);
+
+inline uint32_t ContainsMask(const RectBatch& rects,
+                             size_t i,
+                             Simd::V x,
+                             Simd::V y) {
+    using S = Simd;
+    const S::V inside = S::And(
+        S::And(S::Greater(x, S::Load(rects.MinX() + i)),
+               S::Less(x, S::Load(rects.MaxX() + i))),
+        S::And(S::Greater(y, S::Load(rects.MinY() + i)),
+               S::Less(y, S::Load(rects.MaxY() + i))));
+    return S::MoveMask(inside);
+}
+
+// Writes the bits of the real rects of a block
+inline void StoreMask(uint32_t mask, size_t i, size_t size, bool* out) {
+    const size_t count = std::min(Simd::kWidth, size - i);
+    for (size_t j = 0; j < count; ++j) {
+        out[i + j] = (mask >> j) & 1;
+    }
+}
+
+void Contains(const RectBatch& rects, float2 point, bool* out) {
+    const Simd::V x = Simd::Set(point.x);
+    const Simd::V y = Simd::Set(point.y);
+    for (size_t i = 0; i < rects.Size(); i += Simd::kWidth) {
+        StoreMask(ContainsMask(rects, i, x, y), i, rects.Size(), out);
+    }
+}
+
+size_t FindLastContaining(const RectBatch& rects, float2 point) {
+    const Simd::V x = Simd::Set(point.x);
+    const Simd::V y = Simd::Set(point.y);
+    // The padding never contains a point
+    size_t i = (rects.Size() + Simd::kWidth - 1) / Simd::kWidth * Simd::kWidth;
+    while (i) {
+        i -= Simd::kWidth;
+        if (const uint32_t mask = ContainsMask(rects, i, x, y)) {
+            return i + (31 - (size_t)std::countl_zero(mask));
+        }
+    }
+    return kNotFound;
+}
+
+void Intersects(const RectBatch& rects, const Rect& rect, bool* out) {
+    using S = Simd;
+    const S::V minX = S::Set(rect.min.x);
+    const S::V minY = S::Set(rect.min.y);
+    const S::V maxX = S::Set(rect.max.x);
+    const S::V maxY = S::Set(rect.max.y);
+    for (size_t i = 0; i < rects.Size(); i += S::kWidth) {
+        // Same comparisons as Rect::Intersects for the nan
+        const S::V separated = S::Or(
+            S::Or(S::Less(S::Load(rects.MaxX() + i), minX),
+                  S::Greater(S::Load(rects.MinX() + i), maxX)),
+            S::Or(S::Less(S::Load(rects.MaxY() + i), minY),
+                  S::Greater(S::Load(rects.MinY() + i), maxY)));
+        StoreMask(~S::MoveMask(separated), i, rects.Size(), out);
+    }
+}
+
+void Clip(RectBatch& rects, const Rect& clipRect) {
+    using S = Simd;
+    const S::V minX = S::Set(clipRect.min.x);
+    const S::V minY = S::Set(clipRect.min.y);
+    const S::V maxX = S::Set(clipRect.max.x);
+    const S::V maxY = S::Set(clipRect.max.y);
+    for (size_t i = 0; i < rects.PaddedSize(); i += S::kWidth) {
+        S::Store(rects.MinX() + i, S::Max(S::Load(rects.MinX() + i), minX));
+        S::Store(rects.MinY() + i, S::Max(S::Load(rects.MinY() + i), minY));
+        S::Store(rects.MaxX() + i, S::Min(S::Load(rects.MaxX() + i), maxX));
+        S::Store(rects.MaxY() + i, S::Min(S::Load(rects.MaxY() + i), maxY));
+    }
+}
+
+Rect Union(const RectBatch& rects) {
+    using S = Simd;
+    constexpr float kInf = std::numeric_limits<float>::infinity();
+    S::V minX = S::Set(kInf);
+    S::V minY = S::Set(kInf);
+    S::V maxX = S::Set(-kInf);
+    S::V maxY = S::Set(-kInf);
+    for (size_t i = 0; i < rects.PaddedSize(); i += S::kWidth) {
+        minX = S::Min(S::Load(rects.MinX() + i), minX);
+        minY = S::Min(S::Load(rects.MinY() + i), minY);
+        maxX = S::Max(S::Load(rects.MaxX() + i), maxX);
+        maxY = S::Max(S::Load(rects.MaxY() + i), maxY);
+    }
+    float lanes[4][S::kWidth];
+    S::Store(lanes[0], minX);
+    S::Store(lanes[1], minY);
+    S::Store(lanes[2], maxX);
+    S::Store(lanes[3], maxY);
+    Rect out(kInf, kInf, -kInf, -kInf);
+    for (size_t j = 0; j < S::kWidth; ++j) {
+        out.min.x = math::Min(lanes[0][j], out.min.x);
+        out.min.y = math::Min(lanes[1][j], out.min.y);
+        out.max.x = math::Max(lanes[2][j], out.max.x);
+        out.max.y = math::Max(lanes[3][j], out.max.y);
+    }
+    return out;
+}
+
+void TranslateRects(RectBatch& rects, float2 offset) {
+    using S = Simd;
+    const S::V x = S::Set(offset.x);
+    const S::V y = S::Set(offset.y);
+    for (size_t i = 0; i < rects.PaddedSize(); i += S::kWidth) {
+        S::Store(rects.MinX() + i, S::Add(S::Load(rects.MinX() + i), x));
+        S::Store(rects.MinY() + i, S::Add(S::Load(rects.MinY() + i), y));
+        S::Store(rects.MaxX() + i, S::Add(S::Load(rects.MaxX() + i), x));
+        S::Store(rects.MaxY() + i, S::Add(S::Load(rects.MaxY() + i), y));
+    }
+}
+
+void RoundRects(RectBatch& rects) {
+    using S = Simd;
+    for (float* array :
+         {rects.MinX(), rects.MinY(), rects.MaxX(), rects.MaxY()}) {
+        for (size_t i = 0; i < rects.PaddedSize(); i += S::kWidth) {
+            S::Store(array + i, S::Floor(S::Load(array + i)));
+        }
+    }
+}
+
+// The points are processed as an array of interleaved x and y, the
+// odd point at the end is left to the scalar code
+void TranslatePoints(std::span<float2> points, float2 offset) {
+    using S = Simd;
+    const S::V xy = S::SetPair(offset.x, offset.y);
+    float* data = AsFloats(points);
+    const size_t size = points.size() * 2;
+    size_t i = 0;
+    for (; i + S::kWidth <= size; i += S::kWidth) {
+        S::Store(data + i, S::Add(S::Load(data + i), xy));
+    }
+    scalar::TranslatePoints(points.subspan(i / 2), offset);
+}
+
+void RoundPoints(std::span<float2> points) {
+    using S = Simd;
+    float* data = AsFloats(points);
+    const size_t size = points.size() * 2;
+    size_t i = 0;
+    for (; i + S::kWidth <= size; i += S::kWidth) {
+        S::Store(data + i, S::Floor(S::Load(data + i)));
+    }
+    scalar::RoundPoints(points.subspan(i / 2));
+}
+
+void ClampPoints(std::span<float2> points, float2 min, float2 max) {
+    using S = Simd;
+    const S::V lo = S::SetPair(min.x, min.y);
+    const S::V hi = S::SetPair(max.x, max.y);
+    float* data = AsFloats(points);
+    const size_t size = points.size() * 2;
+    size_t i = 0;
+    for (; i + S::kWidth <= size; i += S::kWidth) {
+        // Same order of the comparisons as math::Clamp
+        const S::V v = S::Load(data + i);
+        const S::V clamped = S::Select(S::Greater(v, hi), hi, v);
+        S::Store(data + i, S::Select(S::Less(v, lo), lo, clamped));
+    }
+    scalar::ClampPoints(points.subspan(i / 2), min, max);
+}
@@ -1,9 +1,13 @@
 #pragma once
 #include <array>
 #include <format>
+#include <limits>
 #include <numeric>
 #include <random>
+#include <span>
+#include <vector>
 
+#include "cpu_features.h"
 #include "error.h"
 
 enum class Axis : uint8_t { X, Y };
@@ -888,6 +892,129 @@ constexpr void Rect::BuildFromPoints(point_type inP0, point_type inP1) {
     }
 }
 
+/*
+ * Rects stored as a structure of arrays for the batch kernels below
+ * The arrays are padded to a multiple of kPadding with inverted rects
+ * (+inf, -inf), which contain and intersect nothing and don't change
+ * a union, so the kernels always process whole blocks
+ */
+class RectBatch {
+public:
+    static constexpr size_t kPadding = 8;
+
+    RectBatch() = default;
+
+    explicit RectBatch(std::span<const Rect> rects) {
+        Reserve(rects.size());
+        for (const Rect& rect : rects) {
+            Push(rect);
+        }
+    }
+
+    void Reserve(size_t count) {
+        for (auto* array : {&minX_, &minY_, &maxX_, &maxY_}) {
+            array->reserve(PaddedSize(count));
+        }
+    }
+
+    void Push(const Rect& rect) {
+        if (size_ == minX_.size()) {
+            const size_t padded = PaddedSize(size_ + 1);
+            minX_.resize(padded, kPadMin);
+            minY_.resize(padded, kPadMin);
+            maxX_.resize(padded, kPadMax);
+            maxY_.resize(padded, kPadMax);
+        }
+        Set(size_++, rect);
+    }
+
+    void Clear() {
+        for (auto* array : {&minX_, &minY_, &maxX_, &maxY_}) {
+            array->clear();
+        }
+        size_ = 0;
+    }
+
+    Rect Get(size_t index) const {
+        DASSERT(index < size_);
+        return {minX_[index], minY_[index], maxX_[index], maxY_[index]};
+    }
+
+    void Set(size_t index, const Rect& rect) {
+        DASSERT(index < size_);
+        minX_[index] = rect.min.x;
+        minY_[index] = rect.min.y;
+        maxX_[index] = rect.max.x;
+        maxY_[index] = rect.max.y;
+    }
+
+    size_t Size() const { return size_; }
+    bool Empty() const { return size_ == 0; }
+    // Number of lanes processed by the kernels
+    size_t PaddedSize() const { return minX_.size(); }
+
+    float* MinX() { return minX_.data(); }
+    float* MinY() { return minY_.data(); }
+    float* MaxX() { return maxX_.data(); }
+    float* MaxY() { return maxY_.data(); }
+    const float* MinX() const { return minX_.data(); }
+    const float* MinY() const { return minY_.data(); }
+    const float* MaxX() const { return maxX_.data(); }
+    const float* MaxY() const { return maxY_.data(); }
+
+private:
+    static constexpr float kPadMin = std::numeric_limits<float>::infinity();
+    static constexpr float kPadMax = -std::numeric_limits<float>::infinity();
+
+    static size_t PaddedSize(size_t count) {
+        return (count + kPadding - 1) / kPadding * kPadding;
+    }
+
+private:
+    std::vector<float> minX_;
+    std::vector<float> minY_;
+    std::vector<float> maxX_;
+    std::vector<float> maxY_;
+    size_t size_ = 0;
+};
+
+/*
+ * Batch versions of the Rect and Vec2 operations
+ * Process 4 rects at once with SSE2 and 8 with AVX, selected at runtime
+ * The results match the scalar operations exactly
+ */
+namespace math {
+
+inline constexpr size_t kNotFound = ~size_t(0);
+
+// out[i] = rects[i].Contains(point), |out| has rects.Size() elements
+void Contains(const RectBatch& rects, float2 point, bool* out);
+
+// Index of the last rect containing the point or kNotFound
+// The last one is the topmost for rects in the drawing order
+size_t FindLastContaining(const RectBatch& rects, float2 point);
+
+// out[i] = rects[i].Intersects(rect)
+void Intersects(const RectBatch& rects, const Rect& rect, bool* out);
+
+// Intersects every rect with the clip rect. Rects outside of it end up
+// with a negative width or height
+void Clip(RectBatch& rects, const Rect& clipRect);
+
+// Bounding rect of all rects. Inverted (+inf, -inf) if empty
+Rect Union(const RectBatch& rects);
+
+void Translate(RectBatch& rects, float2 offset);
+
+// Rounds down like Round() for vectors
+void Round(RectBatch& rects);
+
+void Translate(std::span<float2> points, float2 offset);
+void Round(std::span<float2> points);
+void Clamp(std::span<float2> points, float2 min, float2 max);
+
+}  // namespace math
+
 inline void alignment_should_be_power_of_two() {}
 
 template <class T>
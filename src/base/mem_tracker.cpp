@@ -0,0 +1,269 @@
+#include "mem_tracker.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <format>
+#include <mutex>
+#include <ranges>
+
+namespace mem {
+
+namespace {
+
+struct Context {
+    std::mutex lock;
+    // Reused after the threads exit
+    std::vector<std::unique_ptr<detail::ThreadCounters>> threads;
+    std::vector<detail::ThreadCounters*> freeThreads;
+    // Counters of the exited threads
+    std::array<detail::Counters, kTagCount> retired;
+    // Updated every kPeakGranularity bytes of a thread for the peak
+    std::array<std::atomic<int64_t>, kTagCount> liveBytes{};
+    std::array<std::atomic<int64_t>, kTagCount> peakBytes{};
+};
+
+// Never deleted, static allocators are destroyed after it
+Context& GetContext() {
+    static Context* ctx = new Context();
+    return *ctx;
+}
+
+void UpdatePeak(std::atomic<int64_t>& peak, int64_t value) {
+    int64_t current = peak.load(std::memory_order_relaxed);
+    while (value > current &&
+           !peak.compare_exchange_weak(current, value,
+                                       std::memory_order_relaxed)) {
+    }
+}
+
+void AddLiveBytes(Tag tag, int64_t bytes) {
+    Context& ctx = GetContext();
+    std::atomic<int64_t>& live = ctx.liveBytes[(size_t)tag];
+    UpdatePeak(ctx.peakBytes[(size_t)tag],
+               live.fetch_add(bytes, std::memory_order_relaxed) + bytes);
+}
+
+void MoveCounter(std::atomic<uint64_t>& from, std::atomic<uint64_t>& to) {
+    to.fetch_add(from.exchange(0, std::memory_order_relaxed),
+                 std::memory_order_relaxed);
+}
+
+// The thread local destructors after this one record into the retired
+// counters directly
+thread_local bool tlsExited = false;
+
+// Moves the counters into the retired ones when the thread exits
+struct ThreadCountersOwner {
+    detail::ThreadCounters* counters = nullptr;
+
+    ~ThreadCountersOwner() {
+        if (!counters) {
+            return;
+        }
+        detail::tlsCounters = nullptr;
+        tlsExited = true;
+        Context& ctx = GetContext();
+        std::scoped_lock _(ctx.lock);
+        for (size_t i = 0; i < kTagCount; ++i) {
+            detail::Counters& from = counters->tags[i];
+            detail::Counters& to = ctx.retired[i];
+            MoveCounter(from.allocatedBytes, to.allocatedBytes);
+            MoveCounter(from.freedBytes, to.freedBytes);
+            MoveCounter(from.allocCount, to.allocCount);
+            MoveCounter(from.freeCount, to.freeCount);
+            AddLiveBytes((Tag)i, from.pendingBytes);
+            from.pendingBytes = 0;
+        }
+        ctx.freeThreads.push_back(counters);
+    }
+};
+
+thread_local ThreadCountersOwner tlsCountersOwner;
+
+void RegisterThread() {
+    Context& ctx = GetContext();
+    detail::ThreadCounters* counters = nullptr;
+    {
+        std::scoped_lock _(ctx.lock);
+        if (!ctx.freeThreads.empty()) {
+            counters = ctx.freeThreads.back();
+            ctx.freeThreads.pop_back();
+        } else {
+            counters = ctx.threads
+                           .emplace_back(
+                               std::make_unique<detail::ThreadCounters>())
+                           .get();
+        }
+    }
+    detail::tlsCounters = counters;
+    tlsCountersOwner.counters = counters;
+}
+
+std::string FormatBytes(int64_t bytes) {
+    constexpr std::string_view kUnits[] = {"KiB", "MiB", "GiB"};
+    if (std::abs(bytes) < 1024) {
+        return std::format("{} B", bytes);
+    }
+    double value = (double)bytes / 1024.;
+    size_t unit = 0;
+    for (; std::abs(value) >= 1024. && unit + 1 < std::size(kUnits); ++unit) {
+        value /= 1024.;
+    }
+    return std::format("{:.1f} {}", value, kUnits[unit]);
+}
+
+}  // namespace
+
+void detail::RecordSlow(size_t size, Tag tag, bool bFree) {
+    if (!tlsExited) {
+        RegisterThread();
+        bFree ? RecordFree(size, tag) : RecordAlloc(size, tag);
+        return;
+    }
+    Counters& retired = GetContext().retired[(size_t)tag];
+    if (bFree) {
+        retired.freedBytes.fetch_add(size, std::memory_order_relaxed);
+        retired.freeCount.fetch_add(1, std::memory_order_relaxed);
+    } else {
+        retired.allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+        retired.allocCount.fetch_add(1, std::memory_order_relaxed);
+    }
+    AddLiveBytes(tag, bFree ? -(int64_t)size : (int64_t)size);
+}
+
+void detail::PublishPending(Counters& counters, Tag tag) {
+    AddLiveBytes(tag, counters.pendingBytes);
+    counters.pendingBytes = 0;
+}
+
+std::string_view ToString(Tag tag) {
+    switch (tag) {
+        case Tag::Untagged: return "Untagged";
+        case Tag::UI: return "UI";
+        case Tag::Fonts: return "Fonts";
+        case Tag::Shaders: return "Shaders";
+        case Tag::Strings: return "Strings";
+        default: return "Unknown";
+    }
+}
+
+int64_t Snapshot::GetLiveBytes() const {
+    int64_t out = 0;
+    for (const TagStats& stats : tags) {
+        out += stats.liveBytes;
+    }
+    return out;
+}
+
+Snapshot TakeSnapshot() {
+    struct Totals {
+        void Add(const detail::Counters& counters) {
+            constexpr auto kRelaxed = std::memory_order_relaxed;
+            allocatedBytes += counters.allocatedBytes.load(kRelaxed);
+            freedBytes += counters.freedBytes.load(kRelaxed);
+            allocCount += counters.allocCount.load(kRelaxed);
+            freeCount += counters.freeCount.load(kRelaxed);
+        }
+
+        uint64_t allocatedBytes = 0;
+        uint64_t freedBytes = 0;
+        uint64_t allocCount = 0;
+        uint64_t freeCount = 0;
+    };
+
+    Context& ctx = GetContext();
+    Snapshot out;
+    out.time = std::chrono::steady_clock::now();
+    std::scoped_lock _(ctx.lock);
+    for (size_t i = 0; i < kTagCount; ++i) {
+        Totals totals;
+        totals.Add(ctx.retired[i]);
+        // The free counters are zeroed
+        for (const auto& thread : ctx.threads) {
+            totals.Add(thread->tags[i]);
+        }
+        TagStats& stats = out.tags[i];
+        // Frees of other threads could be counted before their allocations
+        stats.liveBytes = (int64_t)(totals.allocatedBytes - totals.freedBytes);
+        stats.allocatedBytes = totals.allocatedBytes;
+        stats.allocCount = totals.allocCount;
+        stats.freeCount = totals.freeCount;
+        UpdatePeak(ctx.peakBytes[i], stats.liveBytes);
+        stats.peakBytes = ctx.peakBytes[i].load(std::memory_order_relaxed);
+    }
+    return out;
+}
+
+std::vector<TagDiff> Diff(const Snapshot& before, const Snapshot& after) {
+    const double seconds =
+        std::chrono::duration<double>(after.time - before.time).count();
+    std::vector<TagDiff> out;
+    for (size_t i = 0; i < kTagCount; ++i) {
+        const TagStats& from = before.tags[i];
+        const TagStats& to = after.tags[i];
+        if (to.allocCount == from.allocCount &&
+            to.freeCount == from.freeCount) {
+            continue;
+        }
+        TagDiff& diff = out.emplace_back();
+        diff.tag = (Tag)i;
+        diff.liveBytes = to.liveBytes - from.liveBytes;
+        diff.allocatedBytes = to.allocatedBytes - from.allocatedBytes;
+        diff.allocCount = to.allocCount - from.allocCount;
+        diff.bytesPerSecond =
+            seconds > 0. ? (double)diff.allocatedBytes / seconds : 0.;
+    }
+    std::ranges::sort(out, [](const TagDiff& lhs, const TagDiff& rhs) {
+        if (lhs.liveBytes != rhs.liveBytes) {
+            return lhs.liveBytes > rhs.liveBytes;
+        }
+        return lhs.allocatedBytes > rhs.allocatedBytes;
+    });
+    return out;
+}
+
+std::string FormatSnapshot(const Snapshot& snapshot, size_t maxTags) {
+    std::vector<Tag> tags;
+    for (size_t i = 0; i < kTagCount; ++i) {
+        if (snapshot.tags[i].allocCount) {
+            tags.push_back((Tag)i);
+        }
+    }
+    std::ranges::stable_sort(tags, [&](Tag lhs, Tag rhs) {
+        return snapshot[lhs].liveBytes > snapshot[rhs].liveBytes;
+    });
+    std::string out = std::format("Memory: {} live\n",
+                                  FormatBytes(snapshot.GetLiveBytes()));
+    out += std::format("{:<10} {:>12} {:>12} {:>12}\n", "Tag", "Live", "Peak",
+                       "Allocs");
+    for (Tag tag : tags | std::views::take(maxTags)) {
+        const TagStats& stats = snapshot[tag];
+        out += std::format("{:<10} {:>12} {:>12} {:>12}\n", ToString(tag),
+                           FormatBytes(stats.liveBytes),
+                           FormatBytes(stats.peakBytes), stats.allocCount);
+    }
+    return out;
+}
+
+std::string FormatDiff(const Snapshot& before,
+                       const Snapshot& after,
+                       size_t maxTags) {
+    const std::vector<TagDiff> diffs = Diff(before, after);
+    std::string out = std::format(
+        "Memory: {} live over {:.1f} s\n",
+        FormatBytes(after.GetLiveBytes() - before.GetLiveBytes()),
+        std::chrono::duration<double>(after.time - before.time).count());
+    out += std::format("{:<10} {:>12} {:>12} {:>12} {:>12}\n", "Tag",
+                       "Live", "Allocated", "Allocs", "Rate/s");
+    for (const TagDiff& diff : diffs | std::views::take(maxTags)) {
+        out += std::format("{:<10} {:>12} {:>12} {:>12} {:>12}\n",
+                           ToString(diff.tag), FormatBytes(diff.liveBytes),
+                           FormatBytes((int64_t)diff.allocatedBytes),
+                           diff.allocCount,
+                           FormatBytes((int64_t)diff.bytesPerSecond));
+    }
+    return out;
+}
+
+}  // namespace mem
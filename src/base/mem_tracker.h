@@ -0,0 +1,222 @@
+#pragma once
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+// Memory accounting by subsystem
+// Allocators report the memory they get from the system under a tag. An
+// allocator takes the tag of the scope it was created in:
+//   {
+//       MEM_TAG(Shaders);
+//       program = wgsl::Program::Create(code);
+//   }
+//   const mem::Snapshot before = mem::TakeSnapshot();
+//   ...
+//   LOGF(Info, "{}", mem::FormatDiff(before, mem::TakeSnapshot()));
+//
+// Counters are thread local and summed up when a snapshot is taken
+// Compiled out without ENABLE_MEMORY_TRACKING
+namespace mem {
+
+enum class Tag : uint8_t {
+    Untagged,
+    UI,
+    Fonts,
+    Shaders,
+    Strings,
+    Count,
+};
+
+constexpr size_t kTagCount = (size_t)Tag::Count;
+
+std::string_view ToString(Tag tag);
+
+struct TagStats {
+    int64_t liveBytes = 0;
+    // Highest live bytes, precise to detail::kPeakGranularity per thread
+    int64_t peakBytes = 0;
+    // Totals since the start
+    uint64_t allocatedBytes = 0;
+    uint64_t allocCount = 0;
+    uint64_t freeCount = 0;
+};
+
+struct Snapshot {
+    const TagStats& operator[](Tag tag) const { return tags[(size_t)tag]; }
+
+    int64_t GetLiveBytes() const;
+
+    std::chrono::steady_clock::time_point time;
+    std::array<TagStats, kTagCount> tags;
+};
+
+// Change of a tag between two snapshots
+struct TagDiff {
+    Tag tag;
+    int64_t liveBytes;
+    uint64_t allocatedBytes;
+    uint64_t allocCount;
+    // Allocation rate
+    double bytesPerSecond;
+};
+
+Snapshot TakeSnapshot();
+
+// Tags which allocated between the snapshots, largest growth first
+std::vector<TagDiff> Diff(const Snapshot& before, const Snapshot& after);
+
+// Tables for the log with the largest tags first
+std::string FormatSnapshot(const Snapshot& snapshot,
+                           size_t maxTags = kTagCount);
+std::string FormatDiff(const Snapshot& before,
+                       const Snapshot& after,
+                       size_t maxTags = kTagCount);
+
+namespace detail {
+
+// Live bytes a thread accumulates before adding them to the global peak
+constexpr int64_t kPeakGranularity = 64 * 1024;
+
+struct Counters {
+    std::atomic<uint64_t> allocatedBytes = 0;
+    std::atomic<uint64_t> freedBytes = 0;
+    std::atomic<uint64_t> allocCount = 0;
+    std::atomic<uint64_t> freeCount = 0;
+    // Not yet added to the global live bytes
+    int64_t pendingBytes = 0;
+};
+
+// Written only by the owning thread, read by the snapshots
+struct ThreadCounters {
+    std::array<Counters, kTagCount> tags;
+};
+
+inline thread_local ThreadCounters* tlsCounters = nullptr;
+inline thread_local Tag tlsTag = Tag::Untagged;
+
+// Registers the thread. Records into the shared counters if the thread
+// has already exited and is running the thread local destructors
+void RecordSlow(size_t size, Tag tag, bool bFree);
+void PublishPending(Counters& counters, Tag tag);
+
+// A plain add as only the owning thread writes
+inline void Increment(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+}  // namespace detail
+
+inline Tag GetCurrentTag() {
+    return detail::tlsTag;
+}
+
+inline void RecordAlloc(size_t size, Tag tag) {
+#if defined(ENABLE_MEMORY_TRACKING)
+    detail::ThreadCounters* thread = detail::tlsCounters;
+    if (!thread) [[unlikely]] {
+        detail::RecordSlow(size, tag, false);
+        return;
+    }
+    detail::Counters& counters = thread->tags[(size_t)tag];
+    detail::Increment(counters.allocatedBytes, size);
+    detail::Increment(counters.allocCount, 1);
+    counters.pendingBytes += (int64_t)size;
+    if (counters.pendingBytes >= detail::kPeakGranularity) {
+        detail::PublishPending(counters, tag);
+    }
+#endif
+}
+
+inline void RecordFree(size_t size, Tag tag) {
+#if defined(ENABLE_MEMORY_TRACKING)
+    detail::ThreadCounters* thread = detail::tlsCounters;
+    if (!thread) [[unlikely]] {
+        detail::RecordSlow(size, tag, true);
+        return;
+    }
+    detail::Counters& counters = thread->tags[(size_t)tag];
+    detail::Increment(counters.freedBytes, size);
+    detail::Increment(counters.freeCount, 1);
+    counters.pendingBytes -= (int64_t)size;
+    if (counters.pendingBytes <= -detail::kPeakGranularity) {
+        detail::PublishPending(counters, tag);
+    }
+#endif
+}
+
+// Sets the tag of the current thread until the end of the scope
+class TagScope {
+public:
+    explicit TagScope(Tag tag) : prev_(detail::tlsTag) {
+        detail::tlsTag = tag;
+    }
+
+    ~TagScope() { detail::tlsTag = prev_; }
+
+    TagScope(const TagScope&) = delete;
+    TagScope& operator=(const TagScope&) = delete;
+
+private:
+    Tag prev_;
+};
+
+// Std allocator which reports to the tag of the scope it was created in
+// The tag moves with the memory:
+//   std::vector<char, mem::TrackedAllocator<char>> blob;
+template <class T>
+class TrackedAllocator {
+public:
+    using value_type = T;
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    TrackedAllocator() : tag_(GetCurrentTag()) {}
+    explicit TrackedAllocator(Tag tag) : tag_(tag) {}
+
+    template <class U>
+    TrackedAllocator(const TrackedAllocator<U>& rhs) : tag_(rhs.GetTag()) {}
+
+    T* allocate(size_t count) {
+        T* out = std::allocator<T>().allocate(count);
+        RecordAlloc(count * sizeof(T), tag_);
+        return out;
+    }
+
+    void deallocate(T* ptr, size_t count) {
+        RecordFree(count * sizeof(T), tag_);
+        std::allocator<T>().deallocate(ptr, count);
+    }
+
+    Tag GetTag() const { return tag_; }
+
+    template <class U>
+    bool operator==(const TrackedAllocator<U>& rhs) const {
+        return tag_ == rhs.GetTag();
+    }
+
+private:
+    Tag tag_;
+};
+
+}  // namespace mem
+
+#define MEM_CONCAT_IMPL(A, B) A##B
+#define MEM_CONCAT(A, B) MEM_CONCAT_IMPL(A, B)
+
+#if defined(ENABLE_MEMORY_TRACKING)
+#define MEM_TAG(TAG) \
+    mem::TagScope MEM_CONCAT(_memTag, __LINE__)(mem::Tag::TAG)
+#else
+#define MEM_TAG(TAG) \
+    do {             \
+    } while (false)
+#endif
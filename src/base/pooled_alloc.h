@@ -1,9 +1,12 @@
 #pragma once
 #include "base/common.h"
+#include "base/mem_tracker.h"
 
 // Simple pooled allocator
 // Manages a collection of pages with each page containing kPageSize slots
 // Object's destructors are not called so they should be trivial types
+// Pages are reported to the memory tag of the scope the allocator is
+// created in
 template<size_t kSlotSize, size_t kPageSize>
 class PooledAllocator {
 public:
@@ -16,14 +19,18 @@ public:
 public:
 
     constexpr PooledAllocator() {
-        activePagesHead_ = new Page();
+        activePagesHead_ = NewPage();
     }
 
     constexpr ~PooledAllocator() {
-        ListDelete(activePagesHead_);
-        ListDelete(fullPagesHead_);
+        while(Page* page = DListPop(activePagesHead_)) {
+            DeletePage(page);
+        }
+        while(Page* page = DListPop(fullPagesHead_)) {
+            DeletePage(page);
+        }
         if(emptyPage_) {
-            delete emptyPage_;
+            DeletePage(emptyPage_);
         }
     }
 
@@ -37,7 +44,7 @@ public:
         Page* activePage = GetActive();
         if(!activePage) {
             if(!emptyPage_) {
-                activePage = new Page();
+                activePage = NewPage();
             } else {
                 activePage = emptyPage_;
                 emptyPage_ = nullptr;
@@ -63,7 +70,7 @@ public:
 
         } else if(page->Empty()) {
             if(emptyPage_) {
-                delete emptyPage_;
+                DeletePage(emptyPage_);
             }
             emptyPage_ = page;
             DListRemove(activePagesHead_, page);
@@ -153,8 +160,19 @@ private:
         return activePagesHead_;
     }
 
+    Page* NewPage() {
+        mem::RecordAlloc(sizeof(Page), tag_);
+        return new Page();
+    }
+
+    void DeletePage(Page* page) {
+        mem::RecordFree(sizeof(Page), tag_);
+        delete page;
+    }
+
 private:
     Page* activePagesHead_ = nullptr;
     Page* fullPagesHead_ = nullptr;
     Page* emptyPage_ = nullptr;
+    mem::Tag tag_ = mem::GetCurrentTag();
 };
\ No newline at end of file
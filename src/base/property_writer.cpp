@@ -0,0 +1,376 @@
+#include "property_writer.h"
+
+#include <cstdio>
+#include <vector>
+
+BufferedWriter::BufferedWriter(FlushFunc onFlush, size_t size)
+    : onFlush_(std::move(onFlush))
+    , buffer_(new char[size])
+    , size_(size) {
+    DASSERT(size_ && onFlush_);
+}
+
+BufferedWriter::~BufferedWriter() {
+    Flush();
+}
+
+BufferedWriter::FlushFunc BufferedWriter::ToString(std::string* out) {
+    return [out](std::string_view data) { out->append(data); };
+}
+
+BufferedWriter::FlushFunc BufferedWriter::ToFile(std::FILE* file) {
+    return [file](std::string_view data) {
+        std::fwrite(data.data(), 1, data.size(), file);
+    };
+}
+
+void BufferedWriter::Flush() {
+    if (pos_) {
+        onFlush_(std::string_view(buffer_.get(), pos_));
+        flushed_ += pos_;
+        pos_ = 0;
+    }
+}
+
+void BufferedWriter::WriteSlow(std::string_view data) {
+    Flush();
+    // Large writes bypass the buffer
+    if (data.size() >= size_) {
+        onFlush_(data);
+        flushed_ += data.size();
+        return;
+    }
+    std::memcpy(buffer_.get(), data.data(), data.size());
+    pos_ = data.size();
+}
+
+/*-------------------------------------------------------------------------*/
+
+JsonPropertyWriter::JsonPropertyWriter(BufferedWriter* out, uint32_t indent)
+    : out_(out), indent_(indent) {}
+
+JsonPropertyWriter::~JsonPropertyWriter() {
+    Finish();
+}
+
+void JsonPropertyWriter::OpenObject(std::string_view className,
+                                    ObjectID objectID) {
+    if (hasChildren_.empty()) {
+        out_->Put(bHasRoots_ ? ',' : '[');
+        bHasRoots_ = true;
+    } else {
+        out_->Put(',');
+        if (!hasChildren_.back()) {
+            hasChildren_.back() = true;
+            NewLine(hasChildren_.size() * 2);
+            out_->Write(indent_ ? "\"children\": [" : "\"children\":[");
+        }
+    }
+    hasChildren_.push_back(false);
+    if (properties_.size() < hasChildren_.size()) {
+        properties_.resize(hasChildren_.size());
+    }
+    properties_[hasChildren_.size() - 1].clear();
+    // The object keys are indented twice per level: the object and its
+    // properties or children
+    const size_t depth = hasChildren_.size() * 2;
+    NewLine(depth - 1);
+    out_->Put('{');
+    NewLine(depth);
+    out_->Write(indent_ ? "\"class\": " : "\"class\":");
+    WriteString(className);
+    out_->Put(',');
+    NewLine(depth);
+    out_->Write(indent_ ? "\"id\": " : "\"id\":");
+    out_->Format("\"{:#x}\"", objectID);
+}
+
+void JsonPropertyWriter::CloseObject() {
+    DASSERT(!hasChildren_.empty());
+    const size_t depth = hasChildren_.size() * 2;
+    if (hasChildren_.back()) {
+        NewLine(depth);
+        out_->Put(']');
+    }
+    const std::string& properties = properties_[hasChildren_.size() - 1];
+    if (!properties.empty()) {
+        out_->Put(',');
+        NewLine(depth);
+        out_->Write(indent_ ? "\"properties\": {" : "\"properties\":{");
+        out_->Write(properties);
+        NewLine(depth);
+        out_->Put('}');
+    }
+    hasChildren_.pop_back();
+    NewLine(depth - 1);
+    out_->Put('}');
+}
+
+void JsonPropertyWriter::Property(std::string_view name,
+                                  std::string_view value, bool bQuoted) {
+    DASSERT(!hasChildren_.empty());
+    std::string& out = properties_[hasChildren_.size() - 1];
+    if (!out.empty()) {
+        out.push_back(',');
+    }
+    if (indent_) {
+        out.push_back('\n');
+        out.append((hasChildren_.size() * 2 + 1) * indent_, ' ');
+    }
+    const auto append = [&out](std::string_view s) { out.append(s); };
+    WriteJsonString(name, append);
+    out.append(indent_ ? ": " : ":");
+    WriteJsonString(value, append);
+}
+
+void JsonPropertyWriter::Finish() {
+    if (bFinished_) {
+        return;
+    }
+    DASSERT_M(hasChildren_.empty(), "Objects are still open");
+    bFinished_ = true;
+    if (!bHasRoots_) {
+        out_->Put('[');
+    }
+    NewLine(0);
+    out_->Put(']');
+    if (indent_) {
+        out_->Put('\n');
+    }
+}
+
+void JsonPropertyWriter::NewLine(size_t depth) {
+    if (!indent_) {
+        return;
+    }
+    constexpr std::string_view kSpaces = "                                ";
+    out_->Put('\n');
+    for (size_t count = depth * indent_; count;) {
+        const size_t n = std::min(count, kSpaces.size());
+        out_->Write(kSpaces.substr(0, n));
+        count -= n;
+    }
+}
+
+void JsonPropertyWriter::WriteString(std::string_view str) {
+    WriteJsonString(str, [this](std::string_view s) { out_->Write(s); });
+}
+
+/*-------------------------------------------------------------------------*/
+
+BinaryPropertyWriter::BinaryPropertyWriter(BufferedWriter* out) : out_(out) {
+    out_->Write(kMagic);
+}
+
+BinaryPropertyWriter::~BinaryPropertyWriter() {
+    Finish();
+}
+
+void BinaryPropertyWriter::OpenObject(std::string_view className,
+                                      ObjectID objectID) {
+    out_->Put(kOpenObject);
+    WriteName(className);
+    WriteVarint(objectID);
+}
+
+void BinaryPropertyWriter::CloseObject() {
+    out_->Put(kCloseObject);
+}
+
+void BinaryPropertyWriter::Property(std::string_view name,
+                                    std::string_view value, bool bQuoted) {
+    out_->Put(bQuoted ? kQuotedProperty : kProperty);
+    WriteName(name);
+    WriteVarint(value.size());
+    out_->Write(value);
+}
+
+void BinaryPropertyWriter::Finish() {
+    if (!bFinished_) {
+        bFinished_ = true;
+        out_->Put(kEnd);
+    }
+}
+
+void BinaryPropertyWriter::WriteVarint(uint64_t value) {
+    char bytes[10];
+    size_t size = 0;
+    for (; value >= 0x80; value >>= 7) {
+        bytes[size++] = (char)(value | 0x80);
+    }
+    bytes[size++] = (char)value;
+    out_->Write(std::string_view(bytes, size));
+}
+
+void BinaryPropertyWriter::WriteName(std::string_view name) {
+    if (auto it = names_.find(name); it != names_.end()) {
+        WriteVarint((uint64_t)it->second << 1);
+        return;
+    }
+    names_.emplace(std::string(name), (uint32_t)names_.size());
+    WriteVarint((uint64_t)name.size() << 1 | 1);
+    out_->Write(name);
+}
+
+namespace {
+
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) : data_(data) {}
+
+    bool ReadByte(uint8_t& out) {
+        if (pos_ == data_.size()) {
+            return false;
+        }
+        out = (uint8_t)data_[pos_++];
+        return true;
+    }
+
+    bool ReadVarint(uint64_t& out) {
+        out = 0;
+        for (uint32_t shift = 0; shift < 64; shift += 7) {
+            uint8_t byte;
+            if (!ReadByte(byte)) {
+                return false;
+            }
+            out |= (uint64_t)(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ReadString(uint64_t size, std::string_view& out) {
+        if (size > data_.size() - pos_) {
+            return false;
+        }
+        out = data_.substr(pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool ReadName(std::string_view& out) {
+        uint64_t value;
+        if (!ReadVarint(value)) {
+            return false;
+        }
+        if (!(value & 1)) {
+            if ((value >> 1) >= names_.size()) {
+                return false;
+            }
+            out = names_[value >> 1];
+            return true;
+        }
+        if (!ReadString(value >> 1, out)) {
+            return false;
+        }
+        names_.push_back(out);
+        return true;
+    }
+
+private:
+    std::string_view data_;
+    size_t pos_ = 0;
+    std::vector<std::string_view> names_;
+};
+
+}  // namespace
+
+bool ReadBinaryProperties(std::string_view data, PropertySink& sink) {
+    using Tag = BinaryPropertyWriter::Tag;
+    constexpr auto kMagic = BinaryPropertyWriter::kMagic;
+    if (!data.starts_with(kMagic)) {
+        return false;
+    }
+    BinaryReader reader(data.substr(kMagic.size()));
+    size_t depth = 0;
+
+    for (;;) {
+        uint8_t tag;
+        if (!reader.ReadByte(tag)) {
+            return false;
+        }
+        switch (tag) {
+            case Tag::kEnd: {
+                return depth == 0;
+            }
+            case Tag::kOpenObject: {
+                std::string_view className;
+                uint64_t objectID;
+                if (!reader.ReadName(className) ||
+                    !reader.ReadVarint(objectID)) {
+                    return false;
+                }
+                ++depth;
+                sink.OpenObject(className, (PropertySink::ObjectID)objectID);
+                break;
+            }
+            case Tag::kProperty:
+            case Tag::kQuotedProperty: {
+                std::string_view name;
+                std::string_view value;
+                uint64_t size;
+                if (!depth || !reader.ReadName(name) ||
+                    !reader.ReadVarint(size) ||
+                    !reader.ReadString(size, value)) {
+                    return false;
+                }
+                sink.Property(name, value, tag == Tag::kQuotedProperty);
+                break;
+            }
+            case Tag::kCloseObject: {
+                if (!depth) {
+                    return false;
+                }
+                --depth;
+                sink.CloseObject();
+                break;
+            }
+            default: return false;
+        }
+    }
+}
+
+/*-------------------------------------------------------------------------*/
+
+void TextPropertyWriter::OpenObject(std::string_view className,
+                                    ObjectID objectID) {
+    ++depth_;
+    WriteIndent(depth_);
+    out_->Put('\n');
+    WriteIndent(depth_ - 1);
+    out_->Write("|-> ");
+    out_->Write(className);
+    out_->Write(":\n");
+}
+
+void TextPropertyWriter::CloseObject() {
+    DASSERT(depth_);
+    --depth_;
+}
+
+void TextPropertyWriter::Property(std::string_view name,
+                                  std::string_view value, bool bQuoted) {
+    WriteIndent(depth_);
+    out_->Write(name);
+    out_->Write(": ");
+    if (bQuoted) {
+        out_->Put('"');
+        out_->Write(value);
+        out_->Put('"');
+    } else {
+        out_->Write(value);
+    }
+    out_->Put('\n');
+}
+
+void TextPropertyWriter::WriteIndent(size_t depth) {
+    if (!depth) {
+        return;
+    }
+    out_->Write("    ");
+    for (--depth; depth; --depth) {
+        out_->Write("|   ");
+    }
+}
@@ -0,0 +1,227 @@
+#pragma once
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "flat_hash_map.h"
+#include "small_vector.h"
+#include "tree_printer.h"
+
+// Fixed size output buffer, passed to a flush callback when full
+// The callback writes to a file, a socket or appends to a string:
+//   BufferedWriter out(BufferedWriter::ToString(&str));
+//   out.Format("{}: {}", name, value);
+class BufferedWriter {
+public:
+    using FlushFunc = std::function<void(std::string_view)>;
+
+    static constexpr size_t kDefaultSize = 64 * 1024;
+
+    explicit BufferedWriter(FlushFunc onFlush, size_t size = kDefaultSize);
+    ~BufferedWriter();
+
+    BufferedWriter(const BufferedWriter&) = delete;
+    BufferedWriter& operator=(const BufferedWriter&) = delete;
+
+    static FlushFunc ToString(std::string* out);
+    static FlushFunc ToFile(std::FILE* file);
+
+    void Write(std::string_view data) {
+        if (data.size() <= size_ - pos_) {
+            std::memcpy(buffer_.get() + pos_, data.data(), data.size());
+            pos_ += data.size();
+        } else {
+            WriteSlow(data);
+        }
+    }
+
+    void Put(char c) {
+        if (pos_ == size_) {
+            Flush();
+        }
+        buffer_[pos_++] = c;
+    }
+
+    // Formats directly into the buffer
+    template <class... Args>
+    void Format(std::format_string<Args...> fmt, Args&&... args) {
+        std::format_to(OutputIterator{this}, fmt, std::forward<Args>(args)...);
+    }
+
+    void Flush();
+
+    // Total number of written bytes including the buffered ones
+    uint64_t GetSize() const { return flushed_ + pos_; }
+
+private:
+    struct OutputIterator {
+        using iterator_category = std::output_iterator_tag;
+        using value_type = void;
+        using difference_type = ptrdiff_t;
+        using pointer = void;
+        using reference = void;
+
+        OutputIterator& operator*() { return *this; }
+        OutputIterator& operator++() { return *this; }
+        OutputIterator operator++(int) { return *this; }
+        OutputIterator& operator=(char c) {
+            writer->Put(c);
+            return *this;
+        }
+
+        BufferedWriter* writer;
+    };
+
+    void WriteSlow(std::string_view data);
+
+private:
+    FlushFunc onFlush_;
+    std::unique_ptr<char[]> buffer_;
+    size_t size_ = 0;
+    size_t pos_ = 0;
+    uint64_t flushed_ = 0;
+};
+
+// Writes a json string with the quotes
+// Runs of chars which don't need escaping are written at once
+template <class Write>
+void WriteJsonString(std::string_view str, Write&& write) {
+    constexpr char kHex[] = "0123456789abcdef";
+    write(std::string_view("\""));
+    size_t runStart = 0;
+    for (size_t i = 0; i < str.size(); ++i) {
+        const auto c = (uint8_t)str[i];
+        if (c >= 0x20 && c != '"' && c != '\\') {
+            continue;
+        }
+        write(str.substr(runStart, i - runStart));
+        runStart = i + 1;
+        switch (c) {
+            case '"': write(std::string_view("\\\"")); break;
+            case '\\': write(std::string_view("\\\\")); break;
+            case '\n': write(std::string_view("\\n")); break;
+            case '\r': write(std::string_view("\\r")); break;
+            case '\t': write(std::string_view("\\t")); break;
+            default: {
+                const char escaped[] = {'\\', 'u', '0', '0', kHex[c >> 4],
+                                        kHex[c & 0xf]};
+                write(std::string_view(escaped, sizeof(escaped)));
+            }
+        }
+    }
+    write(str.substr(runStart));
+    write(std::string_view("\""));
+}
+
+// Streams the objects as a json array of the root objects:
+//   [{"class": "Button", "id": "0x1f2a", "children": [...],
+//     "properties": {"text": "Ok"}}]
+// The properties are buffered and written when the object is closed, so
+// the ones pushed after the children end up in the same object
+// Unquoted values are written as json strings too, as they are formatted
+// vectors, enums and numbers
+class JsonPropertyWriter final : public PropertySink {
+public:
+    // |indent| of 0 writes everything into a single line
+    explicit JsonPropertyWriter(BufferedWriter* out, uint32_t indent = 0);
+    ~JsonPropertyWriter() override;
+
+    void OpenObject(std::string_view className, ObjectID objectID) override;
+    void CloseObject() override;
+    void Property(std::string_view name, std::string_view value,
+                  bool bQuoted) override;
+
+    // Closes the root array. Called by the destructor
+    void Finish();
+
+private:
+    void NewLine(size_t depth);
+    void WriteString(std::string_view str);
+
+private:
+    BufferedWriter* out_;
+    uint32_t indent_;
+    bool bHasRoots_ = false;
+    bool bFinished_ = false;
+    // Whether each open object has started its "children" array
+    SmallVector<bool, 32> hasChildren_;
+    // Buffered properties of each open object. Kept after the object is
+    // closed to reuse the capacity
+    std::vector<std::string> properties_;
+};
+
+// Compact binary encoding of the stream
+//   Stream   := "PAR1" Record* kEnd
+//   Record   := kOpenObject Name varint(id)
+//             | kProperty Name String
+//             | kQuotedProperty Name String
+//             | kCloseObject
+//   Name     := varint(index << 1)                 a name written before
+//             | varint(length << 1 | 1) bytes      a new name
+//   String   := varint(length) bytes
+// Class and property names repeat a lot and are written only once
+class BinaryPropertyWriter final : public PropertySink {
+public:
+    enum Tag : uint8_t {
+        kEnd,
+        kOpenObject,
+        kProperty,
+        kQuotedProperty,
+        kCloseObject,
+    };
+
+    static constexpr std::string_view kMagic = "PAR1";
+
+    explicit BinaryPropertyWriter(BufferedWriter* out);
+    ~BinaryPropertyWriter() override;
+
+    void OpenObject(std::string_view className, ObjectID objectID) override;
+    void CloseObject() override;
+    void Property(std::string_view name, std::string_view value,
+                  bool bQuoted) override;
+
+    // Writes the end tag. Called by the destructor
+    void Finish();
+
+private:
+    void WriteVarint(uint64_t value);
+    void WriteName(std::string_view name);
+
+private:
+    BufferedWriter* out_;
+    bool bFinished_ = false;
+    FlatHashMap<std::string, uint32_t> names_;
+};
+
+// Replays a stream written by BinaryPropertyWriter into a sink,
+// e.g. to convert a binary dump into json
+// Returns false if the data is malformed
+bool ReadBinaryProperties(std::string_view data, PropertySink& sink);
+
+// Human readable tree used by the debug log:
+//   |-> Button:
+//       text: "Ok"
+//       |
+//       |-> Label:
+class TextPropertyWriter final : public PropertySink {
+public:
+    explicit TextPropertyWriter(BufferedWriter* out) : out_(out) {}
+
+    void OpenObject(std::string_view className, ObjectID objectID) override;
+    void CloseObject() override;
+    void Property(std::string_view name, std::string_view value,
+                  bool bQuoted) override;
+
+private:
+    void WriteIndent(size_t depth);
+
+private:
+    BufferedWriter* out_;
+    size_t depth_ = 0;
+};
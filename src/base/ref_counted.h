@@ -1,28 +1,231 @@
 #pragma once
 #include "base/common.h"
 
+#include <atomic>
+#include <thread>
+#include <utility>
+
+// Ref count policies of BasicRefCounted
+
+// Thread-safe
+struct AtomicRefCount {
+    static constexpr bool kThreadSafe = true;
+
+    using Counter = std::atomic<uint64_t>;
+
+    static void Increment(Counter& counter) {
+        counter.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    // Returns true when the last reference is released
+    static bool Decrement(Counter& counter) {
+        return counter.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
+    // Increments only if not zero
+    static bool TryIncrement(Counter& counter) {
+        uint64_t value = counter.load(std::memory_order_relaxed);
+        while (value != 0) {
+            if (counter.compare_exchange_weak(value, value + 1,
+                                              std::memory_order_relaxed)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    static uint64_t Load(const Counter& counter) {
+        return counter.load(std::memory_order_relaxed);
+    }
+};
+
+// For objects that never leave one thread
+struct NonAtomicRefCount {
+    static constexpr bool kThreadSafe = false;
+
+    using Counter = uint64_t;
+
+    static void Increment(Counter& counter) { ++counter; }
+    static bool Decrement(Counter& counter) { return --counter == 0; }
+
+    static bool TryIncrement(Counter& counter) {
+        if (counter == 0) {
+            return false;
+        }
+        ++counter;
+        return true;
+    }
+
+    static uint64_t Load(const Counter& counter) { return counter; }
+};
+
+// NonAtomicRefCount that asserts that the object is used by the thread
+// that created it
+struct CheckedRefCount {
+    static constexpr bool kThreadSafe = false;
+
+    struct Counter {
+        Counter(uint64_t value) : value(value) {}
+
+        uint64_t value;
+        std::thread::id owner = std::this_thread::get_id();
+    };
+
+    static void Increment(Counter& counter) {
+        CheckThread(counter);
+        ++counter.value;
+    }
+
+    static bool Decrement(Counter& counter) {
+        CheckThread(counter);
+        return --counter.value == 0;
+    }
+
+    static bool TryIncrement(Counter& counter) {
+        CheckThread(counter);
+        if (counter.value == 0) {
+            return false;
+        }
+        ++counter.value;
+        return true;
+    }
+
+    static uint64_t Load(const Counter& counter) { return counter.value; }
+
+    static void CheckThread(const Counter& counter) {
+        DASSERT_M(counter.owner == std::this_thread::get_id(),
+                  "A single threaded object is used by another thread");
+    }
+};
+
+// Checked only in debug builds
+using SingleThreadRefCount =
+    std::conditional_t<kDebugBuild, CheckedRefCount, NonAtomicRefCount>;
+
 // Owning ref counter
-class RefCountedBase {
+// Supports weak references through a control block allocated on the first
+// request, see WeakRefCountedPtr
+template <class Policy>
+class BasicRefCounted {
+public:
+    using RefCountPolicy = Policy;
+
+    // Shared by the object and its weak references
+    // Outlives the object while referenced
+    class WeakControlBlock {
+    public:
+        explicit WeakControlBlock(BasicRefCounted* object) : object_(object) {}
+
+        WeakControlBlock(const WeakControlBlock&) = delete;
+        WeakControlBlock& operator=(const WeakControlBlock&) = delete;
+
+        void AddWeakRef() { Policy::Increment(weakCount_); }
+
+        void ReleaseWeakRef() {
+            if (Policy::Decrement(weakCount_)) {
+                delete this;
+            }
+        }
+
+        // Adds a strong reference if the object is alive
+        bool TryAddRef() {
+            Lock();
+            const bool bAdded =
+                object_ && Policy::TryIncrement(object_->refCount_);
+            Unlock();
+            return bAdded;
+        }
+
+        bool IsAlive() {
+            Lock();
+            const bool bAlive = object_ && Policy::Load(object_->refCount_) > 0;
+            Unlock();
+            return bAlive;
+        }
+
+        // Called by the object before deletion
+        void OnDestructed() {
+            Lock();
+            object_ = nullptr;
+            Unlock();
+            ReleaseWeakRef();
+        }
+
+    private:
+        // Serializes TryAddRef() with the deletion of the object
+        void Lock() {
+            if constexpr (Policy::kThreadSafe) {
+                while (lock_.test_and_set(std::memory_order_acquire)) {
+                }
+            }
+        }
+
+        void Unlock() {
+            if constexpr (Policy::kThreadSafe) {
+                lock_.clear(std::memory_order_release);
+            }
+        }
+
+    private:
+        BasicRefCounted* object_;
+        // The object holds one reference
+        typename Policy::Counter weakCount_{1};
+        std::atomic_flag lock_;
+    };
+
 public:
-    explicit RefCountedBase(uint64_t count = 1) : refCount_(count) {}
+    explicit BasicRefCounted(uint64_t count = 1) : refCount_(count) {}
+
+    BasicRefCounted(const BasicRefCounted&) = delete;
+    BasicRefCounted& operator=(const BasicRefCounted&) = delete;
 
-    void AddRef() { refCount_.fetch_add(1, std::memory_order_relaxed); }
+    void AddRef() { Policy::Increment(refCount_); }
 
     void Release() {
-        DASSERT(refCount_ > 0);
-        if (refCount_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        DASSERT(Policy::Load(refCount_) > 0);
+        if (Policy::Decrement(refCount_)) {
+            if (WeakControlBlock* block =
+                    weakBlock_.load(std::memory_order_acquire)) {
+                block->OnDestructed();
+            }
             delete this;
         }
     }
 
-    uint64_t GetRefCount() const {
-        return refCount_.load(std::memory_order_acq_rel);
+    uint64_t GetRefCount() const { return Policy::Load(refCount_); }
+
+    // Creates the control block on the first call
+    // The caller should hold a reference
+    WeakControlBlock* GetWeakControlBlock() {
+        WeakControlBlock* block = weakBlock_.load(std::memory_order_acquire);
+        if (block) {
+            return block;
+        }
+        auto* newBlock = new WeakControlBlock(this);
+        if (weakBlock_.compare_exchange_strong(block, newBlock,
+                                               std::memory_order_acq_rel,
+                                               std::memory_order_acquire)) {
+            return newBlock;
+        }
+        // Created by another thread
+        delete newBlock;
+        return block;
     }
 
+protected:
+    virtual ~BasicRefCounted() = default;
+
 private:
-    std::atomic<uint64_t> refCount_;
+    typename Policy::Counter refCount_;
+    std::atomic<WeakControlBlock*> weakBlock_ = nullptr;
 };
 
+// Thread-safe ref counter
+using RefCountedBase = BasicRefCounted<AtomicRefCount>;
+
+// Avoids atomic operations for objects used by one thread
+using SingleThreadRefCountedBase = BasicRefCounted<SingleThreadRefCount>;
+
 
 // Calls AddRef() and Release()
 // Similar to boost::intrusive_ptr
@@ -34,7 +237,7 @@ public:
 
     constexpr RefCountedPtr() : ptr(nullptr) {}
 
-    constexpr RefCountedPtr(nullptr_t) {}
+    constexpr RefCountedPtr(nullptr_t) : ptr(nullptr) {}
 
     explicit RefCountedPtr(T* ptr) {
         this->ptr = ptr;
@@ -43,6 +246,13 @@ public:
         }
     }
 
+    // Takes ownership of an already added reference
+    static RefCountedPtr Adopt(T* ptr) {
+        RefCountedPtr out;
+        out.ptr = ptr;
+        return out;
+    }
+
     RefCountedPtr(const RefCountedPtr& rhs) {
         ptr = rhs.ptr;
         if (ptr) {
@@ -118,10 +328,10 @@ public:
     void Swap(RefCountedPtr& rhs) { std::swap(ptr, rhs.ptr); }
 
     constexpr const T* operator->() const { return ptr; }
-    constexpr const T& operator*() const { return ptr; }
+    constexpr const T& operator*() const { return *ptr; }
 
     constexpr T* operator->() { return ptr; }
-    constexpr T& operator*() { return ptr; }
+    constexpr T& operator*() { return *ptr; }
 
     constexpr T* Get() const { return ptr; }
 
@@ -157,6 +367,104 @@ RefCountedPtr<T> GetRef(T* object) {
     return RefCountedPtr<T>(object);
 }
 
+// Weak reference to a BasicRefCounted object
+// Doesn't keep the object alive, Lock() returns a strong reference
+// if the object still exists:
+//   WeakRefCountedPtr<Font> weak = font;
+//   if (RefCountedPtr<Font> locked = weak.Lock()) {
+//       ...
+//   }
+template <class T>
+class WeakRefCountedPtr {
+public:
+    using ControlBlock = typename T::WeakControlBlock;
+
+    template <class U>
+    friend class WeakRefCountedPtr;
+
+    constexpr WeakRefCountedPtr() = default;
+
+    constexpr WeakRefCountedPtr(nullptr_t) {}
+
+    // The caller should hold a reference to the object
+    explicit WeakRefCountedPtr(T* object) {
+        if (object) {
+            ptr_ = object;
+            block_ = object->GetWeakControlBlock();
+            block_->AddWeakRef();
+        }
+    }
+
+    template <class U>
+        requires std::convertible_to<U*, T*>
+    WeakRefCountedPtr(const RefCountedPtr<U>& rhs)
+        : WeakRefCountedPtr(static_cast<T*>(rhs.Get())) {}
+
+    WeakRefCountedPtr(const WeakRefCountedPtr& rhs)
+        : ptr_(rhs.ptr_), block_(rhs.block_) {
+        if (block_) {
+            block_->AddWeakRef();
+        }
+    }
+
+    template <class U>
+        requires std::convertible_to<U*, T*>
+    WeakRefCountedPtr(const WeakRefCountedPtr<U>& rhs)
+        : ptr_(rhs.ptr_), block_(rhs.block_) {
+        if (block_) {
+            block_->AddWeakRef();
+        }
+    }
+
+    WeakRefCountedPtr(WeakRefCountedPtr&& rhs)
+        : ptr_(std::exchange(rhs.ptr_, nullptr)),
+          block_(std::exchange(rhs.block_, nullptr)) {}
+
+    ~WeakRefCountedPtr() { Reset(); }
+
+    WeakRefCountedPtr& operator=(const WeakRefCountedPtr& rhs) {
+        WeakRefCountedPtr(rhs).Swap(*this);
+        return *this;
+    }
+
+    WeakRefCountedPtr& operator=(WeakRefCountedPtr&& rhs) {
+        WeakRefCountedPtr(std::move(rhs)).Swap(*this);
+        return *this;
+    }
+
+    WeakRefCountedPtr& operator=(nullptr_t) {
+        Reset();
+        return *this;
+    }
+
+    void Reset() {
+        if (block_) {
+            block_->ReleaseWeakRef();
+        }
+        block_ = nullptr;
+        ptr_ = nullptr;
+    }
+
+    void Swap(WeakRefCountedPtr& rhs) {
+        std::swap(ptr_, rhs.ptr_);
+        std::swap(block_, rhs.block_);
+    }
+
+    // Returns null if the object is deleted
+    RefCountedPtr<T> Lock() const {
+        if (!block_ || !block_->TryAddRef()) {
+            return nullptr;
+        }
+        return RefCountedPtr<T>::Adopt(ptr_);
+    }
+
+    bool Expired() const { return !block_ || !block_->IsAlive(); }
+
+private:
+    T* ptr_ = nullptr;
+    ControlBlock* block_ = nullptr;
+};
+
 
 
 // Ref-counter for the WeakPtr
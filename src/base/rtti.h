@@ -1,6 +1,10 @@
 #pragma once
-#include <array>
+#include <atomic>
+#include <deque>
+#include <mutex>
 #include <string>
+#include <unordered_map>
+#include <vector>
 
 #include "error.h"
 
@@ -41,16 +45,7 @@ public:                                                                      \
 public:                                                                      \
     template <class ClassType>                                               \
     bool IsA() const {                                                       \
-        if (ClassType::GetStaticClass() == GetClass()) {                     \
-            return true;                                                     \
-        }                                                                    \
-        auto* super = GetClass()->Super;                                     \
-        for (auto* super = GetClass()->Super; super; super = super->Super) { \
-            if (super == ClassType::GetStaticClass()) {                      \
-                return true;                                                 \
-            }                                                                \
-        }                                                                    \
-        return false;                                                        \
+        return GetClass()->IsSubclassOf(ClassType::GetStaticClass());        \
     }                                                                        \
                                                                              \
     template <class ClassType>                                               \
@@ -73,60 +68,78 @@ public:                                                                      \
 struct ClassMeta {
     ClassMeta* Super = nullptr;
     std::string ClassName;
+    // Pre-order range of the class and its subclasses in the class tree
+    // Assigned by ClassTree::Finalize() and renumbered by a late
+    // registration, read without the lock
+    std::atomic<uint32_t> First = 0;
+    std::atomic<uint32_t> Last = 0;
+
+    bool IsSubclassOf(const ClassMeta* other) const;
 };
 
 /*
  * Stores C++ inheritance class tree
  * Used for safe object casting
+ * Classes are numbered in pre-order so a subclass check is a range check
  */
 class ClassTree {
 public:
-    constexpr static inline auto BufferSize = 100;
-
-    using container_type = std::array<ClassMeta, BufferSize>;
-    using iterator = typename container_type::iterator;
-
-public:
-    ClassTree() : classList_{}, tail_(0) {}
-
     // Called statically before main
     // Which means call order is unspecified
+    // A class registered after the first check, e.g. by a static
+    // initializer of another translation unit, renumbers the tree
     const ClassMeta* RegisterClass(std::string_view inClassName,
                                    std::string_view inSuperClassName) {
-        DASSERT(tail_ < BufferSize);
+        std::scoped_lock _(lock_);
         ClassMeta* superClassPtr = nullptr;
 
         if (!inSuperClassName.empty()) {
-            auto superClass =
-                std::ranges::find_if(classList_, [&](const ClassMeta& inClass) {
-                    return inClass.ClassName == inSuperClassName;
-                });
-
-            if (superClass == classList_.end()) {
-                // Precreate superclass for later, when the actual class gets to
-                // register, update its super
-                classList_[tail_].ClassName = std::string(inSuperClassName);
-                superClass = classList_.begin() + tail_;
-                ++tail_;
-            }
-            superClassPtr = &*superClass;
+            // Precreate superclass for later, when the actual class gets to
+            // register, update its super
+            superClassPtr = FindOrAdd(inSuperClassName);
         }
-        // Check if already added as a super previously
-        auto classObject =
-            std::ranges::find_if(classList_, [&](const ClassMeta& inClass) {
-                return inClass.ClassName == inClassName;
-            });
-
-        if (classObject == classList_.end()) {
-            classList_[tail_].Super = superClassPtr;
-            classList_[tail_].ClassName = std::string(inClassName);
-            classObject = classList_.begin() + tail_;
-            ++tail_;
-
-        } else {
-            classObject->Super = superClassPtr;
+        // Could be already added as a super previously
+        ClassMeta* classObject = FindOrAdd(inClassName);
+        classObject->Super = superClassPtr;
+        if (IsFinalized()) {
+            AssignAllRanges();
         }
-        return &*classObject;
+        return classObject;
+    }
+
+    // Assigns class ranges, called on the first check
+    void Finalize() {
+        std::scoped_lock _(lock_);
+        if (IsFinalized()) {
+            return;
+        }
+        AssignAllRanges();
+    }
+
+    static bool IsFinalized() {
+        return generation_.load(std::memory_order_acquire) != 0;
+    }
+
+    // The ranges are read like a seqlock. The generation is odd while the
+    // ranges are assigned and 0 before the first check:
+    //   do {
+    //       generation = BeginRead();
+    //       ...
+    //   } while (!EndRead(generation));
+    static uint32_t BeginRead() {
+        return generation_.load(std::memory_order_acquire);
+    }
+
+    static bool EndRead(uint32_t generation) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return generation % 2 == 0 &&
+               generation_.load(std::memory_order_relaxed) == generation;
+    }
+
+    const ClassMeta* Find(std::string_view inClassName) const {
+        std::scoped_lock _(lock_);
+        const auto it = classMap_.find(inClassName);
+        return it != classMap_.end() ? it->second : nullptr;
     }
 
 public:
@@ -139,11 +152,79 @@ public:
     }
 
 private:
-    // Points to sentinel
-    size_t tail_;
-    container_type classList_;
+    using ChildrenMap =
+        std::unordered_map<const ClassMeta*, std::vector<ClassMeta*>>;
+
+    // Should be called under the lock
+    void AssignAllRanges() {
+        const uint32_t generation =
+            generation_.load(std::memory_order_relaxed);
+        generation_.store(generation + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+
+        ChildrenMap children;
+        std::vector<ClassMeta*> roots;
+        for (ClassMeta& classMeta : classList_) {
+            if (classMeta.Super) {
+                children[classMeta.Super].push_back(&classMeta);
+            } else {
+                roots.push_back(&classMeta);
+            }
+        }
+        uint32_t nextID = 0;
+        for (ClassMeta* root : roots) {
+            AssignRanges(root, children, nextID);
+        }
+        generation_.store(generation + 2, std::memory_order_release);
+    }
+
+    static void AssignRanges(ClassMeta* classMeta,
+                             const ChildrenMap& children,
+                             uint32_t& nextID) {
+        classMeta->First.store(nextID++, std::memory_order_relaxed);
+        if (auto it = children.find(classMeta); it != children.end()) {
+            for (ClassMeta* child : it->second) {
+                AssignRanges(child, children, nextID);
+            }
+        }
+        classMeta->Last.store(nextID - 1, std::memory_order_relaxed);
+    }
+
+    ClassMeta* FindOrAdd(std::string_view inClassName) {
+        if (auto it = classMap_.find(inClassName); it != classMap_.end()) {
+            return it->second;
+        }
+        ClassMeta& classMeta = classList_.emplace_back();
+        classMeta.ClassName = std::string(inClassName);
+        classMap_.emplace(classMeta.ClassName, &classMeta);
+        return &classMeta;
+    }
+
+private:
+    mutable std::mutex lock_;
+    // Stable pointers
+    std::deque<ClassMeta> classList_;
+    // Points to names in the list
+    std::unordered_map<std::string_view, ClassMeta*> classMap_;
+    // Static to check without the instance
+    static inline std::atomic<uint32_t> generation_ = 0;
 };
 
+inline bool ClassMeta::IsSubclassOf(const ClassMeta* other) const {
+    if (!ClassTree::IsFinalized()) [[unlikely]] {
+        ClassTree::Instance()->Finalize();
+    }
+    bool bResult;
+    uint32_t generation;
+    do {
+        generation = ClassTree::BeginRead();
+        const uint32_t first = First.load(std::memory_order_relaxed);
+        bResult = first >= other->First.load(std::memory_order_relaxed) &&
+                  first <= other->Last.load(std::memory_order_relaxed);
+    } while (!ClassTree::EndRead(generation));
+    return bResult;
+}
+
 /*
  * Used to refiste C++ classes for simple RTTI
  * RTTI used for safe object casting
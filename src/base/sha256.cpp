@@ -0,0 +1,138 @@
+#include "sha256.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+namespace {
+
+constexpr std::array<uint32_t, 8> kInitialState = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+constexpr uint32_t kRound[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1,
+    0x923f82a4, 0xab1c5ed5, 0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174, 0xe49b69c1, 0xefbe4786,
+    0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147,
+    0x06ca6351, 0x14292967, 0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85, 0xa2bfe8a1, 0xa81a664b,
+    0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a,
+    0x5b9cca4f, 0x682e6ff3, 0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+uint32_t LoadBigEndian(const uint8_t* data) {
+    return (uint32_t)data[0] << 24 | (uint32_t)data[1] << 16 |
+           (uint32_t)data[2] << 8 | (uint32_t)data[3];
+}
+
+}  // namespace
+
+Sha256::Sha256() : state_(kInitialState) {}
+
+void Sha256::Update(std::string_view data) {
+    const auto* bytes = reinterpret_cast<const uint8_t*>(data.data());
+    size_t size = data.size();
+    totalSize_ += size;
+    if (blockSize_) {
+        const size_t n = std::min(size, block_.size() - blockSize_);
+        std::memcpy(block_.data() + blockSize_, bytes, n);
+        blockSize_ += n;
+        bytes += n;
+        size -= n;
+        if (blockSize_ < block_.size()) {
+            return;
+        }
+        Compress(block_.data());
+        blockSize_ = 0;
+    }
+    // Full blocks are read in place
+    for (; size >= block_.size(); bytes += 64, size -= 64) {
+        Compress(bytes);
+    }
+    std::memcpy(block_.data(), bytes, size);
+    blockSize_ = size;
+}
+
+Sha256::Digest Sha256::Finish() {
+    const uint64_t totalBits = totalSize_ * 8;
+    // The padding is 0x80, zeros and the size in bits as the last 8 bytes
+    // of a block
+    block_[blockSize_++] = 0x80;
+    if (blockSize_ > 56) {
+        std::memset(block_.data() + blockSize_, 0, 64 - blockSize_);
+        Compress(block_.data());
+        blockSize_ = 0;
+    }
+    std::memset(block_.data() + blockSize_, 0, 56 - blockSize_);
+    for (int i = 0; i < 8; ++i) {
+        block_[56 + i] = (uint8_t)(totalBits >> (56 - 8 * i));
+    }
+    Compress(block_.data());
+
+    Digest out;
+    for (size_t i = 0; i < state_.size(); ++i) {
+        for (int byte = 0; byte < 4; ++byte) {
+            out[i * 4 + byte] = (uint8_t)(state_[i] >> (24 - 8 * byte));
+        }
+    }
+    *this = Sha256();
+    return out;
+}
+
+std::string Sha256::ToHex(const Digest& digest) {
+    constexpr char kHex[] = "0123456789abcdef";
+    std::string out(digest.size() * 2, '\0');
+    for (size_t i = 0; i < digest.size(); ++i) {
+        out[i * 2] = kHex[digest[i] >> 4];
+        out[i * 2 + 1] = kHex[digest[i] & 0xf];
+    }
+    return out;
+}
+
+void Sha256::Compress(const uint8_t* block) {
+    uint32_t w[64];
+    for (int i = 0; i < 16; ++i) {
+        w[i] = LoadBigEndian(block + i * 4);
+    }
+    for (int i = 16; i < 64; ++i) {
+        const uint32_t s0 = std::rotr(w[i - 15], 7) ^
+                            std::rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+        const uint32_t s1 = std::rotr(w[i - 2], 17) ^
+                            std::rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+        w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+    }
+
+    uint32_t a = state_[0], b = state_[1], c = state_[2], d = state_[3];
+    uint32_t e = state_[4], f = state_[5], g = state_[6], h = state_[7];
+    for (int i = 0; i < 64; ++i) {
+        const uint32_t s1 =
+            std::rotr(e, 6) ^ std::rotr(e, 11) ^ std::rotr(e, 25);
+        const uint32_t ch = (e & f) ^ (~e & g);
+        const uint32_t t1 = h + s1 + ch + kRound[i] + w[i];
+        const uint32_t s0 =
+            std::rotr(a, 2) ^ std::rotr(a, 13) ^ std::rotr(a, 22);
+        const uint32_t maj = (a & b) ^ (a & c) ^ (b & c);
+        const uint32_t t2 = s0 + maj;
+        h = g;
+        g = f;
+        f = e;
+        e = d + t1;
+        d = c;
+        c = b;
+        b = a;
+        a = t1 + t2;
+    }
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+    state_[5] += f;
+    state_[6] += g;
+    state_[7] += h;
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+// SHA-256 (FIPS 180-4) for content addressed keys, e.g. the file names of
+// the disk caches
+// Not constant time, not meant for secrets
+class Sha256 {
+public:
+    using Digest = std::array<uint8_t, 32>;
+
+    Sha256();
+
+    void Update(std::string_view data);
+
+    // The hasher is reset afterwards
+    Digest Finish();
+
+    static Digest Hash(std::string_view data) {
+        Sha256 hasher;
+        hasher.Update(data);
+        return hasher.Finish();
+    }
+
+    // Lower case hex, 64 chars
+    static std::string ToHex(const Digest& digest);
+
+private:
+    void Compress(const uint8_t* block);
+
+private:
+    std::array<uint32_t, 8> state_;
+    std::array<uint8_t, 64> block_;
+    size_t blockSize_ = 0;
+    uint64_t totalSize_ = 0;
+};
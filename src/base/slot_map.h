@@ -0,0 +1,228 @@
+#pragma once
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "base/error.h"
+
+// Stable handle to a value of a SlotMap
+// A slot changes its generation on every insertion and erasure, so the
+// handle of an erased value never matches a new value in the same slot
+// (until the slot is reused 2^31 times)
+struct SlotHandle {
+    uint32_t index = 0;
+    // Odd while the value is alive, 0 is never valid
+    uint32_t generation = 0;
+
+    explicit operator bool() const { return generation != 0; }
+    bool operator==(const SlotHandle&) const = default;
+
+    // Packs into a single integer, e.g. for logs or the user data of the
+    // OS callbacks
+    uint64_t ToBits() const { return (uint64_t)generation << 32 | index; }
+
+    static SlotHandle FromBits(uint64_t bits) {
+        return {(uint32_t)bits, (uint32_t)(bits >> 32)};
+    }
+};
+
+// Container which hands out handles instead of pointers or indices:
+//   SlotMap<Timer> timers;
+//   SlotHandle handle = timers.insert(timer);
+//   if (Timer* timer = timers.get(handle)) { ... }
+//   timers.erase(handle);
+//
+// Insertion, erasure and lookup are O(1). The values are stored densely,
+// iteration goes over a contiguous array in no particular order. Erasing
+// moves the last value into the hole, so pointers and iterators are
+// invalidated by any modification, the handles stay valid.
+//
+// The slots are allocated in pages which are never moved or freed until
+// destruction. contains() could be called by any thread concurrently with
+// a single writer, e.g. to validate a handle without taking the lock of
+// the writers. Other methods need external synchronization.
+template <class T>
+class SlotMap {
+public:
+    using value_type = T;
+    using iterator = typename std::vector<T>::iterator;
+    using const_iterator = typename std::vector<T>::const_iterator;
+
+    SlotMap() = default;
+
+    ~SlotMap() {
+        for (auto& page : pages_) {
+            delete[] page.load(std::memory_order_relaxed);
+        }
+    }
+
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    template <class... Args>
+    SlotHandle emplace(Args&&... args) {
+        const uint32_t index = AcquireSlot();
+        values_.emplace_back(std::forward<Args>(args)...);
+        slotOfValue_.push_back(index);
+        Slot& slot = GetSlot(index);
+        slot.denseIndex = (uint32_t)values_.size() - 1;
+        // Becomes odd
+        const uint32_t generation =
+            slot.generation.load(std::memory_order_relaxed) + 1;
+        slot.generation.store(generation, std::memory_order_release);
+        return {index, generation};
+    }
+
+    SlotHandle insert(const T& value) { return emplace(value); }
+    SlotHandle insert(T&& value) { return emplace(std::move(value)); }
+
+    // Returns false if the handle is stale
+    bool erase(SlotHandle handle) {
+        if (!contains(handle)) {
+            return false;
+        }
+        Slot& slot = GetSlot(handle.index);
+        const uint32_t dense = slot.denseIndex;
+        const uint32_t last = (uint32_t)values_.size() - 1;
+        if (dense != last) {
+            values_[dense] = std::move(values_[last]);
+            slotOfValue_[dense] = slotOfValue_[last];
+            GetSlot(slotOfValue_[dense]).denseIndex = dense;
+        }
+        values_.pop_back();
+        slotOfValue_.pop_back();
+        ReleaseSlot(handle.index, slot);
+        return true;
+    }
+
+    // Returns nullptr if the handle is stale
+    T* get(SlotHandle handle) {
+        return contains(handle) ? &values_[GetSlot(handle.index).denseIndex]
+                                : nullptr;
+    }
+
+    const T* get(SlotHandle handle) const {
+        return const_cast<SlotMap*>(this)->get(handle);
+    }
+
+    bool contains(SlotHandle handle) const {
+        if (!handle ||
+            handle.index >= slotCount_.load(std::memory_order_acquire)) {
+            return false;
+        }
+        const Slot& slot = GetSlot(handle.index);
+        return slot.generation.load(std::memory_order_acquire) ==
+               handle.generation;
+    }
+
+    // Handle of the value at the position of the dense array
+    SlotHandle handle_at(size_t index) const {
+        DASSERT(index < values_.size());
+        const uint32_t slotIndex = slotOfValue_[index];
+        return {slotIndex, GetSlot(slotIndex).generation.load(
+                               std::memory_order_relaxed)};
+    }
+
+    void clear() {
+        for (uint32_t index : slotOfValue_) {
+            ReleaseSlot(index, GetSlot(index));
+        }
+        values_.clear();
+        slotOfValue_.clear();
+    }
+
+    void reserve(size_t count) {
+        values_.reserve(count);
+        slotOfValue_.reserve(count);
+    }
+
+    size_t size() const { return values_.size(); }
+    bool empty() const { return values_.empty(); }
+
+    std::span<T> values() { return values_; }
+    std::span<const T> values() const { return values_; }
+
+    T& operator[](size_t index) { return values_[index]; }
+    const T& operator[](size_t index) const { return values_[index]; }
+
+    iterator begin() { return values_.begin(); }
+    iterator end() { return values_.end(); }
+    const_iterator begin() const { return values_.begin(); }
+    const_iterator end() const { return values_.end(); }
+
+private:
+    struct Slot {
+        // Odd while occupied
+        std::atomic<uint32_t> generation = 0;
+        // Position in the dense array while occupied, next free slot
+        // otherwise
+        uint32_t denseIndex = 0;
+    };
+
+    // Page 0 holds kFirstPageSize slots, each next page doubles the
+    // capacity: [0, 64), [64, 128), [128, 256)...
+    static constexpr uint32_t kFirstPageBits = 6;
+    static constexpr uint32_t kFirstPageSize = 1u << kFirstPageBits;
+    static constexpr uint32_t kMaxPages = 32 - kFirstPageBits + 1;
+    static constexpr uint32_t kNoFreeSlot = UINT32_MAX;
+
+    static uint32_t PageOf(uint32_t index) {
+        return (uint32_t)std::bit_width(index >> kFirstPageBits);
+    }
+
+    static uint32_t PageStart(uint32_t page) {
+        return page ? kFirstPageSize << (page - 1) : 0;
+    }
+
+    static uint32_t PageSize(uint32_t page) {
+        return page ? kFirstPageSize << (page - 1) : kFirstPageSize;
+    }
+
+    const Slot& GetSlot(uint32_t index) const {
+        const uint32_t page = PageOf(index);
+        return pages_[page].load(std::memory_order_acquire)[index -
+                                                            PageStart(page)];
+    }
+
+    Slot& GetSlot(uint32_t index) {
+        return const_cast<Slot&>(std::as_const(*this).GetSlot(index));
+    }
+
+    uint32_t AcquireSlot() {
+        if (freeHead_ != kNoFreeSlot) {
+            const uint32_t index = freeHead_;
+            freeHead_ = GetSlot(index).denseIndex;
+            return index;
+        }
+        const uint32_t index = slotCount_.load(std::memory_order_relaxed);
+        DASSERT_M(index != UINT32_MAX, "Too many slots");
+        const uint32_t page = PageOf(index);
+        if (index == PageStart(page)) {
+            pages_[page].store(new Slot[PageSize(page)],
+                               std::memory_order_release);
+        }
+        // Published after the page
+        slotCount_.store(index + 1, std::memory_order_release);
+        return index;
+    }
+
+    void ReleaseSlot(uint32_t index, Slot& slot) {
+        // Becomes even
+        slot.generation.store(
+            slot.generation.load(std::memory_order_relaxed) + 1,
+            std::memory_order_release);
+        slot.denseIndex = freeHead_;
+        freeHead_ = index;
+    }
+
+private:
+    std::vector<T> values_;
+    // Slot index of each value
+    std::vector<uint32_t> slotOfValue_;
+    std::atomic<uint32_t> slotCount_ = 0;
+    uint32_t freeHead_ = kNoFreeSlot;
+    std::atomic<Slot*> pages_[kMaxPages] = {};
+};
@@ -0,0 +1,357 @@
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <iterator>
+#include <memory>
+#include <span>
+#include <type_traits>
+#include <utility>
+
+#include "base/error.h"
+
+// Vector which stores up to N elements inline without heap allocations
+// Spills into memory from the allocator when exceeded:
+//   SmallVector<Widget*, 4> children;
+//   children.push_back(child);
+//
+// Any std allocator is supported, e.g. ArenaAllocator from bump_alloc.h
+// Moving a vector with inline elements moves them one by one
+template <class T, size_t N, class Alloc = std::allocator<T>>
+class SmallVector {
+public:
+    static_assert(N > 0, "Use std::vector for no inline storage");
+
+    using value_type = T;
+    using size_type = size_t;
+    using difference_type = ptrdiff_t;
+    using reference = T&;
+    using const_reference = const T&;
+    using pointer = T*;
+    using const_pointer = const T*;
+    using iterator = T*;
+    using const_iterator = const T*;
+    using reverse_iterator = std::reverse_iterator<iterator>;
+    using const_reverse_iterator = std::reverse_iterator<const_iterator>;
+    using allocator_type = Alloc;
+
+    static constexpr size_t kInlineCapacity = N;
+
+public:
+    SmallVector() = default;
+
+    explicit SmallVector(const Alloc& alloc) : alloc_(alloc) {}
+
+    explicit SmallVector(size_t count, const T& value = T(),
+                         const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        assign(count, value);
+    }
+
+    SmallVector(std::initializer_list<T> init, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        append(init.begin(), init.end());
+    }
+
+    template <std::input_iterator It>
+    SmallVector(It first, It last, const Alloc& alloc = Alloc())
+        : alloc_(alloc) {
+        append(first, last);
+    }
+
+    SmallVector(const SmallVector& rhs)
+        : alloc_(std::allocator_traits<Alloc>::
+                     select_on_container_copy_construction(rhs.alloc_)) {
+        append(rhs.begin(), rhs.end());
+    }
+
+    SmallVector(SmallVector&& rhs) noexcept(
+        std::is_nothrow_move_constructible_v<T>)
+        : alloc_(std::move(rhs.alloc_)) {
+        MoveFrom(rhs);
+    }
+
+    SmallVector& operator=(const SmallVector& rhs) {
+        if (this != &rhs) {
+            assign(rhs.begin(), rhs.end());
+        }
+        return *this;
+    }
+
+    // The elements are moved one by one into memory from this allocator
+    // if the allocators differ, which could throw
+    SmallVector& operator=(SmallVector&& rhs) noexcept(
+        std::is_nothrow_move_constructible_v<T> &&
+        std::allocator_traits<Alloc>::is_always_equal::value) {
+        if (this != &rhs) {
+            clear();
+            if (rhs.IsInline() || alloc_ == rhs.alloc_) {
+                Deallocate();
+                MoveFrom(rhs);
+            } else {
+                append(std::make_move_iterator(rhs.begin()),
+                       std::make_move_iterator(rhs.end()));
+                rhs.clear();
+            }
+        }
+        return *this;
+    }
+
+    SmallVector& operator=(std::initializer_list<T> init) {
+        assign(init.begin(), init.end());
+        return *this;
+    }
+
+    ~SmallVector() {
+        clear();
+        Deallocate();
+    }
+
+    void assign(size_t count, const T& value) {
+        clear();
+        reserve(count);
+        std::uninitialized_fill_n(data_, count, value);
+        size_ = count;
+    }
+
+    template <std::input_iterator It>
+    void assign(It first, It last) {
+        clear();
+        append(first, last);
+    }
+
+public:
+    T* data() { return data_; }
+    const T* data() const { return data_; }
+
+    size_t size() const { return size_; }
+    size_t capacity() const { return capacity_; }
+    bool empty() const { return size_ == 0; }
+
+    // True while the elements fit into the inline storage
+    bool IsInline() const { return data_ == InlineData(); }
+
+    allocator_type get_allocator() const { return alloc_; }
+
+    iterator begin() { return data_; }
+    iterator end() { return data_ + size_; }
+    const_iterator begin() const { return data_; }
+    const_iterator end() const { return data_ + size_; }
+    const_iterator cbegin() const { return data_; }
+    const_iterator cend() const { return data_ + size_; }
+
+    reverse_iterator rbegin() { return reverse_iterator(end()); }
+    reverse_iterator rend() { return reverse_iterator(begin()); }
+    const_reverse_iterator rbegin() const {
+        return const_reverse_iterator(end());
+    }
+    const_reverse_iterator rend() const {
+        return const_reverse_iterator(begin());
+    }
+
+    T& operator[](size_t index) {
+        DASSERT(index < size_);
+        return data_[index];
+    }
+
+    const T& operator[](size_t index) const {
+        DASSERT(index < size_);
+        return data_[index];
+    }
+
+    T& front() {
+        DASSERT(size_);
+        return data_[0];
+    }
+    const T& front() const {
+        DASSERT(size_);
+        return data_[0];
+    }
+
+    T& back() {
+        DASSERT(size_);
+        return data_[size_ - 1];
+    }
+    const T& back() const {
+        DASSERT(size_);
+        return data_[size_ - 1];
+    }
+
+    operator std::span<T>() { return {data_, size_}; }
+    operator std::span<const T>() const { return {data_, size_}; }
+
+public:
+    void push_back(const T& value) { emplace_back(value); }
+    void push_back(T&& value) { emplace_back(std::move(value)); }
+
+    template <class... Args>
+    T& emplace_back(Args&&... args) {
+        if (size_ == capacity_) {
+            // The argument could reference an element
+            return GrowAndEmplaceBack(std::forward<Args>(args)...);
+        }
+        T* elem = std::construct_at(data_ + size_, std::forward<Args>(args)...);
+        ++size_;
+        return *elem;
+    }
+
+    void pop_back() {
+        DASSERT(size_);
+        --size_;
+        std::destroy_at(data_ + size_);
+    }
+
+    template <std::input_iterator It>
+    void append(It first, It last) {
+        if constexpr (std::forward_iterator<It>) {
+            reserve(size_ + (size_t)std::distance(first, last));
+        }
+        for (; first != last; ++first) {
+            emplace_back(*first);
+        }
+    }
+
+    iterator insert(const_iterator pos, const T& value) {
+        return emplace(pos, value);
+    }
+
+    iterator insert(const_iterator pos, T&& value) {
+        return emplace(pos, std::move(value));
+    }
+
+    template <class... Args>
+    iterator emplace(const_iterator pos, Args&&... args) {
+        DASSERT(pos >= begin() && pos <= end());
+        const size_t index = (size_t)(pos - begin());
+        if (index == size_) {
+            emplace_back(std::forward<Args>(args)...);
+            return data_ + index;
+        }
+        // Constructed first as the arguments could reference an element
+        T value(std::forward<Args>(args)...);
+        emplace_back(std::move(back()));
+        std::move_backward(data_ + index, data_ + size_ - 2,
+                           data_ + size_ - 1);
+        data_[index] = std::move(value);
+        return data_ + index;
+    }
+
+    iterator erase(const_iterator pos) { return erase(pos, pos + 1); }
+
+    iterator erase(const_iterator first, const_iterator last) {
+        DASSERT(first >= begin() && last <= end() && first <= last);
+        T* dst = data_ + (first - begin());
+        T* newEnd = std::move(dst + (last - first), end(), dst);
+        std::destroy(newEnd, end());
+        size_ = (size_t)(newEnd - data_);
+        return dst;
+    }
+
+    void clear() {
+        std::destroy(begin(), end());
+        size_ = 0;
+    }
+
+    void resize(size_t count) {
+        if (count < size_) {
+            std::destroy(data_ + count, end());
+        } else {
+            reserve(count);
+            std::uninitialized_value_construct(data_ + size_, data_ + count);
+        }
+        size_ = count;
+    }
+
+    void resize(size_t count, const T& value) {
+        if (count < size_) {
+            std::destroy(data_ + count, end());
+            size_ = count;
+            return;
+        }
+        while (size_ < count) {
+            push_back(value);
+        }
+    }
+
+    void reserve(size_t count) {
+        if (count > capacity_) {
+            Reallocate(std::max(count, capacity_ * 2));
+        }
+    }
+
+    // Moves the elements back into the inline storage if they fit
+    void shrink_to_fit() {
+        if (!IsInline() && size_ < capacity_) {
+            Reallocate(size_);
+        }
+    }
+
+    bool operator==(const SmallVector& rhs) const {
+        return std::equal(begin(), end(), rhs.begin(), rhs.end());
+    }
+
+private:
+    using AllocTraits = std::allocator_traits<Alloc>;
+
+    T* InlineData() { return reinterpret_cast<T*>(inline_); }
+    const T* InlineData() const { return reinterpret_cast<const T*>(inline_); }
+
+    template <class... Args>
+    T& GrowAndEmplaceBack(Args&&... args) {
+        const size_t newCapacity = capacity_ * 2;
+        T* newData = AllocTraits::allocate(alloc_, newCapacity);
+        T* elem =
+            std::construct_at(newData + size_, std::forward<Args>(args)...);
+        std::uninitialized_move(begin(), end(), newData);
+        std::destroy(begin(), end());
+        Deallocate();
+        data_ = newData;
+        capacity_ = newCapacity;
+        ++size_;
+        return *elem;
+    }
+
+    void Reallocate(size_t newCapacity) {
+        DASSERT(newCapacity >= size_);
+        T* newData = newCapacity <= N
+                         ? InlineData()
+                         : AllocTraits::allocate(alloc_, newCapacity);
+        if (newData == data_) {
+            return;
+        }
+        std::uninitialized_move(begin(), end(), newData);
+        std::destroy(begin(), end());
+        Deallocate();
+        data_ = newData;
+        capacity_ = std::max(newCapacity, N);
+    }
+
+    void Deallocate() {
+        if (!IsInline()) {
+            AllocTraits::deallocate(alloc_, data_, capacity_);
+            data_ = InlineData();
+            capacity_ = N;
+        }
+    }
+
+    // Steals the heap memory or moves the inline elements
+    void MoveFrom(SmallVector& rhs) {
+        if (rhs.IsInline()) {
+            std::uninitialized_move(rhs.begin(), rhs.end(), data_);
+            size_ = rhs.size_;
+            rhs.clear();
+        } else {
+            data_ = std::exchange(rhs.data_, rhs.InlineData());
+            size_ = std::exchange(rhs.size_, 0);
+            capacity_ = std::exchange(rhs.capacity_, N);
+        }
+    }
+
+private:
+    [[no_unique_address]] Alloc alloc_;
+    T* data_ = InlineData();
+    size_t size_ = 0;
+    size_t capacity_ = N;
+    alignas(T) std::byte inline_[N * sizeof(T)];
+};
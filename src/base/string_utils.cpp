@@ -2,103 +2,239 @@
 #include "common.h"
 #include "util.h"
 #include "threading.h"
+#include "mem_tracker.h"
 
+#include <algorithm>
+#include <array>
+#include <bit>
 #include <map>
 
 using int32 = int32_t;
 
 #define check(a) DASSERT(a)
 
+/*
+ * Pool of interned strings
+ * Entries are stored in fixed size chunks and never move, so indices
+ * and references stay valid for the lifetime of the process
+ * Lookup tables are split into shards by hash, each one is an open addressing
+ * table of indices. Lookups are lock-free, only insertions lock a shard
+ */
 class StringPool {
 public:
 
+	struct Entry {
+		std::string str;
+		uint64_t    hash = 0;
+		// First 8 bytes in the big endian order
+		// Orders most strings without touching the string data
+		uint64_t    lexicalKey = 0;
+	};
+
+	static constexpr int32 kNumShardsLog2 = 4;
+	static constexpr int32 kNumShards = 1 << kNumShardsLog2;
+	static constexpr int32 kChunkSizeLog2 = 10;
+	static constexpr int32 kChunkSize = 1 << kChunkSizeLog2;
+	static constexpr int32 kMaxChunks = 4096;
+	static constexpr uint32_t kInitialShardCapacity = 
+		(uint32_t)std::bit_ceil(2 * kStringPoolSize / kNumShards);
+	// Shorter strings are stored inside of the entry
+	static constexpr size_t kInlineCapacity = std::string().capacity();
+
 	// Reserve 0 index
-	StringPool() { 
-		m_StringPool.reserve(kStringPoolSize); 
-		m_StringPool.emplace_back(); 
+	StringPool() {
+		m_Chunks[0].store(_newChunk(), std::memory_order_relaxed);
+		for (Shard& shard : m_Shards) {
+			shard.table.store(_newTable(kInitialShardCapacity, nullptr), std::memory_order_relaxed);
+		}
 	}
 
 	static StringPool& instance() {
-		static StringPool* _instance; 
-		if (!_instance) {
-			_instance = new StringPool;
-		}
+		// Never destroyed, StringIDs could be used from static destructors
+		static StringPool* _instance = new StringPool;
 		return *_instance; 
 	}
 
 	/**
 	 * Adds new string to pool or returns existing one
 	 */
-	void intern(std::string_view inString, int32& outCompareIndex, int32& outDisplayIndex) {
+	void intern(std::string_view inString, const StringID::Hashes& inHashes, int32& outCompareIndex, int32& outDisplayIndex) {
 		check(!inString.empty());
+		outCompareIndex = _intern(inString, inHashes.compare, true);
 
-		std::string compareStr(inString);
-
-		std::transform(
-			std::begin(compareStr),
-			std::end(compareStr),
-			std::begin(compareStr),
-			[](unsigned char c) {
-				return std::tolower(c);
-			}
-		);
-		_intern(compareStr, outCompareIndex);
-
-		if (inString == compareStr) {
+		const bool isLowerCase = std::ranges::none_of(inString, [](char c) {
+			return c != string_hash::FoldCase(c);
+		});
+		if (isLowerCase) {
 			outDisplayIndex = outCompareIndex;			
 		} else {
-			_intern(std::string(inString), outDisplayIndex);
+			outDisplayIndex = _intern(inString, inHashes.display, false);
 		}
 	}
 
-	/**
-	 * Returns intern or NULL for specified index
-	 */
-	const std::string& string(int32 inIndex) {
-		DASSERT(inIndex < m_StringPool.size());
-		return m_StringPool[inIndex];
+	const Entry& entry(int32 inIndex) const {
+		DASSERT(inIndex >= 0 && inIndex < m_NextIndex.load(std::memory_order_relaxed));
+		const Entry* chunk = m_Chunks[inIndex >> kChunkSizeLog2].load(std::memory_order_acquire);
+		return chunk[inIndex & (kChunkSize - 1)];
+	}
+
+	const std::string& string(int32 inIndex) const {
+		return entry(inIndex).str;
 	}
 
 private:
 
-	void _intern(const std::string& inString, int32& outIndex) {
+	struct Table {
+		Table(uint32_t capacity, Table* prev)
+			: mask(capacity - 1)
+			, slots(new std::atomic<int32>[capacity]{})
+			, retired(prev) {}
 
-		auto& str = inString;
-		Spinlock::ScopedLock lock(m_StringPoolMutex);
-		auto it = m_InternedStrings.find(str);
+		uint32_t                              mask;
+		std::unique_ptr<std::atomic<int32>[]> slots;
+		// Previous smaller table. Kept alive because readers could still probe it
+		Table*                                retired;
+	};
 
-		if (it != m_InternedStrings.end()) {
-			outIndex = it->second;
+	struct alignas(64) Shard {
+		Spinlock            lock;
+		std::atomic<Table*> table;
+		// Guarded by the lock
+		uint32_t            count = 0;
+	};
 
-		} else {			
-			auto newIndex = (int32)m_StringPool.size();
-			m_StringPool.emplace_back(str);
-			m_InternedStrings.emplace(str, newIndex);
-			outIndex = newIndex;
+	// Returns the index of the string or 0
+	// If |fold| is set matches lower case entries with a lower case version of |str|
+	int32 _find(const Table* table, std::string_view str, uint64_t hash, bool fold) const {
+		for (uint32_t i = (uint32_t)hash & table->mask;; i = (i + 1) & table->mask) {
+			const int32 index = table->slots[i].load(std::memory_order_acquire);
+			if (index == 0) {
+				return 0;
+			}
+			const Entry& e = entry(index);
+			if (e.hash == hash && _equals(e.str, str, fold)) {
+				return index;
+			}
 		}
 	}
 
-private:
-	Spinlock						m_StringPoolMutex;
-	std::vector<std::string>		m_StringPool;
+	static bool _equals(std::string_view entry, std::string_view str, bool fold) {
+		if (!fold) {
+			return entry == str;
+		}
+		return std::ranges::equal(entry, str, [](char a, char b) {
+			return a == string_hash::FoldCase(b);
+		});
+	}
+
+	int32 _intern(std::string_view inString, uint64_t inHash, bool inFold) {
+		Shard& shard = m_Shards[inHash >> (64 - kNumShardsLog2)];
+		// Fast path, already interned
+		if (int32 index = _find(shard.table.load(std::memory_order_acquire), inString, inHash, inFold)) {
+			return index;
+		}
+		Spinlock::ScopedLock lock(shard.lock);
+		Table* table = shard.table.load(std::memory_order_relaxed);
+		// Could be added by another thread
+		if (int32 index = _find(table, inString, inHash, inFold)) {
+			return index;
+		}
+		if (2 * (shard.count + 1) > table->mask + 1) {
+			table = _grow(shard, table);
+		}
+		const int32 newIndex = _allocateEntry(inString, inHash, inFold);
+		_insert(table, newIndex, inHash);
+		++shard.count;
+		return newIndex;
+	}
 
-	// TODO try using hash map
-	std::map<std::string, int32>	m_InternedStrings;
+	void _insert(Table* table, int32 index, uint64_t hash) {
+		uint32_t i = (uint32_t)hash & table->mask;
+		while (table->slots[i].load(std::memory_order_relaxed) != 0) {
+			i = (i + 1) & table->mask;
+		}
+		table->slots[i].store(index, std::memory_order_release);
+	}
+
+	// The pool memory is never freed and is reported to the Strings tag
+	static Entry* _newChunk() {
+		auto* chunk = new Entry[kChunkSize];
+		mem::RecordAlloc(kChunkSize * sizeof(Entry), mem::Tag::Strings);
+		return chunk;
+	}
+
+	static Table* _newTable(uint32_t capacity, Table* prev) {
+		auto* table = new Table(capacity, prev);
+		mem::RecordAlloc(sizeof(Table) + capacity * sizeof(std::atomic<int32>), mem::Tag::Strings);
+		return table;
+	}
+
+	Table* _grow(Shard& shard, Table* table) {
+		auto* newTable = _newTable(2 * (table->mask + 1), table);
+		for (uint32_t i = 0; i <= table->mask; ++i) {
+			if (int32 index = table->slots[i].load(std::memory_order_relaxed)) {
+				_insert(newTable, index, entry(index).hash);
+			}
+		}
+		shard.table.store(newTable, std::memory_order_release);
+		return newTable;
+	}
+
+	int32 _allocateEntry(std::string_view inString, uint64_t inHash, bool inFold) {
+		const int32 index = m_NextIndex.fetch_add(1, std::memory_order_relaxed);
+		const int32 chunkIndex = index >> kChunkSizeLog2;
+		// Checked in all builds, past the last chunk is outside of the table
+		if (chunkIndex >= kMaxChunks) {
+			LOGF(Fatal, "String pool overflow. Max {} strings",
+				 kMaxChunks * kChunkSize);
+			std::abort();
+		}
+
+		Entry* chunk = m_Chunks[chunkIndex].load(std::memory_order_acquire);
+		if (!chunk) {
+			auto* newChunk = _newChunk();
+			if (m_Chunks[chunkIndex].compare_exchange_strong(chunk, newChunk, std::memory_order_acq_rel)) {
+				chunk = newChunk;
+			} else {
+				delete[] newChunk;
+				mem::RecordFree(kChunkSize * sizeof(Entry), mem::Tag::Strings);
+			}
+		}
+		Entry& e = chunk[index & (kChunkSize - 1)];
+		e.str = inString;
+		if (inFold) {
+			std::ranges::transform(e.str, e.str.begin(), string_hash::FoldCase);
+		}
+		if (e.str.capacity() > kInlineCapacity) {
+			mem::RecordAlloc(e.str.capacity() + 1, mem::Tag::Strings);
+		}
+		e.hash = inHash;
+		for (size_t i = 0; i < sizeof(e.lexicalKey); ++i) {
+			const uint8_t c = i < e.str.size() ? (uint8_t)e.str[i] : 0;
+			e.lexicalKey |= (uint64_t)c << (8 * (sizeof(e.lexicalKey) - 1 - i));
+		}
+		return index;
+	}
+
+private:
+	std::array<Shard, kNumShards>                m_Shards;
+	std::array<std::atomic<Entry*>, kMaxChunks>  m_Chunks{};
+	std::atomic<int32>                           m_NextIndex = 1;
 };
 
-void StringID::_intern(std::string_view inName) {
-	StringPool::instance().intern(inName, m_CompareIndex, m_DisplayIndex);
+void StringID::_intern(std::string_view inName, const Hashes& hashes) {
+	StringPool::instance().intern(inName, hashes, m_CompareIndex, m_DisplayIndex);
 }
 
 int StringID::_compareLexically(const StringID& right) const {
 	if (m_CompareIndex == right.m_CompareIndex) { return 0; }
-	const char* rightStr = StringPool::instance().string(m_CompareIndex).c_str();
-	const char* thisStr = StringPool::instance().string(m_DisplayIndex).c_str();
-	auto len = std::min(std::strlen(thisStr), std::strlen(rightStr));
-	if (int32 diff = std::strncmp(thisStr, rightStr, len)) {
-		return diff;
+	const auto& pool = StringPool::instance();
+	const auto& thisEntry = pool.entry(m_CompareIndex);
+	const auto& rightEntry = pool.entry(right.m_CompareIndex);
+	if (thisEntry.lexicalKey != rightEntry.lexicalKey) {
+		return thisEntry.lexicalKey < rightEntry.lexicalKey ? -1 : 1;
 	}
-	return (int)std::strlen(thisStr) - (int)std::strlen(rightStr);
+	return thisEntry.str.compare(rightEntry.str);
 }
 
 const std::string& StringID::String() const {
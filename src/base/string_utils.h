@@ -1,6 +1,8 @@
 #pragma once
 #include "common.h"
+#include "utf8.h"
 
+#include <atomic>
 #include <istream>
 #include <ostream>
 #include <filesystem>
@@ -143,11 +145,17 @@ private:
     std::string* buffer_;
 };
 
-inline std::wstring ToWideString(const std::string& inStr) {
-    auto out = std::wstring(inStr.size() + 1, L'\0');
-    size_t convertedChars = 0;
-    mbstowcs_s(&convertedChars, out.data(), out.size(), inStr.c_str(),
-               _TRUNCATE);
+// Returns an empty string if |str| isn't valid UTF-8
+inline std::wstring ToWideString(std::string_view str) {
+    std::wstring out(str.size(), L'\0');
+    size_t size;
+    // wchar_t is UTF-16 on Windows and UTF-32 elsewhere
+    if constexpr (sizeof(wchar_t) == sizeof(char16_t)) {
+        size = utf8::ToUtf16(str, reinterpret_cast<char16_t*>(out.data()));
+    } else {
+        size = utf8::ToUtf32(str, reinterpret_cast<char32_t*>(out.data()));
+    }
+    out.resize(size != utf8::kError ? size : 0);
     return out;
 }
 
@@ -158,40 +166,86 @@ inline std::string ToLower(const std::string& inString) {
     return str;
 }
 
+// Converts into UTF-8, returns false if |wstr| isn't valid UTF-16
 inline bool WStringToString(std::wstring_view wstr, std::string& str) {
-    size_t strLen;
-    errno_t err;
-    if ((err = wcstombs_s(&strLen, nullptr, 0, wstr.data(), _TRUNCATE)) != 0) {
-        return false;
-    }
-    DASSERT(strLen > 0);
-    // Remove \0
-    str.clear();
-    str.resize(strLen);
-    // Remove \0
-    str.pop_back();
-
-    if ((err = wcstombs_s(nullptr, &str.front(), strLen, wstr.data(),
-                          _TRUNCATE)) != 0) {
-        return false;
+    size_t size;
+    if constexpr (sizeof(wchar_t) == sizeof(char16_t)) {
+        str.resize(wstr.size() * 3);
+        size = utf8::FromUtf16(
+            {reinterpret_cast<const char16_t*>(wstr.data()), wstr.size()},
+            str.data());
+    } else {
+        str.resize(wstr.size() * 4);
+        size = utf8::FromUtf32(
+            {reinterpret_cast<const char32_t*>(wstr.data()), wstr.size()},
+            str.data());
     }
-    return true;
+    str.resize(size != utf8::kError ? size : 0);
+    return size != utf8::kError;
+}
+
+
+// 64-bit FNV-1a used by the StringID pool
+// Constexpr so string literals could be hashed at compile time
+namespace string_hash {
+
+constexpr uint64_t kFnvOffset = 14695981039346656037ull;
+constexpr uint64_t kFnvPrime = 1099511628211ull;
+
+// ASCII only, matches std::tolower() in the "C" locale
+constexpr char FoldCase(char c) {
+	return c >= 'A' && c <= 'Z' ? char(c - 'A' + 'a') : c;
 }
 
+constexpr uint64_t Fnv1a(std::string_view s) {
+	uint64_t hash = kFnvOffset;
+	for (char c : s) {
+		hash = (hash ^ (uint8_t)c) * kFnvPrime;
+	}
+	return hash;
+}
+
+// Hash of the lower case version of |s|
+constexpr uint64_t Fnv1aFolded(std::string_view s) {
+	uint64_t hash = kFnvOffset;
+	for (char c : s) {
+		hash = (hash ^ (uint8_t)FoldCase(c)) * kFnvPrime;
+	}
+	return hash;
+}
+
+} // namespace string_hash
 
 /**
  * Interned string in a string pool
  * Stores indices into that pool
  * Case insensitive MyString == mystring
  * But case is preserved when transformed back to string
+ * 
+ * Interning is lock-free when the string is already in the pool.
+ * For literals prefer "MyString"_sid: the hash is computed at compile time
+ * and the indices are cached per literal after the first use
  */
 class StringID {
 public:	
 
 	using index_type = int32_t;
 
+	// Precomputed hashes of a string
+	struct Hashes {
+		// Hash of the lower case string
+		uint64_t compare = 0;
+		// Hash of the string as is
+		uint64_t display = 0;
+	};
+
+	static constexpr Hashes ComputeHashes(std::string_view str) {
+		return {string_hash::Fnv1aFolded(str), string_hash::Fnv1a(str)};
+	}
+
 	constexpr StringID();
 	StringID(const char* inNewName);
+	StringID(std::string_view str, const Hashes& hashes);
 
 	template<StringData T>
 	StringID(const T& inStringData): StringID(inStringData.data()) {}
@@ -202,6 +256,10 @@ public:
 	constexpr StringID& operator=(const StringID& other) = default;
 	constexpr StringID& operator=(StringID&& other) = default;
 
+	// Resolves a literal with precomputed hashes
+	// |cache| is a per literal storage of the packed indices, 0 if not resolved yet
+	static StringID FromLiteral(std::string_view str, const Hashes& hashes, std::atomic<uint64_t>& cache);
+
 	const std::string&		String() const;
 
 	bool					Empty() const { return m_CompareIndex == 0; }
@@ -255,7 +313,8 @@ public:
 	/** Fast non-alphabetical order that is only stable during this process' lifetime. */
 	constexpr bool			FastLess(const StringID& right) const;
 
-	/** Slow alphabetical order that is stable / deterministic over process runs. */
+	/** Case insensitive alphabetical order that is stable / deterministic over process runs. 
+	 *  Compares cached 8 byte prefixes first, touches the strings only on a tie */
 	bool					LexicalLess(const StringID& right) const;
 
 	// Returns c_str()
@@ -278,8 +337,8 @@ public:
 
 	// Lexical less predicate
 	struct LexicalLessPred {
-		constexpr bool operator()(const StringID& left, const StringID& right) const {
-			return left.FastLess(right);
+		bool operator()(const StringID& left, const StringID& right) const {
+			return left.LexicalLess(right);
 		}
 	};
 
@@ -293,11 +352,15 @@ public:
 		inNameID = StringID(inString);
 	}
 
+	friend struct std::hash<StringID>;
+
 private:
 
+	StringID(index_type compareIndex, index_type displayIndex);
+
 	// Interns this string array to the string pool
 	// and return indices to the pool array
-	void _intern(std::string_view inName);
+	void _intern(std::string_view inName, const Hashes& hashes);
 
 	// Compares string values
 	// Stable across runs
@@ -324,6 +387,14 @@ private:
 };
 
 
+// Equal for the case insensitive equal strings, like operator==
+template<>
+struct std::hash<StringID> {
+	size_t operator()(const StringID& id) const noexcept {
+		return std::hash<StringID::index_type>{}(id.m_CompareIndex);
+	}
+};
+
 template<>
 struct std::formatter<StringID>: std::formatter<std::string_view> {
     using Super = formatter<std::string_view>;
@@ -347,15 +418,36 @@ constexpr StringID::StringID()
 {}
 
 inline StringID::StringID(const char* inNewName)
+	: StringID(std::string_view(inNewName), ComputeHashes(inNewName)) {}
+
+inline StringID::StringID(std::string_view str, const Hashes& hashes)
 	: m_CompareIndex(0)
 	, m_DisplayIndex(0) {
-	std::string_view s(inNewName);
-	if (!s.empty()) { _intern(s); }
+	if (!str.empty()) { _intern(str, hashes); }
 #ifndef NDEBUG
 	m_DebugString = String().c_str();
 #endif
 }
 
+inline StringID::StringID(index_type compareIndex, index_type displayIndex)
+	: m_CompareIndex(compareIndex)
+	, m_DisplayIndex(displayIndex) {
+#ifndef NDEBUG
+	m_DebugString = String().c_str();
+#endif
+}
+
+inline StringID StringID::FromLiteral(std::string_view str, const Hashes& hashes, std::atomic<uint64_t>& cache) {
+	const uint64_t packed = cache.load(std::memory_order_acquire);
+	if (packed != 0) {
+		return StringID((index_type)(packed >> 32), (index_type)(uint32_t)packed);
+	}
+	StringID id(str, hashes);
+	cache.store(((uint64_t)(uint32_t)id.m_CompareIndex << 32) | (uint32_t)id.m_DisplayIndex, 
+				std::memory_order_release);
+	return id;
+}
+
 constexpr bool StringID::FastLess(const StringID& right) const {
 	return this->m_CompareIndex < right.m_CompareIndex;
 }
@@ -368,7 +460,21 @@ NODISCARD inline std::string operator+(const std::string& left, const StringID&
 	return std::move(left + right.String());
 }
 
+// Compile time string for literal operator templates
+template<size_t N>
+struct StringLiteral {
+	consteval StringLiteral(const char (&str)[N]) { std::copy_n(str, N, data); }
+	constexpr std::string_view View() const { return {data, N - 1}; }
 
+	char data[N]{};
+};
 
-
-
+// "Button"_sid
+// Hashes are computed at compile time, after the first call
+// the cost is a single atomic load
+template<StringLiteral S>
+StringID operator""_sid() {
+	static constexpr StringID::Hashes kHashes = StringID::ComputeHashes(S.View());
+	static std::atomic<uint64_t> cache;
+	return StringID::FromLiteral(S.View(), kHashes, cache);
+}
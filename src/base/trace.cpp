@@ -0,0 +1,215 @@
+#include "trace.h"
+#include "threading.h"
+
+#include <format>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace trace {
+
+namespace detail {
+std::atomic<bool> gEnabled = false;
+}  // namespace detail
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// Minimal interval to estimate the frequency of the time stamp counter
+constexpr auto kMinCalibrationTime = std::chrono::milliseconds(10);
+
+struct Context {
+    std::mutex lock;
+    // Never deleted to export events of exited threads
+    // Reused after retired buffers are cleared
+    std::vector<std::unique_ptr<detail::ThreadBuffer>> buffers;
+    std::atomic<uint64_t> frameNum = 0;
+    // Reference points to convert timestamps to microseconds
+    uint64_t startTimestamp = 0;
+    Clock::time_point startTime;
+};
+
+Context& GetContext() {
+    static Context ctx;
+    return ctx;
+}
+
+// Marks the buffer as retired when the thread exits
+struct ThreadBufferOwner {
+    detail::ThreadBuffer* buffer = nullptr;
+
+    ~ThreadBufferOwner() {
+        if (buffer) {
+            detail::tlsBuffer = nullptr;
+            buffer->bRetired_.store(true, std::memory_order_release);
+        }
+    }
+};
+
+thread_local ThreadBufferOwner tlsBufferOwner;
+
+void AppendEscaped(std::string& out, std::string_view str) {
+    for (char c : str) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+        } else if ((uint8_t)c < 0x20) {
+            continue;
+        }
+        out += c;
+    }
+}
+
+}  // namespace
+
+detail::ThreadBuffer* detail::RegisterThread() {
+    Context& ctx = GetContext();
+    ThreadBuffer* buffer = nullptr;
+    {
+        std::scoped_lock _(ctx.lock);
+        for (auto& retired : ctx.buffers) {
+            // Free when the events of the exited thread are cleared
+            if (retired->bRetired_.load(std::memory_order_acquire) &&
+                retired->tail_.load(std::memory_order_relaxed) ==
+                    retired->head_.load(std::memory_order_relaxed)) {
+                buffer = retired.get();
+                buffer->bRetired_.store(false, std::memory_order_relaxed);
+                break;
+            }
+        }
+        if (!buffer) {
+            buffer = ctx.buffers.emplace_back(std::make_unique<ThreadBuffer>()).get();
+        }
+        buffer->threadID_ = Thread::GetCurrentThreadID();
+        buffer->threadName_ = Thread::GetCurrentThreadName();
+        if (buffer->threadName_.empty()) {
+            buffer->threadName_ = std::format("Thread {}", buffer->threadID_);
+        }
+    }
+    tlsBuffer = buffer;
+    tlsBufferOwner.buffer = buffer;
+    return buffer;
+}
+
+void Start() {
+    Context& ctx = GetContext();
+    Clear();
+    {
+        std::scoped_lock _(ctx.lock);
+        ctx.startTime = Clock::now();
+        ctx.startTimestamp = GetTimestamp();
+    }
+    detail::gEnabled.store(true, std::memory_order_relaxed);
+}
+
+void Stop() {
+    detail::gEnabled.store(false, std::memory_order_relaxed);
+}
+
+void Clear() {
+    Context& ctx = GetContext();
+    std::scoped_lock _(ctx.lock);
+    for (auto& buffer : ctx.buffers) {
+        buffer->tail_.store(buffer->head_.load(std::memory_order_acquire),
+                            std::memory_order_relaxed);
+    }
+    ctx.frameNum.store(0, std::memory_order_relaxed);
+}
+
+void MarkFrame() {
+    if (!IsEnabled()) {
+        return;
+    }
+    Context& ctx = GetContext();
+    Event event{"Frame", GetTimestamp(), {}, EventType::Frame};
+    event.frameNum = ctx.frameNum.fetch_add(1, std::memory_order_relaxed);
+    detail::Record(event);
+}
+
+std::string ToChromeTraceJson() {
+    Context& ctx = GetContext();
+    std::scoped_lock _(ctx.lock);
+
+    // Estimate the frequency of the counter from the time since Start()
+    if (Clock::now() - ctx.startTime < kMinCalibrationTime) {
+        std::this_thread::sleep_until(ctx.startTime + kMinCalibrationTime);
+    }
+    const uint64_t endTimestamp = GetTimestamp();
+    const Clock::time_point endTime = Clock::now();
+    const double elapsedUs =
+        std::chrono::duration<double, std::micro>(endTime - ctx.startTime).count();
+    const double ticksPerUs =
+        elapsedUs > 0. ? (double)(endTimestamp - ctx.startTimestamp) / elapsedUs
+                       : 1.;
+    const auto toUs = [&](uint64_t timestamp) {
+        return ((double)timestamp - (double)ctx.startTimestamp) / ticksPerUs;
+    };
+
+    std::string out = "{\"traceEvents\":[\n";
+    bool bFirst = true;
+    const auto beginEvent = [&] {
+        if (!bFirst) {
+            out += ",\n";
+        }
+        bFirst = false;
+    };
+    for (const auto& buffer : ctx.buffers) {
+        const uint64_t head = buffer->head_.load(std::memory_order_acquire);
+        const uint64_t tail = std::max(
+            buffer->tail_.load(std::memory_order_relaxed),
+            head > detail::ThreadBuffer::kCapacity
+                ? head - detail::ThreadBuffer::kCapacity
+                : 0);
+        if (tail == head) {
+            continue;
+        }
+        const uint64_t tid = buffer->threadID_;
+        beginEvent();
+        out += std::format(
+            "{{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":{},"
+            "\"args\":{{\"name\":\"",
+            tid);
+        AppendEscaped(out, buffer->threadName_);
+        out += "\"}}";
+
+        for (uint64_t i = tail; i < head; ++i) {
+            const Event& event =
+                buffer->events_[i & (detail::ThreadBuffer::kCapacity - 1)];
+            beginEvent();
+            out += "{\"name\":\"";
+            AppendEscaped(out, event.name);
+            switch (event.type) {
+                case EventType::Scope:
+                    out += std::format(
+                        "\",\"ph\":\"X\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                        "\"dur\":{:.3f}}}",
+                        tid, toUs(event.start),
+                        (double)(event.end - event.start) / ticksPerUs);
+                    break;
+                case EventType::Counter:
+                    out += std::format(
+                        "\",\"ph\":\"C\",\"pid\":1,\"tid\":{},\"ts\":{:.3f},"
+                        "\"args\":{{\"value\":{}}}}}",
+                        tid, toUs(event.start), event.value);
+                    break;
+                case EventType::Frame:
+                    out += std::format(
+                        "\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":{},"
+                        "\"ts\":{:.3f},\"args\":{{\"frame\":{}}}}}",
+                        tid, toUs(event.start), event.frameNum);
+                    break;
+            }
+        }
+    }
+    out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+    return out;
+}
+
+bool ExportChromeTrace(const std::filesystem::path& path) {
+    const std::string json = ToChromeTraceJson();
+    std::ofstream file(path, std::ios::binary);
+    file.write(json.data(), (std::streamsize)json.size());
+    return (bool)file;
+}
+
+}  // namespace trace
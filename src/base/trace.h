@@ -0,0 +1,168 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <string>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <x86intrin.h>
+#endif
+#endif
+
+// Instrumentation profiler
+// Records scopes, counters and frame markers into per-thread rings
+// and exports them in the Chrome trace format (chrome://tracing, Perfetto):
+//   trace::Start();
+//   {
+//       TRACE_SCOPE("Update");
+//       TRACE_COUNTER("Widgets", widgets.size());
+//   }
+//   TRACE_FRAME();
+//   trace::Stop();
+//   trace::ExportChromeTrace("trace.json");
+//
+// Names must be string literals, they are stored as pointers
+// Compiled out without ENABLE_TRACING, a relaxed load when not started
+namespace trace {
+
+enum class EventType : uint8_t {
+    Scope,
+    Counter,
+    Frame,
+};
+
+struct Event {
+    const char* name;
+    uint64_t start;
+    union {
+        // Scope
+        uint64_t end;
+        // Counter
+        double value;
+        // Frame
+        uint64_t frameNum;
+    };
+    EventType type;
+};
+
+// Ticks of the time stamp counter, steady_clock on other architectures
+inline uint64_t GetTimestamp() {
+#if defined(_M_X64) || defined(__x86_64__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now().time_since_epoch().count();
+#endif
+}
+
+namespace detail {
+
+// A ring written only by the owning thread
+// Overwrites the oldest events when full
+struct ThreadBuffer {
+    static constexpr size_t kCapacity = 64 * 1024;
+
+    void Push(const Event& event) {
+        const uint64_t head = head_.load(std::memory_order_relaxed);
+        events_[head & (kCapacity - 1)] = event;
+        head_.store(head + 1, std::memory_order_release);
+    }
+
+    std::unique_ptr<Event[]> events_ = std::make_unique<Event[]>(kCapacity);
+    std::atomic<uint64_t> head_ = 0;
+    // Events before are cleared. Written by Clear()
+    std::atomic<uint64_t> tail_ = 0;
+    uint64_t threadID_ = 0;
+    std::string threadName_;
+    // The thread has exited
+    std::atomic<bool> bRetired_ = false;
+};
+
+extern std::atomic<bool> gEnabled;
+inline thread_local ThreadBuffer* tlsBuffer = nullptr;
+
+ThreadBuffer* RegisterThread();
+
+inline void Record(const Event& event) {
+    ThreadBuffer* buffer = tlsBuffer;
+    if (!buffer) [[unlikely]] {
+        buffer = RegisterThread();
+    }
+    buffer->Push(event);
+}
+
+}  // namespace detail
+
+inline bool IsEnabled() {
+    return detail::gEnabled.load(std::memory_order_relaxed);
+}
+
+// Clears previous events and starts recording
+void Start();
+void Stop();
+void Clear();
+
+// Writes recorded events of all threads
+// Call after Stop(), events overwritten during the export could be torn
+std::string ToChromeTraceJson();
+bool ExportChromeTrace(const std::filesystem::path& path);
+
+// Marks the start of a new frame
+void MarkFrame();
+
+inline void RecordCounter(const char* name, double value) {
+    if (IsEnabled()) {
+        Event event{name, GetTimestamp(), {}, EventType::Counter};
+        event.value = value;
+        detail::Record(event);
+    }
+}
+
+class Scope {
+public:
+    explicit Scope(const char* name)
+        : name_(name), start_(IsEnabled() ? GetTimestamp() : 0) {}
+
+    ~Scope() {
+        if (start_) {
+            Event event{name_, start_, {}, EventType::Scope};
+            event.end = GetTimestamp();
+            detail::Record(event);
+        }
+    }
+
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+
+private:
+    const char* name_;
+    // 0 if not recording
+    uint64_t start_;
+};
+
+}  // namespace trace
+
+#define TRACE_CONCAT_IMPL(A, B) A##B
+#define TRACE_CONCAT(A, B) TRACE_CONCAT_IMPL(A, B)
+
+#if defined(ENABLE_TRACING)
+// Concatenation with "" accepts only literals
+#define TRACE_SCOPE(NAME) \
+    trace::Scope TRACE_CONCAT(_traceScope, __LINE__)("" NAME)
+#define TRACE_COUNTER(NAME, VALUE) trace::RecordCounter("" NAME, (double)(VALUE))
+#define TRACE_FRAME() trace::MarkFrame()
+#else
+#define TRACE_SCOPE(NAME) \
+    do {                  \
+    } while (false)
+#define TRACE_COUNTER(NAME, VALUE) \
+    do {                           \
+    } while (false)
+#define TRACE_FRAME() \
+    do {              \
+    } while (false)
+#endif
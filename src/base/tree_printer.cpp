@@ -1,4 +1,5 @@
 #include "tree_printer.h"
+#include "property_writer.h"
 
 JsonTreePrinter::JsonTreePrinter() : depth_(0) {
     Write("{").NewLine().PushDepth();
@@ -8,8 +9,8 @@ void JsonTreePrinter::ReserveBuffer(uint32_t size) {
     buffer_.reserve(size);
 }
 
-TreePrinter& JsonTreePrinter::OpenObject(const std::string& name) {
-    WriteIndent().Write("\"", name, "\": {").NewLine().PushDepth();
+TreePrinter& JsonTreePrinter::OpenObject(std::string_view name) {
+    WriteIndent().WriteString(name).Write(": {").NewLine().PushDepth();
     return *this;
 }
 
@@ -18,9 +19,9 @@ TreePrinter& JsonTreePrinter::CloseObject() {
     return *this;
 }
 
-TreePrinter& JsonTreePrinter::OpenArray(const std::string& name) {
+TreePrinter& JsonTreePrinter::OpenArray(std::string_view name) {
     ++arrayDepth_;
-    WriteIndent().Write("\"", name, "\": [").NewLine().PushDepth();
+    WriteIndent().WriteString(name).Write(": [").NewLine().PushDepth();
     return *this;
 }
 
@@ -30,15 +31,16 @@ TreePrinter& JsonTreePrinter::CloseArray() {
     return *this;
 }
 
-TreePrinter& JsonTreePrinter::PushImpl(const std::string& name,
-                                       const std::string& value) {
-    WriteIndent().Write("\"", name, "\": \"", value, "\",").NewLine();
+TreePrinter& JsonTreePrinter::PushImpl(std::string_view name,
+                                       std::string_view value) {
+    WriteIndent().WriteString(name).Write(": ").WriteString(value).Write(",");
+    NewLine();
     return *this;
 }
 
-TreePrinter& JsonTreePrinter::PushElementImpl(const std::string& value) {
+TreePrinter& JsonTreePrinter::PushElementImpl(std::string_view value) {
     DASSERT(arrayDepth_);
-    WriteIndent().Write("\"", value, "\",").NewLine();
+    WriteIndent().WriteString(value).Write(",").NewLine();
     return *this;
 }
 
@@ -49,11 +51,12 @@ std::string JsonTreePrinter::Finalize() {
 }
 
 JsonTreePrinter& JsonTreePrinter::WriteIndent() {
-    if (depth_) {
-        for (auto i = depth_ * indentSize_; i; --i) {
-            buffer_.append(" ");
-        }
-    }
+    buffer_.append(depth_ * indentSize_, ' ');
+    return *this;
+}
+
+JsonTreePrinter& JsonTreePrinter::WriteString(std::string_view str) {
+    WriteJsonString(str, [this](std::string_view s) { buffer_.append(s); });
     return *this;
 }
 
@@ -1,8 +1,10 @@
 #pragma once
 #include "common.h"
+#include "small_vector.h"
 #include "util.h"
 
 #include <functional>
+#include <string_view>
 
 class JsonObjectBuilder;
 
@@ -22,32 +24,37 @@ public:
     virtual ~TreePrinter() = default;
 
     // Open object node '{'
-    virtual TreePrinter& OpenObject(const std::string& name) = 0;
+    virtual TreePrinter& OpenObject(std::string_view name) = 0;
     // Close previously opened object node '}'
     virtual TreePrinter& CloseObject() = 0;
 
     // Open array node '['
-    virtual TreePrinter& OpenArray(const std::string& name) = 0;
+    virtual TreePrinter& OpenArray(std::string_view name) = 0;
     // Close previously opened array node ']'
     virtual TreePrinter& CloseArray() = 0;
 
     // Push regular {name : value} node
+    // The value is formatted into a reused buffer
     template <Formattable T>
-    TreePrinter& Entry(const std::string& name, T&& value) {
-        PushImpl(name, std::format("{}", value));
+    TreePrinter& Entry(std::string_view name, T&& value) {
+        scratch_.clear();
+        std::format_to(std::back_inserter(scratch_), "{}", value);
+        PushImpl(name, scratch_);
         return *this;
     }
 
     // Push array element [ value, ... ] node
     template <Formattable T>
     TreePrinter& Element(T&& value) {
-        PushElementImpl(std::format("{}", value));
+        scratch_.clear();
+        std::format_to(std::back_inserter(scratch_), "{}", value);
+        PushElementImpl(scratch_);
         return *this;
     }
 
     // RAII helper to close object node
     struct AutoObject {
-        AutoObject(TreePrinter* p, const std::string& name) {
+        AutoObject(TreePrinter* p, std::string_view name) {
             p_ = p;
             p_->OpenObject(name);
         }
@@ -59,7 +66,7 @@ public:
     
     // RAII helper to close array node
     struct AutoArray {
-        AutoArray(TreePrinter* p, const std::string& name) {
+        AutoArray(TreePrinter* p, std::string_view name) {
             p_ = p;
             p_->OpenArray(name);
         }
@@ -70,10 +77,13 @@ public:
     };
 
 protected:
-    virtual TreePrinter& PushImpl(const std::string& name,
-                                  const std::string& value) = 0;
+    virtual TreePrinter& PushImpl(std::string_view name,
+                                  std::string_view value) = 0;
 
-    virtual TreePrinter& PushElementImpl(const std::string& value) = 0;
+    virtual TreePrinter& PushElementImpl(std::string_view value) = 0;
+
+private:
+    std::string scratch_;
 };
 
 
@@ -84,16 +94,16 @@ public:
     JsonTreePrinter();
     void ReserveBuffer(uint32_t size);
 
-    TreePrinter& OpenObject(const std::string& name) override;
+    TreePrinter& OpenObject(std::string_view name) override;
     TreePrinter& CloseObject() override;
 
-    TreePrinter& OpenArray(const std::string& name) override;
+    TreePrinter& OpenArray(std::string_view name) override;
     TreePrinter& CloseArray() override;
 
-    TreePrinter& PushImpl(const std::string& name,
-                          const std::string& value) override;
+    TreePrinter& PushImpl(std::string_view name,
+                          std::string_view value) override;
 
-    TreePrinter& PushElementImpl(const std::string& value) override;
+    TreePrinter& PushElementImpl(std::string_view value) override;
 
     std::string Finalize();
 
@@ -106,6 +116,8 @@ private:
         return *this;
     }
 
+    JsonTreePrinter& WriteString(std::string_view str);
+
     JsonTreePrinter& NewLine();
     JsonTreePrinter& PushDepth();
     JsonTreePrinter& PopDepth();
@@ -119,16 +131,39 @@ private:
 };
 
 
+// Receives the objects of a streaming PropertyArchive as they are pushed
+// Objects are nested and closed before the next sibling is opened
+// See property_writer.h for the json, binary and text writers
+class PropertySink {
+public:
+    using ObjectID = uintptr_t;
+
+    virtual ~PropertySink() = default;
+
+    virtual void OpenObject(std::string_view className, ObjectID objectID) = 0;
+    virtual void CloseObject() = 0;
+
+    // Quoted values are strings, the rest are numbers, enums, vectors...
+    virtual void Property(std::string_view name, std::string_view value,
+                          bool bQuoted) = 0;
+};
+
 /*
  * Similar to TreePrinter but stores object internally
  * Simple write only archive class
  * Used for building a tree of objects with string properties
+ *
+ * With a sink the objects are streamed instead and no tree is built:
+ *   JsonPropertyWriter writer(&out);
+ *   PropertyArchive archive(&writer);
+ *   widget->OnEvent(&event);
+ *   archive.Finish();
  */
 class PropertyArchive {
 public:
     struct Object;
 
-    using ObjectID = uintptr_t;
+    using ObjectID = PropertySink::ObjectID;
 
     using Visitor = std::function<bool(Object&)>;
 
@@ -143,14 +178,14 @@ public:
 
     struct Object {
 
-        Object(const std::string& className, ObjectID objectID, Object* parent)
+        Object(std::string_view className, ObjectID objectID, Object* parent)
             : debugName_(className), objectID_(objectID), parent_(parent) {}
 
         void PushProperty(std::string_view name, const std::string& value) {
             properties_.emplace_back(name, value);
         }
 
-        Object* EmplaceChild(const std::string& className, ObjectID objectID) {
+        Object* EmplaceChild(std::string_view className, ObjectID objectID) {
             return &*children_.emplace_back(
                 new Object(className, objectID, this));
         }
@@ -176,6 +211,24 @@ public:
     };
 
 public:
+    PropertyArchive() = default;
+
+    explicit PropertyArchive(PropertySink* sink) : sink_(sink) {}
+
+    PropertyArchive(const PropertyArchive&) = delete;
+    PropertyArchive& operator=(const PropertyArchive&) = delete;
+
+    ~PropertyArchive() { Finish(); }
+
+    bool IsStreaming() const { return sink_ != nullptr; }
+
+    // Closes the streamed objects which are still open
+    void Finish() {
+        if (sink_) {
+            CloseObjects(0);
+        }
+    }
+
     // Visit objects recursively in depth first
     // Stops iteration if visitor returns false
     void VisitRecursively(const Visitor& visitor) {
@@ -191,9 +244,13 @@ public:
 
     template <class T>
         requires(std::is_pointer_v<T> || std::is_integral_v<T>)
-    void PushObject(const std::string& debugName, T object, T parent) {
+    void PushObject(std::string_view debugName, T object, T parent) {
         const auto objectID = (ObjectID)object;
         const auto parentID = (ObjectID)parent;
+        if (sink_) {
+            StreamObject(debugName, objectID, parentID);
+            return;
+        }
         if (!parent || !cursorObject_) {
             cursorObject_ = &*rootObjects_.emplace_back(
                 new Object(debugName, objectID, nullptr));
@@ -218,49 +275,89 @@ public:
             v.y;
         })
     void PushProperty(std::string_view name, const Vec2& property) {
-        DASSERT_M(cursorObject_, "PushObject() should be called first");
-        DASSERT(!name.empty());
-        cursorObject_->PushProperty(
-            name, std::format("{:.0f}:{:.0f}", property.x, property.y));
+        PushValue(name, Format("{:.0f}:{:.0f}", property.x, property.y));
     }
 
-    void PushProperty(std::string_view name, const std::string& property) {
-        DASSERT_M(cursorObject_, "PushObject() should be called first");
-        DASSERT(!name.empty());
-        cursorObject_->PushProperty(name, std::format("{}", property));
+    void PushProperty(std::string_view name, std::string_view property) {
+        PushValue(name, property);
     }
 
-    void PushStringProperty(std::string_view name,
-                            const std::string& property) {
-        DASSERT_M(cursorObject_, "PushObject() should be called first");
-        DASSERT(!name.empty());
-        cursorObject_->PushProperty(name, std::format("\"{}\"", property));
+    void PushStringProperty(std::string_view name, std::string_view property) {
+        PushValue(name, property, true);
     }
 
     template <typename Enum>
         requires std::is_enum_v<Enum>
     void PushProperty(std::string_view name, Enum property) {
-        DASSERT_M(cursorObject_, "PushObject() should be called first");
-        DASSERT(!name.empty());
-        cursorObject_->PushProperty(name, ToString(property));
+        PushValue(name, ToString(property));
     }
 
     template <typename T>
         requires std::is_arithmetic_v<T>
     void PushProperty(std::string_view name, T property) {
-        DASSERT_M(cursorObject_, "PushObject() should be called first");
-        DASSERT(!name.empty());
-
         if constexpr (std::is_integral_v<T>) {
-            cursorObject_->PushProperty(name, std::format("{}", property));
+            PushValue(name, Format("{}", property));
         } else if constexpr (std::is_same_v<T, bool>) {
-            cursorObject_->PushProperty(name, property ? "True" : "False");
+            PushValue(name, property ? "True" : "False");
         } else {
-            cursorObject_->PushProperty(name, std::format("{:.2f}", property));
+            PushValue(name, Format("{:.2f}", property));
+        }
+    }
+
+private:
+    template <class... Args>
+    std::string_view Format(std::format_string<Args...> fmt, Args&&... args) {
+        scratch_.clear();
+        std::format_to(std::back_inserter(scratch_), fmt,
+                       std::forward<Args>(args)...);
+        return scratch_;
+    }
+
+    void PushValue(std::string_view name, std::string_view value,
+                   bool bQuoted = false) {
+        DASSERT(!name.empty());
+        if (sink_) {
+            DASSERT_M(!openObjects_.empty(),
+                      "PushObject() should be called first");
+            sink_->Property(name, value, bQuoted);
+            return;
+        }
+        DASSERT_M(cursorObject_, "PushObject() should be called first");
+        cursorObject_->PushProperty(
+            name, bQuoted ? std::format("\"{}\"", value) : std::string(value));
+    }
+
+    // Same nesting rules as the tree: a child of the closest open object
+    // with the parent id or of the last object if none matches
+    void StreamObject(std::string_view debugName, ObjectID objectID,
+                      ObjectID parentID) {
+        if (!parentID) {
+            CloseObjects(0);
+        } else {
+            for (size_t depth = openObjects_.size(); depth; --depth) {
+                if (openObjects_[depth - 1] == parentID) {
+                    CloseObjects(depth);
+                    break;
+                }
+            }
+        }
+        openObjects_.push_back(objectID);
+        sink_->OpenObject(debugName, objectID);
+    }
+
+    void CloseObjects(size_t depth) {
+        while (openObjects_.size() > depth) {
+            openObjects_.pop_back();
+            sink_->CloseObject();
         }
     }
 
 public:
     std::list<std::unique_ptr<Object>> rootObjects_;
     Object* cursorObject_ = nullptr;
+
+private:
+    PropertySink* sink_ = nullptr;
+    SmallVector<ObjectID, 32> openObjects_;
+    std::string scratch_;
 };
\ No newline at end of file
@@ -0,0 +1,562 @@
+#include "utf8.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define UTF8_X64
+#include <immintrin.h>
+#endif
+
+namespace utf8 {
+
+namespace {
+
+inline bool IsValidCodePoint(char32_t cp) {
+    return cp <= 0x10FFFF && (cp < 0xD800 || cp > 0xDFFF);
+}
+
+// Returns the length of the sequence or 0 if invalid
+inline uint32_t DecodeUtf8(const uint8_t* in, size_t size, char32_t& cp) {
+    const uint8_t b0 = in[0];
+    if (b0 < 0x80) {
+        cp = b0;
+        return 1;
+    }
+    // Continuation or an overlong 2 byte lead
+    if (b0 < 0xC2) {
+        return 0;
+    }
+    if (b0 < 0xE0) {
+        if (size < 2 || (in[1] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = ((b0 & 0x1F) << 6) | (in[1] & 0x3F);
+        return 2;
+    }
+    if (b0 < 0xF0) {
+        if (size < 3 || (in[1] & 0xC0) != 0x80 || (in[2] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = ((b0 & 0x0F) << 12) | ((in[1] & 0x3F) << 6) | (in[2] & 0x3F);
+        return cp >= 0x800 && IsValidCodePoint(cp) ? 3 : 0;
+    }
+    if (b0 < 0xF5) {
+        if (size < 4 || (in[1] & 0xC0) != 0x80 || (in[2] & 0xC0) != 0x80 ||
+            (in[3] & 0xC0) != 0x80) {
+            return 0;
+        }
+        cp = ((b0 & 0x07) << 18) | ((in[1] & 0x3F) << 12) |
+             ((in[2] & 0x3F) << 6) | (in[3] & 0x3F);
+        return cp >= 0x10000 && cp <= 0x10FFFF ? 4 : 0;
+    }
+    return 0;
+}
+
+// Returns the number of units or 0 if an unpaired surrogate
+inline uint32_t DecodeUtf16(const char16_t* in, size_t size, char32_t& cp) {
+    const char16_t c0 = in[0];
+    if (c0 < 0xD800 || c0 > 0xDFFF) {
+        cp = c0;
+        return 1;
+    }
+    if (c0 > 0xDBFF || size < 2 || in[1] < 0xDC00 || in[1] > 0xDFFF) {
+        return 0;
+    }
+    cp = 0x10000 + (((char32_t)c0 - 0xD800) << 10) + (in[1] - 0xDC00);
+    return 2;
+}
+
+inline uint8_t* EncodeUtf8(char32_t cp, uint8_t* out) {
+    if (cp < 0x80) {
+        *out++ = (uint8_t)cp;
+    } else if (cp < 0x800) {
+        *out++ = (uint8_t)(0xC0 | (cp >> 6));
+        *out++ = (uint8_t)(0x80 | (cp & 0x3F));
+    } else if (cp < 0x10000) {
+        *out++ = (uint8_t)(0xE0 | (cp >> 12));
+        *out++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (uint8_t)(0x80 | (cp & 0x3F));
+    } else {
+        *out++ = (uint8_t)(0xF0 | (cp >> 18));
+        *out++ = (uint8_t)(0x80 | ((cp >> 12) & 0x3F));
+        *out++ = (uint8_t)(0x80 | ((cp >> 6) & 0x3F));
+        *out++ = (uint8_t)(0x80 | (cp & 0x3F));
+    }
+    return out;
+}
+
+inline char16_t* EncodeUtf16(char32_t cp, char16_t* out) {
+    if (cp < 0x10000) {
+        *out++ = (char16_t)cp;
+    } else {
+        cp -= 0x10000;
+        *out++ = (char16_t)(0xD800 + (cp >> 10));
+        *out++ = (char16_t)(0xDC00 + (cp & 0x3FF));
+    }
+    return out;
+}
+
+}  // namespace
+
+// 8 bytes at once in a general purpose register
+namespace scalar {
+
+struct Simd {
+    static constexpr size_t kWidth = 8;
+    static constexpr uint64_t kHighBits = 0x8080808080808080ull;
+
+    static_assert(std::endian::native == std::endian::little);
+
+    // High bits of the non-ASCII bytes
+    using Mask = uint64_t;
+
+    static uint32_t Prefix(Mask nonAscii) {
+        return (uint32_t)std::countr_zero(nonAscii) / 8;
+    }
+
+    static Mask NonAscii(const uint8_t* in) {
+        uint64_t block;
+        std::memcpy(&block, in, sizeof(block));
+        return block & kHighBits;
+    }
+
+    template <class Char>
+    static Mask WidenAscii(const uint8_t* in, Char* out) {
+        for (size_t i = 0; i < kWidth; ++i) {
+            out[i] = (Char)in[i];
+        }
+        return NonAscii(in);
+    }
+
+    template <class Char>
+    static Mask NarrowAscii(const Char* in, uint8_t* out) {
+        Mask nonAscii = 0;
+        for (size_t i = 0; i < kWidth; ++i) {
+            out[i] = (uint8_t)in[i];
+            nonAscii |= (Mask)(in[i] >= 0x80) << (i * 8 + 7);
+        }
+        return nonAscii;
+    }
+};
+
+#include "utf8_kernels.inl"
+
+bool IsValid(const uint8_t* in, size_t size) {
+    return ValidateBlocks(in, size);
+}
+
+}  // namespace scalar
+
+#ifdef UTF8_X64
+
+namespace sse2 {
+
+struct Simd {
+    static constexpr size_t kWidth = 16;
+
+    static __m128i Load(const void* in) {
+        return _mm_loadu_si128(static_cast<const __m128i*>(in));
+    }
+
+    static void Store(void* out, __m128i value) {
+        _mm_storeu_si128(static_cast<__m128i*>(out), value);
+    }
+
+    // A bit per non-ASCII unit
+    using Mask = uint32_t;
+
+    static uint32_t Prefix(Mask nonAscii) {
+        return (uint32_t)std::countr_zero(nonAscii);
+    }
+
+    static Mask NonAscii(const uint8_t* in) {
+        return (Mask)_mm_movemask_epi8(Load(in));
+    }
+
+    static Mask WidenAscii(const uint8_t* in, char16_t* out) {
+        const __m128i bytes = Load(in);
+        const __m128i zero = _mm_setzero_si128();
+        Store(out, _mm_unpacklo_epi8(bytes, zero));
+        Store(out + 8, _mm_unpackhi_epi8(bytes, zero));
+        return (Mask)_mm_movemask_epi8(bytes);
+    }
+
+    static Mask WidenAscii(const uint8_t* in, char32_t* out) {
+        const __m128i bytes = Load(in);
+        const __m128i zero = _mm_setzero_si128();
+        const __m128i low = _mm_unpacklo_epi8(bytes, zero);
+        const __m128i high = _mm_unpackhi_epi8(bytes, zero);
+        Store(out, _mm_unpacklo_epi16(low, zero));
+        Store(out + 4, _mm_unpackhi_epi16(low, zero));
+        Store(out + 8, _mm_unpacklo_epi16(high, zero));
+        Store(out + 12, _mm_unpackhi_epi16(high, zero));
+        return (Mask)_mm_movemask_epi8(bytes);
+    }
+
+    // Non-ASCII units are stored saturated and overwritten by the caller
+    static Mask NarrowAscii(const char16_t* in, uint8_t* out) {
+        const __m128i a = Load(in);
+        const __m128i b = Load(in + 8);
+        Store(out, _mm_packus_epi16(a, b));
+        const __m128i mask = _mm_set1_epi16((short)0xFF80);
+        const __m128i zero = _mm_setzero_si128();
+        // One bit per unit
+        const __m128i isAscii =
+            _mm_packs_epi16(_mm_cmpeq_epi16(_mm_and_si128(a, mask), zero),
+                            _mm_cmpeq_epi16(_mm_and_si128(b, mask), zero));
+        return ~(Mask)_mm_movemask_epi8(isAscii) & 0xFFFF;
+    }
+
+    static Mask NarrowAscii(const char32_t* in, uint8_t* out) {
+        const __m128i a = Load(in);
+        const __m128i b = Load(in + 4);
+        const __m128i c = Load(in + 8);
+        const __m128i d = Load(in + 12);
+        Store(out, _mm_packus_epi16(_mm_packs_epi32(a, b),
+                                    _mm_packs_epi32(c, d)));
+        const __m128i mask = _mm_set1_epi32(~0x7F);
+        const __m128i zero = _mm_setzero_si128();
+        auto isAscii = [&](__m128i v) {
+            return _mm_cmpeq_epi32(_mm_and_si128(v, mask), zero);
+        };
+        const __m128i ascii =
+            _mm_packs_epi16(_mm_packs_epi32(isAscii(a), isAscii(b)),
+                            _mm_packs_epi32(isAscii(c), isAscii(d)));
+        return ~(Mask)_mm_movemask_epi8(ascii) & 0xFFFF;
+    }
+};
+
+#include "utf8_kernels.inl"
+
+bool IsValid(const uint8_t* in, size_t size) {
+    return ValidateBlocks(in, size);
+}
+
+}  // namespace sse2
+
+// MSVC emits any intrinsic, other compilers need the target enabled
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), \
+                             apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+namespace avx2 {
+
+struct Simd {
+    static constexpr size_t kWidth = 32;
+
+    static __m256i Load(const void* in) {
+        return _mm256_loadu_si256(static_cast<const __m256i*>(in));
+    }
+
+    static void Store(void* out, __m256i value) {
+        _mm256_storeu_si256(static_cast<__m256i*>(out), value);
+    }
+
+    using Mask = uint32_t;
+
+    static uint32_t Prefix(Mask nonAscii) {
+        return (uint32_t)std::countr_zero(nonAscii);
+    }
+
+    static Mask NonAscii(const uint8_t* in) {
+        return (Mask)_mm256_movemask_epi8(Load(in));
+    }
+
+    static Mask WidenAscii(const uint8_t* in, char16_t* out) {
+        const __m128i low = _mm_loadu_si128((const __m128i*)in);
+        const __m128i high = _mm_loadu_si128((const __m128i*)(in + 16));
+        Store(out, _mm256_cvtepu8_epi16(low));
+        Store(out + 16, _mm256_cvtepu8_epi16(high));
+        return NonAscii(in);
+    }
+
+    static Mask WidenAscii(const uint8_t* in, char32_t* out) {
+        for (size_t i = 0; i < kWidth; i += 8) {
+            const __m128i bytes = _mm_loadl_epi64((const __m128i*)(in + i));
+            Store(out + i, _mm256_cvtepu8_epi32(bytes));
+        }
+        return NonAscii(in);
+    }
+
+    // Non-ASCII units are stored saturated and overwritten by the caller
+    // Packing works within 128 bit lanes, the order is restored after
+    static Mask NarrowAscii(const char16_t* in, uint8_t* out) {
+        const __m256i a = Load(in);
+        const __m256i b = Load(in + 16);
+        Store(out, _mm256_permute4x64_epi64(_mm256_packus_epi16(a, b), 0xD8));
+        const __m256i mask = _mm256_set1_epi16((short)0xFF80);
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i isAscii = _mm256_packs_epi16(
+            _mm256_cmpeq_epi16(_mm256_and_si256(a, mask), zero),
+            _mm256_cmpeq_epi16(_mm256_and_si256(b, mask), zero));
+        return ~(Mask)_mm256_movemask_epi8(
+            _mm256_permute4x64_epi64(isAscii, 0xD8));
+    }
+
+    static Mask NarrowAscii(const char32_t* in, uint8_t* out) {
+        const __m256i a = Load(in);
+        const __m256i b = Load(in + 8);
+        const __m256i c = Load(in + 16);
+        const __m256i d = Load(in + 24);
+        const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+        const __m256i packed = _mm256_packus_epi16(_mm256_packs_epi32(a, b),
+                                                   _mm256_packs_epi32(c, d));
+        Store(out, _mm256_permutevar8x32_epi32(packed, order));
+        const __m256i mask = _mm256_set1_epi32(~0x7F);
+        const __m256i zero = _mm256_setzero_si256();
+        auto isAscii = [&](__m256i v) {
+            return _mm256_cmpeq_epi32(_mm256_and_si256(v, mask), zero);
+        };
+        const __m256i ascii = _mm256_packs_epi16(
+            _mm256_packs_epi32(isAscii(a), isAscii(b)),
+            _mm256_packs_epi32(isAscii(c), isAscii(d)));
+        return ~(Mask)_mm256_movemask_epi8(
+            _mm256_permutevar8x32_epi32(ascii, order));
+    }
+};
+
+#include "utf8_kernels.inl"
+
+// Validation with lookup tables (Keiser, Lemire. Validating UTF-8 In Less
+// Than One Instruction Per Byte). Each byte is classified by the high and
+// low nibbles of the previous byte and the high nibble of itself.
+// A bit set in all three lookups is an error
+namespace lookup {
+
+constexpr uint8_t kTooShort = 1 << 0;   // 11______ 0_______, 11______ 11______
+constexpr uint8_t kTooLong = 1 << 1;    // 0_______ 10______
+constexpr uint8_t kOverlong3 = 1 << 2;  // 11100000 100_____
+constexpr uint8_t kTooLarge = 1 << 3;   // 11110100 1001____, 11110101+ 10______
+constexpr uint8_t kSurrogate = 1 << 4;  // 11101101 101_____
+constexpr uint8_t kOverlong2 = 1 << 5;  // 1100000_ 10______
+constexpr uint8_t kTooLarge1000 = 1 << 6;  // 11110101+ 1000____
+constexpr uint8_t kOverlong4 = 1 << 6;     // 11110000 1000____
+constexpr uint8_t kTwoConts = 1 << 7;      // 10______ 10______
+constexpr uint8_t kCarry = kTooShort | kTooLong | kTwoConts;
+
+inline __m256i Table(uint8_t v0, uint8_t v1, uint8_t v2, uint8_t v3,
+                     uint8_t v4, uint8_t v5, uint8_t v6, uint8_t v7,
+                     uint8_t v8, uint8_t v9, uint8_t v10, uint8_t v11,
+                     uint8_t v12, uint8_t v13, uint8_t v14, uint8_t v15) {
+    return _mm256_setr_epi8(v0, v1, v2, v3, v4, v5, v6, v7, v8, v9, v10, v11,
+                            v12, v13, v14, v15, v0, v1, v2, v3, v4, v5, v6, v7,
+                            v8, v9, v10, v11, v12, v13, v14, v15);
+}
+
+inline __m256i HighNibble(__m256i v) {
+    return _mm256_and_si256(_mm256_srli_epi16(v, 4), _mm256_set1_epi8(0x0F));
+}
+
+// Bytes of |input| shifted right by N with the end of |prev| shifted in
+template <int N>
+__m256i Prev(__m256i input, __m256i prev) {
+    return _mm256_alignr_epi8(
+        input, _mm256_permute2x128_si256(prev, input, 0x21), 16 - N);
+}
+
+inline __m256i CheckSpecialCases(__m256i input, __m256i prev1) {
+    const __m256i byte1High = _mm256_shuffle_epi8(
+        Table(kTooLong, kTooLong, kTooLong, kTooLong, kTooLong, kTooLong,
+              kTooLong, kTooLong, kTwoConts, kTwoConts, kTwoConts, kTwoConts,
+              kTooShort | kOverlong2, kTooShort,
+              kTooShort | kOverlong3 | kSurrogate,
+              kTooShort | kTooLarge | kTooLarge1000 | kOverlong4),
+        HighNibble(prev1));
+    constexpr uint8_t kLarge = kCarry | kTooLarge | kTooLarge1000;
+    const __m256i byte1Low = _mm256_shuffle_epi8(
+        Table(kCarry | kOverlong3 | kOverlong2 | kOverlong4,
+              kCarry | kOverlong2, kCarry, kCarry, kCarry | kTooLarge, kLarge,
+              kLarge, kLarge, kLarge, kLarge, kLarge, kLarge, kLarge,
+              kLarge | kSurrogate, kLarge, kLarge),
+        _mm256_and_si256(prev1, _mm256_set1_epi8(0x0F)));
+    constexpr uint8_t kCont1000 = kTooLong | kOverlong2 | kTwoConts |
+                                  kOverlong3 | kTooLarge1000 | kOverlong4;
+    constexpr uint8_t kCont1001 =
+        kTooLong | kOverlong2 | kTwoConts | kOverlong3 | kTooLarge;
+    constexpr uint8_t kCont101 =
+        kTooLong | kOverlong2 | kTwoConts | kSurrogate | kTooLarge;
+    const __m256i byte2High = _mm256_shuffle_epi8(
+        Table(kTooShort, kTooShort, kTooShort, kTooShort, kTooShort, kTooShort,
+              kTooShort, kTooShort, kCont1000, kCont1001, kCont101, kCont101,
+              kTooShort, kTooShort, kTooShort, kTooShort),
+        HighNibble(input));
+    return _mm256_and_si256(_mm256_and_si256(byte1High, byte1Low), byte2High);
+}
+
+// The third and fourth bytes of a sequence must be continuations,
+// flags them and cancels out the kTwoConts bit for them
+inline __m256i CheckMultibyteLengths(__m256i input,
+                                     __m256i prev,
+                                     __m256i specialCases) {
+    const __m256i prev2 = Prev<2>(input, prev);
+    const __m256i prev3 = Prev<3>(input, prev);
+    const __m256i isThird =
+        _mm256_subs_epu8(prev2, _mm256_set1_epi8((char)(0xE0 - 0x80)));
+    const __m256i isFourth =
+        _mm256_subs_epu8(prev3, _mm256_set1_epi8((char)(0xF0 - 0x80)));
+    const __m256i must23 = _mm256_and_si256(_mm256_or_si256(isThird, isFourth),
+                                            _mm256_set1_epi8((char)0x80));
+    return _mm256_xor_si256(must23, specialCases);
+}
+
+// Non zero if the block ends in the middle of a sequence
+inline __m256i IsIncomplete(__m256i input) {
+    const __m256i max = _mm256_setr_epi8(
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+        -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, (char)(0xF0 - 1),
+        (char)(0xE0 - 1), (char)(0xC0 - 1));
+    return _mm256_subs_epu8(input, max);
+}
+
+}  // namespace lookup
+
+bool IsValid(const uint8_t* in, size_t size) {
+    using namespace lookup;
+    __m256i error = _mm256_setzero_si256();
+    __m256i prev = _mm256_setzero_si256();
+    __m256i prevIncomplete = _mm256_setzero_si256();
+
+    auto checkBlock = [&](__m256i input) {
+        if (_mm256_movemask_epi8(input) == 0) {
+            error = _mm256_or_si256(error, prevIncomplete);
+            prevIncomplete = _mm256_setzero_si256();
+        } else {
+            const __m256i prev1 = Prev<1>(input, prev);
+            const __m256i special = CheckSpecialCases(input, prev1);
+            error = _mm256_or_si256(error,
+                                    CheckMultibyteLengths(input, prev, special));
+            prevIncomplete = IsIncomplete(input);
+        }
+        prev = input;
+    };
+
+    size_t i = 0;
+    for (; size - i >= Simd::kWidth; i += Simd::kWidth) {
+        checkBlock(Simd::Load(in + i));
+    }
+    // Zero padding is ASCII which ends any sequence
+    if (i < size) {
+        alignas(32) uint8_t tail[Simd::kWidth] = {};
+        std::memcpy(tail, in + i, size - i);
+        checkBlock(Simd::Load(tail));
+    }
+    error = _mm256_or_si256(error, prevIncomplete);
+    return _mm256_testz_si256(error, error);
+}
+
+}  // namespace avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif  // UTF8_X64
+
+namespace {
+
+struct Kernels {
+    bool (*isValid)(const uint8_t*, size_t);
+    bool (*isAscii)(const uint8_t*, size_t);
+    size_t (*toUtf16)(const uint8_t*, size_t, char16_t*);
+    size_t (*toUtf32)(const uint8_t*, size_t, char32_t*);
+    size_t (*fromUtf16)(const char16_t*, size_t, uint8_t*);
+    size_t (*fromUtf32)(const char32_t*, size_t, uint8_t*);
+};
+
+#define UTF8_KERNELS(NS)                                                    \
+    Kernels{&NS::IsValid,              &NS::IsAsciiBlocks,                  \
+            &NS::ToUtfN<char16_t>,     &NS::ToUtfN<char32_t>,               \
+            &NS::FromUtfN<char16_t>,   &NS::FromUtfN<char32_t>}
+
+const Kernels kKernels[] = {
+    UTF8_KERNELS(scalar),
+#ifdef UTF8_X64
+    UTF8_KERNELS(sse2),
+    UTF8_KERNELS(avx2),
+#endif
+};
+
+#undef UTF8_KERNELS
+
+const Kernels& GetKernels() {
+    return kKernels[(size_t)cpu::GetSimdLevel()];
+}
+
+const uint8_t* AsBytes(const char* str) {
+    return reinterpret_cast<const uint8_t*>(str);
+}
+
+}  // namespace
+
+bool IsValid(std::string_view str) {
+    return GetKernels().isValid(AsBytes(str.data()), str.size());
+}
+
+bool IsAscii(std::string_view str) {
+    return GetKernels().isAscii(AsBytes(str.data()), str.size());
+}
+
+size_t ToUtf16(std::string_view str, char16_t* out) {
+    return GetKernels().toUtf16(AsBytes(str.data()), str.size(), out);
+}
+
+size_t ToUtf32(std::string_view str, char32_t* out) {
+    return GetKernels().toUtf32(AsBytes(str.data()), str.size(), out);
+}
+
+size_t FromUtf16(std::u16string_view str, char* out) {
+    return GetKernels().fromUtf16(str.data(), str.size(),
+                                  reinterpret_cast<uint8_t*>(out));
+}
+
+size_t FromUtf32(std::u32string_view str, char* out) {
+    return GetKernels().fromUtf32(str.data(), str.size(),
+                                  reinterpret_cast<uint8_t*>(out));
+}
+
+namespace {
+
+// Converts into a string of the maximum size and shrinks it
+template <class OutString, class InString, class Func>
+bool ConvertString(InString str, OutString& out, size_t maxSize, Func func) {
+    out.resize(maxSize);
+    const size_t size = func(str, out.data());
+    if (size == kError) {
+        out.clear();
+        return false;
+    }
+    out.resize(size);
+    return true;
+}
+
+}  // namespace
+
+bool ToUtf16(std::string_view str, std::u16string& out) {
+    return ConvertString(str, out, str.size(),
+                         [](auto in, auto* o) { return ToUtf16(in, o); });
+}
+
+bool ToUtf32(std::string_view str, std::u32string& out) {
+    return ConvertString(str, out, str.size(),
+                         [](auto in, auto* o) { return ToUtf32(in, o); });
+}
+
+bool FromUtf16(std::u16string_view str, std::string& out) {
+    return ConvertString(str, out, str.size() * 3,
+                         [](auto in, auto* o) { return FromUtf16(in, o); });
+}
+
+bool FromUtf32(std::u32string_view str, std::string& out) {
+    return ConvertString(str, out, str.size() * 4,
+                         [](auto in, auto* o) { return FromUtf32(in, o); });
+}
+
+}  // namespace utf8
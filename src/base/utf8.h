@@ -0,0 +1,41 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "cpu_features.h"
+
+// UTF-8 validation and transcoding to and from UTF-16 and UTF-32
+// Runs of ASCII are processed with SIMD, 16 bytes at once with SSE2 and
+// 32 with AVX2, the rest is decoded one code point at a time.
+// With AVX2 the validation of multibyte text is vectorized too.
+// The instruction set is cpu::GetSimdLevel().
+//
+// Invalid input: overlong encodings, surrogates, code points above
+// U+10FFFF, truncated sequences and unpaired UTF-16 surrogates
+namespace utf8 {
+
+inline constexpr size_t kError = ~size_t(0);
+
+bool IsValid(std::string_view str);
+
+bool IsAscii(std::string_view str);
+
+// Low level conversions into a buffer large enough for any input:
+//   ToUtf16, ToUtf32: str.size() units
+//   FromUtf16: str.size() * 3 bytes
+//   FromUtf32: str.size() * 4 bytes
+// Return the number of written units or kError if the input is invalid
+size_t ToUtf16(std::string_view str, char16_t* out);
+size_t ToUtf32(std::string_view str, char32_t* out);
+size_t FromUtf16(std::u16string_view str, char* out);
+size_t FromUtf32(std::u32string_view str, char* out);
+
+// Return false if the input is invalid
+bool ToUtf16(std::string_view str, std::u16string& out);
+bool ToUtf32(std::string_view str, std::u32string& out);
+bool FromUtf16(std::u16string_view str, std::string& out);
+bool FromUtf32(std::u32string_view str, std::string& out);
+
+}  // namespace utf8
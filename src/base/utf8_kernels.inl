@@ -0,0 +1,122 @@
+// Transcoding kernels shared by the instruction sets
+// Included by utf8.cpp into a namespace which defines a Simd policy:
+//   kWidth                 Number of units per block
+//   Mask                   Marks the non-ASCII units of a block
+//   Prefix(mask)           Number of ASCII units before the first marked
+//   NonAscii(in)           Mask of a block of bytes
+//   WidenAscii(in, out)    Widens a block of bytes into 16 or 32 bit units
+//   NarrowAscii(in, out)   Narrows a block of 16 or 32 bit units into bytes
+// Widen and Narrow store the whole block and return its mask, the units
+// after the ASCII prefix are overwritten by the scalar decoder. The output
+// buffers are large enough as a block never produces more units than the
+// decoder. Blocks with a zero mask are skipped without looking at the mask
+// further so the loop doesn't wait for the loads.
+// Compiled for the target of the including namespace.
+
+inline bool ValidateBlocks(const uint8_t* in, size_t size) {
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= Simd::kWidth) {
+            const auto nonAscii = Simd::NonAscii(in + i);
+            if (!nonAscii) {
+                i += Simd::kWidth;
+                continue;
+            }
+            i += Simd::Prefix(nonAscii);
+        }
+        // Decodes until the next ASCII char
+        do {
+            char32_t cp;
+            const uint32_t len = DecodeUtf8(in + i, size - i, cp);
+            if (!len) {
+                return false;
+            }
+            i += len;
+        } while (i < size && in[i] >= 0x80);
+    }
+    return true;
+}
+
+inline bool IsAsciiBlocks(const uint8_t* in, size_t size) {
+    size_t i = 0;
+    for (; size - i >= Simd::kWidth; i += Simd::kWidth) {
+        if (Simd::NonAscii(in + i)) {
+            return false;
+        }
+    }
+    for (; i < size; ++i) {
+        if (in[i] >= 0x80) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <class Char>
+size_t ToUtfN(const uint8_t* in, size_t size, Char* out) {
+    Char* o = out;
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= Simd::kWidth) {
+            const auto nonAscii = Simd::WidenAscii(in + i, o);
+            if (!nonAscii) {
+                i += Simd::kWidth;
+                o += Simd::kWidth;
+                continue;
+            }
+            const uint32_t prefix = Simd::Prefix(nonAscii);
+            i += prefix;
+            o += prefix;
+        }
+        do {
+            char32_t cp;
+            const uint32_t len = DecodeUtf8(in + i, size - i, cp);
+            if (!len) {
+                return kError;
+            }
+            i += len;
+            if constexpr (sizeof(Char) == 2) {
+                o = EncodeUtf16(cp, o);
+            } else {
+                *o++ = cp;
+            }
+        } while (i < size && in[i] >= 0x80);
+    }
+    return (size_t)(o - out);
+}
+
+template <class Char>
+size_t FromUtfN(const Char* in, size_t size, uint8_t* out) {
+    uint8_t* o = out;
+    size_t i = 0;
+    while (i < size) {
+        if (size - i >= Simd::kWidth) {
+            const auto nonAscii = Simd::NarrowAscii(in + i, o);
+            if (!nonAscii) {
+                i += Simd::kWidth;
+                o += Simd::kWidth;
+                continue;
+            }
+            const uint32_t prefix = Simd::Prefix(nonAscii);
+            i += prefix;
+            o += prefix;
+        }
+        do {
+            char32_t cp;
+            if constexpr (sizeof(Char) == 2) {
+                const uint32_t len = DecodeUtf16(in + i, size - i, cp);
+                if (!len) {
+                    return kError;
+                }
+                i += len;
+            } else {
+                cp = in[i++];
+                if (!IsValidCodePoint(cp)) {
+                    return kError;
+                }
+            }
+            o = EncodeUtf8(cp, o);
+        } while (i < size && in[i] >= 0x80);
+    }
+    return (size_t)(o - out);
+}
@@ -3,9 +3,25 @@
 #include "pooled_alloc.h"
 #include "vector_types.h"
 #include "bump_alloc.h"
+#include "log_buffer.h"
+#include "log_file.h"
+#include "rtti.h"
+#include "bench.h"
+#include "trace.h"
+#include "flat_hash_map.h"
+#include "slot_map.h"
+#include "small_vector.h"
+#include "utf8.h"
+#include "property_writer.h"
+#include "mem_tracker.h"
+#include "sha256.h"
 
 #include <doctest/doctest.h>
 
+#include <random>
+#include <set>
+#include <thread>
+
 namespace {
 
 bool isDestructed = false;
@@ -64,6 +80,50 @@ TEST_CASE("[RefCountedPtr]") {
     CHECK_EQ(baseRc->refCount, 1);
 }
 
+TEST_CASE("[RefCountedPtr] Weak references") {
+    struct Object : public RefCountedBase {
+        explicit Object(bool& destructed)
+            : RefCountedBase(0), destructed(destructed) {}
+        ~Object() override { destructed = true; }
+        bool& destructed;
+    };
+    bool destructed = false;
+    WeakRefCountedPtr<Object> weak;
+    CHECK(weak.Expired());
+    CHECK(!weak.Lock());
+    {
+        RefCountedPtr<Object> strong = MakeRefCounted<Object>(destructed);
+        CHECK(strong->GetRefCount() == 1);
+        weak = strong;
+        WeakRefCountedPtr<Object> weak2 = weak;
+        CHECK(!weak.Expired());
+        {
+            RefCountedPtr<Object> locked = weak2.Lock();
+            CHECK(locked == strong);
+            CHECK(strong->GetRefCount() == 2);
+        }
+        CHECK(strong->GetRefCount() == 1);
+    }
+    CHECK(destructed);
+    CHECK(weak.Expired());
+    CHECK(!weak.Lock());
+    weak = nullptr;
+}
+
+TEST_CASE("[RefCountedPtr] Single thread policy") {
+    struct Object : public SingleThreadRefCountedBase {
+        Object() : SingleThreadRefCountedBase(0) {}
+    };
+    RefCountedPtr<Object> a = MakeRefCounted<Object>();
+    RefCountedPtr<Object> b = a;
+    CHECK(a->GetRefCount() == 2);
+    WeakRefCountedPtr<Object> weak = a;
+    a = nullptr;
+    CHECK(weak.Lock() == b);
+    b = nullptr;
+    CHECK(weak.Expired());
+}
+
 TEST_CASE("[TrivialPoolAllocator]") {
     struct MyClass {
         size_t index = 42;
@@ -120,6 +180,356 @@ TEST_CASE("[StringID]") {
 	CHECK(sid4.String() == "NeW MaTerial");
 }
 
+TEST_CASE("[StringID] Literals") {
+    const StringID runtime("New Material");
+    for (int i = 0; i < 2; ++i) {
+        const StringID literal = "NEW MATERIAL"_sid;
+        CHECK(literal == runtime);
+        CHECK(literal.String() == "NEW MATERIAL");
+    }
+    CHECK(""_sid.Empty());
+}
+
+TEST_CASE("[StringID] Lexical order") {
+    CHECK(StringID("apple").LexicalLess(StringID("Banana")));
+    CHECK(!StringID("Banana").LexicalLess(StringID("apple")));
+    CHECK(!StringID("Apple").LexicalLess(StringID("apple")));
+    CHECK(StringID("abc").LexicalLess(StringID("abcd")));
+    // Same 8 byte prefix
+    CHECK(StringID("material_1").LexicalLess(StringID("Material_2")));
+
+    std::set<StringID, StringID::LexicalLessPred> set{"c", "B", "a"};
+    CHECK(set.begin()->String() == "a");
+    CHECK(set.rbegin()->String() == "c");
+}
+
+TEST_CASE("[StringID] Concurrent interning") {
+    constexpr int kNumThreads = 4;
+    constexpr int kNumStrings = 10000;
+    std::vector<std::vector<StringID>> results(kNumThreads);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kNumThreads; ++t) {
+        threads.emplace_back([&, t] {
+            for (int i = 0; i < kNumStrings; ++i) {
+                results[t].emplace_back(std::format("Concurrent_{}", i));
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    for (int t = 1; t < kNumThreads; ++t) {
+        CHECK(results[t] == results[0]);
+    }
+    CHECK(results[0].back().String() ==
+        std::format("Concurrent_{}", kNumStrings - 1));
+}
+
+TEST_CASE("[Log] Binary record") {
+    using namespace logging::detail;
+    const std::string str = "string";
+    const char* literal = "literal";
+    std::vector<std::byte> buffer(EncodedSize(42) + EncodedSize(1.5) +
+                                  EncodedSize(str) + EncodedSize(literal));
+    std::byte* data = buffer.data();
+    Encode(data, 42);
+    Encode(data, 1.5);
+    Encode(data, str);
+    Encode(data, literal);
+    CHECK(data == buffer.data() + buffer.size());
+
+    std::string out;
+    FormatRecord<int, double, std::string, const char*>(
+        "{} {} {} {}", buffer.data(), out);
+    CHECK(out == "42 1.5 string literal");
+}
+
+TEST_CASE("[Log] Binary record format specs") {
+    using namespace logging::detail;
+    static_assert(kIsDeferredArg<const void*>);
+    static_assert(!kIsDeferredArg<std::vector<int>>);
+
+    const int value = 0;
+    const void* ptr = &value;
+    std::vector<std::byte> buffer(EncodedSize(ptr) + EncodedSize(2.5));
+    std::byte* data = buffer.data();
+    Encode(data, ptr);
+    Encode(data, 2.5);
+    std::string out;
+    FormatRecord<const void*, double>("{:p} {:.2f}", buffer.data(), out);
+    CHECK(out == std::format("{:p} 2.50", ptr));
+
+    // Formatted by the caller, the format of the site is ignored
+    const std::string message = "formatted {}";
+    buffer.resize(EncodedSize(message));
+    data = buffer.data();
+    Encode(data, message);
+    out.clear();
+    FormatMessage("{:p}", buffer.data(), out);
+    CHECK(out == message);
+
+    // Compiles the path formatted by the caller
+    LOG_VERBOSE("Formatted by the caller {:>6}", std::chrono::seconds(1));
+}
+
+namespace {
+
+// Writes a record with an int argument, false if dropped
+bool PushRecord(logging::ThreadBuffer& buffer, int value) {
+    constexpr size_t kSize = sizeof(logging::RecordHeader) + sizeof(int);
+    std::byte* data = buffer.Reserve(kSize);
+    if (!data) {
+        return false;
+    }
+    auto* header = reinterpret_cast<logging::RecordHeader*>(data);
+    header->size = (uint32_t)AlignUp(kSize, logging::kRecordAlign);
+    header->isPadding = false;
+    std::memcpy(header + 1, &value, sizeof(value));
+    buffer.Commit();
+    return true;
+}
+
+std::vector<int> ConsumeRecords(logging::ThreadBuffer& buffer) {
+    std::vector<int> values;
+    buffer.Consume([&](const logging::RecordHeader&, const std::byte* args) {
+        int value;
+        std::memcpy(&value, args, sizeof(value));
+        values.push_back(value);
+    });
+    return values;
+}
+
+}  // namespace
+
+TEST_CASE("[Log] Ring buffer wraparound") {
+    // 40 bytes per record, the end of the buffer is padded every few rounds
+    logging::ThreadBuffer buffer(256);
+    int next = 0;
+    for (int round = 0; round < 20; ++round) {
+        std::vector<int> expected;
+        for (int i = 0; i < 3; ++i) {
+            REQUIRE(PushRecord(buffer, next));
+            expected.push_back(next++);
+        }
+        CHECK(ConsumeRecords(buffer) == expected);
+    }
+    CHECK(ConsumeRecords(buffer).empty());
+    CHECK(buffer.TakeDropped() == 0);
+}
+
+TEST_CASE("[Log] Dropped records") {
+    logging::ThreadBuffer buffer(256);
+    int numPushed = 0;
+    while (PushRecord(buffer, numPushed)) {
+        ++numPushed;
+    }
+    // The last record doesn't fit with the padding before the wrap
+    CHECK(numPushed == 6);
+    CHECK_FALSE(PushRecord(buffer, -1));
+    CHECK(buffer.TakeDropped() == 2);
+    CHECK(buffer.TakeDropped() == 0);
+
+    // Producers continue after the consumer catches up
+    CHECK(ConsumeRecords(buffer) == std::vector<int>{0, 1, 2, 3, 4, 5});
+    CHECK(PushRecord(buffer, 6));
+    CHECK(ConsumeRecords(buffer) == std::vector<int>{6});
+    CHECK(buffer.TakeDropped() == 0);
+}
+
+TEST_CASE("[Log] Module levels") {
+    int numEvaluated = 0;
+    const auto log = [&] { LOG_VERBOSE("Evaluated {} times", ++numEvaluated); };
+
+    logging::SetModuleLevel("base/util_test", logging::Level::Error);
+    log();
+    // Arguments are not evaluated for disabled sites
+    CHECK(numEvaluated == 0);
+
+    logging::SetModuleLevel("base/util_test", logging::Level::Verbose);
+    log();
+    CHECK(numEvaluated ==
+        (logging::IsCompiledIn(logging::Level::Verbose) ? 1 : 0));
+
+    // The longest match wins
+    logging::SetModuleLevel("base/util_test.cpp", logging::Level::Warning);
+    log();
+    CHECK(numEvaluated ==
+        (logging::IsCompiledIn(logging::Level::Verbose) ? 1 : 0));
+
+    logging::ClearModuleLevel("base/util_test.cpp");
+    logging::ClearModuleLevel("base/util_test");
+}
+
+TEST_CASE("[Log] File sink rotation") {
+    namespace fs = std::filesystem;
+    const fs::path dir = fs::temp_directory_path() / "pet_engine_log_test";
+    fs::remove_all(dir);
+    {
+        logging::FileSinkOptions options;
+        options.segmentSize = 1000;
+        options.maxSegments = 3;
+        logging::FileSink sink(dir, options);
+        CHECK(sink.IsOpen());
+        // 100 lines of 50 bytes, 5 segments
+        for (int i = 0; i < 100; ++i) {
+            sink.Write("0123456789012345678901234567890123456789012345678\n");
+        }
+        CHECK(sink.GetCurrentPath().filename() == "log_000005.txt");
+    }
+    std::vector<fs::path> segments;
+    for (const auto& entry : fs::directory_iterator(dir)) {
+        segments.push_back(entry.path().filename());
+        // Truncated to the written size
+        CHECK(entry.file_size() == 1000);
+    }
+    std::ranges::sort(segments);
+    CHECK(segments == std::vector<fs::path>{"log_000003.txt", "log_000004.txt",
+                                            "log_000005.txt"});
+    fs::remove_all(dir);
+}
+
+TEST_CASE("[Bench] Time stats") {
+    std::vector<double> samples;
+    for (int i = 1; i <= 99; ++i) {
+        samples.push_back(1.0 + i * 0.001);
+    }
+    // Far outside of 3 MADs
+    samples.push_back(100.0);
+    uint32_t numOutliers = 0;
+    const bench::TimeStats stats =
+        bench::ComputeTimeStats(samples, &numOutliers);
+    CHECK(numOutliers == 1);
+    CHECK(stats.min == doctest::Approx(1.001));
+    CHECK(stats.max == doctest::Approx(100.0));
+    CHECK(stats.median == doctest::Approx(1.0505));
+    CHECK(stats.mad == doctest::Approx(0.025));
+    // The outlier is excluded from the trimmed mean but not from percentiles
+    CHECK(stats.trimmedMean == doctest::Approx(1.05));
+    CHECK(stats.average == doctest::Approx(stats.total / samples.size()));
+    CHECK(stats.p90 == doctest::Approx(1.0901));
+    CHECK(stats.medianLower < stats.median);
+    CHECK(stats.medianUpper > stats.median);
+    CHECK(stats.medianUpper - stats.medianLower < 0.03);
+}
+
+TEST_CASE("[Bench] Compare with baseline") {
+    const auto makeResult = [](std::string name, double median) {
+        bench::Result result{std::move(name), {}};
+        result.stats.wallTime.median = median;
+        result.stats.wallTime.medianLower = median * 0.99;
+        result.stats.wallTime.medianUpper = median * 1.01;
+        return result;
+    };
+    const std::vector<bench::Result> baseline = {
+        makeResult("A", 1e-6), makeResult("B/8", 1e-6), makeResult("C", 1e-6)};
+    const std::vector<bench::Result> current = {
+        makeResult("A", 1.2e-6), makeResult("B/8", 1.01e-6),
+        makeResult("C", 0.5e-6), makeResult("D", 1e-6)};
+    const auto comparison =
+        bench::Compare(current, bench::ToJson(baseline), 0.05);
+    REQUIRE(comparison.size() == 4);
+    CHECK(comparison[0].verdict == bench::Comparison::Verdict::Slower);
+    CHECK(comparison[0].change == doctest::Approx(0.2));
+    CHECK(comparison[1].verdict == bench::Comparison::Verdict::Same);
+    CHECK(comparison[2].verdict == bench::Comparison::Verdict::Faster);
+    CHECK(comparison[3].verdict == bench::Comparison::Verdict::New);
+}
+
+TEST_CASE("[Trace] Chrome trace export") {
+    const auto countOf = [](std::string_view str, std::string_view what) {
+        size_t count = 0;
+        for (size_t pos = str.find(what); pos != str.npos;
+             pos = str.find(what, pos + 1)) {
+            ++count;
+        }
+        return count;
+    };
+    // Not recorded
+    {
+        trace::Scope scope("Before start");
+    }
+    trace::Start();
+    trace::MarkFrame();
+    {
+        trace::Scope scope("Outer");
+        trace::RecordCounter("Count", 42);
+        std::thread thread([] {
+            for (int i = 0; i < 10; ++i) {
+                trace::Scope scope("Worker");
+            }
+        });
+        thread.join();
+    }
+    trace::Stop();
+    {
+        trace::Scope scope("After stop");
+    }
+    const std::string json = trace::ToChromeTraceJson();
+    CHECK(countOf(json, "\"ph\":\"X\"") == 11);
+    CHECK(countOf(json, "\"name\":\"Worker\"") == 10);
+    CHECK(countOf(json, "\"name\":\"Outer\"") == 1);
+    CHECK(countOf(json, "\"value\":42") == 1);
+    CHECK(countOf(json, "\"frame\":0") == 1);
+    CHECK(countOf(json, "thread_name") == 2);
+    CHECK(countOf(json, "stop") == 0);
+    CHECK(countOf(json, "Before") == 0);
+
+    trace::Clear();
+    CHECK(countOf(trace::ToChromeTraceJson(), "\"ph\"") == 0);
+}
+
+namespace {
+
+class TestShape {
+    DEFINE_ROOT_CLASS_META(TestShape)
+public:
+    virtual ~TestShape() = default;
+};
+
+class TestPolygon : public TestShape {
+    DEFINE_CLASS_META(TestPolygon, TestShape)
+};
+
+class TestRect : public TestPolygon {
+    DEFINE_CLASS_META(TestRect, TestPolygon)
+};
+
+class TestCircle : public TestShape {
+    DEFINE_CLASS_META(TestCircle, TestShape)
+};
+
+}  // namespace
+
+TEST_CASE("[Rtti] Class ranges") {
+    TestRect rect;
+    TestCircle circle;
+    const TestShape* shape = &rect;
+    CHECK(shape->IsA<TestShape>());
+    CHECK(shape->IsA<TestPolygon>());
+    CHECK(shape->IsA<TestRect>());
+    CHECK_FALSE(shape->IsA<TestCircle>());
+    CHECK(shape->As<TestPolygon>() == &rect);
+
+    shape = &circle;
+    CHECK(shape->IsA<TestShape>());
+    CHECK(shape->IsA<TestCircle>());
+    CHECK_FALSE(shape->IsA<TestPolygon>());
+    CHECK(shape->As<TestRect>() == nullptr);
+
+    // Finalized by the first check, a later registration renumbers it
+    CHECK(ClassTree::IsFinalized());
+    const ClassMeta* square =
+        ClassTree::Instance()->RegisterClass("TestSquare", "TestRect");
+    CHECK(ClassTree::Instance()->Find("TestSquare") == square);
+    CHECK(square->IsSubclassOf(TestRect::GetStaticClass()));
+    CHECK(square->IsSubclassOf(TestShape::GetStaticClass()));
+    CHECK_FALSE(square->IsSubclassOf(TestCircle::GetStaticClass()));
+    CHECK_FALSE(TestRect::GetStaticClass()->IsSubclassOf(square));
+    shape = &rect;
+    CHECK(shape->IsA<TestPolygon>());
+    CHECK_FALSE(shape->IsA<TestCircle>());
+}
+
 TEST_CASE("[DList]") {
     struct Node {
         Node* next = nullptr;
@@ -208,3 +618,813 @@ TEST_CASE("[BumpAlloc] Overaligned") {
     CHECK(foo3 % 16 == 0);
     CHECK_NE(ptr += 16, foo3);
 }
+
+TEST_CASE("[BumpAlloc] Dedicated allocation") {
+    auto alloc = BumpAllocator(64);
+    auto* small = (char*)alloc.Allocate(8, 8);
+    auto* big = (char*)alloc.Allocate(1024, 64);
+    CHECK((uintptr_t)big % 64 == 0);
+    memset(big, 0xcc, 1024);
+    // The current page is still used
+    auto* small2 = (char*)alloc.Allocate(8, 8);
+    CHECK_EQ(small2, small + 8);
+}
+
+TEST_CASE("[FlatHashMap] Basic") {
+    FlatHashMap<int, int> map;
+    CHECK(map.empty());
+    CHECK(map.find(1) == map.end());
+    CHECK(map.begin() == map.end());
+
+    constexpr int kCount = 1000;
+    for(int i = 0; i < kCount; ++i) {
+        CHECK(map.try_emplace(i, i * 10).second);
+    }
+    CHECK_FALSE(map.try_emplace(5, 0).second);
+    CHECK_EQ(map.size(), kCount);
+    CHECK(map.size() <= FlatHashMap<int, int>::MaxLoad(map.capacity()));
+    for(int i = 0; i < kCount; ++i) {
+        REQUIRE(map.contains(i));
+        CHECK_EQ(map.at(i), i * 10);
+    }
+    CHECK_FALSE(map.contains(kCount));
+    CHECK_THROWS(map.at(kCount));
+
+    // Erase odd keys
+    for(int i = 1; i < kCount; i += 2) {
+        CHECK_EQ(map.erase(i), 1);
+    }
+    CHECK_EQ(map.erase(1), 0);
+    CHECK_EQ(map.size(), kCount / 2);
+    int sum = 0;
+    size_t numVisited = 0;
+    for(const auto& [key, value] : map) {
+        CHECK(key % 2 == 0);
+        sum += key;
+        ++numVisited;
+    }
+    CHECK_EQ(numVisited, kCount / 2);
+    CHECK_EQ(sum, (kCount - 2) * kCount / 4);
+
+    // Erase while iterating
+    for(auto it = map.begin(); it != map.end();) {
+        it = it->first % 4 == 0 ? map.erase(it) : std::next(it);
+    }
+    CHECK_EQ(map.size(), kCount / 4);
+    CHECK(map.contains(2));
+    CHECK_FALSE(map.contains(4));
+
+    map[4] = 1;
+    map[4] += 1;
+    CHECK_EQ(map.at(4), 2);
+    map.insert_or_assign(4, 7);
+    CHECK_EQ(map.at(4), 7);
+
+    auto copy = map;
+    CHECK_EQ(copy.size(), map.size());
+    CHECK_EQ(copy.at(4), 7);
+    auto moved = std::move(copy);
+    CHECK(copy.empty());
+    CHECK_EQ(moved.size(), map.size());
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(map.find(2) == map.end());
+}
+
+TEST_CASE("[FlatHashMap] Tombstones") {
+    // Churn within a small table rehashes in place
+    FlatHashMap<int, int> map;
+    for(int i = 0; i < 10000; ++i) {
+        map[i] = i;
+        if(i >= 8) {
+            CHECK_EQ(map.erase(i - 8), 1);
+        }
+    }
+    CHECK_EQ(map.size(), 8);
+    CHECK(map.capacity() <= 32);
+    for(int i = 10000 - 8; i < 10000; ++i) {
+        CHECK_EQ(map.at(i), i);
+    }
+}
+
+TEST_CASE("[FlatHashMap] Heterogeneous lookup") {
+    FlatHashMap<std::string, int> map{{"one", 1}, {"two", 2}};
+    static_assert(decltype(map)::kIsTransparent);
+    CHECK_EQ(map.at(std::string_view("one")), 1);
+    CHECK_EQ(map.at("two"), 2);
+    CHECK(map.contains(std::string_view("two")));
+    CHECK(map.find("three") == map.end());
+    CHECK_EQ(map.erase(std::string_view("one")), 1);
+    CHECK_EQ(map.size(), 1);
+
+    FlatHashSet<std::string> set;
+    CHECK(set.insert("a").second);
+    CHECK_FALSE(set.insert("a").second);
+    CHECK(set.contains("a"));
+    CHECK_FALSE(set.contains(std::string_view("b")));
+}
+
+TEST_CASE("[FlatHashMap] Arena allocator") {
+    BumpAllocator arena;
+    using Alloc = ArenaAllocator<std::pair<std::string_view, int>>;
+    FlatHashMap<std::string_view, int, FlatHash<std::string_view>,
+                std::equal_to<>, Alloc> map{Alloc(arena)};
+    const std::string keys[] = {"alpha", "beta", "gamma", "delta"};
+    for(int i = 0; i < 100; ++i) {
+        map.try_emplace(keys[i % 4], i);
+    }
+    CHECK_EQ(map.size(), 4);
+    CHECK_EQ(map.at("gamma"), 2);
+    CHECK(map.get_allocator().GetArena() == &arena);
+}
+
+TEST_CASE("[SmallVector] Basic") {
+    SmallVector<std::string, 2> vec;
+    CHECK(vec.IsInline());
+    vec.push_back("a");
+    vec.emplace_back("b");
+    CHECK(vec.IsInline());
+    CHECK_EQ(vec.capacity(), 2);
+
+    // Spills to the heap, the argument references an element
+    vec.push_back(vec[0]);
+    CHECK_FALSE(vec.IsInline());
+    CHECK_EQ(vec.size(), 3);
+    CHECK_EQ(vec[2], "a");
+
+    vec.insert(vec.begin() + 1, "c");
+    CHECK(vec == SmallVector<std::string, 2>{"a", "c", "b", "a"});
+    vec.erase(vec.begin());
+    CHECK(vec == SmallVector<std::string, 2>{"c", "b", "a"});
+
+    auto copy = vec;
+    CHECK(copy == vec);
+    auto moved = std::move(copy);
+    CHECK(moved == vec);
+    CHECK(copy.empty());
+
+    vec.resize(1);
+    vec.shrink_to_fit();
+    CHECK(vec.IsInline());
+    CHECK_EQ(vec.front(), "c");
+
+    // Inline elements are moved one by one
+    SmallVector<std::string, 2> small{"x"};
+    auto movedSmall = std::move(small);
+    CHECK(movedSmall.IsInline());
+    CHECK_EQ(movedSmall[0], "x");
+    movedSmall = std::move(moved);
+    CHECK_EQ(movedSmall.size(), 3);
+    CHECK_FALSE(movedSmall.IsInline());
+}
+
+TEST_CASE("[SmallVector] Arena allocator") {
+    BumpAllocator arena;
+    using Alloc = ArenaAllocator<int>;
+    SmallVector<int, 4, Alloc> vec{Alloc(arena)};
+    for(int i = 0; i < 100; ++i) {
+        vec.push_back(i);
+    }
+    CHECK_FALSE(vec.IsInline());
+    CHECK_EQ(vec.back(), 99);
+    CHECK_EQ(vec.size(), 100);
+
+    // Moving between arenas allocates from the target one
+    static_assert(
+        !std::is_nothrow_move_assignable_v<SmallVector<int, 4, Alloc>>);
+    static_assert(std::is_nothrow_move_assignable_v<SmallVector<int, 4>>);
+    BumpAllocator otherArena;
+    SmallVector<int, 4, Alloc> other{Alloc(otherArena)};
+    other = std::move(vec);
+    CHECK(other.get_allocator() == Alloc(otherArena));
+    CHECK_EQ(other.size(), 100);
+    CHECK_EQ(other.back(), 99);
+}
+
+namespace {
+
+// Reference validator after the table 3-7 of the Unicode standard
+bool IsValidUtf8Reference(std::string_view str) {
+    const auto* p = (const uint8_t*)str.data();
+    const auto* end = p + str.size();
+    auto inRange = [&](int offset, uint8_t lo, uint8_t hi) {
+        return end - p > offset && p[offset] >= lo && p[offset] <= hi;
+    };
+    while(p < end) {
+        const uint8_t b = *p;
+        int len = 0;
+        if(b <= 0x7F) len = 1;
+        else if(b >= 0xC2 && b <= 0xDF) len = inRange(1, 0x80, 0xBF) ? 2 : 0;
+        else if(b == 0xE0)
+            len = inRange(1, 0xA0, 0xBF) && inRange(2, 0x80, 0xBF) ? 3 : 0;
+        else if(b == 0xED)
+            len = inRange(1, 0x80, 0x9F) && inRange(2, 0x80, 0xBF) ? 3 : 0;
+        else if(b >= 0xE1 && b <= 0xEF)
+            len = inRange(1, 0x80, 0xBF) && inRange(2, 0x80, 0xBF) ? 3 : 0;
+        else if(b == 0xF0)
+            len = inRange(1, 0x90, 0xBF) && inRange(2, 0x80, 0xBF) &&
+                    inRange(3, 0x80, 0xBF) ? 4 : 0;
+        else if(b >= 0xF1 && b <= 0xF3)
+            len = inRange(1, 0x80, 0xBF) && inRange(2, 0x80, 0xBF) &&
+                    inRange(3, 0x80, 0xBF) ? 4 : 0;
+        else if(b == 0xF4)
+            len = inRange(1, 0x80, 0x8F) && inRange(2, 0x80, 0xBF) &&
+                    inRange(3, 0x80, 0xBF) ? 4 : 0;
+        if(!len) {
+            return false;
+        }
+        p += len;
+    }
+    return true;
+}
+
+constexpr cpu::SimdLevel kSimdLevels[] = {
+    cpu::SimdLevel::Scalar, cpu::SimdLevel::SSE2, cpu::SimdLevel::AVX2};
+
+struct ScopedSimdLevel {
+    explicit ScopedSimdLevel(cpu::SimdLevel level)
+        : prev(cpu::SetSimdLevel(level)) {}
+    ~ScopedSimdLevel() { cpu::SetSimdLevel(prev); }
+    cpu::SimdLevel prev;
+};
+
+}  // namespace
+
+TEST_CASE("[Utf8] Validation") {
+    const std::string valid[] = {
+        "", "ascii", "\xC3\xA9t\xC3\xA9", "\xE2\x82\xAC", "\xED\x9F\xBF",
+        "\xF0\x9F\x98\x80", "\xF4\x8F\xBF\xBF",
+        std::string(100, 'a') + "\xE6\x97\xA5"};
+    const std::string invalid[] = {
+        "\x80", "\xC3", "\xC0\xAF", "\xE0\x80\xAF", "\xED\xA0\x80",
+        "\xF0\x8F\xBF\xBF", "\xF4\x90\x80\x80", "\xF5\x80\x80\x80", "\xFF",
+        std::string(31, 'a') + "\xE2\x82",
+        std::string(32, 'a') + "\xE2\x82" + std::string(40, 'b')};
+    for(cpu::SimdLevel level : kSimdLevels) {
+        ScopedSimdLevel _(level);
+        for(const std::string& str : valid) {
+            CHECK(utf8::IsValid(str));
+        }
+        for(const std::string& str : invalid) {
+            CHECK_FALSE(utf8::IsValid(str));
+            std::u16string out;
+            CHECK_FALSE(utf8::ToUtf16(str, out));
+        }
+        CHECK(utf8::IsAscii(std::string(100, 'a')));
+        CHECK_FALSE(utf8::IsAscii(std::string(100, 'a') + "\xC3\xA9"));
+    }
+}
+
+TEST_CASE("[Utf8] Transcoding") {
+    const std::string text = std::string(40, 'a') +
+        "\xC3\xA9\xE2\x82\xAC\xF0\x9F\x98\x80" +
+        std::string(40, 'b');
+    const std::u16string expected16 = std::u16string(40, u'a') +
+        u"\u00E9\u20AC\U0001F600" +
+        std::u16string(40, u'b');
+    const std::u32string expected32 = std::u32string(40, U'a') +
+        U"\u00E9\u20AC\U0001F600" +
+        std::u32string(40, U'b');
+    for(cpu::SimdLevel level : kSimdLevels) {
+        ScopedSimdLevel _(level);
+        std::u16string utf16;
+        REQUIRE(utf8::ToUtf16(text, utf16));
+        CHECK(utf16 == expected16);
+        std::u32string utf32;
+        REQUIRE(utf8::ToUtf32(text, utf32));
+        CHECK(utf32 == expected32);
+        std::string back;
+        REQUIRE(utf8::FromUtf16(utf16, back));
+        CHECK_EQ(back, text);
+        REQUIRE(utf8::FromUtf32(utf32, back));
+        CHECK_EQ(back, text);
+        // Unpaired surrogates
+        CHECK_FALSE(
+            utf8::FromUtf16(std::u16string(20, u'a') + u'\xD800', back));
+        CHECK_FALSE(utf8::FromUtf16(std::u16string(1, u'\xDC00'), back));
+        CHECK_FALSE(
+            utf8::FromUtf32(std::u32string(1, (char32_t)0x110000), back));
+    }
+    CHECK(ToWideString("\xC3\xA9t\xC3\xA9") == L"\u00E9t\u00E9");
+    std::string narrow;
+    CHECK(WStringToString(L"\u00E9t\u00E9", narrow));
+    CHECK_EQ(narrow, "\xC3\xA9t\xC3\xA9");
+}
+
+TEST_CASE("[Utf8] Fuzz") {
+    // Mutates valid text around block boundaries, all levels must agree
+    // with the reference validator and the scalar conversion
+    std::mt19937 rng(42);
+    const char32_t alphabet[] = {U'a', U'z', 0x7F, 0x80, 0x7FF, 0x800, 0xD7FF,
+                                 0xE000, 0xFFFF, 0x10000, 0x10FFFF};
+    for(int iteration = 0; iteration < 2000; ++iteration) {
+        std::u32string codepoints(rng() % 100, U'a');
+        for(char32_t& cp : codepoints) {
+            cp = rng() % 4 ? alphabet[rng() % std::size(alphabet)]
+                           : (char32_t)(rng() % 0x800);
+        }
+        std::string text;
+        REQUIRE(utf8::FromUtf32(codepoints, text));
+        for(int i = rng() % 4; i > 0 && !text.empty(); --i) {
+            text[rng() % text.size()] = (char)(rng() % 256);
+        }
+        const bool expectedValid = IsValidUtf8Reference(text);
+        std::u16string expected16;
+        std::u32string expected32;
+        {
+            ScopedSimdLevel _(cpu::SimdLevel::Scalar);
+            CHECK_EQ(utf8::ToUtf16(text, expected16), expectedValid);
+            CHECK_EQ(utf8::ToUtf32(text, expected32), expectedValid);
+        }
+        for(cpu::SimdLevel level : kSimdLevels) {
+            ScopedSimdLevel _(level);
+            CHECK_EQ(utf8::IsValid(text), expectedValid);
+            std::u16string utf16;
+            std::u32string utf32;
+            CHECK_EQ(utf8::ToUtf16(text, utf16), expectedValid);
+            CHECK_EQ(utf8::ToUtf32(text, utf32), expectedValid);
+            CHECK(utf16 == expected16);
+            CHECK(utf32 == expected32);
+            if(expectedValid) {
+                std::string back;
+                CHECK(utf8::FromUtf16(utf16, back));
+                CHECK_EQ(back, text);
+            }
+        }
+    }
+}
+
+namespace {
+
+struct TestWidget {
+    std::string name;
+    std::vector<TestWidget> children;
+};
+
+// Pushes the widgets in depth first order like DebugLogEvent
+void SerializeTestWidget(PropertyArchive& ar, const TestWidget& widget,
+                         const TestWidget* parent) {
+    ar.PushObject(widget.name, &widget, parent);
+    ar.PushStringProperty("name", widget.name);
+    ar.PushProperty("children", widget.children.size());
+    for(auto& child : widget.children) {
+        SerializeTestWidget(ar, child, &widget);
+    }
+}
+
+struct NullPropertySink final : PropertySink {
+    void OpenObject(std::string_view, ObjectID) override {}
+    void CloseObject() override {}
+    void Property(std::string_view, std::string_view, bool) override {}
+};
+
+TestWidget MakeTestWidgetTree() {
+    return TestWidget{"Window", {
+        TestWidget{"Flexbox",
+            {TestWidget{"Button", {}}, TestWidget{"\"Label\"\n", {}}}},
+        TestWidget{"Tooltip", {}},
+    }};
+}
+
+}  // namespace
+
+TEST_CASE("[BufferedWriter] Chunks") {
+    std::string out;
+    uint32_t flushCount = 0;
+    {
+        BufferedWriter writer([&](std::string_view data) {
+            out += data;
+            ++flushCount;
+        }, 8);
+        writer.Write("abc");
+        writer.Put('d');
+        writer.Format("{}-{}", 12345, "xyz");
+        CHECK_EQ(writer.GetSize(), 13);
+        // Bypasses the buffer
+        writer.Write("0123456789");
+    }
+    CHECK_EQ(out, "abcd12345-xyz0123456789");
+    CHECK_EQ(flushCount, 3);
+}
+
+TEST_CASE("[PropertyArchive] Streaming") {
+    const TestWidget window = MakeTestWidgetTree();
+
+    // Text log format
+    std::string text;
+    {
+        BufferedWriter buffer(BufferedWriter::ToString(&text));
+        TextPropertyWriter writer(&buffer);
+        PropertyArchive ar(&writer);
+        SerializeTestWidget(ar, window, nullptr);
+    }
+    CHECK_EQ(text,
+        "    \n"
+        "|-> Window:\n"
+        "    name: \"Window\"\n"
+        "    children: 2\n"
+        "    |   \n"
+        "    |-> Flexbox:\n"
+        "    |   name: \"Flexbox\"\n"
+        "    |   children: 2\n"
+        "    |   |   \n"
+        "    |   |-> Button:\n"
+        "    |   |   name: \"Button\"\n"
+        "    |   |   children: 0\n"
+        "    |   |   \n"
+        "    |   |-> \"Label\"\n:\n"
+        "    |   |   name: \"\"Label\"\n\"\n"
+        "    |   |   children: 0\n"
+        "    |   \n"
+        "    |-> Tooltip:\n"
+        "    |   name: \"Tooltip\"\n"
+        "    |   children: 0\n");
+
+    // The same nesting as the tree
+    PropertyArchive tree;
+    SerializeTestWidget(tree, window, nullptr);
+    CHECK_EQ(tree.rootObjects_.size(), 1);
+    CHECK_EQ(tree.rootObjects_.front()->children_.size(), 2);
+
+    std::string json;
+    {
+        BufferedWriter buffer(BufferedWriter::ToString(&json));
+        JsonPropertyWriter writer(&buffer);
+        PropertyArchive ar(&writer);
+        SerializeTestWidget(ar, window.children[1], nullptr);
+        ar.PushObject("Empty", 1, 0);
+    }
+    CHECK_EQ(json, std::format(
+        "[{{\"class\":\"Tooltip\",\"id\":\"{:#x}\","
+        "\"properties\":{{\"name\":\"Tooltip\",\"children\":\"0\"}}}},"
+        "{{\"class\":\"Empty\",\"id\":\"0x1\"}}]",
+        (uintptr_t)&window.children[1]));
+
+    // Properties pushed after the children are kept in one object
+    json.clear();
+    {
+        BufferedWriter buffer(BufferedWriter::ToString(&json));
+        JsonPropertyWriter writer(&buffer);
+        writer.OpenObject("Parent", 1);
+        writer.Property("first", "1", false);
+        writer.OpenObject("Child", 2);
+        writer.CloseObject();
+        writer.Property("second", "2", false);
+        writer.CloseObject();
+    }
+    CHECK_EQ(json,
+        "[{\"class\":\"Parent\",\"id\":\"0x1\","
+        "\"children\":[{\"class\":\"Child\",\"id\":\"0x2\"}],"
+        "\"properties\":{\"first\":\"1\",\"second\":\"2\"}}]");
+
+    // Binary replayed into json is the same as the json written directly
+    std::string binary;
+    json.clear();
+    {
+        BufferedWriter buffer(BufferedWriter::ToString(&binary));
+        BufferedWriter jsonBuffer(BufferedWriter::ToString(&json));
+        BinaryPropertyWriter writer(&buffer);
+        JsonPropertyWriter jsonWriter(&jsonBuffer, 2);
+        for(PropertySink* sink :
+            {(PropertySink*)&writer, (PropertySink*)&jsonWriter}) {
+            PropertyArchive ar(sink);
+            SerializeTestWidget(ar, window, nullptr);
+            SerializeTestWidget(ar, window, nullptr);
+        }
+    }
+    std::string replayed;
+    {
+        BufferedWriter buffer(BufferedWriter::ToString(&replayed));
+        JsonPropertyWriter writer(&buffer, 2);
+        CHECK(ReadBinaryProperties(binary, writer));
+    }
+    CHECK_EQ(replayed, json);
+    // Names are written once
+    CHECK_LT(binary.size(), json.size() / 4);
+
+    NullPropertySink nullSink;
+    for(size_t size = 0; size < binary.size(); ++size) {
+        CHECK_FALSE(ReadBinaryProperties(
+            std::string_view(binary).substr(0, size), nullSink));
+    }
+}
+
+TEST_CASE("[JsonTreePrinter] Escaping") {
+    JsonTreePrinter printer;
+    printer.OpenObject("obj");
+    printer.Entry("quote\"", "a\\b\x01");
+    printer.Entry("number", 10);
+    printer.CloseObject();
+    CHECK_EQ(printer.Finalize(),
+        "{\n"
+        "  \"obj\": {\n"
+        "    \"quote\\\"\": \"a\\\\b\\u0001\",\n"
+        "    \"number\": \"10\"\n"
+        "  }\n"
+        "}");
+}
+
+namespace {
+
+// Coordinates on a coarse grid so the points hit the edges
+float RandomCoord(std::mt19937& rng) {
+    return (float)((int)(rng() % 64) - 32) * 0.5f;
+}
+
+}  // namespace
+
+TEST_CASE("[RectBatch] Kernels") {
+    std::mt19937 rng(7);
+    for(int iteration = 0; iteration < 200; ++iteration) {
+        std::vector<Rect> rects(rng() % 40);
+        for(Rect& rect : rects) {
+            const float x = RandomCoord(rng);
+            const float y = RandomCoord(rng);
+            rect = Rect(x, y, x + RandomCoord(rng) + 8.f,
+                        y + RandomCoord(rng) + 8.f);
+        }
+        std::vector<float2> points(rng() % 20);
+        for(float2& point : points) {
+            point = {RandomCoord(rng) + 0.25f, -RandomCoord(rng) - 0.75f};
+        }
+        const float2 point(RandomCoord(rng), RandomCoord(rng));
+        const Rect other(RandomCoord(rng), RandomCoord(rng),
+                         RandomCoord(rng) + 4.f, RandomCoord(rng) + 4.f);
+        const float2 offset(0.3f, -1.6f);
+
+        size_t expectedLast = math::kNotFound;
+        Rect expectedUnion(INFINITY, INFINITY, -INFINITY, -INFINITY);
+        for(size_t i = 0; i < rects.size(); ++i) {
+            if(rects[i].Contains(point)) {
+                expectedLast = i;
+            }
+            expectedUnion.min.x = std::min(expectedUnion.min.x, rects[i].min.x);
+            expectedUnion.min.y = std::min(expectedUnion.min.y, rects[i].min.y);
+            expectedUnion.max.x = std::max(expectedUnion.max.x, rects[i].max.x);
+            expectedUnion.max.y = std::max(expectedUnion.max.y, rects[i].max.y);
+        }
+
+        for(cpu::SimdLevel level : kSimdLevels) {
+            ScopedSimdLevel _(level);
+            RectBatch batch(rects);
+            REQUIRE_EQ(batch.Size(), rects.size());
+            CHECK_EQ(batch.PaddedSize() % RectBatch::kPadding, 0);
+
+            bool contains[64];
+            bool intersects[64];
+            math::Contains(batch, point, contains);
+            math::Intersects(batch, other, intersects);
+            for(size_t i = 0; i < rects.size(); ++i) {
+                CHECK_EQ(contains[i], rects[i].Contains(point));
+                CHECK_EQ(intersects[i], rects[i].Intersects(other));
+            }
+            CHECK_EQ(math::FindLastContaining(batch, point), expectedLast);
+            CHECK(math::Union(batch) == expectedUnion);
+
+            math::Translate(batch, offset);
+            math::Round(batch);
+            math::Clip(batch, other);
+            for(size_t i = 0; i < rects.size(); ++i) {
+                const float2 min = math::Round(rects[i].min + offset);
+                const float2 max = math::Round(rects[i].max + offset);
+                const Rect expected(std::max(min.x, other.min.x),
+                                    std::max(min.y, other.min.y),
+                                    std::min(max.x, other.max.x),
+                                    std::min(max.y, other.max.y));
+                CHECK(batch.Get(i) == expected);
+            }
+
+            std::vector<float2> rounded = points;
+            std::vector<float2> clamped = points;
+            math::Translate(std::span(rounded), offset);
+            math::Round(std::span(rounded));
+            math::Clamp(std::span(clamped), float2(-4.f, -6.f),
+                        float2(4.f, 2.f));
+            for(size_t i = 0; i < points.size(); ++i) {
+                CHECK(rounded[i] == math::Round(points[i] + offset));
+                CHECK(clamped[i] == math::Clamp(points[i], float2(-4.f, -6.f),
+                                                float2(4.f, 2.f)));
+            }
+        }
+    }
+
+    // Whole floats, inf and the sign of zero are kept by the rounding
+    for(cpu::SimdLevel level : kSimdLevels) {
+        ScopedSimdLevel _(level);
+        std::vector<float2> points = {{-0.f, -0.5f}, {16777216.f, -8388609.f},
+                                      {INFINITY, -2.5f}, {1e9f, 0.99f}};
+        math::Round(std::span(points));
+        CHECK(std::signbit(points[0].x));
+        CHECK_EQ(points[0].y, -1.f);
+        CHECK_EQ(points[1].x, 16777216.f);
+        CHECK_EQ(points[1].y, -8388609.f);
+        CHECK_EQ(points[2].x, INFINITY);
+        CHECK_EQ(points[2].y, -3.f);
+        CHECK_EQ(points[3].x, 1e9f);
+        CHECK_EQ(points[3].y, 0.f);
+    }
+}
+
+#if defined(ENABLE_MEMORY_TRACKING)
+TEST_CASE("[MemTracker] Tags") {
+    const auto findDiff = [](const std::vector<mem::TagDiff>& diffs,
+                             mem::Tag tag) {
+        const auto it = std::ranges::find(diffs, tag, &mem::TagDiff::tag);
+        return it != diffs.end() ? *it : mem::TagDiff{tag};
+    };
+    const mem::Snapshot before = mem::TakeSnapshot();
+    {
+        MEM_TAG(Shaders);
+        {
+            MEM_TAG(Fonts);
+            CHECK(mem::GetCurrentTag() == mem::Tag::Fonts);
+        }
+        CHECK(mem::GetCurrentTag() == mem::Tag::Shaders);
+
+        BumpAllocator arena(1024);
+        arena.Allocate(16);
+        // Dedicated page
+        arena.Allocate(4096);
+        PooledAllocator<16, 4> pool;
+        pool.Free(pool.Allocate());
+
+        const mem::Snapshot during = mem::TakeSnapshot();
+        const mem::TagDiff diff =
+            findDiff(mem::Diff(before, during), mem::Tag::Shaders);
+        CHECK(diff.allocCount == 3);
+        CHECK(diff.liveBytes >= (int64_t)(arena.GetAllocatedBytes() + 4 * 16));
+        CHECK(diff.allocatedBytes == (uint64_t)diff.liveBytes);
+        CHECK(during[mem::Tag::Shaders].peakBytes >=
+            during[mem::Tag::Shaders].liveBytes);
+        CHECK(mem::FormatDiff(before, during).find("Shaders") !=
+            std::string::npos);
+    }
+    mem::Snapshot after = mem::TakeSnapshot();
+    CHECK(after[mem::Tag::Shaders].liveBytes ==
+        before[mem::Tag::Shaders].liveBytes);
+    CHECK(after[mem::Tag::Shaders].freeCount ==
+        before[mem::Tag::Shaders].freeCount + 2);
+    CHECK(findDiff(mem::Diff(before, after), mem::Tag::Fonts).allocCount == 0);
+
+    // Allocated by an exited thread, freed by this one
+    using Blob = std::vector<char, mem::TrackedAllocator<char>>;
+    Blob blob;
+    std::thread thread([&] {
+        MEM_TAG(Fonts);
+        Blob data(1000);
+        blob = std::move(data);
+    });
+    thread.join();
+    CHECK(blob.get_allocator().GetTag() == mem::Tag::Fonts);
+    after = mem::TakeSnapshot();
+    CHECK(after[mem::Tag::Fonts].liveBytes ==
+        before[mem::Tag::Fonts].liveBytes + 1000);
+    blob = Blob();
+    after = mem::TakeSnapshot();
+    CHECK(after[mem::Tag::Fonts].liveBytes ==
+        before[mem::Tag::Fonts].liveBytes);
+
+    // Largest growth first
+    const mem::Snapshot start = mem::TakeSnapshot();
+    BumpAllocator small(64);
+    small.Allocate(8);
+    std::unique_ptr<BumpAllocator> large;
+    {
+        MEM_TAG(UI);
+        large = std::make_unique<BumpAllocator>(4096);
+        large->Allocate(8);
+    }
+    const std::vector<mem::TagDiff> diffs =
+        mem::Diff(start, mem::TakeSnapshot());
+    REQUIRE(diffs.size() == 2);
+    CHECK(diffs[0].tag == mem::Tag::UI);
+    CHECK(diffs[1].tag == mem::Tag::Untagged);
+
+    // Interned strings are reported by the pool
+    const mem::Snapshot beforeIntern = mem::TakeSnapshot();
+    const std::string name = std::string(100, 'm') + "MemTrackerString";
+    const StringID sid(name.c_str());
+    const mem::TagDiff strings =
+        findDiff(mem::Diff(beforeIntern, mem::TakeSnapshot()),
+                 mem::Tag::Strings);
+    CHECK(strings.liveBytes > (int64_t)name.size());
+    CHECK_EQ(sid.String(), name);
+}
+#endif
+
+TEST_CASE("[SlotMap] Basic") {
+    SlotMap<std::string> map;
+    CHECK(!map.contains({}));
+    const SlotHandle a = map.insert("a");
+    const SlotHandle b = map.insert("b");
+    const SlotHandle c = map.emplace(3, 'c');
+    CHECK(map.size() == 3);
+    CHECK(*map.get(a) == "a");
+    CHECK(*map.get(c) == "ccc");
+
+    CHECK(map.erase(a));
+    CHECK(!map.erase(a));
+    CHECK(!map.contains(a));
+    CHECK(map.get(a) == nullptr);
+    // The last value is moved into the hole
+    CHECK(*map.get(b) == "b");
+    CHECK(*map.get(c) == "ccc");
+
+    // The slot is reused with a new generation
+    const SlotHandle d = map.insert("d");
+    CHECK(d.index == a.index);
+    CHECK(d != a);
+    CHECK(!map.contains(a));
+    CHECK(SlotHandle::FromBits(d.ToBits()) == d);
+
+    std::set<std::string> values(map.begin(), map.end());
+    CHECK(values == std::set<std::string>{"b", "ccc", "d"});
+    for(size_t i = 0; i < map.size(); ++i) {
+        CHECK(map.get(map.handle_at(i)) == &map[i]);
+    }
+
+    map.clear();
+    CHECK(map.empty());
+    CHECK(!map.contains(b));
+    CHECK(!map.contains(d));
+    CHECK(*map.get(map.insert("e")) == "e");
+}
+
+TEST_CASE("[SlotMap] Random") {
+    SlotMap<int> map;
+    std::vector<std::pair<SlotHandle, int>> live;
+    std::vector<SlotHandle> erased;
+    std::mt19937 rng(0);
+    for(int i = 0; i < 20000; ++i) {
+        // Grows over a few pages then shrinks
+        const bool bInsert =
+            live.empty() || rng() % 100 < (i < 10000 ? 70u : 30u);
+        if(bInsert) {
+            live.emplace_back(map.insert(i), i);
+        } else {
+            const size_t pos = rng() % live.size();
+            CHECK(map.erase(live[pos].first));
+            erased.push_back(live[pos].first);
+            live[pos] = live.back();
+            live.pop_back();
+        }
+    }
+    REQUIRE(map.size() == live.size());
+    for(auto& [handle, value] : live) {
+        REQUIRE(map.get(handle));
+        CHECK(*map.get(handle) == value);
+    }
+    for(SlotHandle handle : erased) {
+        CHECK(!map.contains(handle));
+    }
+}
+
+TEST_CASE("[SlotMap] Concurrent contains") {
+    SlotMap<int> map;
+    std::atomic<bool> bDone = false;
+    std::atomic<SlotHandle> published{};
+    std::thread reader([&] {
+        // A published handle stays valid until the writer sees bDone
+        while(!bDone.load(std::memory_order_acquire)) {
+            const SlotHandle handle = published.load(std::memory_order_acquire);
+            if(handle) {
+                CHECK(map.contains(handle));
+            }
+        }
+    });
+    std::vector<SlotHandle> handles;
+    for(int i = 0; i < 5000; ++i) {
+        handles.push_back(map.insert(i));
+        if(i % 10 == 0) {
+            published.store(handles.back(), std::memory_order_release);
+        }
+    }
+    bDone.store(true, std::memory_order_release);
+    reader.join();
+}
+
+TEST_CASE("[Sha256] Test vectors") {
+    CHECK_EQ(Sha256::ToHex(Sha256::Hash("")),
+             "e3b0c44298fc1c149afbf4c8996fb924"
+             "27ae41e4649b934ca495991b7852b855");
+    CHECK_EQ(Sha256::ToHex(Sha256::Hash("abc")),
+             "ba7816bf8f01cfea414140de5dae2223"
+             "b00361a396177a9cb410ff61f20015ad");
+    // Two blocks, the padding doesn't fit into the first one
+    constexpr std::string_view kLong =
+        "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+    CHECK_EQ(Sha256::ToHex(Sha256::Hash(kLong)),
+             "248d6a61d20638b8e5c026930c3e6039"
+             "a33ce45964ff2167f6ecedd419db06c1");
+
+    // Split at every position
+    const std::string text(200, 'x');
+    const Sha256::Digest expected = Sha256::Hash(text);
+    Sha256 hasher;
+    for (size_t split = 0; split <= text.size(); ++split) {
+        hasher.Update(std::string_view(text).substr(0, split));
+        hasher.Update(std::string_view(text).substr(split));
+        CHECK(hasher.Finish() == expected);
+    }
+}
@@ -1,5 +1,6 @@
 #include "win_minimal.h"
 #include <Windows.h>
+#include <compressapi.h>
 
 #undef max
 #undef min
@@ -36,4 +37,59 @@ namespace windows {
 	void SetConsoleCodepageUtf8() {
 		::SetConsoleOutputCP(CP_UTF8);
 	}
+
+	bool CreateMappedFile(const wchar_t* path, uint64_t size, MappedFile& outFile) {
+		HANDLE file = ::CreateFileW(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, NULL,
+									CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		// Preallocates the file
+		HANDLE mapping = ::CreateFileMappingW(file, NULL, PAGE_READWRITE, (DWORD)(size >> 32),
+											  (DWORD)size, NULL);
+		if (!mapping) {
+			::CloseHandle(file);
+			return false;
+		}
+		void* data = ::MapViewOfFile(mapping, FILE_MAP_WRITE, 0, 0, (SIZE_T)size);
+		if (!data) {
+			::CloseHandle(mapping);
+			::CloseHandle(file);
+			return false;
+		}
+		outFile = MappedFile{file, mapping, data, size};
+		return true;
+	}
+
+	void FlushMappedFile(const MappedFile& file) {
+		::FlushViewOfFile(file.data, 0);
+		::FlushFileBuffers(file.file);
+	}
+
+	void CloseMappedFile(MappedFile& file, uint64_t finalSize) {
+		::UnmapViewOfFile(file.data);
+		::CloseHandle(file.mapping);
+		LARGE_INTEGER pos;
+		pos.QuadPart = (LONGLONG)finalSize;
+		::SetFilePointerEx(file.file, pos, NULL, FILE_BEGIN);
+		::SetEndOfFile(file.file);
+		::CloseHandle(file.file);
+		file = MappedFile();
+	}
+
+	bool CompressBuffer(const void* data, uint64_t size, std::vector<uint8_t>& out) {
+		COMPRESSOR_HANDLE compressor;
+		if (!::CreateCompressor(COMPRESS_ALGORITHM_XPRESS_HUFF, NULL, &compressor)) {
+			return false;
+		}
+		// Query the buffer size
+		::SIZE_T compressedSize = 0;
+		::Compress(compressor, data, (::SIZE_T)size, NULL, 0, &compressedSize);
+		out.resize(compressedSize);
+		const BOOL ok = ::Compress(compressor, data, (::SIZE_T)size, out.data(), out.size(),
+								   &compressedSize);
+		::CloseCompressor(compressor);
+		out.resize(ok ? compressedSize : 0);
+		return ok;
+	}
 }
\ No newline at end of file
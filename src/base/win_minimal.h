@@ -1,5 +1,6 @@
 #pragma once
 #include <stdint.h>
+#include <vector>
 
 #ifndef WINAPI
 	#define WINAPI __stdcall
@@ -45,4 +46,22 @@ namespace windows {
 	void Pause();
 
 	void SetConsoleCodepageUtf8();
+
+	// File mapped into memory for writing
+	struct MappedFile {
+		HANDLE   file = nullptr;
+		HANDLE   mapping = nullptr;
+		void*    data = nullptr;
+		uint64_t size = 0;
+	};
+
+	// Creates or overwrites a file of |size| bytes and maps it
+	bool CreateMappedFile(const wchar_t* path, uint64_t size, MappedFile& outFile);
+	// Writes dirty pages and file metadata to the disk
+	void FlushMappedFile(const MappedFile& file);
+	// Unmaps and truncates the file to |finalSize|
+	void CloseMappedFile(MappedFile& file, uint64_t finalSize);
+
+	// Compresses with the XPRESS Huffman algorithm of the Compression API
+	bool CompressBuffer(const void* data, uint64_t size, std::vector<uint8_t>& out);
 }
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "base/bench.h"
+#include "base/command_line.h"
+
+#include <charconv>
+#include <fstream>
+#include <iostream>
+
+// Runs all benchmarks linked into the executable
+// Arguments:
+//   -filter <str>          Runs benchmarks which names contain the string
+//   -format <json|csv>     Format of the -out file. json by default
+//   -out <path>            Writes results to the file
+//   -baseline <path>       Compares with results previously written as json
+//   -threshold <percent>   Minimal change to report. 5 by default
+//   -min_sample_time <ms>  Overrides the calibrated time of a sample
+//   -samples <num>         Overrides the number of samples
+//   -counters <0|1>        Collects hardware counters if available. 1 by default
+// Returns 1 if a benchmark regressed compared to the baseline
+
+namespace {
+
+std::string FormatTime(double seconds) {
+    if (seconds < 1e-6) {
+        return std::format("{:.2f} ns", seconds * 1e9);
+    }
+    if (seconds < 1e-3) {
+        return std::format("{:.2f} us", seconds * 1e6);
+    }
+    if (seconds < 1.) {
+        return std::format("{:.2f} ms", seconds * 1e3);
+    }
+    return std::format("{:.2f} s", seconds);
+}
+
+void PrintResult(const bench::Result& result) {
+    const bench::Benchmark::Stats& stats = result.stats;
+    const bench::TimeStats& wall = stats.wallTime;
+    std::string line = std::format(
+        "{:<40} {:>12} +-{:>5.1f}%  p90 {:>12}  p99 {:>12}  [{}x{}, {} outliers]",
+        result.name, FormatTime(wall.median),
+        wall.median > 0. ? 100. * wall.mad / wall.median : 0.,
+        FormatTime(wall.p90), FormatTime(wall.p99), stats.numSamples,
+        stats.itersPerSample, stats.numOutliers);
+    if (stats.bytesPerSecond > 0.) {
+        line += std::format("  {:.2f} MB/s", stats.bytesPerSecond / 1e6);
+    }
+    if (stats.itemsPerSecond > 0.) {
+        line += std::format("  {:.2f} M items/s", stats.itemsPerSecond / 1e6);
+    }
+    if (stats.ipc > 0.) {
+        line += std::format("  IPC {:.2f}", stats.ipc);
+    }
+    using Counter = bench::PerfCounters::Counter;
+    for (Counter counter :
+         {Counter::CacheMisses, Counter::BranchMisses, Counter::TLBMisses}) {
+        if (const auto value = stats.GetCounter(counter)) {
+            line += std::format("  {} {:.2f}",
+                                bench::PerfCounters::GetName(counter), *value);
+        }
+    }
+    std::cout << line << '\n';
+}
+
+std::optional<std::string> ReadFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return {};
+    }
+    return std::string(std::istreambuf_iterator<char>(file), {});
+}
+
+std::optional<double> ParseDouble(std::string_view argName) {
+    const auto str = CommandLine::ParseArg<std::string>(argName);
+    if (!str) {
+        return {};
+    }
+    double value = 0.;
+    const auto [ptr, err] =
+        std::from_chars(str->data(), str->data() + str->size(), value);
+    if (err != std::errc()) {
+        return {};
+    }
+    return value;
+}
+
+}  // namespace
+
+int main(int argc, char** argv) {
+    CommandLine::Set(argc, argv);
+    logging::SetLevel(logging::Level::Error);
+
+    bench::RunOptions options;
+    options.filter = CommandLine::ParseArgOr<std::string>("-filter", "");
+    options.onResult = &PrintResult;
+    options.collectCounters = CommandLine::ParseArgOr<int>("-counters", 1) != 0;
+    if (options.collectCounters && !bench::PerfCounters().IsAnyAvailable()) {
+        std::cout << "Hardware counters are not available\n";
+    }
+
+    const auto minSampleTime = ParseDouble("-min_sample_time");
+    const auto numSamples = CommandLine::ParseArg<uint32_t>("-samples");
+    if (minSampleTime || numSamples) {
+        options.options.emplace();
+        if (minSampleTime) {
+            options.options->minSampleTime = *minSampleTime / 1000.;
+        }
+        if (numSamples) {
+            options.options->numSamples = *numSamples;
+        }
+    }
+    const std::vector<bench::Result> results = bench::RunAll(options);
+
+    if (const auto out = CommandLine::ParseArg<std::string>("-out")) {
+        const std::string format =
+            ToLower(CommandLine::ParseArgOr<std::string>("-format", "json"));
+        const std::string data =
+            format == "csv" ? bench::ToCsv(results) : bench::ToJson(results);
+        std::ofstream file(*out, std::ios::binary);
+        file.write(data.data(), (std::streamsize)data.size());
+        if (!file) {
+            std::cout << std::format("Cannot write results to '{}'\n", *out);
+            return -1;
+        }
+    }
+
+    const auto baselinePath = CommandLine::ParseArg<std::string>("-baseline");
+    if (!baselinePath) {
+        return 0;
+    }
+    const auto baseline = ReadFile(*baselinePath);
+    if (!baseline) {
+        std::cout << std::format("Cannot read the baseline '{}'\n",
+                                 *baselinePath);
+        return -1;
+    }
+    const double threshold = ParseDouble("-threshold").value_or(5.) / 100.;
+    bool bRegressed = false;
+    std::cout << '\n';
+    for (const bench::Comparison& comparison :
+         bench::Compare(results, *baseline, threshold)) {
+        using Verdict = bench::Comparison::Verdict;
+        std::string_view verdict;
+        switch (comparison.verdict) {
+            case Verdict::Same: verdict = "same"; break;
+            case Verdict::Faster: verdict = "FASTER"; break;
+            case Verdict::Slower: verdict = "SLOWER"; break;
+            case Verdict::New: verdict = "new"; break;
+        }
+        bRegressed |= comparison.verdict == Verdict::Slower;
+        std::cout << std::format("{:<40} {:>12} -> {:>12} {:>+7.1f}%  {}\n",
+                                 comparison.name,
+                                 FormatTime(comparison.baseline / 1e9),
+                                 FormatTime(comparison.current / 1e9),
+                                 comparison.change * 100., verdict);
+    }
+    return bRegressed ? 1 : 0;
+}
@@ -52,7 +52,7 @@ constexpr auto kFaceIndex = 0;
 
 
 std::expected<RefCountedPtr<FontTypeface>, ErrorCode> FontTypeface::Create(
-    std::span<char> data) {
+    Blob&& data) {
 
     if(!library) {
         FT_Init_FreeType(&library);
@@ -131,6 +131,8 @@ std::expected<RefCountedPtr<FontTypeface>, ErrorCode> FontTypeface::Create(
     auto out = RefCountedPtr(new FontTypeface());
     out->face_ = face.release();
     out->metrics_ = metrics;
+    // The moved buffer stays at the same address
+    out->data_ = std::move(data);
     return out;
 }
 
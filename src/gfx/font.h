@@ -1,5 +1,6 @@
 #pragma once
 #include "common.h"
+#include "base/mem_tracker.h"
 
 // TODO: hide ft
 #include <ft2build.h>
@@ -41,7 +42,7 @@ struct VariationAxis {
 
 // Owns the actual font data
 // Uses FreeType to access font data
-class FontTypeface: public RefCountedBase {
+class FontTypeface: public SingleThreadRefCountedBase {
 public:
 
     struct Metrics {
@@ -58,8 +59,12 @@ public:
 
 public:
 
+    // Font file data reported to the memory tag of the scope it's loaded in
+    using Blob = std::vector<char, mem::TrackedAllocator<char>>;
+
+    // The typeface keeps the data, FreeType reads it in place
     static std::expected<RefCountedPtr<FontTypeface>, ErrorCode> Create(
-        std::span<char> data);
+        Blob&& data);
 
     FontTypeface() = default;
     ~FontTypeface();
@@ -88,6 +93,7 @@ public:
 private:
     FT_FaceRec_* face_;
     Metrics metrics_;
+    Blob data_;
 };
 
 
@@ -7,12 +7,13 @@
 // TODO: Load asynchronously
 RefCountedPtr<FontTypeface> FontCache::LoadFromDisk(
     const std::string& filename) {
+    MEM_TAG(Fonts);
     // Start loading font
     std::error_code ec;
     auto fileSize = std::filesystem::file_size(filename, ec);
     DASSERT_F(!ec, "Cannot find the file: {}", filename);
 
-    std::vector<char> fileBlob;
+    FontTypeface::Blob fileBlob;
     fileBlob.resize(fileSize);
 
     std::ifstream fontFile;
@@ -24,7 +25,7 @@ RefCountedPtr<FontTypeface> FontCache::LoadFromDisk(
     fontFile.close();
 
     std::expected<RefCountedPtr<FontTypeface>, ErrorCode> face =
-        FontTypeface::Create(fileBlob);
+        FontTypeface::Create(std::move(fileBlob));
     DASSERT(face);
     // TODO: Check for duplicates
     typefaces_.push_back(face.value());
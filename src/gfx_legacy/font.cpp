@@ -1,13 +1,13 @@
 #include "font.h"
 #include "base/common.h"
 #include "base/string_utils.h"
+#include "base/flat_hash_map.h"
 
 // #define IMGUI_USER_CONFIG "imgui_config.h"
 #include <imgui/imgui.h>
 #include <imgui/imgui_internal.h>
 
 #include <filesystem>
-#include <map>
 
 using namespace ui;
 
@@ -278,6 +278,10 @@ bool operator>(const FontKey& left, const FontKey& right) {
     return left.key > right.key;
 }
 
+struct FontKeyHash {
+    size_t operator()(const FontKey& key) const { return key.key; }
+};
+
 namespace fs = std::filesystem;
 
 /**
@@ -519,7 +523,7 @@ public:
         if (!bStyleAvailable) {
             auto it2 = m_Faces.find(FontKey(inSize, false, false));
             if (it2 != m_Faces.end()) {
-                return it->second;
+                return it2->second;
             }
         }
         return nullptr;
@@ -596,11 +600,11 @@ private:
     ImFontAtlas m_FontAtlas;
     // Array of fonts with different sizes and formats
     // Atlas owns font all variants
-    std::map<FontKey, ImFontFace*> m_Faces;
+    FlatHashMap<FontKey, ImFontFace*, FontKeyHash> m_Faces;
 
     // Slices that should be builded
     // We cannot build on the fly because font texture could be used
-    std::map<FontKey, ImFont*> m_PendingFaces;
+    FlatHashMap<FontKey, ImFont*, FontKeyHash> m_PendingFaces;
 };
 
 Font* ui::Font::FromInternal() {
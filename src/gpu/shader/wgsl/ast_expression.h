@@ -111,9 +111,8 @@ public:
 
     // Result type of the expression after all conversions
     const ast::Type* type = nullptr;
-
-    template <class T>
-    std::optional<T> TryGetConstValueAs() const;
+    // Value of a const-expression, evaluated by the builder
+    const ConstValue* constValue = nullptr;
 
     Expression(SourceLoc loc, NodeType nodeType, const Type* type)
         : Node(loc, nodeType | kStaticType), type(type) {}
@@ -287,24 +286,24 @@ public:
         , indexExpr(indexExpr) {}
 };
 
-}  // namespace wgsl::ast
+using ArgumentList = ProgramList<const Expression*>;
 
-template <class T>
-std::optional<T> wgsl::ast::Expression::TryGetConstValueAs() const {
-    if (auto e = this->As<FloatLiteralExpression>()) {
-        return static_cast<T>(e->value);
-    }
-    if (auto e = this->As<IntLiteralExpression>()) {
-        return static_cast<T>(e->value);
-    }
-    if (auto e = this->As<BoolLiteralExpression>()) {
-        return static_cast<T>(e->value);
-    }
-    // Ident
-    if (auto ident = this->As<IdentExpression>()) {
-        if (auto var = ident->symbol->As<ConstVariable>()) {
-            return var->initializer->TryGetConstValueAs<T>();
-        }
-    }
-    return std::nullopt;
-}
\ No newline at end of file
+// A value constructor or a builtin function call
+// vec3f(1.0), array(1, 2), max(a, b)
+class CallExpression final : public Expression {
+public:
+    constexpr static inline auto kStaticType = NodeType::CallExpression;
+    // nullptr for a value constructor of the type
+    const BuiltinFunction* builtin;
+    const ArgumentList args;
+
+    CallExpression(SourceLoc loc,
+                   const Type* type,
+                   const BuiltinFunction* builtin,
+                   ArgumentList&& args)
+        : Expression(loc, kStaticType, type)
+        , builtin(builtin)
+        , args(std::move(args)) {}
+};
+
+}  // namespace wgsl::ast
\ No newline at end of file
@@ -249,10 +249,11 @@ constexpr std::string_view to_string(BuiltinFn fn) {
 class BuiltinFunction final : public Symbol {
 public:
     constexpr static inline auto kStaticType = NodeType::BuiltinFunction;
+    const std::string_view name;
     const BuiltinFn type;
 
     BuiltinFunction(std::string_view ident, BuiltinFn type)
-        : Symbol(kStaticType), type(type) {}
+        : Symbol(kStaticType), name(ident), type(type) {}
 };
 
 
@@ -35,6 +35,7 @@ namespace wgsl::ast {
     V(MemberAccessExpr, 23)       \
     V(SwizzleExpr, 24)            \
     V(ArrayIndexExpr, 25)         \
+    V(CallExpression, 26)         \
     /* Variables */               \
     V(Variable, 30)               \
     V(OverrideVariable, 31)       \
@@ -104,6 +105,11 @@ public:
     // node source range, including end: [start, end]
     SourceLoc GetLoc() const { return loc_; }
 
+    // Moves the node by |delta| lines after an edit of the text above it
+    void ShiftLines(int32_t delta) {
+        loc_.line = (uint32_t)((int32_t)loc_.line + delta);
+    }
+
 public:
     constexpr static inline auto kStaticType = NodeType::Node;
 
@@ -128,7 +134,7 @@ public:
     static constexpr auto kStaticType = NodeType::Symbol;
 
 protected:
-    Symbol(SourceLoc loc, NodeType type) : Node(type | kStaticType) {}
+    Symbol(SourceLoc loc, NodeType type) : Node(loc, type | kStaticType) {}
 
     Symbol(NodeType type) : Node(type | kStaticType) {}
 };
@@ -5,54 +5,199 @@
 #include "ast_node.h"
 #include "ast_type.h"
 
-#include <unordered_map>
+#include <memory>
+#include <span>
+#include <vector>
 
 namespace wgsl::ast {
 
+// Scope identifiers to declarations
+// An open addressing table with linear probing. The slots and the key
+// strings are allocated from the arena of the owner, so a table never
+// calls malloc and is released with the arena. Destructor is not called.
+// A name is hashed once per lookup and the hash is reused up the chain.
 class SymbolTable {
 public:
     ast::Symbol* FindSymbol(std::string_view name) {
-        auto it = symbols_.find(name);
-        if (it != symbols_.end()) {
-            return it->second;
-        }
-        for (auto* ancestor = parent_; ancestor; ancestor = ancestor->parent_) {
-            if (auto result = ancestor->FindSymbol(name)) {
-                return result;
+        const uint32_t hash = Hash(name);
+        for (auto* table = this; table; table = table->parent_) {
+            if (const Slot* slot = table->FindSlot(name, hash);
+                slot && slot->symbol) {
+                return slot->symbol;
             }
         }
         return nullptr;
     }
 
     // Returns true if successful
-    // Copies a string into internal memory so any source is allowed
+    // Copies a string into the arena so any source is allowed
     bool InsertSymbol(std::string_view name, ast::Symbol* decl) {
+        DASSERT_M(!frozen_, "Frozen symbol table");
+        DASSERT(decl);
+        // Max load factor is 1/2
+        if ((size_ + 1) * 2 > capacity_) {
+            Grow();
+        }
+        const uint32_t hash = Hash(name);
+        Slot* slot = FindSlot(name, hash);
+        if (slot->symbol) {
+            return false;
+        }
         static_assert(sizeof(char) == 1);
-        const auto size = name.size() + 1;
-        auto* mem = static_cast<char*>(keyAlloc_.Allocate(size));
-        memcpy(mem, name.data(), size);
-        const auto res =
-            symbols_.emplace(std::string_view(mem, name.size()), decl);
-        return res.second;
+        auto* mem = static_cast<char*>(alloc_->Allocate(name.size() + 1, 1));
+        memcpy(mem, name.data(), name.size());
+        mem[name.size()] = 0;
+        *slot = Slot{mem, (uint32_t)name.size(), hash, decl};
+        ++size_;
+        return true;
+    }
+
+    // Returns true if the symbol was found
+    // Backward shift deletion, the probe sequences stay without tombstones
+    bool RemoveSymbol(std::string_view name) {
+        DASSERT_M(!frozen_, "Frozen symbol table");
+        Slot* slot = FindSlot(name, Hash(name));
+        if (!slot || !slot->symbol) {
+            return false;
+        }
+        const uint32_t mask = capacity_ - 1;
+        uint32_t hole = (uint32_t)(slot - slots_);
+        for (uint32_t i = (hole + 1) & mask; slots_[i].symbol;
+             i = (i + 1) & mask) {
+            // Moved if the hole is between the home slot and the slot
+            const uint32_t home = slots_[i].hash & mask;
+            if (((i - home) & mask) >= ((i - hole) & mask)) {
+                slots_[hole] = slots_[i];
+                hole = i;
+            }
+        }
+        slots_[hole] = Slot{};
+        --size_;
+        return true;
+    }
+
+    size_t GetSize() const { return size_; }
+
+    SymbolTable* GetParent() const { return parent_; }
+
+    SymbolTable* GetLastChild() const { return lastChild_; }
+    SymbolTable* GetPrevSibling() const { return prevSibling_; }
+
+    // Unlinks the children after |child|, all of them if nullptr
+    void TruncateChildren(SymbolTable* child) {
+        DASSERT(!child || child->parent_ == this);
+        lastChild_ = child;
+    }
+
+    // Links an unlinked child back as the last one
+    void AppendChild(SymbolTable* child) {
+        DASSERT(child->parent_ == this && !frozen_);
+        child->prevSibling_ = lastChild_;
+        lastChild_ = child;
+    }
+
+    // Calls func(SymbolTable*) for the child scopes in declaration order
+    template <class Func>
+    void ForEachChild(Func&& func) const {
+        std::vector<SymbolTable*> children;
+        for (auto* child = lastChild_; child; child = child->prevSibling_) {
+            children.push_back(child);
+        }
+        for (auto it = children.rbegin(); it != children.rend(); ++it) {
+            func(*it);
+        }
+    }
+
+    // Calls func(std::string_view, ast::Symbol*) in no particular order
+    template <class Func>
+    void ForEachSymbol(Func&& func) const {
+        for (const Slot& slot : std::span(slots_, capacity_)) {
+            if (slot.symbol) {
+                func(std::string_view(slot.key, slot.size), slot.symbol);
+            }
+        }
     }
 
-    SymbolTable(SymbolTable* parent) : keyAlloc_(512) {
+    // Makes the table read only, e.g. to be shared between threads
+    // Children of a frozen table are not linked into it
+    void Freeze() { frozen_ = true; }
+
+    bool IsFrozen() const { return frozen_; }
+
+    // |alloc| owns the slots and the keys and should outlive the table
+    SymbolTable(SymbolTable* parent, BumpAllocator& alloc) : alloc_(&alloc) {
         parent_ = parent;
-        if (parent) {
+        if (parent && !parent->frozen_) {
             prevSibling_ = parent->lastChild_;
             parent->lastChild_ = this;
         }
     }
 
+private:
+    struct Slot {
+        const char* key = nullptr;
+        uint32_t size = 0;
+        uint32_t hash = 0;
+        // nullptr if empty
+        ast::Symbol* symbol = nullptr;
+    };
+
+    static constexpr uint32_t kMinCapacity = 8;
+
+    static uint32_t Hash(std::string_view name) {
+        return (uint32_t)std::hash<std::string_view>{}(name);
+    }
+
+    // Returns the slot of |name| or the empty slot where it would be
+    // inserted, nullptr if the table has no slots
+    Slot* FindSlot(std::string_view name, uint32_t hash) const {
+        if (!capacity_) {
+            return nullptr;
+        }
+        const uint32_t mask = capacity_ - 1;
+        for (uint32_t i = hash & mask;; i = (i + 1) & mask) {
+            Slot& slot = slots_[i];
+            if (!slot.symbol ||
+                (slot.hash == hash && slot.size == name.size() &&
+                 memcmp(slot.key, name.data(), name.size()) == 0)) {
+                return &slot;
+            }
+        }
+    }
+
+    // The old slots are left in the arena
+    void Grow() {
+        const uint32_t capacity =
+            capacity_ ? capacity_ * 2 : kMinCapacity;
+        auto* slots = static_cast<Slot*>(
+            alloc_->Allocate(capacity * sizeof(Slot), alignof(Slot)));
+        std::uninitialized_default_construct_n(slots, capacity);
+        const uint32_t mask = capacity - 1;
+        for (const Slot& slot : std::span(slots_, capacity_)) {
+            if (!slot.symbol) {
+                continue;
+            }
+            uint32_t i = slot.hash & mask;
+            while (slots[i].symbol) {
+                i = (i + 1) & mask;
+            }
+            slots[i] = slot;
+        }
+        slots_ = slots;
+        capacity_ = capacity;
+    }
+
 private:
     SymbolTable* parent_ = nullptr;
     // forward lists, reversed to declaration order
     SymbolTable* lastChild_ = nullptr;
     SymbolTable* prevSibling_ = nullptr;
     // identifier to declaration
-    std::unordered_map<std::string_view, ast::Symbol*> symbols_;
-    // Owns key strings
-    BumpAllocator keyAlloc_;
+    Slot* slots_ = nullptr;
+    uint32_t capacity_ = 0;
+    uint32_t size_ = 0;
+    BumpAllocator* alloc_ = nullptr;
+    bool frozen_ = false;
 };
 
 // Global scope with top level declarations
@@ -78,6 +223,13 @@ public:
         decls.push_back(symbol);
     }
 
+    // Reverts the last Declare(), used by the incremental reparsing
+    void UndeclareLast(std::string_view name) {
+        DASSERT(!decls.empty());
+        symbolTable->RemoveSymbol(name);
+        decls.pop_back();
+    }
+
     // Declares a builtin symbol not found in source
     void PreDeclare(std::string_view name, Symbol* symbol) {
         DASSERT(!name.empty() && symbol);
@@ -57,7 +57,7 @@ public:
     constexpr static auto kStaticType = NodeType::ReturnStatement;
 
     ReturnStatement(SourceLoc loc, const Expression* expr)
-        : Statement(loc, kStaticType) {}
+        : Statement(loc, kStaticType), expr(expr) {}
 };
 
 class AssignStatement : public Statement {
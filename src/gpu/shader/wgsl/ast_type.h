@@ -140,6 +140,18 @@ public:
     }
 };
 
+// The type both operands are converted to: 1 + 2.0f -> f32
+// nullptr if neither converts to the other
+constexpr const Scalar* GetCommonType(const Scalar* lhs, const Scalar* rhs) {
+    constexpr uint32_t kMax = std::numeric_limits<uint32_t>::max();
+    const auto lr = lhs->GetConversionRankTo(rhs);
+    const auto rl = rhs->GetConversionRankTo(lhs);
+    if (lr == kMax && rl == kMax) {
+        return nullptr;
+    }
+    return rl > lr ? rhs : lhs;
+}
+
 
 // Vector subtypes
 #define VECTOR_KIND_LIST(V) \
@@ -163,6 +175,15 @@ constexpr std::string_view to_string(VecKind kind) {
 #undef CASE
 }
 
+// Number of components: 2, 3 or 4
+constexpr VecKind VecKindFromSize(size_t size) {
+    return (VecKind)(size - 2);
+}
+
+constexpr uint32_t GetSize(VecKind kind) {
+    return (uint32_t)kind + 2;
+}
+
 constexpr std::optional<VecKind> VecKindFromString(std::string_view str) {
 #define IF_ELSE(NAME, STR)    \
     if (str == STR)           \
@@ -192,6 +213,19 @@ enum class VecComponent : uint8_t {
 #undef ENUM
 };
 
+// Index of the component in a vector: y -> 1, b -> 2
+constexpr uint32_t GetComponentIndex(VecComponent component) {
+    switch (component) {
+        case VecComponent::G:
+        case VecComponent::Y: return 1;
+        case VecComponent::B:
+        case VecComponent::Z: return 2;
+        case VecComponent::A:
+        case VecComponent::W: return 3;
+        default: return 0;
+    }
+}
+
 constexpr std::optional<VecComponent> VecComponentFromString(
     std::string_view str) {
 #define V(NAME, STR)               \
@@ -231,30 +265,6 @@ public:
         }
         return true;
     }
-
-    constexpr std::string GetSwizzleTypeName(uint8_t numComponents) const {
-        switch (kind) {
-            case VecKind::Vec4: {
-                if (numComponents == 4) {
-                    return std::string(valueType->name);
-                }
-            }
-            case VecKind::Vec3: {
-                if (numComponents == 3) {
-                    return std::format("vec3<{}>", valueType->name);
-                }
-            }
-            case VecKind::Vec2: {
-                if (numComponents == 2) {
-                    return std::format("vec2<{}>", valueType->name);
-                }
-            }
-            default: {
-                return std::string(valueType->name);
-            }
-        }
-        return "";
-    }
 };
 
 
@@ -311,6 +321,19 @@ constexpr std::optional<MatrixKind> MatrixKindFromString(std::string_view str) {
 #undef IF_ELSE
 }
 
+// matCxR has C columns of vecR
+constexpr uint32_t GetNumColumns(MatrixKind kind) {
+    return 2 + (uint32_t)kind / 3;
+}
+
+constexpr uint32_t GetNumRows(MatrixKind kind) {
+    return 2 + (uint32_t)kind % 3;
+}
+
+constexpr MatrixKind MatrixKindFromSize(uint32_t columns, uint32_t rows) {
+    return (MatrixKind)((columns - 2) * 3 + rows - 2);
+}
+
 
 
 // Builtin matrix: mat2x3<f32>
@@ -322,12 +345,55 @@ public:
 public:
     constexpr static auto kStaticType = NodeType::Matrix;
 
-    Matrix(MatrixKind kind, const Type* valueType)
-        : Type({}, kStaticType, to_string(kind))
+    Matrix(MatrixKind kind, const Type* valueType, std::string_view name)
+        : Type({}, kStaticType, name)
         , kind(kind)
         , valueType(valueType) {}
 };
 
+// Components of a scalar, vector or matrix, nullptr for other types
+inline const Scalar* GetScalarType(const Type* type) {
+    if (const auto* scalar = type->As<Scalar>()) {
+        return scalar;
+    }
+    if (const auto* vec = type->As<Vec>()) {
+        return vec->valueType;
+    }
+    if (const auto* matrix = type->As<Matrix>()) {
+        return matrix->valueType->As<Scalar>();
+    }
+    return nullptr;
+}
+
+// Both are scalars, or vectors or matrices of the same size
+inline bool IsSameShape(const Type* lhs, const Type* rhs) {
+    if (lhs->Is<Scalar>() || rhs->Is<Scalar>()) {
+        return lhs->Is<Scalar>() && rhs->Is<Scalar>();
+    }
+    const auto* lhsVec = lhs->As<Vec>();
+    const auto* rhsVec = rhs->As<Vec>();
+    if (lhsVec || rhsVec) {
+        return lhsVec && rhsVec && lhsVec->kind == rhsVec->kind;
+    }
+    const auto* lhsMatrix = lhs->As<Matrix>();
+    const auto* rhsMatrix = rhs->As<Matrix>();
+    return lhsMatrix && rhsMatrix && lhsMatrix->kind == rhsMatrix->kind;
+}
+
+// 1 for a scalar, 0 for the types without components
+inline uint32_t GetNumComponents(const Type* type) {
+    if (type->Is<Scalar>()) {
+        return 1;
+    }
+    if (const auto* vec = type->As<Vec>()) {
+        return GetSize(vec->kind);
+    }
+    if (const auto* matrix = type->As<Matrix>()) {
+        return GetNumColumns(matrix->kind) * GetNumRows(matrix->kind);
+    }
+    return 0;
+}
+
 
 
 // Texture subtypes
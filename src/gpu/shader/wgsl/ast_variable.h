@@ -3,6 +3,10 @@
 #include "ast_type.h"
 #include "program_alloc.h"
 
+namespace wgsl {
+class ConstValue;
+}
+
 namespace wgsl::ast {
 
 class Attribute;
@@ -62,11 +66,16 @@ class ConstVariable final : public Variable {
 public:
     constexpr static inline auto kStaticType = NodeType::ConstVariable;
 
+    // The initializer converted to the type
+    const ConstValue* value;
+
     ConstVariable(SourceLoc loc,
                   std::string_view ident,
                   const Type* type,
-                  const Expression* initializer)
-        : Variable(loc, kStaticType, ident, type, {}, initializer) {}
+                  const Expression* initializer,
+                  const ConstValue* value)
+        : Variable(loc, kStaticType, ident, type, {}, initializer)
+        , value(value) {}
 };
 
 // 'override'
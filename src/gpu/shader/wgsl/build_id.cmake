@@ -0,0 +1,21 @@
+# Writes OUTPUT with WGSL_BUILD_ID, a hash of COMPILER and of the SOURCES
+# separated by '|'
+# Run with cmake -P when any of the sources changes
+string(REPLACE "|" ";" SOURCES "${SOURCES}")
+list(SORT SOURCES)
+set(content "${COMPILER}\n")
+foreach(source IN LISTS SOURCES)
+    file(SHA256 "${source}" hash)
+    cmake_path(GET source FILENAME name)
+    string(APPEND content "${name} ${hash}\n")
+endforeach()
+string(SHA256 buildID "${content}")
+
+file(WRITE "${OUTPUT}.tmp"
+    "// Generated by build_id.cmake\n"
+    "#pragma once\n"
+    "#define WGSL_BUILD_ID \"${buildID}\"\n"
+)
+# Keeps the timestamp if nothing changed
+file(COPY_FILE "${OUTPUT}.tmp" "${OUTPUT}" ONLY_IF_DIFFERENT)
+file(REMOVE "${OUTPUT}.tmp")
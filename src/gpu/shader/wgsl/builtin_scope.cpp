@@ -0,0 +1,370 @@
+#include "builtin_scope.h"
+#include "ast_alias.h"
+#include "ast_scope.h"
+
+#include "base/mem_tracker.h"
+
+#include <algorithm>
+#include <array>
+
+namespace wgsl {
+
+using namespace ast;
+
+namespace {
+
+enum class OverloadShape : uint8_t { Scalar, Vec, Matrix };
+
+// Sizes of the vectors and matrices in the tables: 2, 3, 4 or a size bound
+// by the args of a call, N of vecN<f32> and C and R of matCxR<f32>
+enum OverloadSize : uint8_t { kSizeN = 5, kSizeC, kSizeR };
+
+// A param or a return type of an overload: vecN<f32>
+struct OverloadType {
+    OverloadShape shape;
+    ScalarKind scalar;
+    // Size of a vector, columns of a matrix
+    uint8_t columns;
+    uint8_t rows;
+};
+
+struct Overload {
+    // Index in kOverloadParams
+    uint16_t firstParam;
+    uint8_t numParams;
+    bool isConst;
+    OverloadType ret;
+};
+
+// Overloads of a function in kOverloads
+struct OverloadRange {
+    uint16_t first;
+    uint16_t count;
+};
+
+constexpr uint8_t kNoConversion = 0xFF;
+
+#include "builtin_overloads.inl"
+
+// Values of N, C and R, 0 if not bound yet
+using BoundSizes = std::array<uint8_t, 3>;
+using ArgRanks = std::array<uint8_t, kMaxOverloadParams>;
+
+bool BindSize(uint8_t size, uint32_t argSize, BoundSizes& sizes) {
+    if (size < kSizeN) {
+        return size == argSize;
+    }
+    uint8_t& bound = sizes[size - kSizeN];
+    if (bound == 0) {
+        bound = (uint8_t)argSize;
+    }
+    return bound == argSize;
+}
+
+// Conversion rank of the arg to the param, kNoConversion if the arg cannot
+// be converted
+uint8_t GetConversionRank(const OverloadType& param,
+                          const Type* arg,
+                          BoundSizes& sizes) {
+    bool isSameShape = false;
+    switch (param.shape) {
+        case OverloadShape::Scalar: isSameShape = arg->Is<Scalar>(); break;
+        case OverloadShape::Vec: {
+            const auto* vec = arg->As<Vec>();
+            isSameShape = vec && BindSize(param.columns, GetSize(vec->kind),
+                                          sizes);
+            break;
+        }
+        case OverloadShape::Matrix: {
+            const auto* matrix = arg->As<Matrix>();
+            isSameShape =
+                matrix &&
+                BindSize(param.columns, GetNumColumns(matrix->kind), sizes) &&
+                BindSize(param.rows, GetNumRows(matrix->kind), sizes);
+            break;
+        }
+    }
+    if (!isSameShape) {
+        return kNoConversion;
+    }
+    const Scalar* scalar = GetScalarType(arg);
+    return kConversionRank[(size_t)scalar->kind][(size_t)param.scalar];
+}
+
+// False if the args don't match the overload
+bool MatchOverload(const Overload& overload,
+                   std::span<const Type* const> argTypes,
+                   bool isConst,
+                   ArgRanks& ranks,
+                   BoundSizes& sizes) {
+    if (overload.numParams != argTypes.size()) {
+        return false;
+    }
+    sizes = {};
+    for (size_t i = 0; i < argTypes.size(); ++i) {
+        const OverloadType& param = kOverloadParams[overload.firstParam + i];
+        const bool isAbstract = param.scalar == ScalarKind::Int ||
+                                param.scalar == ScalarKind::Float;
+        if (isAbstract && !isConst) {
+            return false;
+        }
+        ranks[i] = GetConversionRank(param, argTypes[i], sizes);
+        if (ranks[i] == kNoConversion) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// No arg of |lhs| converts with a higher rank than of |rhs|, at least one
+// with a lower rank
+bool IsBetter(const ArgRanks& lhs, const ArgRanks& rhs, size_t numArgs) {
+    bool isLower = false;
+    for (size_t i = 0; i < numArgs; ++i) {
+        if (lhs[i] > rhs[i]) {
+            return false;
+        }
+        isLower = isLower || lhs[i] < rhs[i];
+    }
+    return isLower;
+}
+
+static_assert(kMaxOverloadParams <= BuiltinScope::kMaxArgs);
+
+}  // namespace
+
+const BuiltinScope& BuiltinScope::Get() {
+    // Never destroyed, programs could outlive the static destructors
+    static const BuiltinScope* scope = [] {
+        MEM_TAG(Shaders);
+        return new BuiltinScope();
+    }();
+    return *scope;
+}
+
+BuiltinScope::BuiltinScope() : alloc_(4096) {
+    symbols_ = alloc_.Allocate<SymbolTable>(nullptr, alloc_);
+    DeclareScalars();
+    DeclareVectors();
+    DeclareMatrices();
+    DeclareFunctions();
+    symbols_->Freeze();
+}
+
+const Scalar* BuiltinScope::GetScalar(ScalarKind kind) const {
+    return scalars_[(size_t)kind];
+}
+
+const Vec* BuiltinScope::GetVec(VecKind kind, ScalarKind valueType) const {
+    return vectors_[(size_t)kind][(size_t)valueType];
+}
+
+const Matrix* BuiltinScope::GetMatrix(MatrixKind kind,
+                                      ScalarKind valueType) const {
+    return matrices_[(size_t)kind][(size_t)valueType];
+}
+
+const Type* BuiltinScope::GetWithComponents(const Type* type,
+                                            ScalarKind valueType) const {
+    if (type->Is<Scalar>()) {
+        return GetScalar(valueType);
+    }
+    if (const auto* vec = type->As<Vec>()) {
+        return GetVec(vec->kind, valueType);
+    }
+    if (const auto* matrix = type->As<Matrix>()) {
+        return GetMatrix(matrix->kind, valueType);
+    }
+    return nullptr;
+}
+
+const BuiltinFunction* BuiltinScope::FindFunction(std::string_view name) const {
+    const auto it = std::ranges::lower_bound(functionsByName_, name, {},
+                                             &BuiltinFunction::name);
+    return it != functionsByName_.end() && (*it)->name == name ? *it : nullptr;
+}
+
+const BuiltinFunction* BuiltinScope::GetFunction(BuiltinFn fn) const {
+    return (size_t)fn < kNumFunctions ? functions_[(size_t)fn] : nullptr;
+}
+
+Expected<BuiltinScope::ResolvedCall> BuiltinScope::ResolveCall(
+    BuiltinFn fn,
+    std::span<const Type* const> argTypes,
+    bool isConst) const {
+    static_assert(std::size(kOverloadsByFn) == kNumFunctions);
+    if ((size_t)fn >= kNumFunctions) {
+        return std::unexpected(ErrorCode::Unimplemented);
+    }
+    const OverloadRange range = kOverloadsByFn[(size_t)fn];
+    if (range.count == 0) {
+        return std::unexpected(ErrorCode::Unimplemented);
+    }
+    if (argTypes.size() > kMaxArgs) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    const std::span overloads(&kOverloads[range.first], range.count);
+    const Overload* best = nullptr;
+    ArgRanks bestRanks{};
+    BoundSizes bestSizes{};
+    ArgRanks ranks{};
+    BoundSizes sizes{};
+    for (const Overload& overload : overloads) {
+        if (MatchOverload(overload, argTypes, isConst, ranks, sizes) &&
+            (!best || IsBetter(ranks, bestRanks, argTypes.size()))) {
+            best = &overload;
+            bestRanks = ranks;
+            bestSizes = sizes;
+        }
+    }
+    if (!best) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    // The best is better than every other match
+    for (const Overload& overload : overloads) {
+        if (&overload != best &&
+            MatchOverload(overload, argTypes, isConst, ranks, sizes) &&
+            !IsBetter(bestRanks, ranks, argTypes.size())) {
+            return std::unexpected(ErrorCode::AmbiguousCall);
+        }
+    }
+    // The sizes of the return type are bound by the params, the overload
+    // tables are checked when they are generated
+    const auto getSize = [&](uint8_t size) -> uint32_t {
+        DASSERT(size < kSizeN || bestSizes[size - kSizeN]);
+        return size < kSizeN ? size : bestSizes[size - kSizeN];
+    };
+    const auto getType = [&](const OverloadType& type) -> const Type* {
+        switch (type.shape) {
+            case OverloadShape::Scalar: return GetScalar(type.scalar);
+            case OverloadShape::Vec:
+                return GetVec(VecKindFromSize(getSize(type.columns)),
+                              type.scalar);
+            case OverloadShape::Matrix:
+                return GetMatrix(MatrixKindFromSize(getSize(type.columns),
+                                                    getSize(type.rows)),
+                                 type.scalar);
+        }
+        return nullptr;
+    };
+    ResolvedCall out{getType(best->ret), {}, best->isConst};
+    // Not predeclared: vec2<bool>
+    if (!out.returnType) {
+        return std::unexpected(ErrorCode::Unimplemented);
+    }
+    for (size_t i = 0; i < argTypes.size(); ++i) {
+        out.paramTypes[i] = getType(kOverloadParams[best->firstParam + i]);
+        if (!out.paramTypes[i]) {
+            return std::unexpected(ErrorCode::Unimplemented);
+        }
+    }
+    return out;
+}
+
+void BuiltinScope::Declare(std::string_view name,
+                           Type* type,
+                           std::string_view alias) {
+    symbols_->InsertSymbol(name, type);
+    types_.push_back(type);
+    if (!alias.empty()) {
+        auto* aliasType = alloc_.Allocate<Alias>(SourceLoc(), alias, type);
+        symbols_->InsertSymbol(alias, aliasType);
+        types_.push_back(aliasType);
+    }
+}
+
+void BuiltinScope::DeclareScalars() {
+    for (ScalarKind kind : {ScalarKind::Bool, ScalarKind::Float,
+                            ScalarKind::Int, ScalarKind::U32, ScalarKind::I32,
+                            ScalarKind::F32}) {
+        auto* type = alloc_.Allocate<Scalar>(kind);
+        Declare(to_string(kind), type);
+        scalars_[(size_t)kind] = type;
+    }
+}
+
+void BuiltinScope::DeclareVectors() {
+    // Type names view the literals
+    struct VecDecl {
+        VecKind kind;
+        ScalarKind valueType;
+        std::string_view name;
+        std::string_view alias;
+    };
+    constexpr VecDecl kVectors[] = {
+        {VecKind::Vec2, ScalarKind::F32, "vec2<f32>", "vec2f"},
+        {VecKind::Vec2, ScalarKind::I32, "vec2<i32>", "vec2i"},
+        {VecKind::Vec2, ScalarKind::U32, "vec2<u32>", "vec2u"},
+        {VecKind::Vec3, ScalarKind::F32, "vec3<f32>", "vec3f"},
+        {VecKind::Vec3, ScalarKind::I32, "vec3<i32>", "vec3i"},
+        {VecKind::Vec3, ScalarKind::U32, "vec3<u32>", "vec3u"},
+        {VecKind::Vec4, ScalarKind::F32, "vec4<f32>", "vec4f"},
+        {VecKind::Vec4, ScalarKind::I32, "vec4<i32>", "vec4i"},
+        {VecKind::Vec4, ScalarKind::U32, "vec4<u32>", "vec4u"},
+    };
+    for (const VecDecl& decl : kVectors) {
+        auto* type = alloc_.Allocate<Vec>(
+            decl.kind, GetScalar(decl.valueType), decl.name);
+        Declare(decl.name, type, decl.alias);
+        vectors_[(size_t)decl.kind][(size_t)decl.valueType] = type;
+    }
+    constexpr VecDecl kAbstractVectors[] = {
+        {VecKind::Vec2, ScalarKind::Int, "vec2<int>"},
+        {VecKind::Vec2, ScalarKind::Float, "vec2<float>"},
+        {VecKind::Vec3, ScalarKind::Int, "vec3<int>"},
+        {VecKind::Vec3, ScalarKind::Float, "vec3<float>"},
+        {VecKind::Vec4, ScalarKind::Int, "vec4<int>"},
+        {VecKind::Vec4, ScalarKind::Float, "vec4<float>"},
+    };
+    for (const VecDecl& decl : kAbstractVectors) {
+        auto* type = alloc_.Allocate<Vec>(
+            decl.kind, GetScalar(decl.valueType), decl.name);
+        types_.push_back(type);
+        vectors_[(size_t)decl.kind][(size_t)decl.valueType] = type;
+    }
+}
+
+void BuiltinScope::DeclareMatrices() {
+    struct MatrixDecl {
+        MatrixKind kind;
+        std::string_view name;
+        std::string_view alias;
+        // Of the AbstractFloat matrix
+        std::string_view abstractName;
+    };
+    constexpr MatrixDecl kMatrices[] = {
+        {MatrixKind::Mat2x2, "mat2x2<f32>", "mat2x2f", "mat2x2<float>"},
+        {MatrixKind::Mat2x3, "mat2x3<f32>", "mat2x3f", "mat2x3<float>"},
+        {MatrixKind::Mat2x4, "mat2x4<f32>", "mat2x4f", "mat2x4<float>"},
+        {MatrixKind::Mat3x2, "mat3x2<f32>", "mat3x2f", "mat3x2<float>"},
+        {MatrixKind::Mat3x3, "mat3x3<f32>", "mat3x3f", "mat3x3<float>"},
+        {MatrixKind::Mat3x4, "mat3x4<f32>", "mat3x4f", "mat3x4<float>"},
+        {MatrixKind::Mat4x2, "mat4x2<f32>", "mat4x2f", "mat4x2<float>"},
+        {MatrixKind::Mat4x3, "mat4x3<f32>", "mat4x3f", "mat4x3<float>"},
+        {MatrixKind::Mat4x4, "mat4x4<f32>", "mat4x4f", "mat4x4<float>"},
+    };
+    for (const MatrixDecl& decl : kMatrices) {
+        auto* type = alloc_.Allocate<Matrix>(
+            decl.kind, GetScalar(ScalarKind::F32), decl.name);
+        Declare(decl.name, type, decl.alias);
+        matrices_[(size_t)decl.kind][(size_t)ScalarKind::F32] = type;
+    }
+    for (const MatrixDecl& decl : kMatrices) {
+        auto* type = alloc_.Allocate<Matrix>(
+            decl.kind, GetScalar(ScalarKind::Float), decl.abstractName);
+        types_.push_back(type);
+        matrices_[(size_t)decl.kind][(size_t)ScalarKind::Float] = type;
+    }
+}
+
+void BuiltinScope::DeclareFunctions() {
+#define DECLARE(NAME)                                                     \
+    functions_[(size_t)BuiltinFn::__##NAME] =                             \
+        alloc_.Allocate<BuiltinFunction>(#NAME, BuiltinFn::__##NAME);
+    BUILTIN_FUNC_LIST(DECLARE)
+#undef DECLARE
+    functionsByName_.assign(std::begin(functions_), std::end(functions_));
+    std::ranges::sort(functionsByName_, {}, &BuiltinFunction::name);
+}
+
+}  // namespace wgsl
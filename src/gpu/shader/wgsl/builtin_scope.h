@@ -0,0 +1,112 @@
+#pragma once
+#include "base/bump_alloc.h"
+
+#include "ast_function.h"
+#include "ast_type.h"
+
+#include <array>
+#include <span>
+#include <vector>
+
+namespace wgsl {
+
+namespace ast {
+class SymbolTable;
+}
+
+// Predeclared types shared by all programs: scalars, vectors, matrices and
+// their aliases, and the builtin functions
+// Built once on the first use and frozen after, so any thread can read it.
+// The global symbol table of each program has it as the parent, user
+// scopes see the builtins without copying them.
+class BuiltinScope {
+public:
+    static const BuiltinScope& Get();
+
+    ast::SymbolTable* GetSymbolTable() const { return symbols_; }
+
+    // All declared nodes in declaration order, which is stable within a
+    // build. Serialized programs refer to the builtins by the index
+    std::span<ast::Type* const> GetTypes() const { return types_; }
+
+    // Return nullptr if the type is not predeclared, e.g. f16 or vec2<bool>
+    // Vectors and matrices of the abstract types have no names in the
+    // symbol table, they are the types of const-expressions: vec2(1, 2)
+    const ast::Scalar* GetScalar(ast::ScalarKind kind) const;
+    const ast::Vec* GetVec(ast::VecKind kind, ast::ScalarKind valueType) const;
+    const ast::Matrix* GetMatrix(ast::MatrixKind kind,
+                                 ast::ScalarKind valueType) const;
+    // A scalar, vector or matrix of the shape of |type| with |valueType|
+    // components: vec3<i32>, f32 -> vec3<f32>
+    const ast::Type* GetWithComponents(const ast::Type* type,
+                                       ast::ScalarKind valueType) const;
+
+    // Builtin functions are found after the symbols of the program, so the
+    // names may be declared by the user: 'const length = 1;'
+    const ast::BuiltinFunction* FindFunction(std::string_view name) const;
+    const ast::BuiltinFunction* GetFunction(ast::BuiltinFn fn) const;
+
+    // Most args of the builtin functions in the overload tables
+    static constexpr size_t kMaxArgs = 4;
+
+    // The overload of a call of a builtin function
+    struct ResolvedCall {
+        const ast::Type* returnType;
+        // The types the args are converted to, one per arg
+        std::array<const ast::Type*, kMaxArgs> paramTypes;
+        // The function has a const evaluation
+        bool isConst;
+    };
+
+    // The overload of |fn| the args are converted to with the lowest
+    // conversion ranks: max(1, 2.0f) -> max(f32, f32) -> f32
+    // https://www.w3.org/TR/WGSL/#overload-resolution-section
+    // The overloads with abstract params are only for the const args.
+    // The overloads are generated from builtin_functions.txt, the calls are
+    // resolved without allocations.
+    // Errors: Unimplemented if the function has no overloads, InvalidArg if
+    // no overload matches, AmbiguousCall if none is better than the others
+    Expected<ResolvedCall> ResolveCall(
+        ast::BuiltinFn fn,
+        std::span<const ast::Type* const> argTypes,
+        bool isConst) const;
+
+private:
+    BuiltinScope();
+
+    void DeclareScalars();
+    void DeclareVectors();
+    void DeclareMatrices();
+    void DeclareFunctions();
+
+    // Also declares the |alias| of |type| if not empty
+    void Declare(std::string_view name,
+                 ast::Type* type,
+                 std::string_view alias = "");
+
+private:
+#define COUNT(NAME, STR) +1
+    static constexpr size_t kNumScalarKinds = 0 SCALAR_KIND_LIST(COUNT);
+    static constexpr size_t kNumVecKinds = 0 VECTOR_KIND_LIST(COUNT);
+    static constexpr size_t kNumMatrixKinds = 0 MATRIX_KIND_LIST(COUNT);
+#undef COUNT
+#define COUNT(NAME) +1
+    static constexpr size_t kNumFunctions = 0 BUILTIN_FUNC_LIST(COUNT);
+#undef COUNT
+
+    // Owns the nodes and the table
+    BumpAllocator alloc_;
+    ast::SymbolTable* symbols_ = nullptr;
+    // Indexed by the kinds
+    const ast::Scalar* scalars_[kNumScalarKinds] = {};
+    const ast::Vec* vectors_[kNumVecKinds][kNumScalarKinds] = {};
+    // Only f32 and abstract float matrices
+    const ast::Matrix* matrices_[kNumMatrixKinds][kNumScalarKinds] = {};
+    std::vector<ast::Type*> types_;
+    // Indexed by BuiltinFn
+    const ast::BuiltinFunction* functions_[kNumFunctions] = {};
+    // Sorted by the name
+    std::vector<const ast::BuiltinFunction*> functionsByName_;
+};
+
+}  // namespace wgsl
@@ -42,8 +42,12 @@ namespace wgsl {
       "a variable with this address space may not be declared in the current " \
       "scope")                                                                 \
     V(InvalidArg, "no operator matches the arguments")                         \
+    V(AmbiguousCall, "more than one overload matches the arguments")           \
     V(ConstOverflow,                                                           \
-      "this operation cannot result in a constant value. numeric overflow")
+      "this operation cannot result in a constant value. numeric overflow")    \
+    V(ConstDivByZero, "division by zero in a const-expression")                \
+    V(ConstIndexOutOfBounds, "index out of bounds")                            \
+    V(NotConstExpr, "expected a const-expression")
 
 // Define enum
 #define ENUM(Name, Str) Name,
@@ -0,0 +1,32 @@
+#include "compile_batch.h"
+#include "builtin_scope.h"
+
+#include "base/trace.h"
+#include "task/task_executor.h"
+
+namespace wgsl {
+
+std::vector<std::unique_ptr<Program>> CompileBatch(
+    ThreadPool& pool,
+    std::span<const std::string_view> sources) {
+    TRACE_SCOPE("wgsl::CompileBatch");
+    DASSERT_F(TaskExecutor::GetForCurrentThread() == nullptr,
+              "CompileBatch() would wait for its own thread");
+    std::vector<std::unique_ptr<Program>> programs(sources.size());
+    if (sources.empty()) {
+        return programs;
+    }
+    // Built here rather than by the first worker while the others wait
+    BuiltinScope::Get();
+    // Each slot is written by a single task
+    auto generator = std::make_shared<TaskGenerator>(
+        sources.size(), pool.GetThreadNum(), [&](size_t index) {
+            programs[index] = Program::Create(sources[index]);
+        });
+    pool.RegisterTaskSource(generator);
+    generator->Wait();
+    pool.UnregisterTaskSource(generator.get());
+    return programs;
+}
+
+}  // namespace wgsl
@@ -0,0 +1,20 @@
+#pragma once
+#include "program.h"
+
+#include <span>
+
+class ThreadPool;
+
+namespace wgsl {
+
+// Creates the programs of |sources| in parallel on the threads of |pool|
+// Each program is built by a single worker into its own arena, the frozen
+// builtins are shared by all of them. The result is in the order of the
+// sources and the same as of Program::Create() for each one.
+// Blocks until all programs are built, so can't be called by a worker of
+// the pool
+std::vector<std::unique_ptr<Program>> CompileBatch(
+    ThreadPool& pool,
+    std::span<const std::string_view> sources);
+
+}  // namespace wgsl
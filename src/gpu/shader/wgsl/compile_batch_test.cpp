@@ -0,0 +1,68 @@
+#include "compile_batch.h"
+#include "program.h"
+
+#include "task/task_executor.h"
+
+#include <doctest/doctest.h>
+
+#include <format>
+
+using namespace wgsl;
+
+namespace {
+
+// Valid and invalid shaders, each with its own symbols
+std::vector<std::string> MakeSources(size_t count) {
+    std::vector<std::string> sources;
+    for (size_t i = 0; i < count; ++i) {
+        if (i % 5 == 3) {
+            sources.push_back(std::format("struct S{} {{ a : vec2<bool>, }};",
+                                          i));
+            continue;
+        }
+        sources.push_back(std::format(R"(
+            struct Light{0} {{
+                color : vec3f,
+                intensity : f32,
+            }};
+            const scale{0} = {0}.0;
+            fn shade{0}(normal : vec3f, dir : vec3f) -> f32 {{
+                return scale{0};
+            }}
+        )", i));
+    }
+    return sources;
+}
+
+}  // namespace
+
+TEST_CASE("[WGSL] compile batch") {
+    ThreadPool pool(4);
+    pool.Start();
+    pool.WaitUntilStarted();
+
+    const std::vector<std::string> sources = MakeSources(64);
+    const std::vector<std::string_view> views(sources.begin(), sources.end());
+
+    for (int pass = 0; pass < 2; ++pass) {
+        auto programs = CompileBatch(pool, views);
+        REQUIRE_EQ(programs.size(), views.size());
+        for (size_t i = 0; i < views.size(); ++i) {
+            REQUIRE(programs[i]);
+            // Deterministic order and the same result as a sequential build
+            CHECK_EQ(programs[i]->GetSource(), views[i]);
+            const auto expected = Program::Create(views[i]);
+            CHECK_EQ(programs[i]->GetDiagsAsString(),
+                     expected->GetDiagsAsString());
+            if (i % 5 == 3) {
+                CHECK(!programs[i]->GetDiags().empty());
+            } else {
+                CHECK(programs[i]->GetDiags().empty());
+                CHECK(programs[i]->FindSymbol(std::format("Light{}", i)));
+                CHECK(programs[i]->FindSymbol(std::format("shade{}", i)));
+            }
+        }
+    }
+    CHECK(CompileBatch(pool, {}).empty());
+    pool.Stop();
+}
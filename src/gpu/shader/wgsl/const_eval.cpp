@@ -0,0 +1,920 @@
+#include "const_eval.h"
+#include "builtin_scope.h"
+
+#include <bit>
+#include <cmath>
+#include <limits>
+#include <numbers>
+
+namespace wgsl {
+
+using namespace ast;
+
+namespace {
+
+// Scalars, vectors and matrices have at most 16 components
+constexpr size_t kMaxComponents = 16;
+using Components = std::array<ConstScalar, kMaxComponents>;
+
+// Checks a result of |type|, f32 is rounded to single precision
+ErrorCode CheckRange(ConstScalar& value, const Scalar* type) {
+    switch (type->kind) {
+        case ScalarKind::I32: {
+            if (value.i < std::numeric_limits<int32_t>::min() ||
+                value.i > std::numeric_limits<int32_t>::max()) {
+                return ErrorCode::ConstOverflow;
+            }
+            break;
+        }
+        case ScalarKind::U32: {
+            if (value.i < 0 || value.i > std::numeric_limits<uint32_t>::max()) {
+                return ErrorCode::ConstOverflow;
+            }
+            break;
+        }
+        case ScalarKind::F32: {
+            if (!std::isfinite(value.f) ||
+                std::abs(value.f) > std::numeric_limits<float>::max()) {
+                return ErrorCode::ConstOverflow;
+            }
+            value.f = (double)(float)value.f;
+            break;
+        }
+        case ScalarKind::Float: {
+            if (!std::isfinite(value.f)) {
+                return ErrorCode::ConstOverflow;
+            }
+            break;
+        }
+        default: break;
+    }
+    return ErrorCode::Ok;
+}
+
+Expected<ConstScalar> ConvertScalar(ConstScalar value,
+                                    const Scalar* from,
+                                    const Scalar* to) {
+    ConstScalar out{};
+    if (from->IsFloat()) {
+        if (to->IsFloat()) {
+            out.f = value.f;
+        } else if (to->IsBool()) {
+            out.i = value.f != 0.0;
+        } else {
+            // Truncated and clamped to the range of the integer
+            if (std::isnan(value.f)) {
+                return std::unexpected(ErrorCode::ConstOverflow);
+            }
+            double lo = -0x1p63;
+            double hi = 0x1p63 - 1024.0;
+            if (to->kind == ScalarKind::I32) {
+                lo = std::numeric_limits<int32_t>::min();
+                hi = std::numeric_limits<int32_t>::max();
+            } else if (to->kind == ScalarKind::U32) {
+                lo = 0.0;
+                hi = std::numeric_limits<uint32_t>::max();
+            }
+            out.i = (int64_t)std::clamp(std::trunc(value.f), lo, hi);
+        }
+    } else if (to->IsFloat()) {
+        out.f = (double)value.i;
+    } else if (to->IsBool()) {
+        out.i = value.i != 0;
+    } else {
+        out.i = value.i;
+    }
+    if (const ErrorCode code = CheckRange(out, to); code != ErrorCode::Ok) {
+        return std::unexpected(code);
+    }
+    return out;
+}
+
+ErrorCode ConvertComponents(const ConstValue* value,
+                            const Scalar* to,
+                            Components& out) {
+    const Scalar* from = GetScalarType(value->type);
+    DASSERT(from && value->scalars.size() <= kMaxComponents);
+    for (size_t i = 0; i < value->scalars.size(); ++i) {
+        auto res = ConvertScalar(value->scalars[i], from, to);
+        if (!res) {
+            return res.error();
+        }
+        out[i] = *res;
+    }
+    return ErrorCode::Ok;
+}
+
+bool IsComparison(OpCode op) {
+    return IsOpLogical(op) && op != OpCode::LogAnd && op != OpCode::LogOr &&
+           op != OpCode::LogNot;
+}
+
+template <class T>
+bool Compare(OpCode op, T lhs, T rhs) {
+    switch (op) {
+        case OpCode::Less: return lhs < rhs;
+        case OpCode::Greater: return lhs > rhs;
+        case OpCode::LessEqual: return lhs <= rhs;
+        case OpCode::GreaterEqual: return lhs >= rhs;
+        case OpCode::Equal: return lhs == rhs;
+        case OpCode::NotEqual: return lhs != rhs;
+        default: return false;
+    }
+}
+
+// Checked 64-bit arithmetic, returns false on overflow
+constexpr int64_t kInt64Min = std::numeric_limits<int64_t>::min();
+constexpr int64_t kInt64Max = std::numeric_limits<int64_t>::max();
+
+bool CheckedAdd(int64_t a, int64_t b, int64_t& out) {
+    if (b > 0 ? a > kInt64Max - b : a < kInt64Min - b) {
+        return false;
+    }
+    out = a + b;
+    return true;
+}
+
+bool CheckedSub(int64_t a, int64_t b, int64_t& out) {
+    if (b < 0 ? a > kInt64Max + b : a < kInt64Min + b) {
+        return false;
+    }
+    out = a - b;
+    return true;
+}
+
+bool CheckedMul(int64_t a, int64_t b, int64_t& out) {
+    if (a > 0) {
+        if (b > 0 ? a > kInt64Max / b : b < kInt64Min / a) {
+            return false;
+        }
+    } else if (a < 0) {
+        if (b > 0 ? a < kInt64Min / b : b < kInt64Max / a) {
+            return false;
+        }
+    }
+    out = a * b;
+    return true;
+}
+
+Expected<ConstScalar> EvalScalar(OpCode op,
+                                 const Scalar* type,
+                                 ConstScalar lhs,
+                                 ConstScalar rhs) {
+    ConstScalar out{};
+    if (IsComparison(op)) {
+        out.i = type->IsFloat() ? Compare(op, lhs.f, rhs.f)
+                                : Compare(op, lhs.i, rhs.i);
+        return out;
+    }
+    if (type->IsBool()) {
+        switch (op) {
+            case OpCode::LogAnd: out.i = lhs.i && rhs.i; break;
+            case OpCode::LogOr: out.i = lhs.i || rhs.i; break;
+            default: return std::unexpected(ErrorCode::InvalidArg);
+        }
+        return out;
+    }
+    if (type->IsFloat()) {
+        switch (op) {
+            case OpCode::Add: out.f = lhs.f + rhs.f; break;
+            case OpCode::Sub: out.f = lhs.f - rhs.f; break;
+            case OpCode::Mul: out.f = lhs.f * rhs.f; break;
+            case OpCode::Div: out.f = lhs.f / rhs.f; break;
+            case OpCode::Mod: out.f = std::fmod(lhs.f, rhs.f); break;
+            default: return std::unexpected(ErrorCode::InvalidArg);
+        }
+    } else {
+        const int64_t a = lhs.i;
+        const int64_t b = rhs.i;
+        const int64_t numBits = type->kind == ScalarKind::Int ? 64 : 32;
+        bool overflow = false;
+        switch (op) {
+            case OpCode::Add: overflow = !CheckedAdd(a, b, out.i); break;
+            case OpCode::Sub: overflow = !CheckedSub(a, b, out.i); break;
+            case OpCode::Mul: overflow = !CheckedMul(a, b, out.i); break;
+            case OpCode::Div:
+            case OpCode::Mod: {
+                if (b == 0) {
+                    return std::unexpected(ErrorCode::ConstDivByZero);
+                }
+                overflow = a == std::numeric_limits<int64_t>::min() && b == -1;
+                if (!overflow) {
+                    out.i = op == OpCode::Div ? a / b : a % b;
+                }
+                break;
+            }
+            case OpCode::BitAnd: out.i = a & b; break;
+            case OpCode::BitOr: out.i = a | b; break;
+            case OpCode::BitXor: out.i = a ^ b; break;
+            case OpCode::BitLsh: {
+                // The bits shifted out must be zero
+                overflow = b < 0 || b >= numBits || (b == 63 && a != 0) ||
+                           (b < 63 && !CheckedMul(a, int64_t(1) << b, out.i));
+                break;
+            }
+            case OpCode::BitRsh: {
+                overflow = b < 0 || b >= numBits;
+                if (!overflow) {
+                    out.i = a >> b;
+                }
+                break;
+            }
+            default: return std::unexpected(ErrorCode::InvalidArg);
+        }
+        if (overflow) {
+            return std::unexpected(ErrorCode::ConstOverflow);
+        }
+    }
+    if (const ErrorCode code = CheckRange(out, type); code != ErrorCode::Ok) {
+        return std::unexpected(code);
+    }
+    return out;
+}
+
+// Builtins evaluated per component, a scalar arg is broadcast
+constexpr bool IsComponentWise(BuiltinFn fn) {
+    using enum BuiltinFn;
+    switch (fn) {
+        case __abs:
+        case __acos:
+        case __acosh:
+        case __asin:
+        case __asinh:
+        case __atan:
+        case __atan2:
+        case __atanh:
+        case __ceil:
+        case __clamp:
+        case __cos:
+        case __cosh:
+        case __countLeadingZeros:
+        case __countOneBits:
+        case __countTrailingZeros:
+        case __degrees:
+        case __exp:
+        case __exp2:
+        case __firstLeadingBit:
+        case __firstTrailingBit:
+        case __floor:
+        case __fma:
+        case __fract:
+        case __inverseSqrt:
+        case __log:
+        case __log2:
+        case __max:
+        case __min:
+        case __mix:
+        case __pow:
+        case __radians:
+        case __reverseBits:
+        case __round:
+        case __saturate:
+        case __sign:
+        case __sin:
+        case __sinh:
+        case __smoothstep:
+        case __sqrt:
+        case __step:
+        case __tan:
+        case __tanh:
+        case __trunc: return true;
+        default: return false;
+    }
+}
+
+double EvalFloatFn(BuiltinFn fn, double x, double y, double z) {
+    using enum BuiltinFn;
+    constexpr double kPi = std::numbers::pi;
+    switch (fn) {
+        case __abs: return std::abs(x);
+        case __acos: return std::acos(x);
+        case __acosh: return std::acosh(x);
+        case __asin: return std::asin(x);
+        case __asinh: return std::asinh(x);
+        case __atan: return std::atan(x);
+        case __atan2: return std::atan2(x, y);
+        case __atanh: return std::atanh(x);
+        case __ceil: return std::ceil(x);
+        case __clamp: return std::min(std::max(x, y), z);
+        case __cos: return std::cos(x);
+        case __cosh: return std::cosh(x);
+        case __degrees: return x * 180.0 / kPi;
+        case __exp: return std::exp(x);
+        case __exp2: return std::exp2(x);
+        case __floor: return std::floor(x);
+        case __fma: return std::fma(x, y, z);
+        case __fract: return x - std::floor(x);
+        case __inverseSqrt: return 1.0 / std::sqrt(x);
+        case __log: return std::log(x);
+        case __log2: return std::log2(x);
+        case __max: return std::max(x, y);
+        case __min: return std::min(x, y);
+        case __mix: return x * (1.0 - z) + y * z;
+        case __pow: return std::pow(x, y);
+        case __radians: return x * kPi / 180.0;
+        // Half to even with the default rounding mode
+        case __round: return std::nearbyint(x);
+        case __saturate: return std::clamp(x, 0.0, 1.0);
+        case __sign: return (double)((x > 0.0) - (x < 0.0));
+        case __sin: return std::sin(x);
+        case __sinh: return std::sinh(x);
+        case __smoothstep: {
+            const double t = std::clamp((z - x) / (y - x), 0.0, 1.0);
+            return t * t * (3.0 - 2.0 * t);
+        }
+        case __sqrt: return std::sqrt(x);
+        case __step: return y >= x ? 1.0 : 0.0;
+        case __tan: return std::tan(x);
+        case __tanh: return std::tanh(x);
+        case __trunc: return std::trunc(x);
+        default: return std::numeric_limits<double>::quiet_NaN();
+    }
+}
+
+Expected<int64_t> EvalIntFn(BuiltinFn fn,
+                            const Scalar* type,
+                            int64_t x,
+                            int64_t y,
+                            int64_t z) {
+    using enum BuiltinFn;
+    // i32 values as the bits
+    const auto bits = (uint32_t)x;
+    const bool isSigned = type->kind == ScalarKind::I32;
+    // -1 for the first bit functions without a result
+    const int64_t none = isSigned ? -1 : std::numeric_limits<uint32_t>::max();
+    switch (fn) {
+        case __abs: {
+            // abs() of the min i32 is the same value
+            if (x == std::numeric_limits<int64_t>::min()) {
+                return std::unexpected(ErrorCode::ConstOverflow);
+            }
+            if (x == std::numeric_limits<int32_t>::min() && isSigned) {
+                return x;
+            }
+            return x < 0 ? -x : x;
+        }
+        case __clamp: return std::min(std::max(x, y), z);
+        case __max: return std::max(x, y);
+        case __min: return std::min(x, y);
+        case __sign: return (int64_t)((x > 0) - (x < 0));
+        case __countLeadingZeros: return std::countl_zero(bits);
+        case __countOneBits: return std::popcount(bits);
+        case __countTrailingZeros: return std::countr_zero(bits);
+        case __firstLeadingBit: {
+            // The first bit which differs from the sign for i32
+            const uint32_t value = isSigned && x < 0 ? ~bits : bits;
+            return value == 0 ? none : 31 - std::countl_zero(value);
+        }
+        case __firstTrailingBit: {
+            return bits == 0 ? none : std::countr_zero(bits);
+        }
+        case __reverseBits: {
+            uint32_t reversed = 0;
+            for (uint32_t i = 0; i < 32; ++i) {
+                reversed |= ((bits >> i) & 1u) << (31 - i);
+            }
+            return isSigned ? (int64_t)(int32_t)reversed : (int64_t)reversed;
+        }
+        default: return std::unexpected(ErrorCode::InvalidArg);
+    }
+}
+
+// Determinant of a square matrix by columns
+double Determinant(std::span<const ConstScalar> m, uint32_t size) {
+    // Gaussian elimination with the pivots of the max magnitude
+    double a[4][4] = {};
+    for (uint32_t c = 0; c < size; ++c) {
+        for (uint32_t r = 0; r < size; ++r) {
+            a[r][c] = m[c * size + r].f;
+        }
+    }
+    double det = 1.0;
+    for (uint32_t k = 0; k < size; ++k) {
+        uint32_t pivot = k;
+        for (uint32_t r = k + 1; r < size; ++r) {
+            if (std::abs(a[r][k]) > std::abs(a[pivot][k])) {
+                pivot = r;
+            }
+        }
+        if (a[pivot][k] == 0.0) {
+            return 0.0;
+        }
+        if (pivot != k) {
+            std::swap(a[pivot], a[k]);
+            det = -det;
+        }
+        det *= a[k][k];
+        for (uint32_t r = k + 1; r < size; ++r) {
+            const double f = a[r][k] / a[k][k];
+            for (uint32_t c = k; c < size; ++c) {
+                a[r][c] -= f * a[k][c];
+            }
+        }
+    }
+    return det;
+}
+
+}  // namespace
+
+//===========================================================================//
+
+const ConstValue* ConstEval::Create(const Type* type,
+                                    std::span<const ConstScalar> scalars) {
+    DASSERT(scalars.size() == GetNumComponents(type));
+    auto* data = static_cast<ConstScalar*>(alloc_.Allocate(
+        scalars.size() * sizeof(ConstScalar), alignof(ConstScalar)));
+    std::ranges::copy(scalars, data);
+    return alloc_.Allocate<ConstValue>(
+        type, std::span<const ConstScalar>(data, scalars.size()),
+        std::span<const ConstValue* const>());
+}
+
+const ConstValue* ConstEval::CreateComposite(
+    const Type* type,
+    std::span<const ConstValue* const> elements) {
+    auto* data = static_cast<const ConstValue**>(alloc_.Allocate(
+        elements.size() * sizeof(ConstValue*), alignof(ConstValue*)));
+    std::ranges::copy(elements, data);
+    return alloc_.Allocate<ConstValue>(
+        type, std::span<const ConstScalar>(),
+        std::span<const ConstValue* const>(data, elements.size()));
+}
+
+const ConstValue* ConstEval::CreateInt(const Scalar* type, int64_t value) {
+    const ConstScalar scalar{.i = value};
+    return Create(type, {&scalar, 1});
+}
+
+const ConstValue* ConstEval::CreateFloat(const Scalar* type, double value) {
+    ConstScalar scalar{};
+    scalar.f = value;
+    return Create(type, {&scalar, 1});
+}
+
+const ConstValue* ConstEval::CreateBool(bool value) {
+    return CreateInt(BuiltinScope::Get().GetScalar(ScalarKind::Bool), value);
+}
+
+const ConstValue* ConstEval::CreateZero(const Type* type) {
+    if (const auto* array = type->As<Array>()) {
+        const ConstValue* element = CreateZero(array->valueType);
+        std::vector<const ConstValue*> elements(array->size, element);
+        return CreateComposite(type, elements);
+    }
+    if (const auto* structType = type->As<Struct>()) {
+        std::vector<const ConstValue*> elements;
+        for (const ast::Member* member : structType->members) {
+            elements.push_back(CreateZero(member->type));
+        }
+        return CreateComposite(type, elements);
+    }
+    // Zero bits are 0 and 0.0
+    const Components zero{};
+    return Create(type, {zero.data(), GetNumComponents(type)});
+}
+
+Expected<const ConstValue*> ConstEval::Convert(const ConstValue* value,
+                                               const Type* type) {
+    if (value->type == type) {
+        return value;
+    }
+    if (const auto* array = type->As<Array>()) {
+        const auto* from = value->type->As<Array>();
+        if (!from || from->size != array->size) {
+            return std::unexpected(ErrorCode::InvalidArg);
+        }
+        std::vector<const ConstValue*> elements;
+        for (const ConstValue* element : value->elements) {
+            auto res = Convert(element, array->valueType);
+            if (!res) {
+                return res;
+            }
+            elements.push_back(*res);
+        }
+        return CreateComposite(type, elements);
+    }
+    const Scalar* to = GetScalarType(type);
+    if (!to || !GetScalarType(value->type) ||
+        GetNumComponents(type) != value->scalars.size()) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    Components out;
+    if (const ErrorCode code = ConvertComponents(value, to, out);
+        code != ErrorCode::Ok) {
+        return std::unexpected(code);
+    }
+    return Create(type, {out.data(), value->scalars.size()});
+}
+
+Expected<const ConstValue*> ConstEval::Unary(OpCode op, const ConstValue* arg) {
+    const Scalar* type = GetScalarType(arg->type);
+    if (!type) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    Components out;
+    for (size_t i = 0; i < arg->scalars.size(); ++i) {
+        const ConstScalar value = arg->scalars[i];
+        switch (op) {
+            case OpCode::Negation: {
+                if (!type->IsSigned()) {
+                    return std::unexpected(ErrorCode::InvalidArg);
+                }
+                if (type->IsFloat()) {
+                    out[i].f = -value.f;
+                } else if (value.i == std::numeric_limits<int64_t>::min()) {
+                    return std::unexpected(ErrorCode::ConstOverflow);
+                } else {
+                    out[i].i = -value.i;
+                }
+                break;
+            }
+            case OpCode::BitNot: {
+                out[i].i = type->kind == ScalarKind::U32
+                               ? (int64_t)(uint32_t)~(uint32_t)value.i
+                               : ~value.i;
+                break;
+            }
+            case OpCode::LogNot: out[i].i = !value.i; break;
+            default: return std::unexpected(ErrorCode::InvalidArg);
+        }
+        if (const ErrorCode code = CheckRange(out[i], type);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+    }
+    return Create(arg->type, {out.data(), arg->scalars.size()});
+}
+
+Expected<const ConstValue*> ConstEval::Binary(OpCode op,
+                                              const Scalar* operandType,
+                                              const Type* resultType,
+                                              const ConstValue* lhs,
+                                              const ConstValue* rhs) {
+    if (!GetScalarType(lhs->type) || !GetScalarType(rhs->type)) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    Components a;
+    Components b;
+    for (auto [value, out] : {std::pair(lhs, &a), std::pair(rhs, &b)}) {
+        if (const ErrorCode code = ConvertComponents(value, operandType, *out);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+    }
+    const size_t numLhs = lhs->scalars.size();
+    const size_t numRhs = rhs->scalars.size();
+    const size_t numOut = GetNumComponents(resultType);
+    Components out;
+    const auto* lhsMatrix = lhs->type->As<Matrix>();
+    const auto* rhsMatrix = rhs->type->As<Matrix>();
+    if (op == OpCode::Mul && (lhsMatrix || rhsMatrix) && numLhs > 1 &&
+        numRhs > 1) {
+        // (R x K) * (K x C), a vector on the left is a row
+        const uint32_t numRows = lhsMatrix ? GetNumRows(lhsMatrix->kind) : 1;
+        const uint32_t numInner = (uint32_t)numLhs / numRows;
+        const uint32_t numColumns = (uint32_t)numRhs / numInner;
+        if (numInner * numColumns != numRhs ||
+            numRows * numColumns != numOut) {
+            return std::unexpected(ErrorCode::InvalidArg);
+        }
+        for (uint32_t c = 0; c < numColumns; ++c) {
+            for (uint32_t r = 0; r < numRows; ++r) {
+                double sum = 0.0;
+                for (uint32_t k = 0; k < numInner; ++k) {
+                    sum += a[k * numRows + r].f * b[c * numInner + k].f;
+                }
+                ConstScalar& value = out[c * numRows + r];
+                value.f = sum;
+                if (const ErrorCode code = CheckRange(value, operandType);
+                    code != ErrorCode::Ok) {
+                    return std::unexpected(code);
+                }
+            }
+        }
+        return Create(resultType, {out.data(), numOut});
+    }
+    // Component-wise, a scalar is broadcast
+    if ((numLhs != numOut && numLhs != 1) ||
+        (numRhs != numOut && numRhs != 1)) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    for (size_t i = 0; i < numOut; ++i) {
+        auto res = EvalScalar(op, operandType, a[numLhs == 1 ? 0 : i],
+                              b[numRhs == 1 ? 0 : i]);
+        if (!res) {
+            return std::unexpected(res.error());
+        }
+        out[i] = *res;
+    }
+    return Create(resultType, {out.data(), numOut});
+}
+
+Expected<const ConstValue*> ConstEval::Construct(
+    const Type* type,
+    std::span<const ConstValue* const> args) {
+    if (args.empty()) {
+        return CreateZero(type);
+    }
+    if (const auto* array = type->As<Array>()) {
+        if (args.size() != array->size) {
+            return std::unexpected(ErrorCode::InvalidArg);
+        }
+        std::vector<const ConstValue*> elements;
+        for (const ConstValue* arg : args) {
+            auto res = Convert(arg, array->valueType);
+            if (!res) {
+                return res;
+            }
+            elements.push_back(*res);
+        }
+        return CreateComposite(type, elements);
+    }
+    if (const auto* structType = type->As<Struct>()) {
+        if (args.size() != structType->members.size()) {
+            return std::unexpected(ErrorCode::InvalidArg);
+        }
+        std::vector<const ConstValue*> elements;
+        auto arg = args.begin();
+        for (const ast::Member* member : structType->members) {
+            auto res = Convert(*arg++, member->type);
+            if (!res) {
+                return res;
+            }
+            elements.push_back(*res);
+        }
+        return CreateComposite(type, elements);
+    }
+    const Scalar* to = GetScalarType(type);
+    if (!to) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    const size_t numOut = GetNumComponents(type);
+    // Conversion: vec3<f32>(vec3<i32>)
+    if (args.size() == 1 && args[0]->scalars.size() == numOut) {
+        return Convert(args[0], type);
+    }
+    Components out;
+    size_t numComponents = 0;
+    for (const ConstValue* arg : args) {
+        if (!GetScalarType(arg->type) ||
+            numComponents + arg->scalars.size() > numOut) {
+            return std::unexpected(ErrorCode::InvalidArg);
+        }
+        Components components;
+        if (const ErrorCode code = ConvertComponents(arg, to, components);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+        std::copy_n(components.begin(), arg->scalars.size(),
+                    out.begin() + numComponents);
+        numComponents += arg->scalars.size();
+    }
+    // Splat: vec3(1.0)
+    if (numComponents == 1) {
+        std::fill_n(out.begin() + 1, numOut - 1, out[0]);
+    } else if (numComponents != numOut) {
+        return std::unexpected(ErrorCode::InvalidArg);
+    }
+    return Create(type, {out.data(), numOut});
+}
+
+const ConstValue* ConstEval::Swizzle(const Type* type,
+                                     const ConstValue* value,
+                                     std::span<const VecComponent> swizzle) {
+    Components out;
+    size_t numOut = 0;
+    for (VecComponent component : swizzle) {
+        if (component == VecComponent::None) {
+            break;
+        }
+        const uint32_t index = GetComponentIndex(component);
+        DASSERT(index < value->scalars.size());
+        out[numOut++] = value->scalars[index];
+    }
+    return Create(type, {out.data(), numOut});
+}
+
+Expected<const ConstValue*> ConstEval::Index(const ConstValue* value,
+                                             int64_t index) {
+    if (const auto* array = value->type->As<Array>()) {
+        if (index < 0 || index >= array->size) {
+            return std::unexpected(ErrorCode::ConstIndexOutOfBounds);
+        }
+        return value->elements[index];
+    }
+    if (const auto* vec = value->type->As<Vec>()) {
+        if (index < 0 || index >= GetSize(vec->kind)) {
+            return std::unexpected(ErrorCode::ConstIndexOutOfBounds);
+        }
+        return Create(vec->valueType, value->scalars.subspan(index, 1));
+    }
+    if (const auto* matrix = value->type->As<Matrix>()) {
+        const uint32_t numRows = GetNumRows(matrix->kind);
+        if (index < 0 || index >= GetNumColumns(matrix->kind)) {
+            return std::unexpected(ErrorCode::ConstIndexOutOfBounds);
+        }
+        const auto* column = BuiltinScope::Get().GetVec(
+            VecKindFromSize(numRows), GetScalarType(matrix)->kind);
+        return Create(column, value->scalars.subspan(index * numRows, numRows));
+    }
+    return std::unexpected(ErrorCode::InvalidArg);
+}
+
+const ConstValue* ConstEval::Member(const ConstValue* value, size_t index) {
+    DASSERT(index < value->elements.size());
+    return value->elements[index];
+}
+
+//===========================================================================//
+
+Expected<const ConstValue*> ConstEval::CallBuiltin(
+    BuiltinFn fn,
+    std::span<const ConstValue* const> args,
+    std::span<const Type* const> paramTypes,
+    const Type* returnType) {
+    using enum BuiltinFn;
+    DASSERT(args.size() == paramTypes.size());
+    std::array<const ConstValue*, BuiltinScope::kMaxArgs> params{};
+    DASSERT(args.size() <= params.size());
+    for (size_t i = 0; i < args.size(); ++i) {
+        auto converted = Convert(args[i], paramTypes[i]);
+        if (!converted) {
+            return converted;
+        }
+        params[i] = *converted;
+    }
+    const std::span converted(params.data(), args.size());
+    switch (fn) {
+        // Only scalar bools, there are no bool vectors
+        case __all:
+        case __any: return converted[0];
+        // select(f, t, cond)
+        case __select: return converted[converted[2]->scalars[0].i ? 1 : 0];
+        case __cross:
+        case __distance:
+        case __dot:
+        case __faceForward:
+        case __length:
+        case __normalize:
+        case __reflect: return CallVectorFn(fn, converted, returnType);
+        case __determinant:
+        case __transpose:
+            return CallMatrixFn(fn, converted[0], returnType);
+        default: break;
+    }
+    if (IsComponentWise(fn)) {
+        return CallComponentWise(fn, converted, returnType);
+    }
+    // Not a const function or not implemented
+    return nullptr;
+}
+
+Expected<const ConstValue*> ConstEval::CallComponentWise(
+    BuiltinFn fn,
+    std::span<const ConstValue* const> args,
+    const Type* returnType) {
+    const Scalar* type = GetScalarType(returnType);
+    const size_t numOut = GetNumComponents(returnType);
+    Components out;
+    for (size_t i = 0; i < numOut; ++i) {
+        ConstScalar arg[3] = {};
+        for (size_t j = 0; j < args.size(); ++j) {
+            // The factor of mix() could be a scalar
+            arg[j] = args[j]->scalars[args[j]->scalars.size() == 1 ? 0 : i];
+        }
+        if (type->IsFloat()) {
+            out[i].f = EvalFloatFn(fn, arg[0].f, arg[1].f, arg[2].f);
+        } else {
+            auto res = EvalIntFn(fn, type, arg[0].i, arg[1].i, arg[2].i);
+            if (!res) {
+                return std::unexpected(res.error());
+            }
+            out[i].i = *res;
+        }
+        if (const ErrorCode code = CheckRange(out[i], type);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+    }
+    return Create(returnType, {out.data(), numOut});
+}
+
+Expected<const ConstValue*> ConstEval::CallVectorFn(
+    BuiltinFn fn,
+    std::span<const ConstValue* const> args,
+    const Type* returnType) {
+    using enum BuiltinFn;
+    // The args are vectors of the same size, length() and distance() also
+    // take scalars
+    const Scalar* type = GetScalarType(args[0]->type);
+    const size_t size = args[0]->scalars.size();
+    std::span<const ConstScalar> in[3];
+    for (size_t i = 0; i < args.size(); ++i) {
+        in[i] = args[i]->scalars;
+    }
+    const auto& a = in[0];
+    const auto& b = in[1];
+    if (fn == __dot) {
+        // Integers are checked for overflow
+        ConstScalar sum{};
+        for (size_t i = 0; i < size; ++i) {
+            auto product = EvalScalar(OpCode::Mul, type, a[i], b[i]);
+            if (!product) {
+                return std::unexpected(product.error());
+            }
+            auto res = EvalScalar(OpCode::Add, type, sum, *product);
+            if (!res) {
+                return std::unexpected(res.error());
+            }
+            sum = *res;
+        }
+        return Create(returnType, {&sum, 1});
+    }
+    const auto dot = [&](std::span<const ConstScalar> x,
+                         std::span<const ConstScalar> y) {
+        double sum = 0.0;
+        for (size_t i = 0; i < size; ++i) {
+            sum += x[i].f * y[i].f;
+        }
+        return sum;
+    };
+    Components out;
+    size_t numOut = size;
+    switch (fn) {
+        case __cross: {
+            out[0].f = a[1].f * b[2].f - a[2].f * b[1].f;
+            out[1].f = a[2].f * b[0].f - a[0].f * b[2].f;
+            out[2].f = a[0].f * b[1].f - a[1].f * b[0].f;
+            break;
+        }
+        case __distance:
+        case __length: {
+            Components diff;
+            for (size_t i = 0; i < size; ++i) {
+                diff[i].f = fn == __distance ? a[i].f - b[i].f : a[i].f;
+            }
+            const std::span<const ConstScalar> d(diff.data(), size);
+            out[0].f = std::sqrt(dot(d, d));
+            numOut = 1;
+            break;
+        }
+        case __faceForward: {
+            const double sign = dot(b, in[2]) < 0.0 ? 1.0 : -1.0;
+            for (size_t i = 0; i < size; ++i) {
+                out[i].f = sign * a[i].f;
+            }
+            break;
+        }
+        case __normalize: {
+            const double length = std::sqrt(dot(a, a));
+            for (size_t i = 0; i < size; ++i) {
+                out[i].f = a[i].f / length;
+            }
+            break;
+        }
+        case __reflect: {
+            const double d = 2.0 * dot(b, a);
+            for (size_t i = 0; i < size; ++i) {
+                out[i].f = a[i].f - d * b[i].f;
+            }
+            break;
+        }
+        default: return nullptr;
+    }
+    for (size_t i = 0; i < numOut; ++i) {
+        if (const ErrorCode code = CheckRange(out[i], type);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+    }
+    return Create(returnType, {out.data(), numOut});
+}
+
+Expected<const ConstValue*> ConstEval::CallMatrixFn(BuiltinFn fn,
+                                                    const ConstValue* arg,
+                                                    const Type* returnType) {
+    const auto* matrix = arg->type->As<Matrix>();
+    DASSERT(matrix);
+    const Scalar* type = GetScalarType(matrix);
+    const uint32_t numColumns = GetNumColumns(matrix->kind);
+    const uint32_t numRows = GetNumRows(matrix->kind);
+    if (fn == BuiltinFn::__determinant) {
+        DASSERT(numColumns == numRows);
+        ConstScalar det{};
+        det.f = Determinant(arg->scalars, numRows);
+        if (const ErrorCode code = CheckRange(det, type);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+        return Create(returnType, {&det, 1});
+    }
+    Components out;
+    for (uint32_t c = 0; c < numColumns; ++c) {
+        for (uint32_t r = 0; r < numRows; ++r) {
+            out[r * numColumns + c] = arg->scalars[c * numRows + r];
+        }
+    }
+    return Create(returnType, {out.data(), arg->scalars.size()});
+}
+
+}  // namespace wgsl
@@ -0,0 +1,134 @@
+#pragma once
+#include "base/bump_alloc.h"
+
+#include "ast_expression.h"
+#include "ast_function.h"
+#include "ast_type.h"
+#include "common.h"
+
+#include <span>
+
+namespace wgsl {
+
+// A component of a const value, the scalar kind of the value type tells
+// which member is set: integers and bools in |i|, floats in |f|
+union ConstScalar {
+    int64_t i;
+    double f;
+};
+
+// Value of a const-expression
+// Evaluated once when the expression is created and cached on the node, so
+// the users of the expression read it without evaluating the operands again.
+// Scalars, vectors and matrices store the components, matrices by columns.
+// Arrays and structs store the values of the elements.
+// Owned by the program arena
+class ConstValue {
+public:
+    // A scalar, vector, matrix, array or struct type
+    const ast::Type* type;
+    std::span<const ConstScalar> scalars;
+    std::span<const ConstValue* const> elements;
+
+    ConstValue(const ast::Type* type,
+               std::span<const ConstScalar> scalars,
+               std::span<const ConstValue* const> elements)
+        : type(type), scalars(scalars), elements(elements) {}
+
+    // The value of a scalar as T, nullopt for the other types
+    template <class T>
+    std::optional<T> TryGetAs() const {
+        const auto* scalar = type->As<ast::Scalar>();
+        if (!scalar) {
+            return std::nullopt;
+        }
+        if (scalar->IsFloat()) {
+            return static_cast<T>(scalars[0].f);
+        }
+        return static_cast<T>(scalars[0].i);
+    }
+};
+
+// Evaluates the operations of const-expressions for the ProgramBuilder
+// The builder resolves the result types and passes the values of the
+// operands. Abstract ints are evaluated in 64 bits and abstract floats in
+// double precision, the concrete types in their own range.
+// Errors: a result out of the range of its type, a float which is not
+// finite, a division by zero, an index out of bounds. A nullptr value
+// without an error means the operation has no const evaluation, e.g. a
+// derivative builtin.
+class ConstEval {
+public:
+    explicit ConstEval(BumpAllocator& alloc) : alloc_(alloc) {}
+
+    const ConstValue* CreateInt(const ast::Scalar* type, int64_t value);
+    const ConstValue* CreateFloat(const ast::Scalar* type, double value);
+    const ConstValue* CreateBool(bool value);
+    // Zero value of a constructible type
+    const ConstValue* CreateZero(const ast::Type* type);
+
+    // Converts the components of |value| to the components of |type| of
+    // the same shape. Floats are truncated to integers, as in i32(1.5)
+    Expected<const ConstValue*> Convert(const ConstValue* value,
+                                        const ast::Type* type);
+
+    Expected<const ConstValue*> Unary(ast::OpCode op, const ConstValue* arg);
+
+    // The operands are converted to the components of |operandType|, a
+    // scalar operand of a vector or matrix operation is broadcast
+    Expected<const ConstValue*> Binary(ast::OpCode op,
+                                       const ast::Scalar* operandType,
+                                       const ast::Type* resultType,
+                                       const ConstValue* lhs,
+                                       const ConstValue* rhs);
+
+    // A value constructor: T(args...) with the args checked by the builder
+    Expected<const ConstValue*> Construct(
+        const ast::Type* type,
+        std::span<const ConstValue* const> args);
+
+    const ConstValue* Swizzle(const ast::Type* type,
+                              const ConstValue* value,
+                              std::span<const ast::VecComponent> swizzle);
+
+    // An element of an array, a component of a vector or a column of a
+    // matrix
+    Expected<const ConstValue*> Index(const ConstValue* value, int64_t index);
+
+    const ConstValue* Member(const ConstValue* value, size_t index);
+
+    // A builtin function of the overload resolved by
+    // BuiltinScope::ResolveCall(). The args are converted to |paramTypes|,
+    // the result is of |returnType|. Null if the function has no const
+    // evaluation
+    Expected<const ConstValue*> CallBuiltin(
+        ast::BuiltinFn fn,
+        std::span<const ConstValue* const> args,
+        std::span<const ast::Type* const> paramTypes,
+        const ast::Type* returnType);
+
+private:
+    const ConstValue* Create(const ast::Type* type,
+                             std::span<const ConstScalar> scalars);
+    const ConstValue* CreateComposite(
+        const ast::Type* type,
+        std::span<const ConstValue* const> elements);
+
+    // The args are of the param types of the overload
+    Expected<const ConstValue*> CallComponentWise(
+        ast::BuiltinFn fn,
+        std::span<const ConstValue* const> args,
+        const ast::Type* returnType);
+    Expected<const ConstValue*> CallVectorFn(
+        ast::BuiltinFn fn,
+        std::span<const ConstValue* const> args,
+        const ast::Type* returnType);
+    Expected<const ConstValue*> CallMatrixFn(ast::BuiltinFn fn,
+                                             const ConstValue* arg,
+                                             const ast::Type* returnType);
+
+private:
+    BumpAllocator& alloc_;
+};
+
+}  // namespace wgsl
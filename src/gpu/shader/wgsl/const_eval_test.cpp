@@ -0,0 +1,385 @@
+#include "const_eval.h"
+#include "program.h"
+
+#include "ast_attribute.h"
+#include "ast_expression.h"
+#include "ast_function.h"
+#include "ast_type.h"
+#include "ast_variable.h"
+#include "builtin_scope.h"
+
+#include <doctest/doctest.h>
+
+using namespace wgsl;
+
+namespace {
+
+const ast::ConstVariable* FindConst(const Program& program,
+                                    std::string_view name) {
+    const ast::Symbol* symbol = program.FindSymbol(name);
+    return symbol ? symbol->As<ast::ConstVariable>() : nullptr;
+}
+
+// Components of a scalar, vector or matrix as doubles
+std::vector<double> GetComponents(const ConstValue* value) {
+    std::vector<double> out;
+    const ast::Scalar* scalar = ast::GetScalarType(value->type);
+    for (const ConstScalar& component : value->scalars) {
+        out.push_back(scalar->IsFloat() ? component.f : (double)component.i);
+    }
+    return out;
+}
+
+// Checks the value and the type name of the global const |name|
+void CheckConst(const Program& program,
+                std::string_view name,
+                std::string_view typeName,
+                std::vector<double> expected) {
+    CAPTURE(name);
+    const ast::ConstVariable* var = FindConst(program, name);
+    REQUIRE(var);
+    REQUIRE(var->value);
+    CHECK_EQ(var->value->type, var->type);
+    CHECK_EQ(var->type->name, typeName);
+    CHECK_EQ(GetComponents(var->value), expected);
+}
+
+std::unique_ptr<Program> Build(std::string_view code) {
+    auto program = Program::Create(code);
+    CHECK_MESSAGE(program->GetDiags().empty(), program->GetDiagsAsString());
+    return program;
+}
+
+void ExpectError(std::string_view code, ErrorCode expected) {
+    CAPTURE(code);
+    auto program = Program::Create(code);
+    const auto& diags = program->GetDiags();
+    REQUIRE(!diags.empty());
+    CHECK_MESSAGE(diags.front().code == expected, "expected an error code '",
+                  ErrorCodeString(expected),
+                  "'. Got: ", program->GetDiagsAsString());
+}
+
+}  // namespace
+
+TEST_CASE("[WGSL] const-expression scalars") {
+    auto program = Build(R"(
+        const a = 1 + 2 * 3;
+        const b : f32 = 1.0 / 4.0;
+        const c = 7 / 2;
+        const d = -7 % 3;
+        const e = 1u << 31u;
+        const f = ~0u;
+        const g = 3 > 2 && 1.5 <= 2;
+        const h = f32(7) / 2;
+        const i = i32(-2.7);
+        const j = -3;
+        const k : u32 = a;
+        const l = 10 - 4 - 3;
+        const m = 1 + 2 * 3 - 8 / 2 / 2 == 5;
+    )");
+    CheckConst(*program, "a", "int", {7});
+    CheckConst(*program, "b", "f32", {0.25});
+    CheckConst(*program, "c", "int", {3});
+    CheckConst(*program, "d", "int", {-1});
+    CheckConst(*program, "e", "u32", {2147483648.0});
+    CheckConst(*program, "f", "u32", {4294967295.0});
+    CheckConst(*program, "g", "bool", {1});
+    CheckConst(*program, "h", "f32", {3.5});
+    CheckConst(*program, "i", "i32", {-2});
+    CheckConst(*program, "j", "int", {-3});
+    CheckConst(*program, "k", "u32", {7});
+    // Precedence and left to right order
+    CheckConst(*program, "l", "int", {3});
+    CheckConst(*program, "m", "bool", {1});
+}
+
+TEST_CASE("[WGSL] const-expression errors") {
+    ExpectError(" const a : i32 = 2147483647 + 1; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = 2147483647i + 1; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = 0u - 1u; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = -3u; ", ErrorCode::InvalidArg);
+    // AbstractInt is 64 bit
+    ExpectError(" const a = 2147483647 * 2147483647 * 4; ",
+                ErrorCode::ConstOverflow);
+    ExpectError(" const a = -2147483647 * 2147483647 * 4; ",
+                ErrorCode::ConstOverflow);
+    ExpectError(" const a = -2147483647 * 2147483647 * 2 - "
+                "2147483647 * 2147483647 * 2; ",
+                ErrorCode::ConstOverflow);
+    ExpectError(" const a = 1 / 0; ", ErrorCode::ConstDivByZero);
+    ExpectError(" const a = 5u % 0u; ", ErrorCode::ConstDivByZero);
+    ExpectError(" const a = 1.0 / 0.0; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = 1u << 32u; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a : f32 = 1e30 * 1e30; ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = true == 1; ", ErrorCode::InvalidArg);
+    ExpectError(" const a = true < false; ", ErrorCode::InvalidArg);
+    ExpectError(" @binding(0) @group(0) var<storage> v : f32; const a = v; ",
+                ErrorCode::NotConstExpr);
+}
+
+TEST_CASE("[WGSL] const-expression vectors and matrices") {
+    auto program = Build(R"(
+        const v = vec3(1, 2, 3) * 2.0;
+        const w = vec4f(v.xy, 0, 1);
+        const s = vec3(1.5);
+        const n = -vec2i(1, -2);
+        const u = vec2(1u, 2u) << vec2(1u, 2u);
+        const m = mat2x2(1, 2, 3, 4);
+        const mf = mat2x2f(m);
+        const mv = m * vec2(1, 1);
+        const vm = vec2(1, 1) * m;
+        const mm = m * m;
+        const ms = m + m * 0.5;
+        const col = m[1];
+        const x = w[3];
+        const y = w.w + v.z;
+    )");
+    CheckConst(*program, "v", "vec3<float>", {2, 4, 6});
+    CheckConst(*program, "w", "vec4<f32>", {2, 4, 0, 1});
+    CheckConst(*program, "s", "vec3<float>", {1.5, 1.5, 1.5});
+    CheckConst(*program, "n", "vec2<i32>", {-1, 2});
+    CheckConst(*program, "u", "vec2<u32>", {2, 8});
+    CheckConst(*program, "m", "mat2x2<float>", {1, 2, 3, 4});
+    CheckConst(*program, "mf", "mat2x2<f32>", {1, 2, 3, 4});
+    CheckConst(*program, "mv", "vec2<float>", {4, 6});
+    CheckConst(*program, "vm", "vec2<float>", {3, 7});
+    CheckConst(*program, "mm", "mat2x2<float>", {7, 10, 15, 22});
+    CheckConst(*program, "ms", "mat2x2<float>", {1.5, 3, 4.5, 6});
+    CheckConst(*program, "col", "vec2<float>", {3, 4});
+    CheckConst(*program, "x", "f32", {1});
+    CheckConst(*program, "y", "f32", {7});
+
+    ExpectError(" const a = vec3f(1, 2); ", ErrorCode::InvalidArg);
+    ExpectError(" const a = vec2(1, 2) + vec3(1, 2, 3); ",
+                ErrorCode::InvalidArg);
+    ExpectError(" const a = mat2x2(1, 2, 3, 4) * vec3(1, 2, 3); ",
+                ErrorCode::InvalidArg);
+    ExpectError(" const a = vec2i(1, 2) * mat2x2f(); ", ErrorCode::InvalidArg);
+    ExpectError(" const a = vec2(1, 2); const b = a[2]; ",
+                ErrorCode::ConstIndexOutOfBounds);
+    // A const index of a runtime value is checked too
+    ExpectError(" fn f(v : vec4f) -> f32 { return v[4]; } ",
+                ErrorCode::ConstIndexOutOfBounds);
+}
+
+TEST_CASE("[WGSL] const-expression arrays and structs") {
+    auto program = Build(R"(
+        struct S {
+            a : f32,
+            b : vec2i,
+        };
+        const s = S(1, vec2(2, 3));
+        const b = s.b.y;
+        const z = S().a;
+        const arr = array(1, 2.5, 3);
+        const e = arr[1];
+        const zeros = array<f32, 2>();
+        const nested = array(vec2(1, 2), vec2(3.0, 4));
+        const last = nested[1].y;
+    )");
+    CheckConst(*program, "b", "i32", {3});
+    CheckConst(*program, "z", "f32", {0});
+    CheckConst(*program, "e", "float", {2.5});
+    CheckConst(*program, "last", "float", {4});
+    const ast::ConstVariable* arr = FindConst(*program, "arr");
+    REQUIRE(arr);
+    CHECK_EQ(arr->type->name, "array<float,3>");
+    REQUIRE_EQ(arr->value->elements.size(), 3);
+    CHECK_EQ(arr->value->elements[2]->TryGetAs<double>(), 3.0);
+    const ast::ConstVariable* zeros = FindConst(*program, "zeros");
+    REQUIRE(zeros);
+    REQUIRE_EQ(zeros->value->elements.size(), 2);
+    CHECK_EQ(zeros->value->elements[1]->TryGetAs<double>(), 0.0);
+
+    ExpectError(" const a = array(1, 2); const b = a[-1]; ",
+                ErrorCode::ConstIndexOutOfBounds);
+    ExpectError(" const a = array<i32, 2>(1, 2, 3); ", ErrorCode::InvalidArg);
+    ExpectError(" const a = array(1, true); ", ErrorCode::TypeError);
+    ExpectError(" struct S { a : f32, }; const s = S(true); ",
+                ErrorCode::TypeError);
+}
+
+TEST_CASE("[WGSL] const-expression builtin functions") {
+    auto program = Build(R"(
+        const a = max(1, 2.5);
+        const b = clamp(5, 0, 3);
+        const c = dot(vec3(1, 2, 3), vec3(4, 5, 6));
+        const d = cross(vec3(1.0, 0, 0), vec3(0.0, 1, 0));
+        const e = length(vec2(3.0, 4.0));
+        const f = determinant(mat2x2(1, 2, 3, 4));
+        const g = transpose(mat2x3(1, 2, 3, 4, 5, 6));
+        const h = countOneBits(255u);
+        const i = abs(vec2i(-1, 2));
+        const j = select(1, 2, a > 2);
+    )");
+    CheckConst(*program, "a", "float", {2.5});
+    CheckConst(*program, "b", "int", {3});
+    CheckConst(*program, "c", "int", {32});
+    CheckConst(*program, "d", "vec3<float>", {0, 0, 1});
+    CheckConst(*program, "e", "float", {5});
+    CheckConst(*program, "f", "float", {-2});
+    CheckConst(*program, "g", "mat3x2<float>", {1, 4, 2, 5, 3, 6});
+    CheckConst(*program, "h", "u32", {8});
+    CheckConst(*program, "i", "vec2<i32>", {1, 2});
+    CheckConst(*program, "j", "int", {2});
+
+    ExpectError(" const a = dot(1, 2); ", ErrorCode::InvalidArg);
+    ExpectError(" const a = cross(vec2(1, 2), vec2(3, 4)); ",
+                ErrorCode::InvalidArg);
+    ExpectError(" const a = abs(-2147483647i - 2); ", ErrorCode::ConstOverflow);
+    ExpectError(" const a = no_such_fn(1); ", ErrorCode::SymbolNotFound);
+}
+
+TEST_CASE("[WGSL] builtin function overloads") {
+    Build(R"(
+        fn f1(a : f32) -> f32 { return sqrt(a); }
+        fn f2(a : f32) -> f32 { return max(a, 1); }
+        fn f3(a : vec3f, b : vec3i) -> vec3f { return ldexp(a, b); }
+        fn f4(a : vec2u) -> u32 { return dot(a, vec2(1, 2)); }
+        fn f5(a : mat2x3f) -> mat3x2f { return transpose(a); }
+        fn f6(a : f32, b : f32) -> f32 { return select(a, b, a > b); }
+    )");
+    ExpectError(" fn f(a : f32) -> vec2f { return sqrt(a); } ",
+                ErrorCode::TypeError);
+    ExpectError(" fn f(a : f32, b : i32) -> f32 { return max(a, b); } ",
+                ErrorCode::InvalidArg);
+    ExpectError(" fn f(a : u32) -> u32 { return abs(a, a); } ",
+                ErrorCode::InvalidArg);
+    ExpectError(" fn f(a : u32) -> u32 { return sqrt(a); } ",
+                ErrorCode::InvalidArg);
+    ExpectError(" fn f(a : f32) -> f32 { return modf(a); } ",
+                ErrorCode::Unimplemented);
+
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    const auto* f32 = builtins.GetScalar(ast::ScalarKind::F32);
+    const auto* i32 = builtins.GetScalar(ast::ScalarKind::I32);
+    const auto* abstractInt = builtins.GetScalar(ast::ScalarKind::Int);
+    const auto* vec3f =
+        builtins.GetVec(ast::VecKind::Vec3, ast::ScalarKind::F32);
+
+    // Abstract args are converted to the overload of the concrete ones
+    const ast::Type* args[] = {abstractInt, f32};
+    auto call = builtins.ResolveCall(ast::BuiltinFn::__max, args, true);
+    REQUIRE(call);
+    CHECK_EQ(call->returnType, f32);
+    CHECK_EQ(call->paramTypes[0], f32);
+    CHECK_EQ(call->paramTypes[1], f32);
+    CHECK(call->isConst);
+
+    // Abstract overloads are only for const args
+    const ast::Type* intArgs[] = {abstractInt, abstractInt};
+    call = builtins.ResolveCall(ast::BuiltinFn::__max, intArgs, true);
+    REQUIRE(call);
+    CHECK_EQ(call->returnType, abstractInt);
+    call = builtins.ResolveCall(ast::BuiltinFn::__max, intArgs, false);
+    REQUIRE(call);
+    CHECK_EQ(call->returnType, i32);
+
+    const ast::Type* vecArgs[] = {vec3f};
+    call = builtins.ResolveCall(ast::BuiltinFn::__length, vecArgs, false);
+    REQUIRE(call);
+    CHECK_EQ(call->returnType, f32);
+    CHECK_EQ(call->paramTypes[0], vec3f);
+
+    // The scalar factor of mix() is converted to the component type
+    const ast::Type* mixArgs[] = {vec3f, vec3f, abstractInt};
+    call = builtins.ResolveCall(ast::BuiltinFn::__mix, mixArgs, true);
+    REQUIRE(call);
+    CHECK_EQ(call->returnType, vec3f);
+    CHECK_EQ(call->paramTypes[2], f32);
+
+    const ast::Type* mixed[] = {vec3f, i32};
+    call = builtins.ResolveCall(ast::BuiltinFn::__cross, mixed, false);
+    REQUIRE(!call);
+    CHECK_EQ(call.error(), ErrorCode::InvalidArg);
+}
+
+TEST_CASE("[WGSL] const-expression user names hide builtins") {
+    auto program = Build(" const length = 1; const a = length + 1; ");
+    CheckConst(*program, "a", "int", {2});
+    ExpectError(" const max = 2; const a = max(1, 2); ",
+                ErrorCode::SymbolNotFound);
+}
+
+TEST_CASE("[WGSL] const-expression attributes and array sizes") {
+    auto program = Build(R"(
+        const size = 8;
+        struct S {
+            a : array<f32, size * 2>,
+        };
+        @compute @workgroup_size(size * 2, size)
+        fn main() -> u32 { return 0u; }
+    )");
+    const ast::Symbol* symbol = program->FindSymbol("S");
+    REQUIRE(symbol);
+    const auto* type = symbol->As<ast::Struct>();
+    REQUIRE(type);
+    const auto* array = type->members.front()->type->As<ast::Array>();
+    REQUIRE(array);
+    CHECK_EQ(array->size, 16);
+
+    symbol = program->FindSymbol("main");
+    REQUIRE(symbol);
+    const auto* func = symbol->As<ast::Function>();
+    REQUIRE(func);
+    const ast::WorkgroupAttribute* workgroup = nullptr;
+    for (const ast::Attribute* attr : func->attributes) {
+        if (const auto* w = attr->As<ast::WorkgroupAttribute>()) {
+            workgroup = w;
+        }
+    }
+    REQUIRE(workgroup);
+    CHECK_EQ(workgroup->x, 16);
+    CHECK_EQ(workgroup->y, 8);
+    CHECK_EQ(workgroup->z, 1);
+
+    ExpectError(" @compute @workgroup_size(0) fn f() -> u32 { return 0u; } ",
+                ErrorCode::InvalidAttribute);
+    ExpectError(" const n = 0; struct S { a : array<f32, n>, }; ",
+                ErrorCode::InvalidTemplateParam);
+}
+
+TEST_CASE("[WGSL] const-expression serialization") {
+    auto program = Build(R"(
+        struct S {
+            a : f32,
+            b : array<vec2f, 2>,
+        };
+        const s = S(1, array(vec2(1, 2), vec2(3, 4)));
+        const v = vec3f(1, 2, 3);
+        const l = length(vec2(3.0, 4.0));
+        const x = s.b[1].y;
+    )");
+    const std::vector<uint8_t> data = program->Serialize();
+    REQUIRE(!data.empty());
+    auto loaded = Program::Deserialize(data);
+    REQUIRE(loaded);
+    CheckConst(*loaded, "v", "vec3<f32>", {1, 2, 3});
+    CheckConst(*loaded, "l", "float", {5});
+    CheckConst(*loaded, "x", "f32", {4});
+
+    const ast::ConstVariable* s = FindConst(*loaded, "s");
+    REQUIRE(s);
+    REQUIRE_EQ(s->value->elements.size(), 2);
+    const ConstValue* b = s->value->elements[1];
+    CHECK_EQ(b->type->name, "array<vec2<f32>,2>");
+    REQUIRE_EQ(b->elements.size(), 2);
+    CHECK_EQ(GetComponents(b->elements[1]), (std::vector<double>{3, 4}));
+    // The initializers keep the values and the calls
+    const auto* call = s->initializer->As<ast::CallExpression>();
+    REQUIRE(call);
+    CHECK_EQ(call->builtin, nullptr);
+    CHECK_EQ(call->args.size(), 2);
+    CHECK_EQ(call->constValue->type, s->type);
+    const auto* length =
+        FindConst(*loaded, "l")->initializer->As<ast::CallExpression>();
+    REQUIRE(length);
+    REQUIRE(length->builtin);
+    CHECK_EQ(length->builtin->type, ast::BuiltinFn::__length);
+
+    // Truncated values are rejected
+    for (size_t size : {data.size() / 2, data.size() - 1}) {
+        CHECK(!Program::Deserialize(std::span(data).first(size)));
+    }
+}
@@ -1,10 +1,149 @@
 #pragma once
+#include <algorithm>
 #include <array>
+#include <span>
+#include "lexer_scan.h"
 #include "token.h"
 #include "util.h"
 
 namespace wgsl {
 
+// Perfect hash of the keywords, reserved words and builtin values
+// Hash and displace: the hash of a word selects a bucket and the
+// displacement of the bucket is mixed into the hash to get the slot. The
+// displacements are searched at compile time so that every word gets a
+// slot of its own, a lookup is one hash and one string compare.
+class IdentTable {
+public:
+    static constexpr size_t kNumSlots = 256;
+    static constexpr size_t kNumBuckets = 64;
+
+    consteval IdentTable() {
+        constexpr size_t kNumWords = std::size(kKeywords) +
+                                     std::size(kReserved) +
+                                     std::size(kBuiltinValues);
+        std::array<Slot, kNumWords> words{};
+        size_t numWords = 0;
+        for (std::string_view word : kKeywords) {
+            words[numWords++] = {word, Token::Kind::Keyword};
+        }
+        for (std::string_view word : kReserved) {
+            words[numWords++] = {word, Token::Kind::Reserved};
+        }
+        for (std::string_view word : kBuiltinValues) {
+            words[numWords++] = {word, Token::Kind::Builtin};
+        }
+        // Group the words by bucket
+        std::array<uint32_t, kNumWords> hashes{};
+        std::array<uint32_t, kNumBuckets + 1> bucketStart{};
+        for (size_t i = 0; i < kNumWords; ++i) {
+            hashes[i] = Hash(words[i].word);
+            ++bucketStart[hashes[i] % kNumBuckets + 1];
+            maxLength_ = std::max(maxLength_, words[i].word.size());
+        }
+        size_t maxBucketSize = 0;
+        for (size_t b = 0; b < kNumBuckets; ++b) {
+            maxBucketSize = std::max(maxBucketSize, (size_t)bucketStart[b + 1]);
+            bucketStart[b + 1] += bucketStart[b];
+        }
+        std::array<uint32_t, kNumWords> byBucket{};
+        std::array<uint32_t, kNumBuckets> bucketFill{};
+        for (uint32_t i = 0; i < kNumWords; ++i) {
+            const size_t bucket = hashes[i] % kNumBuckets;
+            byBucket[bucketStart[bucket] + bucketFill[bucket]++] = i;
+        }
+        // Place the largest buckets first while there are many free slots
+        for (size_t size = maxBucketSize; size > 0; --size) {
+            for (size_t b = 0; b < kNumBuckets; ++b) {
+                if (bucketStart[b + 1] - bucketStart[b] != size) {
+                    continue;
+                }
+                const std::span<const uint32_t> bucket(
+                    byBucket.data() + bucketStart[b], size);
+                if (!PlaceBucket(bucket, words, hashes, displacements_[b])) {
+                    // Duplicate words or the table is too small
+                    return;
+                }
+            }
+        }
+        valid_ = true;
+    }
+
+    // Keyword, Reserved, Builtin or Ident
+    constexpr Token::Kind Classify(std::string_view ident) const {
+        if (ident.size() > maxLength_) {
+            return Token::Kind::Ident;
+        }
+        const uint32_t hash = Hash(ident);
+        const Slot& slot =
+            slots_[GetSlot(hash, displacements_[hash % kNumBuckets])];
+        return slot.word == ident ? slot.kind : Token::Kind::Ident;
+    }
+
+    constexpr bool IsValid() const { return valid_; }
+
+private:
+    struct Slot {
+        std::string_view word;
+        Token::Kind kind = Token::Kind::Ident;
+    };
+
+    static constexpr uint32_t kMaxDisplacement = 1u << 16;
+
+    // FNV-1a
+    static constexpr uint32_t Hash(std::string_view str) {
+        uint32_t hash = 2166136261u;
+        for (char c : str) {
+            hash = (hash ^ (uint8_t)c) * 16777619u;
+        }
+        return hash;
+    }
+
+    // Murmur3 finalizer, spreads the displacement over all bits
+    static constexpr size_t GetSlot(uint32_t hash, uint32_t displacement) {
+        uint32_t x = hash ^ displacement;
+        x = (x ^ (x >> 16)) * 0x85ebca6bu;
+        x = (x ^ (x >> 13)) * 0xc2b2ae35u;
+        return (x ^ (x >> 16)) % kNumSlots;
+    }
+
+    template <size_t N>
+    constexpr bool PlaceBucket(std::span<const uint32_t> bucket,
+                               const std::array<Slot, N>& words,
+                               const std::array<uint32_t, N>& hashes,
+                               uint32_t& outDisplacement) {
+        for (uint32_t d = 1; d < kMaxDisplacement; ++d) {
+            bool fits = true;
+            for (size_t i = 0; i < bucket.size() && fits; ++i) {
+                const size_t slot = GetSlot(hashes[bucket[i]], d);
+                fits = slots_[slot].word.empty();
+                // Words of the same bucket could get the same slot
+                for (size_t j = 0; j < i && fits; ++j) {
+                    fits = slot != GetSlot(hashes[bucket[j]], d);
+                }
+            }
+            if (!fits) {
+                continue;
+            }
+            for (uint32_t index : bucket) {
+                slots_[GetSlot(hashes[index], d)] = words[index];
+            }
+            outDisplacement = d;
+            return true;
+        }
+        return false;
+    }
+
+private:
+    std::array<Slot, kNumSlots> slots_{};
+    std::array<uint32_t, kNumBuckets> displacements_{};
+    size_t maxLength_ = 0;
+    bool valid_ = false;
+};
+
+inline constexpr IdentTable kIdentTable;
+static_assert(kIdentTable.IsValid(), "Increase IdentTable::kNumSlots");
+
 // Text lexer
 class Lexer {
 public:
@@ -16,6 +155,19 @@ public:
         lineOffsets_.push_back(0);
     }
 
+    // Resumes lexing at |pos|, |lineStarts| are the known line starts of
+    // the text up to |pos| at least
+    Lexer(std::string_view code,
+          uint32_t pos,
+          std::span<const uint32_t> lineStarts) {
+        DASSERT(pos <= code.size() && !lineStarts.empty());
+        text_ = code;
+        next_ = pos;
+        const auto end = std::upper_bound(lineStarts.begin(),
+                                          lineStarts.end(), pos);
+        lineOffsets_.assign(lineStarts.begin(), end);
+    }
+
     std::vector<Token> ParseAll() {
         std::vector<Token> out;
         while (out.emplace_back(ParseNext()))
@@ -29,16 +181,14 @@ public:
     }
 
     Token ParseNext() {
-        for(;;) {
-            if(Match("//", "/*")) {
-                SkipComment();
-            } else if(Match(CharKind::LineBreak, CharKind::Space)) {
-                SkipBlankspace();
-            } else if(IsEof()) {
-                return Token::EOF(Loc());
-            } else {
-                break;
-            }
+        // Blank space is skipped by blocks, usually in one call
+        SkipBlankspace();
+        while (Match("//", "/*")) {
+            SkipComment();
+            SkipBlankspace();
+        }
+        if (IsEof()) {
+            return Token::EOF(Loc());
         }
         switch (GetKind()) {
             case CharKind::Digit: return ParseDigit();
@@ -48,6 +198,21 @@ public:
         return Token::Invalid(Loc());
     }
 
+    // Moves over the text up to |pos| without lexing it
+    void SkipTo(uint32_t pos) {
+        DASSERT(pos >= Pos() && pos <= End());
+        JumpTo(pos);
+    }
+
+    // Offset of the char after the last token
+    uint32_t GetPos() const { return Pos(); }
+
+    // Offset of a location of the lexed text
+    uint32_t GetOffset(SourceLoc loc) const {
+        DASSERT(loc.line > 0 && loc.line <= lineOffsets_.size());
+        return lineOffsets_[loc.line - 1] + loc.col - 1;
+    }
+
     // Get current line for diags
     std::string_view GetLine() { return GetLine(kLastLine); }
 
@@ -91,32 +256,32 @@ private:
         if (Match("0x", "0X")) {
             flags.prefixHex = true;
             flags.intType = true;
-            Advance(2);
+            AdvanceInLine(2);
             start += 2;
         }
         while (Match(CharKind::Digit, '.', 'e', '+', '-')) {
             if (Match('.', 'e')) {
                 flags.floatType = true;
             }
-            Advance();
+            AdvanceInLine();
         }
         // Check for user specified type [iufh]
         if (Match('h')) {
             flags.floatType = true;
             flags.suffixH = true;
-            Advance();
+            AdvanceInLine();
         } else if (Match('f')) {
             flags.floatType = true;
             flags.suffixF = true;
-            Advance();
+            AdvanceInLine();
         } else if (Match('u')) {
             flags.intType = true;
             flags.suffixU = true;
-            Advance();
+            AdvanceInLine();
         } else if (Match('i')) {
             flags.intType = true;
             flags.suffixI = true;
-            Advance();
+            AdvanceInLine();
         }
         // If no special symbols are found assume uint
         if (!flags.intType && !flags.floatType) {
@@ -154,37 +319,14 @@ private:
         return Token::Invalid(loc);
     }
 
-    constexpr Token ParseLetter() {
+    Token ParseLetter() {
         const uint32_t start = Pos();
         SourceLoc loc = Loc();
-        while (Match(CharKind::Digit, CharKind::Letter, '_')) {
-            Advance();
-        }
+        next_ = (uint32_t)scan::SkipIdent(text_, Pos());
         const uint32_t len = Pos() - start;
-        auto tok = Token(Token::Kind::Ident, SourceLoc(loc, len),
-                         MakeStringView(start, start + len));
-        // Check if this ident is a keyword
-        for (const std::string_view keyword : kKeywords) {
-            if (tok.Source() == keyword) {
-                tok.kind = Token::Kind::Keyword;
-                return tok;
-            }
-        }
-        // Check if this ident is a reserved ident
-        for (const std::string_view reserved : kReserved) {
-            if (tok.Source() == reserved) {
-                tok.kind = Token::Kind::Reserved;
-                return tok;
-            }
-        }
-        // Check if this ident is a builtint variable name
-        for (const std::string_view builtin : kBuiltinValues) {
-            if (tok.Source() == builtin) {
-                tok.kind = Token::Kind::Builtin;
-                return tok;
-            }
-        }
-        return tok;
+        const std::string_view ident = MakeStringView(start, start + len);
+        // Keyword, reserved word or builtin variable name
+        return Token(kIdentTable.Classify(ident), SourceLoc(loc, len), ident);
     }
 
     constexpr Token ParsePunctuation() {
@@ -327,48 +469,72 @@ private:
 
     constexpr Token Op3(Token::Kind kind) {
         auto lex = Token(kind, SourceLoc(Loc(), 3), &Peek(), 3);
-        Advance(3);
+        AdvanceInLine(3);
         return lex;
     }
 
     constexpr Token Op2(Token::Kind kind) {
         auto lex = Token(kind, SourceLoc(Loc(), 2), &Peek(), 2);
-        Advance(2);
+        AdvanceInLine(2);
         return lex;
     }
 
     constexpr Token Op1(Token::Kind kind) {
         auto lex = Token(kind, Loc(), &Peek(), 1);
-        Advance(1);
+        AdvanceInLine(1);
         return lex;
     }
 
-    constexpr void SkipBlankspace() {
-        while (Match(CharKind::Space, CharKind::LineBreak)) {
-            Advance();
+    void SkipBlankspace() {
+        // Most tokens are followed by a single space or none
+        if (!Match(CharKind::Space, CharKind::LineBreak)) {
+            return;
         }
+        if (Match(' ') && Pos() + 1 < End() && !IsBlank(At(Pos() + 1))) {
+            ++next_;
+            return;
+        }
+        next_ = (uint32_t)scan::SkipBlankspace(text_, Pos(), lineOffsets_);
     }
 
-    constexpr void SkipComment() {
+    void SkipComment() {
         if (Match("/*")) {
             Advance(2);
-            while (!IsEof() && !Match("*/")) {
+            for (;;) {
+                // Only '*' and '/' could end or open a comment
+                JumpTo(scan::FindEither(text_, Pos(), '*', '/'));
+                if (IsEof()) {
+                    return;
+                }
+                if (Match("*/")) {
+                    Advance(2);
+                    return;
+                }
                 // Nested comments /* /* ... */ */
                 if (Match("/*")) {
                     SkipComment();
+                } else {
+                    Advance();
                 }
-                Advance();
             }
-            Advance(2);
         } else if (Match("//")) {
             Advance(2);
-            while (!IsEof() && !Match(CharKind::LineBreak)) {
-                Advance();
-            }
+            JumpTo(scan::FindLineBreak(text_, Pos()));
             Advance();
         }
     }
 
+    // Moves to |pos| at once, adding the lines in between
+    void JumpTo(size_t pos) {
+        scan::CollectLineStarts(text_, Pos(), pos, lineOffsets_);
+        next_ = (uint32_t)pos;
+    }
+
+    // Over chars which are known to be no line breaks
+    constexpr void AdvanceInLine(uint32_t offset = 1) {
+        next_ = std::min(next_ + offset, End());
+    }
+
     constexpr void Advance(uint32_t offset = 1) {
         for (uint32_t i = 0; i < offset && !IsEof(); ++i, ++next_) {
             if (Match(CharKind::LineBreak)) {
@@ -452,6 +618,11 @@ private:
         return (CharKind)ASCII::table[Peek()];
     }
 
+    static constexpr bool IsBlank(char ch) {
+        return (uint8_t)ch < 0x80 &&
+               (ASCII::IsSpace(ch) || ASCII::IsLineBreak(ch));
+    }
+
 private:
     std::string_view text_;
     std::vector<uint32_t> lineOffsets_;
@@ -0,0 +1,95 @@
+#include "base/bench.h"
+#include "lexer.h"
+
+#include <format>
+#include <random>
+
+using namespace wgsl;
+
+namespace {
+
+// Compute shader with the usual mix of keywords, builtins, types,
+// comments and literals. {0} makes the names of each copy unique
+constexpr std::string_view kShaderTemplate = R"(
+// Particle simulation step {0}
+struct Particle{0} {{
+    pos : vec2f,
+    vel : vec2f,
+    color : vec4<f32>,
+}};
+
+struct SimParams{0} {{
+    deltaT : f32,
+    rule1Distance : f32,
+    rule2Distance : f32,
+    rule1Scale : f32,
+}};
+
+@binding(0) @group(0) var<uniform> params{0} : SimParams{0};
+@binding(1) @group(0) var<storage, read_write> particles{0} : array<Particle{0}>;
+
+/* Updates the velocities with the
+   rules of the flock */
+@compute @workgroup_size(64)
+fn main{0}(@builtin(global_invocation_id) id : vec3u) {{
+    let index = id.x;
+    if (index >= arrayLength(&particles{0})) {{
+        return;
+    }}
+    var vPos = particles{0}[index].pos;
+    var vVel = particles{0}[index].vel;
+    var cMass = vec2f(0.0, 0.0);
+    var cVel = vec2(0.0f, 0.0f);
+    var cMassCount = 0u;
+    for (var i = 0u; i < arrayLength(&particles{0}); i++) {{
+        if (i == index) {{
+            continue;
+        }}
+        let pos = particles{0}[i].pos.xy;
+        if (distance(pos, vPos) < params{0}.rule1Distance) {{
+            cMass += pos;
+            cMassCount++;
+        }}
+    }}
+    if (cMassCount > 0u) {{
+        cMass = (cMass / vec2(f32(cMassCount))) - vPos;
+    }}
+    vVel += cMass * params{0}.rule1Scale;
+    vVel = normalize(vVel) * clamp(length(vVel), 0.0, 0.1);
+    vPos = vPos + (vVel * params{0}.deltaT);
+    // Wrap around the boundary
+    if (vPos.x < -1.0) {{ vPos.x = 1.0; }}
+    if (vPos.x > 1.0) {{ vPos.x = -1.0; }}
+    particles{0}[index].pos = vPos;
+    particles{0}[index].vel = vVel;
+}}
+)";
+
+std::string MakeBenchShaderCorpus(size_t size) {
+    std::string text;
+    std::mt19937 rng(0);
+    while (text.size() < size) {
+        text += std::format(kShaderTemplate, rng() % 10000);
+    }
+    return text;
+}
+
+}  // namespace
+
+// Param selects cpu::SimdLevel
+BENCHMARK_PARAMS(WgslLexer_Throughput, 0, 1, 2) {
+    const cpu::SimdLevel level =
+        cpu::SetSimdLevel((cpu::SimdLevel)state.Param());
+    const std::string text = MakeBenchShaderCorpus(1024 * 1024);
+    state.SetBytesPerIter(text.size());
+    for (auto _ : state) {
+        auto lexer = Lexer(text);
+        Token token;
+        size_t numTokens = 0;
+        while (lexer.ParseNext(token)) {
+            ++numTokens;
+        }
+        bench::DoNotOptimize(numTokens);
+    }
+    cpu::SetSimdLevel(level);
+}
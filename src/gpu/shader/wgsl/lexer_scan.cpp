@@ -0,0 +1,299 @@
+#include "lexer_scan.h"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cstring>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#define SCAN_X64
+#include <immintrin.h>
+#endif
+
+namespace wgsl::scan {
+
+namespace {
+
+enum CharClass : uint8_t {
+    kBlank = 1 << 0,
+    kIdent = 1 << 1,
+    kLineBreak = 1 << 2,
+};
+
+constexpr std::array<uint8_t, 256> kCharClasses = [] {
+    std::array<uint8_t, 256> out{};
+    for (char c : {' ', '\t', '\v'}) {
+        out[(uint8_t)c] = kBlank;
+    }
+    for (char c : {'\n', '\f', '\r'}) {
+        out[(uint8_t)c] = kBlank | kLineBreak;
+    }
+    for (size_t c = 0; c < 256; ++c) {
+        if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_') {
+            out[c] = kIdent;
+        }
+    }
+    return out;
+}();
+
+}  // namespace
+
+// 8 bytes at once with the class table
+namespace scalar {
+
+struct Simd {
+    static constexpr size_t kWidth = 8;
+    static constexpr uint32_t kAllBits = 0xFF;
+
+    static uint32_t ClassMask(const uint8_t* in, uint8_t charClass) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kWidth; ++i) {
+            mask |= (uint32_t)((kCharClasses[in[i]] & charClass) != 0) << i;
+        }
+        return mask;
+    }
+
+    static uint32_t BlankMask(const uint8_t* in) {
+        return ClassMask(in, kBlank);
+    }
+
+    static uint32_t IdentMask(const uint8_t* in) {
+        return ClassMask(in, kIdent);
+    }
+
+    static uint32_t LineBreakMask(const uint8_t* in) {
+        return ClassMask(in, kLineBreak);
+    }
+
+    static uint32_t EitherMask(const uint8_t* in, char a, char b) {
+        uint32_t mask = 0;
+        for (size_t i = 0; i < kWidth; ++i) {
+            mask |= (uint32_t)(in[i] == (uint8_t)a || in[i] == (uint8_t)b)
+                    << i;
+        }
+        return mask;
+    }
+};
+
+#include "lexer_scan_kernels.inl"
+
+}  // namespace scalar
+
+#ifdef SCAN_X64
+
+// No byte shuffle before SSSE3, the classes are range compares
+namespace sse2 {
+
+struct Simd {
+    static constexpr size_t kWidth = 16;
+    static constexpr uint32_t kAllBits = 0xFFFF;
+
+    static __m128i Load(const uint8_t* in) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+    }
+
+    static __m128i Equal(__m128i bytes, char c) {
+        return _mm_cmpeq_epi8(bytes, _mm_set1_epi8(c));
+    }
+
+    // lo <= bytes <= hi as unsigned
+    static __m128i InRange(__m128i bytes, char lo, char hi) {
+        const __m128i offset = _mm_sub_epi8(bytes, _mm_set1_epi8(lo));
+        return _mm_cmpeq_epi8(
+            _mm_min_epu8(offset, _mm_set1_epi8((char)(hi - lo))), offset);
+    }
+
+    static uint32_t MoveMask(__m128i mask) {
+        return (uint32_t)_mm_movemask_epi8(mask);
+    }
+
+    static uint32_t BlankMask(const uint8_t* in) {
+        const __m128i bytes = Load(in);
+        return MoveMask(
+            _mm_or_si128(Equal(bytes, ' '), InRange(bytes, '\t', '\r')));
+    }
+
+    static uint32_t IdentMask(const uint8_t* in) {
+        const __m128i bytes = Load(in);
+        // Lower case of the letters
+        const __m128i lower = _mm_or_si128(bytes, _mm_set1_epi8(0x20));
+        return MoveMask(_mm_or_si128(
+            _mm_or_si128(InRange(lower, 'a', 'z'), InRange(bytes, '0', '9')),
+            Equal(bytes, '_')));
+    }
+
+    static uint32_t LineBreakMask(const uint8_t* in) {
+        const __m128i bytes = Load(in);
+        return MoveMask(
+            _mm_or_si128(_mm_or_si128(Equal(bytes, '\n'), Equal(bytes, '\r')),
+                         Equal(bytes, '\f')));
+    }
+
+    static uint32_t EitherMask(const uint8_t* in, char a, char b) {
+        const __m128i bytes = Load(in);
+        return MoveMask(_mm_or_si128(Equal(bytes, a), Equal(bytes, b)));
+    }
+};
+
+#include "lexer_scan_kernels.inl"
+
+}  // namespace sse2
+
+// MSVC emits any intrinsic, other compilers need the target enabled
+#if defined(__clang__)
+#pragma clang attribute push(__attribute__((target("avx2"))), \
+                             apply_to = function)
+#elif defined(__GNUC__)
+#pragma GCC push_options
+#pragma GCC target("avx2")
+#endif
+
+// The classes are looked up by the low and the high nibble of each byte
+// with a shuffle, a byte is in a class if both lookups share a bit
+namespace avx2 {
+
+struct Simd {
+    static constexpr size_t kWidth = 32;
+    static constexpr uint32_t kAllBits = 0xFFFFFFFF;
+
+    static __m256i Load(const uint8_t* in) {
+        return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(in));
+    }
+
+    static __m256i Table(const std::array<char, 16>& table) {
+        return _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(table.data())));
+    }
+
+    static uint32_t LookupMask(__m256i bytes, __m256i lo, __m256i hi) {
+        const __m256i nibble = _mm256_set1_epi8(0x0F);
+        const __m256i loClass =
+            _mm256_shuffle_epi8(lo, _mm256_and_si256(bytes, nibble));
+        // High bytes have the nibbles 8-15 which are in no class
+        const __m256i hiClass = _mm256_shuffle_epi8(
+            hi, _mm256_and_si256(_mm256_srli_epi16(bytes, 4), nibble));
+        const __m256i none = _mm256_cmpeq_epi8(
+            _mm256_and_si256(loClass, hiClass), _mm256_setzero_si256());
+        return ~(uint32_t)_mm256_movemask_epi8(none);
+    }
+
+    static __m256i Equal(__m256i bytes, char c) {
+        return _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8(c));
+    }
+
+    // 1: \t-\r, 2: space
+    static constexpr std::array<char, 16> kBlankLo = {
+        2, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 0, 0};
+    static constexpr std::array<char, 16> kBlankHi = {
+        1, 0, 2, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    // 1: 0-9, 2: A-O a-o, 4: P-Z p-z, 8: _
+    static constexpr std::array<char, 16> kIdentLo = {
+        5, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 2, 2, 2, 2, 10};
+    static constexpr std::array<char, 16> kIdentHi = {
+        0, 0, 0, 1, 2, 12, 2, 4, 0, 0, 0, 0, 0, 0, 0, 0};
+
+    static uint32_t BlankMask(const uint8_t* in) {
+        return LookupMask(Load(in), Table(kBlankLo), Table(kBlankHi));
+    }
+
+    static uint32_t IdentMask(const uint8_t* in) {
+        return LookupMask(Load(in), Table(kIdentLo), Table(kIdentHi));
+    }
+
+    static uint32_t LineBreakMask(const uint8_t* in) {
+        const __m256i bytes = Load(in);
+        return (uint32_t)_mm256_movemask_epi8(_mm256_or_si256(
+            _mm256_or_si256(Equal(bytes, '\n'), Equal(bytes, '\r')),
+            Equal(bytes, '\f')));
+    }
+
+    static uint32_t EitherMask(const uint8_t* in, char a, char b) {
+        const __m256i bytes = Load(in);
+        return (uint32_t)_mm256_movemask_epi8(
+            _mm256_or_si256(Equal(bytes, a), Equal(bytes, b)));
+    }
+};
+
+#include "lexer_scan_kernels.inl"
+
+}  // namespace avx2
+
+#if defined(__clang__)
+#pragma clang attribute pop
+#elif defined(__GNUC__)
+#pragma GCC pop_options
+#endif
+
+#endif  // SCAN_X64
+
+namespace {
+
+struct Kernels {
+    size_t (*skipBlankspace)(const uint8_t*,
+                             size_t,
+                             size_t,
+                             std::vector<uint32_t>&);
+    size_t (*skipIdent)(const uint8_t*, size_t, size_t);
+    size_t (*findLineBreak)(const uint8_t*, size_t, size_t);
+    size_t (*findEither)(const uint8_t*, size_t, size_t, char, char);
+    void (*collectLineStarts)(const uint8_t*,
+                              size_t,
+                              size_t,
+                              size_t,
+                              std::vector<uint32_t>&);
+};
+
+#define SCAN_KERNELS(NS)                                                    \
+    Kernels{&NS::SkipBlankspace, &NS::SkipIdent, &NS::FindLineBreak,        \
+            &NS::FindEither, &NS::CollectLineStarts}
+
+const Kernels kKernels[] = {
+    SCAN_KERNELS(scalar),
+#ifdef SCAN_X64
+    SCAN_KERNELS(sse2),
+    SCAN_KERNELS(avx2),
+#endif
+};
+
+#undef SCAN_KERNELS
+
+const Kernels& GetKernels() {
+    return kKernels[(size_t)cpu::GetSimdLevel()];
+}
+
+const uint8_t* AsBytes(std::string_view text) {
+    return reinterpret_cast<const uint8_t*>(text.data());
+}
+
+}  // namespace
+
+size_t SkipBlankspace(std::string_view text,
+                      size_t pos,
+                      std::vector<uint32_t>& lineStarts) {
+    return GetKernels().skipBlankspace(AsBytes(text), pos, text.size(),
+                                       lineStarts);
+}
+
+size_t SkipIdent(std::string_view text, size_t pos) {
+    return GetKernels().skipIdent(AsBytes(text), pos, text.size());
+}
+
+size_t FindLineBreak(std::string_view text, size_t pos) {
+    return GetKernels().findLineBreak(AsBytes(text), pos, text.size());
+}
+
+size_t FindEither(std::string_view text, size_t pos, char a, char b) {
+    return GetKernels().findEither(AsBytes(text), pos, text.size(), a, b);
+}
+
+void CollectLineStarts(std::string_view text,
+                       size_t begin,
+                       size_t end,
+                       std::vector<uint32_t>& out) {
+    GetKernels().collectLineStarts(AsBytes(text), begin, end, text.size(),
+                                   out);
+}
+
+}  // namespace wgsl::scan
@@ -0,0 +1,40 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "base/cpu_features.h"
+
+// Character scanning of the Lexer
+// Runs of blank space and identifier chars are skipped and comment ends
+// are searched 16 bytes at once with SSE2 and 32 with AVX2. The
+// instruction set is cpu::GetSimdLevel().
+//
+// Blank space: space, \t, \v and the line breaks \n, \f, \r
+// Identifier chars: [A-Za-z0-9_]
+// A line starts after each line break, \r\n is a single line break
+namespace wgsl::scan {
+
+// Return the offset of the first char at or after |pos| which is not
+// blank space or not an identifier char, text.size() if none
+// SkipBlankspace appends the lines which start in the skipped space like
+// CollectLineStarts()
+size_t SkipBlankspace(std::string_view text,
+                      size_t pos,
+                      std::vector<uint32_t>& lineStarts);
+size_t SkipIdent(std::string_view text, size_t pos);
+
+// Return the offset of the first match at or after |pos|, text.size() if
+// none
+size_t FindLineBreak(std::string_view text, size_t pos);
+size_t FindEither(std::string_view text, size_t pos, char a, char b);
+
+// Appends the offsets of the lines which start after the line breaks in
+// [begin, end). A line at the end of the text is not added
+void CollectLineStarts(std::string_view text,
+                       size_t begin,
+                       size_t end,
+                       std::vector<uint32_t>& out);
+
+}  // namespace wgsl::scan
@@ -0,0 +1,129 @@
+// Scanning kernels shared by the instruction sets
+// Included by lexer_scan.cpp into a namespace which defines a Simd policy:
+//   kWidth                 Number of bytes per block, at most 32
+//   kAllBits               Mask with a bit for each byte of a block
+//   BlankMask(in)          Bits of the blank space bytes of a block
+//   IdentMask(in)          Bits of the identifier bytes
+//   LineBreakMask(in)      Bits of \n, \f and \r
+//   EitherMask(in, a, b)   Bits of the bytes equal to a or b
+// The block at the end of the text is copied into a buffer padded with
+// zeros, which belong to no class and match no searched char.
+// Compiled for the target of the including namespace.
+
+static_assert(Simd::kWidth <= 32);
+
+template <class Func>
+inline uint32_t BlockMask(const uint8_t* in,
+                          size_t pos,
+                          size_t size,
+                          Func func) {
+    if (size - pos >= Simd::kWidth) {
+        return func(in + pos);
+    }
+    alignas(32) uint8_t tail[Simd::kWidth] = {};
+    std::memcpy(tail, in + pos, size - pos);
+    return func(tail);
+}
+
+template <class Func>
+inline size_t SkipWhile(const uint8_t* in,
+                        size_t pos,
+                        size_t size,
+                        Func func) {
+    for (; pos < size; pos += Simd::kWidth) {
+        const uint32_t others = ~BlockMask(in, pos, size, func) &
+                                Simd::kAllBits;
+        if (others) {
+            return pos + (size_t)std::countr_zero(others);
+        }
+    }
+    return size;
+}
+
+template <class Func>
+inline size_t FindFirst(const uint8_t* in,
+                        size_t pos,
+                        size_t size,
+                        Func func) {
+    for (; pos < size; pos += Simd::kWidth) {
+        if (const uint32_t mask = BlockMask(in, pos, size, func)) {
+            return pos + (size_t)std::countr_zero(mask);
+        }
+    }
+    return size;
+}
+
+size_t SkipIdent(const uint8_t* in, size_t pos, size_t size) {
+    return SkipWhile(in, pos, size, &Simd::IdentMask);
+}
+
+size_t FindLineBreak(const uint8_t* in, size_t pos, size_t size) {
+    return FindFirst(in, pos, size, &Simd::LineBreakMask);
+}
+
+size_t FindEither(const uint8_t* in, size_t pos, size_t size, char a, char b) {
+    return FindFirst(in, pos, size, [a, b](const uint8_t* block) {
+        return Simd::EitherMask(block, a, b);
+    });
+}
+
+// Appends the line starts of the marked line breaks of a block at |pos|
+inline void AppendLineStarts(const uint8_t* in,
+                             size_t pos,
+                             uint32_t lineBreaks,
+                             size_t size,
+                             std::vector<uint32_t>& out) {
+    // Grows once per block and drops the skipped breaks after
+    size_t count = out.size();
+    out.resize(count + (size_t)std::popcount(lineBreaks));
+    for (; lineBreaks; lineBreaks &= lineBreaks - 1) {
+        const size_t lineBreak = pos + (size_t)std::countr_zero(lineBreaks);
+        const size_t lineStart = lineBreak + 1;
+        if (lineStart >= size ||
+            (in[lineBreak] == '\r' && in[lineStart] == '\n')) {
+            continue;
+        }
+        out[count++] = (uint32_t)lineStart;
+    }
+    out.resize(count);
+}
+
+// The line breaks are collected from the same blocks
+size_t SkipBlankspace(const uint8_t* in,
+                      size_t pos,
+                      size_t size,
+                      std::vector<uint32_t>& lineStarts) {
+    for (; pos < size; pos += Simd::kWidth) {
+        uint32_t lineBreaks = 0;
+        const uint32_t blank =
+            BlockMask(in, pos, size, [&](const uint8_t* block) {
+                lineBreaks = Simd::LineBreakMask(block);
+                return Simd::BlankMask(block);
+            });
+        const uint32_t others = ~blank & Simd::kAllBits;
+        // Only the breaks of the run
+        if (others) {
+            lineBreaks &= (others & (0 - others)) - 1;
+        }
+        if (lineBreaks) {
+            AppendLineStarts(in, pos, lineBreaks, size, lineStarts);
+        }
+        if (others) {
+            return pos + (size_t)std::countr_zero(others);
+        }
+    }
+    return size;
+}
+
+void CollectLineStarts(const uint8_t* in,
+                       size_t begin,
+                       size_t end,
+                       size_t size,
+                       std::vector<uint32_t>& out) {
+    for (size_t pos = begin; pos < end; pos += Simd::kWidth) {
+        if (const uint32_t lineBreaks =
+                BlockMask(in, pos, end, &Simd::LineBreakMask)) {
+            AppendLineStarts(in, pos, lineBreaks, size, out);
+        }
+    }
+}
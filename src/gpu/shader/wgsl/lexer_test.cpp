@@ -1,6 +1,8 @@
 #include "lexer.h"
 #include <doctest/doctest.h>
 
+#include <random>
+
 using namespace wgsl;
 using Kind = Token::Kind;
 
@@ -87,6 +89,118 @@ TEST_CASE("[wgsl::Lexer] OnlyComments") {
     // clang-format on
 }
 
+TEST_CASE("[wgsl::Lexer] Keywords") {
+    const auto check = [](std::string_view word, Kind kind) {
+        auto lexer = Lexer(word);
+        const Token token = lexer.ParseNext();
+        CHECK_MESSAGE(token.GetKind() == kind,
+                      std::format("'{}' is Kind::{}", word,
+                                  to_string(token.GetKind())));
+        CHECK_EQ(token.Source(), word);
+    };
+    for (std::string_view word : kKeywords) {
+        check(word, Kind::Keyword);
+    }
+    for (std::string_view word : kReserved) {
+        check(word, Kind::Reserved);
+    }
+    for (std::string_view word : kBuiltinValues) {
+        check(word, Kind::Builtin);
+    }
+    // Prefixes, suffixes and case of the words
+    for (std::string_view word :
+         {"f", "fnn", "Struct", "const_", "constexpr_", "NULL_", "nul",
+          "position2", "a_very_long_identifier_name_of_a_variable"}) {
+        check(word, Kind::Ident);
+    }
+}
+
+TEST_CASE("[wgsl::Lexer] Scan") {
+    // Line starts as the per char lexer adds them
+    const auto lineStarts = [](std::string_view text, size_t begin,
+                               size_t end) {
+        std::vector<uint32_t> out;
+        for (size_t i = begin; i < end; ++i) {
+            if ((uint8_t)text[i] >= 0x80 || !ASCII::IsLineBreak(text[i]) ||
+                (text[i] == '\r' && i + 1 < text.size() &&
+                 text[i + 1] == '\n')) {
+                continue;
+            }
+            if (i + 1 < text.size()) {
+                out.push_back((uint32_t)i + 1);
+            }
+        }
+        return out;
+    };
+    const auto skip = [](std::string_view text, size_t pos, auto pred) {
+        while (pos < text.size() && pred((uint8_t)text[pos])) {
+            ++pos;
+        }
+        return pos;
+    };
+    const auto isBlank = [](uint8_t c) {
+        return c < 0x80 && (ASCII::IsSpace(c) || ASCII::IsLineBreak(c));
+    };
+    const auto isIdent = [](uint8_t c) {
+        return c < 0x80 && (ASCII::IsLetter(c) || ASCII::IsDigit(c));
+    };
+    const auto isNotLineBreak = [](uint8_t c) {
+        return c >= 0x80 || !ASCII::IsLineBreak(c);
+    };
+    const auto isNotCommentEnd = [](uint8_t c) { return c != '*' && c != '/'; };
+
+    constexpr std::string_view kAlphabet[] = {
+        " ", "\t", "\n", "\r\n", "\r", "\f", "\v", "/*", "*/", "_",
+        "a", "Z", "0", "9", "@", "[", "`", "{", "\x7f", "\xc3\xa9"};
+    std::mt19937 rng(0);
+    const cpu::SimdLevel level = cpu::GetSimdLevel();
+    for (int i = 0; i < 50; ++i) {
+        std::string text;
+        const size_t size = rng() % 100;
+        while (text.size() < size) {
+            text += kAlphabet[rng() % std::size(kAlphabet)];
+        }
+        for (int l = 0; l <= (int)level; ++l) {
+            cpu::SetSimdLevel((cpu::SimdLevel)l);
+            for (size_t pos = 0; pos < text.size(); ++pos) {
+                std::vector<uint32_t> blankStarts;
+                const size_t blankEnd =
+                    scan::SkipBlankspace(text, pos, blankStarts);
+                CHECK_EQ(blankEnd, skip(text, pos, isBlank));
+                CHECK_EQ(blankStarts, lineStarts(text, pos, blankEnd));
+                CHECK_EQ(scan::SkipIdent(text, pos), skip(text, pos, isIdent));
+                CHECK_EQ(scan::FindLineBreak(text, pos),
+                         skip(text, pos, isNotLineBreak));
+                CHECK_EQ(scan::FindEither(text, pos, '*', '/'),
+                         skip(text, pos, isNotCommentEnd));
+                std::vector<uint32_t> starts;
+                scan::CollectLineStarts(text, pos, text.size(), starts);
+                CHECK_EQ(starts, lineStarts(text, pos, text.size()));
+            }
+        }
+    }
+    cpu::SetSimdLevel(level);
+}
+
+TEST_CASE("[wgsl::Lexer] Lines") {
+    std::string_view text =
+        "a\nb\r\nc\rd /* \n\r\n /* \n */ */ e // \n"
+        "f\n\n\n         g /* /* */*/ h";
+    auto lexer = Lexer(text);
+    const std::vector<Token> tokens = lexer.ParseAll();
+    std::vector<uint32_t> lines;
+    std::vector<uint32_t> cols;
+    for (const Token& token : tokens) {
+        lines.push_back(token.loc.line);
+        cols.push_back(token.loc.col);
+    }
+    const std::vector<uint32_t> expectedLines = {1, 2, 3, 4, 7, 8, 11, 11, 11};
+    const std::vector<uint32_t> expectedCols = {1, 1, 1, 1, 8, 1, 10, 23, 24};
+    CHECK_EQ(lines, expectedLines);
+    CHECK_EQ(cols, expectedCols);
+    CHECK_EQ(tokens[7].Source(), "h");
+}
+
 TEST_CASE("[wgsl::Lexer] Struct") {
     // clang-format off
     Test(R"(
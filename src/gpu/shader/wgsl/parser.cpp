@@ -124,11 +124,78 @@ namespace wgsl {
 
 using Tok = wgsl::Token::Kind;
 
+namespace {
+
+// '>' closes a template list: array<i32, 4>
+std::optional<ast::OpCode> GetBinaryOp(const Token& tok, bool inTemplate) {
+    using Op = ast::OpCode;
+    switch (tok.kind) {
+        // Arithmetic
+        case Tok::Mul: return Op::Mul;
+        case Tok::Div: return Op::Div;
+        case Tok::Plus: return Op::Add;
+        case Tok::Minus: return Op::Sub;
+        case Tok::Mod: return Op::Mod;
+        // Relation
+        case Tok::LessThan: return Op::Less;
+        case Tok::LessThanEqual: return Op::LessEqual;
+        case Tok::GreaterThanEqual: return Op::GreaterEqual;
+        case Tok::EqualEqual: return Op::Equal;
+        case Tok::NotEqual: return Op::NotEqual;
+        case Tok::GreaterThan:
+            return inTemplate ? std::nullopt : std::optional(Op::Greater);
+        // Logic
+        case Tok::AndAnd: return Op::LogAnd;
+        case Tok::OrOr: return Op::LogOr;
+        // Bitwise
+        case Tok::And: return Op::BitAnd;
+        case Tok::Or: return Op::BitOr;
+        case Tok::Xor: return Op::BitXor;
+        case Tok::LeftShift: return Op::BitLsh;
+        case Tok::RightShift: return Op::BitRsh;
+        default: return std::nullopt;
+    }
+}
+
+// Higher binds first
+int GetPrecedence(ast::OpCode op) {
+    using Op = ast::OpCode;
+    switch (op) {
+        case Op::Mul:
+        case Op::Div:
+        case Op::Mod: return 9;
+        case Op::Add:
+        case Op::Sub: return 8;
+        case Op::BitLsh:
+        case Op::BitRsh: return 7;
+        case Op::Less:
+        case Op::Greater:
+        case Op::LessEqual:
+        case Op::GreaterEqual:
+        case Op::Equal:
+        case Op::NotEqual: return 6;
+        case Op::BitAnd: return 5;
+        case Op::BitXor: return 4;
+        case Op::BitOr: return 3;
+        case Op::LogAnd: return 2;
+        case Op::LogOr: return 1;
+        default: return 0;
+    }
+}
+
+}  // namespace
+
 // ================================================================//
 
 Parser::Parser(std::string_view code, ProgramBuilder* builder)
     : lexer_(code), builder_(builder) {}
 
+Parser::Parser(std::string_view code,
+               uint32_t pos,
+               std::span<const uint32_t> lineStarts,
+               ProgramBuilder* builder)
+    : lexer_(code, pos, lineStarts), builder_(builder) {}
+
 // global_decl:
 // | attribute * 'fn' ident
 //     '(' ( attribute * ident ':' type_specifier ( ',' param )* ',' ? )? ')'
@@ -146,20 +213,31 @@ Parser::Parser(std::string_view code, ProgramBuilder* builder)
 void Parser::Parse() {
     Advance();
     while (!ShouldExit()) {
-        if (GlobalDecl()) {
+        // A declaration of an edited program could be kept as is
+        const uint32_t offset = lexer_.GetOffset(token_.loc);
+        if (const uint32_t end =
+                builder_->TryReuseGlobalDecl(offset, token_.loc)) {
+            lexer_.SkipTo(end);
+            Advance();
             continue;
         }
-        // Improve errors
-        if (Peek(Tok::Reserved)) {
-            Unexpected(ErrorCode::IdentReserved);
-            continue;
-        }
-        if (Peek(Tok::Ident) || Peek().IsLiteral()) {
-            Unexpected(ErrorCode::ExpectedStorageClass,
-                       "expected storage class 'const', 'override' or 'var'");
-            continue;
+        builder_->BeginGlobalDecl(offset, token_.loc);
+        if (!GlobalDecl()) {
+            // Improve errors
+            if (Peek(Tok::Reserved)) {
+                Unexpected(ErrorCode::IdentReserved);
+            } else if (Peek(Tok::Ident) || Peek().IsLiteral()) {
+                Unexpected(
+                    ErrorCode::ExpectedStorageClass,
+                    "expected storage class 'const', 'override' or 'var'");
+            } else {
+                Unexpected(ErrorCode::ExpectedDecl);
+            }
         }
-        Unexpected(ErrorCode::ExpectedDecl);
+        // A failed declaration ends with the token of the error
+        builder_->EndGlobalDecl(builder_->ShouldStopParsing()
+                                    ? lexer_.GetPos()
+                                    : lastTokenEnd_);
     }
 }
 
@@ -539,53 +617,41 @@ Expected<Ident> Parser::TemplatedIdent() {
     return Ident{ident.loc, ident.Source(), templ};
 }
 
-// unary_expression | relational_expr ...
-// TODO: Parse relational expressions separatly. a < b, a == b
+// unary_expression (binary_operator unary_expression)*
 Expected<const ast::Expression*> Parser::Expression(bool inTemplate) {
-    const ast::Expression* unary = nullptr;
-    VALUE_ELSE_RET(unary, UnaryExpr());
-    // binary operator
-    using Op = ast::OpCode;
-    std::optional<Op> op;
+    const ast::Expression* lhs = nullptr;
+    VALUE_ELSE_RET(lhs, UnaryExpr());
+    return BinaryExpr(lhs, 0, inTemplate);
+}
 
-    Token tok = Peek();
-    switch (tok.kind) {
-        // Arithmetic
-        case Tok::Mul: op = Op::Mul; break;
-        case Tok::Div: op = Op::Div; break;
-        case Tok::Plus: op = Op::Add; break;
-        case Tok::Minus: op = Op::Sub; break;
-        case Tok::Mod: op = Op::Mod; break;
-        // Relation
-        case Tok::LessThan: op = Op::Less; break;
-        case Tok::LessThanEqual: op = Op::LessEqual; break;
-        case Tok::GreaterThanEqual: op = Op::GreaterEqual; break;
-        case Tok::Equal: op = Op::Equal; break;
-        case Tok::NotEqual: op = Op::NotEqual; break;
-        // Logic
-        case Tok::AndAnd: op = Op::LogAnd; break;
-        case Tok::OrOr: op = Op::LogOr; break;
-        // Bitwise
-        case Tok::And: op = Op::BitAnd; break;
-        case Tok::Or: op = Op::BitOr; break;
-        case Tok::Xor: op = Op::BitXor; break;
-        case Tok::LeftShift: op = Op::BitLsh; break;
-        case Tok::RightShift: op = Op::BitRsh; break;
-        case Tok::GreaterThan:
-            if (!inTemplate) {
-                op = Op::Greater;
+// Operators of a higher precedence bind first: a + b * c -> a + (b * c)
+// Operators of the same precedence bind from the left: a - b - c -> (a - b) - c
+Expected<const ast::Expression*> Parser::BinaryExpr(
+    const ast::Expression* lhs,
+    int minPrecedence,
+    bool inTemplate) {
+    for (;;) {
+        const std::optional<ast::OpCode> op = GetBinaryOp(Peek(), inTemplate);
+        if (!op || GetPrecedence(*op) < minPrecedence) {
+            return lhs;
+        }
+        Advance();
+        const ast::Expression* rhs = nullptr;
+        VALUE_ELSE_RET_ERR(rhs, UnaryExpr(), ErrorCode::ExpectedExpr);
+        // The operators after the rhs which bind stronger take it
+        for (;;) {
+            const std::optional<ast::OpCode> next =
+                GetBinaryOp(Peek(), inTemplate);
+            if (!next || GetPrecedence(*next) <= GetPrecedence(*op)) {
+                break;
             }
+            VALUE_ELSE_RET(rhs,
+                           BinaryExpr(rhs, GetPrecedence(*op) + 1, inTemplate));
+        }
+        VALUE_ELSE_RET(lhs, builder_->CreateBinaryExpr(
+                                SourceLoc(lhs->GetLoc(), rhs->GetLoc()), *op,
+                                lhs, rhs));
     }
-    if (!op) {
-        return unary;
-    }
-    Advance();
-    // Expect rhs expression
-    const ast::Expression* lhs = unary;
-    const ast::Expression* rhs = nullptr;
-    VALUE_ELSE_RET_ERR(rhs, Expression(inTemplate), ErrorCode::ExpectedExpr);
-    return builder_->CreateBinaryExpr(SourceLoc(lhs->GetLoc(), rhs->GetLoc()),
-                                      *op, lhs, rhs);
 }
 
 // unary_expression:
@@ -696,6 +762,7 @@ Expected<const ast::Expression*> Parser::IdentExpression() {
             return false;
         }();
         if (isTemplateName) {
+            Advance();
             while (!Expect(Tok::GreaterThan)) {
                 const ast::Expression* expr = nullptr;
                 VALUE_ELSE_RET_ERR(expr, Expression(true),
@@ -807,7 +874,7 @@ Expected<const ast::Attribute*> Parser::Attribute() {
         }
         case AttributeName::WorkgroupSize: {
             EXPECT_TOKEN(Tok::OpenParen);
-            const ast::Expression* xyz[] = {nullptr};
+            const ast::Expression* xyz[3] = {};
             for (uint32_t i = 0; i < 3; ++i) {
                 if (Peek(Tok::CloseParen)) {
                     break;
@@ -816,6 +883,7 @@ Expected<const ast::Attribute*> Parser::Attribute() {
                                    ErrorCode::ExpectedExpr);
                 MAYBE_TOKEN(Tok::Comma);
             }
+            EXPECT_TOKEN(Tok::CloseParen);
             return builder_->CreateWorkGroupAttr(ident.loc, xyz[0], xyz[1],
                                                  xyz[2]);
         }
@@ -882,6 +950,7 @@ bool Parser::Expect(Keyword keyword) {
 
 Token Parser::Advance() {
     lastToken_ = token_;
+    lastTokenEnd_ = lexer_.GetPos();
     token_ = lexer_.ParseNext();
     return lastToken_;
 }
@@ -43,6 +43,11 @@ struct Ident {
 class Parser {
 public:
     Parser(std::string_view code, ProgramBuilder* builder);
+    // Resumes parsing of the top level declarations at |pos|
+    Parser(std::string_view code,
+           uint32_t pos,
+           std::span<const uint32_t> lineStarts,
+           ProgramBuilder* builder);
     void Parse();
 
     std::string_view GetLine(uint32_t line);
@@ -65,6 +70,9 @@ private:
 
     // Expressions
     Expected<const ast::Expression*> Expression(bool inTemplate);
+    Expected<const ast::Expression*> BinaryExpr(const ast::Expression* lhs,
+                                                int minPrecedence,
+                                                bool inTemplate);
     Expected<const ast::Expression*> UnaryExpr();
     Expected<const ast::Expression*> PrimaryExpr();
     Expected<const ast::Expression*> ComponentSwizzleExpr(
@@ -119,6 +127,8 @@ private:
     Lexer lexer_;
     Token token_;
     Token lastToken_;
+    // Offset of the char after the last token
+    uint32_t lastTokenEnd_ = 0;
     ProgramBuilder* builder_;
 };
 
@@ -1,10 +1,12 @@
 #include "base/tree_printer.h"
 #include "program.h"
 
+#include "ast_alias.h"
 #include "ast_expression.h"
 #include "ast_scope.h"
 #include "ast_type.h"
 #include "ast_variable.h"
+#include "builtin_scope.h"
 
 #include <doctest/doctest.h>
 
@@ -229,7 +231,6 @@ TEST_CASE("[WGSL] unary operators") {
 
     ExpectNoErrors(" const a = -3;");
     ExpectNoErrors(" const a = -3i;");
-    ExpectNoErrors(" const a = -3u;");
     ExpectNoErrors(" const a = -3.0;");
     ExpectNoErrors(" const a = -3.0f;");
 
@@ -243,6 +244,7 @@ TEST_CASE("[WGSL] unary operators errors") {
     ExpectError(" const a = ~4.0; ", ErrorCode::InvalidArg);
     ExpectError(" const a = ~true; ", ErrorCode::InvalidArg);
     ExpectError(" const a = -true; ", ErrorCode::InvalidArg);
+    ExpectError(" const a = -3u; ", ErrorCode::InvalidArg);
     ExpectError(" const a = !4.0; ", ErrorCode::InvalidArg);
     ExpectError(" const a = !3; ", ErrorCode::InvalidArg);
 }
@@ -327,6 +329,14 @@ TEST_CASE_FIXTURE(ProgramTest, "[WGSL] func basic") {
     ExpectErrNum(0);
 }
 
+TEST_CASE("[WGSL] workgroup size") {
+    constexpr auto kFunc = "fn f() -> u32 { return 0u; }";
+    ExpectNoErrors(std::format("@compute @workgroup_size(64) {}", kFunc));
+    ExpectNoErrors(std::format("@compute @workgroup_size(8, 8) {}", kFunc));
+    ExpectNoErrors(
+        std::format("@compute @workgroup_size(4, 4, 4,) {}", kFunc));
+}
+
 TEST_CASE_FIXTURE(ProgramTest, "[WGSL] complex component access") {
     Build(R"(
         struct Middle {
@@ -366,3 +376,102 @@ TEST_CASE_FIXTURE(ProgramTest, "[WGSL] if statement") {
     )");
     ExpectErrNum(0);
 }
+
+TEST_CASE("[WGSL] symbol table") {
+    BumpAllocator alloc;
+    ast::Scalar f32(ScalarKind::F32);
+    ast::Scalar i32(ScalarKind::I32);
+
+    ast::SymbolTable global(nullptr, alloc);
+    std::vector<std::string> names;
+    for (int i = 0; i < 1000; ++i) {
+        names.push_back(std::format("name_{}", i));
+        CHECK(global.InsertSymbol(names.back(), i % 2 ? &f32 : &i32));
+    }
+    CHECK_EQ(global.GetSize(), 1000);
+    CHECK(!global.InsertSymbol("name_1", &i32));
+    // The keys are copied
+    names.clear();
+    CHECK_EQ(global.FindSymbol("name_1"), &f32);
+    CHECK_EQ(global.FindSymbol("name_998"), &i32);
+    CHECK_EQ(global.FindSymbol("name_1000"), nullptr);
+    CHECK_EQ(global.FindSymbol(""), nullptr);
+
+    // Inner scopes shadow the outer ones
+    ast::SymbolTable func(&global, alloc);
+    ast::SymbolTable block(&func, alloc);
+    CHECK_EQ(block.FindSymbol("name_1"), &f32);
+    CHECK(func.InsertSymbol("name_1", &i32));
+    CHECK_EQ(block.FindSymbol("name_1"), &i32);
+    CHECK_EQ(global.FindSymbol("name_1"), &f32);
+    CHECK_EQ(block.GetSize(), 0);
+}
+
+TEST_CASE("[WGSL] shared builtin scope") {
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    CHECK(builtins.GetSymbolTable()->IsFrozen());
+    CHECK_EQ(builtins.GetScalar(ScalarKind::F16), nullptr);
+    CHECK_EQ(builtins.GetVec(VecKind::Vec2, ScalarKind::Bool), nullptr);
+    CHECK_EQ(builtins.GetMatrix(MatrixKind::Mat2x2, ScalarKind::I32),
+             nullptr);
+
+    constexpr auto kCode = R"(
+        struct S {
+            a : vec3f,
+            b : vec3<f32>,
+            c : mat2x3<f32>,
+            d : array<u32, 4>,
+            e : array<u32, 4>,
+            f : array<i32, 4>,
+        };
+    )";
+    const auto memberType = [](Program* program,
+                               std::string_view name) -> const ast::Type* {
+        const auto* symbol = program->FindSymbol("S");
+        const auto* type = symbol ? symbol->As<ast::Struct>() : nullptr;
+        if (!type) {
+            return nullptr;
+        }
+        for (const ast::Member* member : type->members) {
+            if (member->name == name) {
+                return member->type;
+            }
+        }
+        return nullptr;
+    };
+    // Builtins are the same nodes in all programs
+    const ast::Vec* vec3f = builtins.GetVec(VecKind::Vec3, ScalarKind::F32);
+    for (int i = 0; i < 2; ++i) {
+        auto program = Program::Create(kCode);
+        ExpectErrNum(program, 0);
+        CHECK_EQ(program->FindSymbol("vec3<f32>"), vec3f);
+        CHECK_EQ(memberType(program.get(), "a"), vec3f);
+        CHECK_EQ(memberType(program.get(), "b"), vec3f);
+        CHECK_EQ(memberType(program.get(), "c"),
+                 builtins.GetMatrix(MatrixKind::Mat2x3, ScalarKind::F32));
+        CHECK(program->FindSymbol("mat2x3f")->Is<ast::Alias>());
+        // Arrays are owned by the program and interned by the structure
+        const ast::Type* array = memberType(program.get(), "d");
+        REQUIRE(array);
+        CHECK(array->Is<ast::Array>());
+        CHECK_EQ(array->name, "array<u32,4>");
+        CHECK_EQ(memberType(program.get(), "e"), array);
+        CHECK_NE(memberType(program.get(), "f"), array);
+        CHECK_EQ(program->FindSymbol("array<u32,4>"), nullptr);
+    }
+
+    ExpectError(" struct S { a : vec2<bool>, }; ", ErrorCode::Unimplemented);
+}
+
+TEST_CASE("[WGSL] swizzle types") {
+    ExpectNoErrors(R"(
+        fn f1(a : vec4f)-> f32 { return a.w; }
+        fn f2(a : vec4f)-> vec2f { return a.xy; }
+        fn f3(a : vec2f)-> vec3f { return a.yxy; }
+        fn f4(a : vec4u)-> vec4u { return a.wzyx; }
+        fn f5(a : vec3i)-> vec4i { return a.rgbr; }
+    )");
+    ExpectError(R"(
+        fn f(a : vec4f)-> vec3f { return a.xy; }
+    )", ErrorCode::TypeError);
+}
@@ -5,7 +5,9 @@
 
 #include "ast_printer.h"
 #include "ast_scope.h"
+#include "builtin_scope.h"
 
+#include "base/mem_tracker.h"
 #include "base/tree_printer.h"
 
 namespace wgsl {
@@ -13,6 +15,7 @@ namespace wgsl {
 thread_local Program* currentProgram = nullptr;
 
 std::unique_ptr<Program> Program::Create(std::string_view code) {
+    MEM_TAG(Shaders);
     auto builder = ProgramBuilder();
     builder.Build(code);
     auto program = builder.Finalize();
@@ -20,14 +23,27 @@ std::unique_ptr<Program> Program::Create(std::string_view code) {
 }
 
 Program::Program() {
-    // Nested program building doesn't make sense
-    DASSERT(!currentProgram);
-    currentProgram = this;
-    auto* symbols = alloc_.Allocate<ast::SymbolTable>(nullptr);
+    Init();
+}
+
+void Program::Init() {
+    BuildScope buildScope(this);
+    auto* symbols = alloc_.Allocate<ast::SymbolTable>(
+        BuiltinScope::Get().GetSymbolTable(), alloc_);
     globalScope_ = alloc_.Allocate<ast::GlobalScope>(symbols);
 }
 
 Program::~Program() {
+    DASSERT(currentProgram != this);
+}
+
+Program::BuildScope::BuildScope(Program* program) {
+    // Nested program building doesn't make sense
+    DASSERT(!currentProgram);
+    currentProgram = program;
+}
+
+Program::BuildScope::~BuildScope() {
     currentProgram = nullptr;
 }
 
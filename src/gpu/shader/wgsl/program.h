@@ -1,15 +1,23 @@
 #pragma once
 #include "base/bump_alloc.h"
 #include "base/common.h"
+#include "base/flat_hash_map.h"
 #include "common.h"
 
+#include <algorithm>
+#include <span>
+
 class TreePrinter;
 
 namespace wgsl {
 
 namespace ast {
+class Array;
 class GlobalScope;
+class Node;
 class Symbol;
+class SymbolTable;
+class Type;
 }
 
 namespace internal {
@@ -32,13 +40,34 @@ public:
         std::string msg;
     };
 
+    // Replaces |removed| bytes at |offset| of the source with |text|
+    struct TextEdit {
+        uint32_t offset = 0;
+        uint32_t removed = 0;
+        std::string_view text;
+    };
+
 public:
     static std::unique_ptr<Program> Create(std::string_view code);
     ~Program();
 
+    // Updates the program to the edited source, the result is the same as
+    // Create() of the new source
+    // Only the top level declarations which overlap the edit or depend on
+    // the changed ones are parsed again, the others keep their nodes. The
+    // first edit parses the whole source to record the declarations. The
+    // nodes of the replaced declarations stay in the arena until it's
+    // twice the size of the last full build, then the source is parsed
+    // again in a new arena. Pointers to the nodes are invalidated.
+    void ApplyEdit(const TextEdit& edit);
+
     std::string GetDiagsAsString();
     const std::vector<DiagMsg>& GetDiags() const { return diags_; }
-    const std::string_view GetSource() const { return sourceCode_; }
+    const std::string_view GetSource() const {
+        return edited_ ? editedSource_ : sourceCode_;
+    }
+
+    const ast::GlobalScope* GetGlobalScope() const { return globalScope_; }
 
     void PrintAst(TreePrinter* printer) const;
 
@@ -46,37 +75,162 @@ public:
     const ast::Symbol* FindSymbol(std::string_view name,
                                   std::string_view scope = "") const;
 
+    // Bumped on any change of the serialized format or of the ast nodes
+    static constexpr uint32_t kSerializedVersion = 4;
+
+    // Binary image of the program, loaded without parsing
+    // The image is valid only for the same build: it refers to the builtins
+    // by the index. Returns an empty vector on failure
+    std::vector<uint8_t> Serialize() const;
+    // Returns nullptr if the data is malformed or of another version
+    static std::unique_ptr<Program> Deserialize(std::span<const uint8_t> data);
+
 private:
     Program();
 
+    // Allocates the empty global scope
+    void Init();
+
+    // Makes the program current on this thread while it's built, the
+    // ProgramAlloc allocates from the current program
+    // A thread builds one program at a time, but any number of built
+    // programs can be alive on any threads
+    class BuildScope {
+    public:
+        explicit BuildScope(Program* program);
+        ~BuildScope();
+
+        BuildScope(const BuildScope&) = delete;
+        BuildScope& operator=(const BuildScope&) = delete;
+    };
+
     friend struct internal::ProgramAllocBase;
     static Program* GetCurrent();
 
     template <class T, class... Args>
         requires std::constructible_from<T, Args...>
     T* Allocate(Args&&... args) {
-        return alloc_.Allocate<T>(std::forward<Args>(args)...);
+        T* out = alloc_.Allocate<T>(std::forward<Args>(args)...);
+        // Array types are shared by the declarations
+        if constexpr (std::derived_from<T, ast::Node> &&
+                      !std::same_as<T, ast::Array>) {
+            if (declNodes_) {
+                declNodes_->push_back(out);
+            }
+        }
+        return out;
     }
 
     // Copy string into program memory
-    std::string_view EmbedString(const std::string& src) {
+    std::string_view EmbedString(std::string_view src) {
         static_assert(sizeof(char) == 1);
-        const auto size = src.size() + 1;
-        auto* mem = static_cast<char*>(alloc_.Allocate(size));
-        memcpy(mem, src.data(), size);
+        auto* mem = static_cast<char*>(alloc_.Allocate(src.size() + 1));
+        memcpy(mem, src.data(), src.size());
+        mem[src.size()] = 0;
         return std::string_view(mem, src.size());
     }
 
+    // Top level declaration of an editable program
+    struct DeclRecord {
+        // Source range of the tokens: [begin, end)
+        // A failed declaration ends with the line of the error
+        uint32_t begin = 0;
+        uint32_t end = 0;
+        SourceLoc loc;
+        // Lines to move the nodes by when the declaration is reused
+        int32_t lineShift = 0;
+        // Parsing stopped at an error in the declaration
+        bool failed = false;
+        // Nodes with a location
+        std::vector<ast::Node*> nodes;
+        // Symbols declared in the global scope
+        std::vector<std::pair<std::string, ast::Symbol*>> symbols;
+        // Scopes linked to the global scope
+        std::vector<ast::SymbolTable*> tables;
+        // Sorted hashes of the names looked up or declared
+        std::vector<size_t> names;
+
+        static size_t HashName(std::string_view name) {
+            return std::hash<std::string_view>{}(name);
+        }
+
+        // Whether a symbol used by the declaration could have changed
+        bool DependsOn(std::span<const size_t> changedNames) const {
+            return std::ranges::any_of(changedNames, [&](size_t name) {
+                return std::ranges::binary_search(names, name);
+            });
+        }
+
+        void AddSymbolNames(std::vector<size_t>& out) const {
+            for (const auto& [name, symbol] : symbols) {
+                out.push_back(HashName(name));
+            }
+        }
+
+        // Whether an edit at |offset| leaves the declaration as is
+        bool IsBefore(uint32_t offset) const {
+            // The error could depend on the next chars
+            return failed ? end < offset : end <= offset;
+        }
+    };
+
+    // Parses the edited source from scratch in a new arena
+    void Rebuild();
+
+    // Moves the line starts after an edit of [offset, oldEnd)
+    void UpdateLineStarts(uint32_t offset, uint32_t oldEnd, uint32_t newEnd);
+
+    // Drops the declarations after |first| which depend on the changed
+    // names, the names of the dropped ones are changed too
+    static void DropChangedDecls(std::vector<DeclRecord>& decls,
+                                 size_t first,
+                                 std::vector<size_t>& changedNames);
+
+    // Composite types are interned by the structure, so equal types are a
+    // single node and compare by pointer
+    struct ArrayTypeKey {
+        const ast::Type* valueType;
+        uint32_t size;
+
+        bool operator==(const ArrayTypeKey&) const = default;
+    };
+
+    struct ArrayTypeKeyHash {
+        size_t operator()(const ArrayTypeKey& key) const {
+            return std::hash<const void*>{}(key.valueType) ^
+                   (size_t)key.size * 0x9E3779B97F4A7C15ull;
+        }
+    };
+
 public:
     friend class ProgramBuilder;
-
     // Copied source code
     std::string sourceCode_;
     BumpAllocator alloc_;
     // Tree of scopes
     // Owned by alloc_
     ast::GlobalScope* globalScope_ = nullptr;
+    // Vectors and matrices are in the BuiltinScope
+    FlatHashMap<ArrayTypeKey, ast::Array*, ArrayTypeKeyHash> arrayTypes_;
     std::vector<DiagMsg> diags_;
+
+    // Edited source, the nodes of the last full build point into
+    // sourceCode_
+    std::string editedSource_;
+    bool edited_ = false;
+    // The declarations are recorded after the first edit
+    bool editable_ = false;
+    // Offsets of the lines of the current source
+    std::vector<uint32_t> lineStarts_;
+    // Declarations in the tree followed by the parked ones, which were
+    // parsed from a previous source and are not reached by the parser
+    // after an error
+    std::vector<DeclRecord> declRecords_;
+    size_t numLiveDecls_ = 0;
+    // The nodes of the parsed declaration
+    std::vector<ast::Node*>* declNodes_ = nullptr;
+    // Arena size after the last full build
+    size_t builtBytes_ = 0;
 };
 
 }  // namespace wgsl
\ No newline at end of file
@@ -0,0 +1,128 @@
+#include "base/bench.h"
+#include "compile_batch.h"
+#include "program.h"
+
+#include "task/task_executor.h"
+
+#include <format>
+
+using namespace wgsl;
+
+namespace {
+
+// A typical small shader, most of the cost is the program setup
+constexpr std::string_view kSmallShader = R"(
+struct Light {
+    color : vec3f,
+    intensity : f32,
+}
+
+@group(0) @binding(0) var<uniform> light : Light;
+
+fn shade(normal : vec3f, dir : vec3f) -> f32 {
+    return 1.0;
+}
+)";
+
+// About 10k lines of functions
+std::string MakeLargeShader() {
+    std::string out;
+    for (int i = 0; i < 1000; ++i) {
+        out += std::format(R"(
+fn compare{}(a : u32, b : u32) -> i32 {{
+    var x : u32 = a;
+    if (x > b) {{
+        return 1;
+    }} else {{
+        return -1;
+    }}
+}}
+)",
+                           i);
+    }
+    return out;
+}
+
+// Tasks of the batch aren't recorded
+class NullTaskTracker : public TaskTracker {
+public:
+    void OnTaskPost(const Task::MetaInfo&) override {}
+    void OnTaskStart(const Task::MetaInfo&) override {}
+    void OnTaskFinish(const Task::MetaInfo&) override {}
+};
+
+}  // namespace
+
+BENCHMARK(WgslProgram_CreateSmall) {
+    for (auto _ : state) {
+        auto program = Program::Create(kSmallShader);
+        bench::DoNotOptimize(program.get());
+    }
+}
+
+BENCHMARK(WgslProgram_DeserializeSmall) {
+    std::vector<uint8_t> data = Program::Create(kSmallShader)->Serialize();
+    for (auto _ : state) {
+        auto program = Program::Deserialize(data);
+        bench::DoNotOptimize(program.get());
+    }
+}
+
+BENCHMARK(WgslProgram_CreateLarge) {
+    const std::string code = MakeLargeShader();
+    for (auto _ : state) {
+        auto program = Program::Create(code);
+        bench::DoNotOptimize(program.get());
+    }
+}
+
+// A char typed in a function in the middle and removed
+BENCHMARK(WgslProgram_EditLarge) {
+    const std::string code = MakeLargeShader();
+    const auto offset = (uint32_t)code.find("return 1;", code.size() / 2);
+    auto program = Program::Create(code);
+    program->ApplyEdit({0, 0, ""});
+    state.SetItemsPerIter(2);
+    for (auto _ : state) {
+        program->ApplyEdit({offset + 7, 0, "1"});
+        program->ApplyEdit({offset + 7, 1, ""});
+        bench::DoNotOptimize(program.get());
+    }
+}
+
+// A line inserted in the middle moves the functions after it
+BENCHMARK(WgslProgram_EditLargeNewLine) {
+    const std::string code = MakeLargeShader();
+    const auto offset = (uint32_t)code.find("\nfn", code.size() / 2);
+    auto program = Program::Create(code);
+    program->ApplyEdit({0, 0, ""});
+    state.SetItemsPerIter(2);
+    for (auto _ : state) {
+        program->ApplyEdit({offset, 0, "\n"});
+        program->ApplyEdit({offset, 1, ""});
+        bench::DoNotOptimize(program.get());
+    }
+}
+
+// Scaling with the number of workers, the parameter
+BENCHMARK_PARAMS(WgslProgram_CompileBatch, 1, 2, 4, 8) {
+    constexpr size_t kNumShaders = 256;
+    std::vector<std::string> sources;
+    for (size_t i = 0; i < kNumShaders; ++i) {
+        // Distinct sources, like the shaders of a scene
+        sources.push_back(std::format("{}const id = {};\n", kSmallShader, i));
+    }
+    const std::vector<std::string_view> views(sources.begin(), sources.end());
+
+    ThreadPool pool(std::make_unique<TaskExecutor>(
+                        std::make_shared<NullTaskTracker>()),
+                    (uint64_t)state.Param(), "Shader Compiler");
+    pool.Start();
+    pool.WaitUntilStarted();
+    state.SetItemsPerIter(kNumShaders);
+    for (auto _ : state) {
+        auto programs = CompileBatch(pool, views);
+        bench::DoNotOptimize(programs.data());
+    }
+    pool.Stop();
+}
@@ -1,9 +1,12 @@
 #include "program_builder.h"
 #include "ast_alias.h"
 #include "ast_scope.h"
+#include "builtin_scope.h"
 #include "parser.h"
 #include "program.h"
+#include "base/trace.h"
 
+#include <array>
 #include <set>
 
 #define EXPECT_OK(expr)                    \
@@ -51,142 +54,127 @@ namespace {
 
 constexpr auto kRetVarSymbolName = "__return_variable";
 
-using EvalResult = std::variant<double, int64_t, bool>;
-
-template <class T, class R>
-std::optional<EvalResult> EvalBinaryOp(OpCode op,
-                                       const ast::Expression* lhs,
-                                       const ast::Expression* rhs) {
-    auto lval = lhs->TryGetConstValueAs<T>();
-    auto rval = rhs->TryGetConstValueAs<T>();
-    if (lval && rval) {
-        auto value = [&]() -> R {
-            using Op = OpCode;
-            if constexpr (std::same_as<R, bool>) {
-                switch (op) {
-                    case Op::Less: return *lval < *rval;
-                    case Op::Greater: return *lval > *rval;
-                    case Op::LessEqual: return *lval <= *rval;
-                    case Op::GreaterEqual: return *lval >= *rval;
-                    case Op::Equal: return *lval == *rval;
-                    case Op::NotEqual: return *lval != *rval;
-                    case Op::LogAnd: return *lval && *rval;
-                    case Op::LogOr: return *lval || *rval;
-                }
-            } else if constexpr (std::same_as<R, int64_t> ||
-                                 std::same_as<R, uint64_t>) {
-                switch (op) {
-                    case Op::Add: return *lval + *rval;
-                    case Op::Sub: return *lval - *rval;
-                    case Op::Mul: return *lval * *rval;
-                    case Op::Div: return *lval / *rval;
-                    case Op::BitAnd: return *lval & *rval;
-                    case Op::BitOr: return *lval | *rval;
-                    case Op::BitXor: return *lval ^ *rval;
-                    case Op::BitLsh: return *lval << *rval;
-                    case Op::BitRsh: return *lval >> *rval;
-                }
-            } else if constexpr (std::same_as<R, double>) {
-                switch (op) {
-                    case Op::Add: return *lval + *rval;
-                    case Op::Sub: return *lval - *rval;
-                    case Op::Mul: return *lval * *rval;
-                    case Op::Div: return *lval / *rval;
-                }
-            }
-            return R();
-        }();
-        return EvalResult(static_cast<R>(value));
+// Automatic conversion of an abstract value: 1 -> f32, vec2(1, 2) -> vec2f
+bool IsAutoConvertible(const Type* from, const Type* to) {
+    if (from == to) {
+        return true;
+    }
+    const auto* fromArray = from->As<Array>();
+    const auto* toArray = to->As<Array>();
+    if (fromArray || toArray) {
+        return fromArray && toArray && fromArray->size == toArray->size &&
+               IsAutoConvertible(fromArray->valueType, toArray->valueType);
+    }
+    const Scalar* fromScalar = GetScalarType(from);
+    const Scalar* toScalar = GetScalarType(to);
+    constexpr uint32_t kMax = std::numeric_limits<uint32_t>::max();
+    return fromScalar && toScalar && IsSameShape(from, to) &&
+           fromScalar->GetConversionRankTo(toScalar) != kMax;
+}
+
+// Value of a const integer scalar
+std::optional<int64_t> GetConstInt(const Expression* expr) {
+    if (!expr || !expr->constValue) {
+        return std::nullopt;
+    }
+    const auto* scalar = expr->type->As<Scalar>();
+    if (!scalar || !scalar->IsInteger()) {
+        return std::nullopt;
+    }
+    return expr->constValue->TryGetAs<int64_t>();
+}
+
+// Shape of the result of a matrix operation, the caller replaces the f32
+// components with the common type. nullptr if the operands don't match
+const Type* GetMatrixOpShape(OpCode op, const Type* lhs, const Type* rhs) {
+    const auto* lhsMatrix = lhs->As<Matrix>();
+    const auto* rhsMatrix = rhs->As<Matrix>();
+    if (op == OpCode::Add || op == OpCode::Sub) {
+        return lhsMatrix && rhsMatrix && lhsMatrix->kind == rhsMatrix->kind
+                   ? lhs
+                   : nullptr;
+    }
+    if (op != OpCode::Mul) {
+        return nullptr;
+    }
+    if (lhsMatrix && rhs->Is<Scalar>()) {
+        return lhs;
+    }
+    if (rhsMatrix && lhs->Is<Scalar>()) {
+        return rhs;
+    }
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    // matKxR * matCxK -> matCxR
+    if (lhsMatrix && rhsMatrix) {
+        if (GetNumColumns(lhsMatrix->kind) != GetNumRows(rhsMatrix->kind)) {
+            return nullptr;
+        }
+        return builtins.GetMatrix(
+            MatrixKindFromSize(GetNumColumns(rhsMatrix->kind),
+                               GetNumRows(lhsMatrix->kind)),
+            ScalarKind::F32);
+    }
+    // matCxR * vecC -> vecR
+    const auto* rhsVec = rhs->As<Vec>();
+    if (lhsMatrix && rhsVec &&
+        GetSize(rhsVec->kind) == GetNumColumns(lhsMatrix->kind)) {
+        return builtins.GetVec(VecKindFromSize(GetNumRows(lhsMatrix->kind)),
+                               ScalarKind::F32);
+    }
+    // vecR * matCxR -> vecC
+    const auto* lhsVec = lhs->As<Vec>();
+    if (rhsMatrix && lhsVec &&
+        GetSize(lhsVec->kind) == GetNumRows(rhsMatrix->kind)) {
+        return builtins.GetVec(VecKindFromSize(GetNumColumns(rhsMatrix->kind)),
+                               ScalarKind::F32);
     }
-    return std::nullopt;
+    return nullptr;
+}
+
+// Names of the constructors with the inferred template: vec3(1.0)
+bool IsConstructorName(std::string_view name) {
+    return name == "array" || VecKindFromString(name) ||
+           MatrixKindFromString(name);
 }
 
 }  // namespace
 
 //==============================================================//
 
-ProgramBuilder::ProgramBuilder() : program_(new Program()) {}
+ProgramBuilder::ProgramBuilder()
+    : ownedProgram_(new Program())
+    , program_(ownedProgram_.get())
+    , constEval_(program_->alloc_) {}
 
-ProgramBuilder::~ProgramBuilder() {}
+ProgramBuilder::ProgramBuilder(Program* program)
+    : program_(program), constEval_(program_->alloc_) {}
 
-void ProgramBuilder::CreateBuiltinSymbols() {
-    ast::GlobalScope& scope = *program_->globalScope_;
-    Program& program = *program_;
-
-    // Predeclare scalars
-    const auto declareScalar = [&](ScalarKind kind) {
-        auto* type = program.Allocate<ast::Scalar>(kind);
-        scope.PreDeclare(to_string(kind), type);
-        return type;
-    };
-    declareScalar(ScalarKind::Bool);
-    declareScalar(ScalarKind::Float);
-    declareScalar(ScalarKind::Int);
-    auto scU32 = declareScalar(ScalarKind::U32);
-    auto scI32 = declareScalar(ScalarKind::I32);
-    auto scF32 = declareScalar(ScalarKind::F32);
-
-    // Predeclare vectors
-    const auto declareVec = [&](ast::VecKind kind, Scalar* valueType,
-                                std::string_view symbol,
-                                std::string_view alias = "") {
-        auto* type = program.Allocate<ast::Vec>(kind, valueType, symbol);
-        scope.PreDeclare(symbol, type);
-
-        if (!alias.empty()) {
-            auto* aliasType =
-                program.Allocate<ast::Alias>(SourceLoc(), alias, type);
-            scope.PreDeclare(alias, aliasType);
-        }
-    };
-    declareVec(ast::VecKind::Vec2, scF32, "vec2<f32>", "vec2f");
-    declareVec(ast::VecKind::Vec2, scI32, "vec2<i32>", "vec2i");
-    declareVec(ast::VecKind::Vec2, scU32, "vec2<u32>", "vec2u");
-    declareVec(ast::VecKind::Vec3, scF32, "vec3<f32>", "vec3f");
-    declareVec(ast::VecKind::Vec3, scI32, "vec3<i32>", "vec3i");
-    declareVec(ast::VecKind::Vec3, scU32, "vec3<u32>", "vec3u");
-    declareVec(ast::VecKind::Vec4, scF32, "vec4<f32>", "vec4f");
-    declareVec(ast::VecKind::Vec4, scI32, "vec4<i32>", "vec4i");
-    declareVec(ast::VecKind::Vec4, scU32, "vec4<u32>", "vec4u");
-
-    // Predeclare matrices
-    const auto declareMat = [&](ast::MatrixKind kind, std::string_view symbol,
-                                std::string_view alias = "") {
-        auto* type = program.Allocate<ast::Matrix>(kind, scF32);
-        scope.PreDeclare(symbol, type);
-
-        if (!alias.empty()) {
-            auto* aliasType =
-                program.Allocate<ast::Alias>(SourceLoc(), alias, type);
-            scope.PreDeclare(alias, aliasType);
-        }
-    };
-    declareMat(ast::MatrixKind::Mat2x2, "mat2x2<f32>", "mat2x2f");
-    declareMat(ast::MatrixKind::Mat2x3, "mat2x3<f32>", "mat2x3f");
-    declareMat(ast::MatrixKind::Mat2x4, "mat2x4<f32>", "mat2x4f");
-    declareMat(ast::MatrixKind::Mat3x2, "mat3x2<f32>", "mat3x2f");
-    declareMat(ast::MatrixKind::Mat3x3, "mat3x3<f32>", "mat3x3f");
-    declareMat(ast::MatrixKind::Mat3x4, "mat3x4<f32>", "mat3x4f");
-    declareMat(ast::MatrixKind::Mat4x2, "mat4x2<f32>", "mat4x2f");
-    declareMat(ast::MatrixKind::Mat4x3, "mat4x3<f32>", "mat4x3f");
-    declareMat(ast::MatrixKind::Mat4x4, "mat4x4<f32>", "mat4x4f");
-}
+ProgramBuilder::~ProgramBuilder() {}
 
 void ProgramBuilder::Build(std::string_view code) {
+    TRACE_SCOPE("ProgramBuilder::Build");
+    Program::BuildScope buildScope(program_);
     // Copy source code
     program_->sourceCode_ = std::string(code);
     code = program_->sourceCode_;
     currentScope_.Init(program_->globalScope_);
-    CreateBuiltinSymbols();
 
-    auto parser = Parser(code, this);
-    parser_ = &parser;
-    parser.Parse();
+    {
+        TRACE_SCOPE("Parse");
+        auto parser = Parser(code, this);
+        parser_ = &parser;
+        parser.Parse();
+    }
 }
 
 std::unique_ptr<Program> ProgramBuilder::Finalize() {
     // TODO: Do whole program optimizations
-    return std::move(program_);
+    return std::move(ownedProgram_);
+}
+
+ast::SymbolTable* ProgramBuilder::CreateSymbolTable() {
+    return program_->Allocate<ast::SymbolTable>(
+        currentScope_.GetCurrentSymbolTable(), program_->alloc_);
 }
 
 bool ProgramBuilder::ShouldStopParsing() {
@@ -204,59 +192,40 @@ ExpectedVoid ProgramBuilder::DeclareConst(
     if (!initializer) {
         return ReportError(loc, ErrorCode::ConstDeclNoInitializer);
     }
+    DASSERT(initializer->type);
+    const SourceLoc exprLoc = initializer->GetLoc();
+    EXPECT_TRUE(initializer->constValue, exprLoc, ErrorCode::NotConstExpr,
+                "'const' initializer must be a const-expression");
     // Result type of the variable [struct | builtin]
-    const ast::Scalar* effectiveType = nullptr;
+    const ast::Type* effectiveType = initializer->type;
     // Validate user defined type
-    if (typeSpecifier) {
-        auto res = ResolveTypeName(*typeSpecifier);
-        if (!res) {
-            return std::unexpected(res.error());
-        }
-        const auto* scalar = res.value()->As<ast::Scalar>();
-        if (!scalar) {
-            return ReportError(loc, ErrorCode::TypeError,
-                               "type of 'const' should be a scalar type");
-        }
-        effectiveType = scalar;
-    }
-    // Validate initializer expression type
-    // Types should be the same or builtin and convertible:
+    // Types should be the same or convertible:
     //   const a : i32 = (AbstrFloat) 3.4;
     //   const a : i32 = (i32) 3i;
     //   const a : i32 = (AbstrInt) 3 * 10;
-    DASSERT(initializer->type);
-    if (!initializer->type->Is<ast::Scalar>()) {
-        return ReportError(
-            loc, ErrorCode::TypeError,
-            "type of 'const' initializer should be a scalar type");
-    }
-    const auto* initType = initializer->type->As<ast::Scalar>();
-    // If explicit type is specified, validate compatibility
-    if (effectiveType) {
-        // Assert types are convertible
-        if (initType != effectiveType &&
-            !initType->AutoConvertibleTo(effectiveType)) {
-            const SourceLoc exprLoc = initializer->GetLoc();
-            // Types are not convertible
-            return ReportError(exprLoc, ErrorCode::TypeError,
-                               "this expression cannot be assigned to a const "
-                               "value of type {}",
-                               to_string(effectiveType->kind));
-        }
-    } else {
-        // No explicit type specified
-        // Result type equals initializer type
-        effectiveType = initType;
+    if (typeSpecifier) {
+        VALUE_ELSE_RET(effectiveType, ResolveTypeName(*typeSpecifier));
+        EXPECT_TRUE(IsAutoConvertible(initializer->type, effectiveType),
+                    exprLoc, ErrorCode::TypeError,
+                    "this expression cannot be assigned to a const value of "
+                    "type {}",
+                    effectiveType->name);
     }
     // Check identifier
     EXPECT_TRUE(!currentScope_.FindSymbol(ident.name), loc,
                 ErrorCode::SymbolAlreadyDefined,
                 "identifier '{}' already defined", ident.name);
-    auto* decl = program_->Allocate<ConstVariable>(loc, ident.name,
-                                                   effectiveType, initializer);
+    // Abstract values are converted once for the users
+    const ConstValue* value = nullptr;
+    VALUE_ELSE_RET(value,
+                   CheckEval(exprLoc, constEval_.Convert(
+                                          initializer->constValue,
+                                          effectiveType)));
+    auto* decl = program_->Allocate<ConstVariable>(
+        loc, PersistName(ident.name), effectiveType, initializer, value);
     currentScope_.Declare(ident.name, decl);
     LOG_VERBOSE("WGSL: Created ConstVariable node. ident: {}, type: {}",
-                ident.name, to_string(effectiveType->kind));
+                ident.name, effectiveType->name);
     return Void();
 }
 
@@ -335,7 +304,7 @@ Expected<const ast::VarVariable*> ProgramBuilder::DeclareVariable(
             "the address space must be specified for all address spaces "
             "except handle and function");
         auto* var = program_->Allocate<VarVariable>(
-            loc, ident.name, addrSpace, accessMode, valueType,
+            loc, PersistName(ident.name), addrSpace, accessMode, valueType,
             std::move(attributes), initializer);
         currentScope_.Declare(ident.name, var);
         return var;
@@ -351,15 +320,16 @@ Expected<const ast::VarVariable*> ProgramBuilder::DeclareVariable(
     if (typeSpecifier) {
         const Ident typeIdent = *typeSpecifier;
         VALUE_ELSE_RET(valueType, ResolveTypeName(typeIdent));
-        EXPECT_TRUE(initializer->type == valueType, loc, ErrorCode::TypeError,
+        EXPECT_TRUE(IsAutoConvertible(initializer->type, valueType), loc,
+                    ErrorCode::TypeError,
                     "a value of type '{}' cannot be assigned to the type '{}'",
                     initializer->type->name, valueType->name);
     } else {
-        valueType = initializer->type;
+        valueType = Concretize(initializer->type);
     }
 
     auto* var = program_->Allocate<VarVariable>(
-        loc, ident.name, addrSpace, accessMode, valueType,
+        loc, PersistName(ident.name), addrSpace, accessMode, valueType,
         std::move(attributes), initializer);
     currentScope_.Declare(ident.name, var);
     return var;
@@ -385,12 +355,11 @@ ExpectedVoid ProgramBuilder::DeclareFunction(
     const ast::Type* retType = nullptr;
     VALUE_ELSE_RET(retType, ResolveTypeName(retTypeSpecifier));
 
-    auto* symbols = program_->Allocate<ast::SymbolTable>(
-        currentScope_.GetCurrentSymbolTable());
+    auto* symbols = CreateSymbolTable();
     auto* scope = program_->Allocate<ast::ScopedStatement>(loc, symbols);
     auto* func = program_->Allocate<ast::Function>(
-        loc, scope, ident.name, std::move(attributes), std::move(params),
-        retType, std::move(retAttributes));
+        loc, scope, PersistName(ident.name), std::move(attributes),
+        std::move(params), retType, std::move(retAttributes));
     currentScope_.Declare(ident.name, func);
     currentScope_.PushScope(scope);
     // Declare parameters
@@ -441,8 +410,7 @@ Expected<ast::IfStatement*> ProgramBuilder::DeclareIfClause(
     EXPECT_TRUE(scalar && scalar->IsBool(), loc, ErrorCode::InvalidArg,
                 "'if' expression type must be a 'bool'");
 
-    auto* symbols = program_->Allocate<ast::SymbolTable>(
-        currentScope_.GetCurrentSymbolTable());
+    auto* symbols = CreateSymbolTable();
     auto* clause = program_->Allocate<ast::IfStatement>(loc, expr, symbols);
     // Continuation clause: else if
     if (prevIf) {
@@ -457,8 +425,7 @@ Expected<ast::IfStatement*> ProgramBuilder::DeclareIfClause(
 
 ExpectedVoid ProgramBuilder::DeclareElseClause(SourceLoc loc,
                                                ast::IfStatement* prevIf) {
-    auto* symbols = program_->Allocate<ast::SymbolTable>(
-        currentScope_.GetCurrentSymbolTable());
+    auto* symbols = CreateSymbolTable();
     auto* elseClause = program_->Allocate<ast::CompoundStatement>(loc, symbols);
     prevIf->AppendElse(elseClause);
     return Void();
@@ -476,8 +443,8 @@ Expected<const ast::Parameter*> ProgramBuilder::CreateParameter(
     // Resolve type
     const ast::Type* type = nullptr;
     VALUE_ELSE_RET(type, ResolveTypeName(typeSpecifier));
-    return program_->Allocate<ast::Parameter>(loc, ident.name, type,
-                                              std::move(attributes));
+    return program_->Allocate<ast::Parameter>(loc, PersistName(ident.name),
+                                              type, std::move(attributes));
 }
 
 //===================================================================//
@@ -500,7 +467,8 @@ Expected<const ast::Struct*> ProgramBuilder::DeclareStruct(
         }
     }
     ast::Struct* out =
-        program_->Allocate<ast::Struct>(loc, ident.name, std::move(members));
+        program_->Allocate<ast::Struct>(loc, PersistName(ident.name),
+                                        std::move(members));
     currentScope_.Declare(ident.name, out);
     return out;
 }
@@ -518,7 +486,7 @@ Expected<const ast::Member*> ProgramBuilder::CreateMember(
                 "struct member type must be scalar, array, mat, vec or "
                 "struct of such types");
     // TODO: validate that type has fixed footprint
-    return program_->Allocate<ast::Member>(loc, ident.name, type,
+    return program_->Allocate<ast::Member>(loc, PersistName(ident.name), type,
                                            std::move(attributes));
 }
 
@@ -570,7 +538,12 @@ Expected<const ast::IdentExpression*> ProgramBuilder::CreateIdentExpr(
             return program_->Allocate<ast::IdentExpression>(ident.loc, type);
         }
         if (const auto* var = symbol->As<ast::Variable>()) {
-            return program_->Allocate<ast::IdentExpression>(ident.loc, var);
+            auto* expr =
+                program_->Allocate<ast::IdentExpression>(ident.loc, var);
+            if (const auto* constVar = var->As<ast::ConstVariable>()) {
+                expr->constValue = constVar->value;
+            }
+            return expr;
         }
         const auto* fn = symbol->As<ast::Function>();
         DASSERT(fn);
@@ -599,19 +572,25 @@ Expected<const ast::Expression*> ProgramBuilder::CreateDotAccessExpr(
     // a.b
     if (const auto* structType = lhs->type->As<ast::Struct>()) {
         // Assert that the struct 'a' has the member 'b'
+        size_t index = 0;
         const auto* member = [&] {
             for (const ast::Member* member : structType->members) {
                 if (member->name == ident.name) {
                     return member;
                 }
+                ++index;
             }
             return (const ast::Member*)nullptr;
         }();
         EXPECT_TRUE(member, loc, ErrorCode::InvalidArg,
                     "struct '{}' has no member '{}'", structType->name,
                     ident.name);
-        return program_->Allocate<ast::MemberAccessExpr>(ident.loc, lhs,
-                                                         member);
+        auto* expr =
+            program_->Allocate<ast::MemberAccessExpr>(ident.loc, lhs, member);
+        if (lhs->constValue) {
+            expr->constValue = constEval_.Member(lhs->constValue, index);
+        }
+        return expr;
     }
     // vec.xyz
     if (const auto* vecType = lhs->type->As<ast::Vec>()) {
@@ -631,17 +610,22 @@ Expected<const ast::Expression*> ProgramBuilder::CreateDotAccessExpr(
             swizzleVec.push_back(res.value());
         }
         // Get result type:
-        //   vec2f.xy -> vec2f
+        //   vec2f.x -> f32
         //   vec4f.xy -> vec2f
-        const std::string resultTypeName =
-            vecType->GetSwizzleTypeName(swizzleVec.size());
-        DASSERT(!resultTypeName.empty());
-        const auto* resultType =
-            currentScope_.FindSymbol<ast::Type>(resultTypeName);
+        const ast::Type* resultType = vecType->valueType;
+        if (swizzleVec.size() > 1) {
+            resultType = BuiltinScope::Get().GetVec(
+                VecKindFromSize(swizzleVec.size()), vecType->valueType->kind);
+        }
         DASSERT(resultType);
 
-        return program_->Allocate<ast::SwizzleExpr>(ident.loc, resultType, lhs,
-                                                    swizzleVec);
+        auto* expr = program_->Allocate<ast::SwizzleExpr>(
+            ident.loc, resultType, lhs, swizzleVec);
+        if (lhs->constValue) {
+            expr->constValue =
+                constEval_.Swizzle(resultType, lhs->constValue, expr->swizzle);
+        }
+        return expr;
     }
     return ReportError(
         ident.loc, ErrorCode::InvalidArg,
@@ -652,9 +636,23 @@ Expected<const ast::Expression*> ProgramBuilder::CreateArrayAccessExpr(
     const ast::Expression* lhs,
     const ast::Expression* indexExpr) {
     // a[index_expr]
-    // a -> array type
-    const auto* arr = lhs->type->As<ast::Array>();
-    EXPECT_TRUE(arr, lhs->GetLoc(), ErrorCode::InvalidArg,
+    // a -> array, vector or matrix type
+    const ast::Type* elementType = nullptr;
+    uint32_t size = 0;
+    if (const auto* arr = lhs->type->As<ast::Array>()) {
+        elementType = arr->valueType;
+        size = arr->size;
+    } else if (const auto* vec = lhs->type->As<ast::Vec>()) {
+        elementType = vec->valueType;
+        size = GetSize(vec->kind);
+    } else if (const auto* matrix = lhs->type->As<ast::Matrix>()) {
+        // A column
+        elementType = BuiltinScope::Get().GetVec(
+            VecKindFromSize(GetNumRows(matrix->kind)),
+            GetScalarType(matrix)->kind);
+        size = GetNumColumns(matrix->kind);
+    }
+    EXPECT_TRUE(elementType, lhs->GetLoc(), ErrorCode::InvalidArg,
                 "this expression cannot be applied to the type '{}'",
                 lhs->type->name);
     // index_expr -> scalar_type
@@ -664,9 +662,22 @@ Expected<const ast::Expression*> ProgramBuilder::CreateArrayAccessExpr(
     // scalar_type -> u32, i32
     EXPECT_TRUE(scalar->IsInteger(), lhs->GetLoc(), ErrorCode::InvalidArg,
                 "array index must be an integer scalar type");
-
-    return program_->Allocate<ast::ArrayIndexExpr>(
-        lhs->GetLoc(), arr->valueType, lhs, indexExpr);
+    // A const index is checked even if the value is not const
+    const ConstValue* value = nullptr;
+    if (const auto index = GetConstInt(indexExpr)) {
+        EXPECT_TRUE(*index >= 0 && *index < size, indexExpr->GetLoc(),
+                    ErrorCode::ConstIndexOutOfBounds,
+                    "index {} is out of bounds of '{}'", *index,
+                    lhs->type->name);
+        if (lhs->constValue) {
+            auto result = constEval_.Index(lhs->constValue, *index);
+            VALUE_ELSE_RET(value, CheckEval(indexExpr->GetLoc(), result));
+        }
+    }
+    auto* expr = program_->Allocate<ast::ArrayIndexExpr>(
+        lhs->GetLoc(), elementType, lhs, indexExpr);
+    expr->constValue = value;
+    return expr;
 }
 
 // ident ('<' template '>')? '(' (args, )* ')'
@@ -675,19 +686,34 @@ Expected<const ast::Expression*> ProgramBuilder::CreateFnCallExpr(
     const ExpressionList& args) {
     // Check if user defined
     const ast::Symbol* symbol = currentScope_.FindSymbol(ident.name);
-    EXPECT_TRUE(symbol, ident.loc, ErrorCode::SymbolNotFound,
-                "symbol '{}' not found in the current scope", ident.name);
+    // Value constructors with an inferred template: vec3(1.0), array(1, 2)
+    const bool templated = !ident.templateList.empty();
+    if (templated || (!symbol && IsConstructorName(ident.name))) {
+        const ast::Type* type = nullptr;
+        if (templated) {
+            VALUE_ELSE_RET(type, ResolveTypeName(ident));
+        }
+        return ResolveConstructor(ident, type, args);
+    }
+    // The user symbols hide the builtin functions
+    if (!symbol) {
+        const auto* builtin = BuiltinScope::Get().FindFunction(ident.name);
+        EXPECT_TRUE(builtin, ident.loc, ErrorCode::SymbolNotFound,
+                    "symbol '{}' not found in the current scope", ident.name);
+        return ResolveBuiltinFunc(builtin, ident, args);
+    }
+    while (const auto* alias = symbol->As<ast::Alias>()) {
+        symbol = alias->parent;
+    }
+    // Value constructors: f32(1), vec3f(v), MyStruct(1, 2)
+    if (const auto* type = symbol->As<ast::Type>()) {
+        return ResolveConstructor(ident, type, args);
+    }
     // Check if is 'function'
-    const bool isFunction =
-        symbol->Is<ast::Function>() || symbol->Is<ast::BuiltinFunction>();
-    EXPECT_TRUE(isFunction, ident.loc, ErrorCode::SymbolNotFound,
+    EXPECT_TRUE(symbol->Is<ast::Function>(), ident.loc,
+                ErrorCode::SymbolNotFound,
                 "symbol '{}' is not a valid function name", ident.name);
-
-    if (symbol->Is<ast::BuiltinFunction>()) {
-        return ResolveBuiltinFunc(symbol->As<ast::BuiltinFunction>(), ident,
-                                  args);
-    } else {
-    }
+    // TODO: Implement user function calls
     return ReportError(ident.loc, ErrorCode::Unimplemented);
 }
 
@@ -696,8 +722,8 @@ Expected<const ast::IntLiteralExpression*> ProgramBuilder::CreateIntLiteralExpr(
     int64_t value,
     ScalarKind type) {
 
-    const ast::Symbol* typeNode = currentScope_.FindSymbol(to_string(type));
-    DASSERT(typeNode && typeNode->Is<ast::Type>());
+    const ast::Scalar* typeNode = BuiltinScope::Get().GetScalar(type);
+    DASSERT(typeNode);
     // Check for overflow for result type
     if (type == ScalarKind::U32) {
         if (value > std::numeric_limits<uint32_t>::max()) {
@@ -709,8 +735,9 @@ Expected<const ast::IntLiteralExpression*> ProgramBuilder::CreateIntLiteralExpr(
             return ReportError(loc, ErrorCode::LiteralInitValueTooLarge);
         }
     }
-    return program_->Allocate<IntLiteralExpression>(
-        loc, typeNode->As<ast::Type>(), value);
+    auto* expr = program_->Allocate<IntLiteralExpression>(loc, typeNode, value);
+    expr->constValue = constEval_.CreateInt(typeNode, value);
+    return expr;
 }
 
 Expected<const ast::FloatLiteralExpression*>
@@ -718,8 +745,7 @@ ProgramBuilder::CreateFloatLiteralExpr(SourceLoc loc,
                                        double value,
                                        ScalarKind type) {
 
-    const ast::Symbol* typeNode = currentScope_.FindSymbol(to_string(type));
-    DASSERT(typeNode && typeNode->Is<ast::Type>());
+    const ast::Scalar* typeNode = BuiltinScope::Get().GetScalar(type);
     // Check for overflow for result type
     if (type == ScalarKind::F32 || type == ScalarKind::Float) {
         if (value > std::numeric_limits<float>::max()) {
@@ -729,16 +755,26 @@ ProgramBuilder::CreateFloatLiteralExpr(SourceLoc loc,
         return ReportError(loc, ErrorCode::Unimplemented,
                            "half types are not implemented");
     }
-    return program_->Allocate<FloatLiteralExpression>(
-        loc, typeNode->As<ast::Type>(), value);
+    DASSERT(typeNode);
+    auto* expr =
+        program_->Allocate<FloatLiteralExpression>(loc, typeNode, value);
+    // f32 literals are rounded to single precision
+    VALUE_ELSE_RET(expr->constValue,
+                   CheckEval(loc, constEval_.Convert(
+                                      constEval_.CreateFloat(
+                                          BuiltinScope::Get().GetScalar(
+                                              ScalarKind::Float),
+                                          value),
+                                      typeNode)));
+    return expr;
 }
 
 Expected<const ast::BoolLiteralExpression*>
 ProgramBuilder::CreateBoolLiteralExpr(SourceLoc loc, bool value) {
-    const auto* type =
-        currentScope_.FindSymbol<ast::Scalar>(to_string(ScalarKind::Bool));
-    DASSERT(type);
-    return program_->Allocate<BoolLiteralExpression>(loc, type, value);
+    const auto* type = BuiltinScope::Get().GetScalar(ScalarKind::Bool);
+    auto* expr = program_->Allocate<BoolLiteralExpression>(loc, type, value);
+    expr->constValue = constEval_.CreateBool(value);
+    return expr;
 }
 
 Expected<const ast::Attribute*> ProgramBuilder::CreateWorkGroupAttr(
@@ -746,20 +782,20 @@ Expected<const ast::Attribute*> ProgramBuilder::CreateWorkGroupAttr(
     const ast::Expression* x,
     const ast::Expression* y,
     const ast::Expression* z) {
-    EXPECT_TRUE(x && x->Is<ast::IntLiteralExpression>(), loc,
-                ErrorCode::InvalidAttribute,
-                "@workgroup value must be a const i32 or u32");
-    EXPECT_TRUE(!y && y->Is<ast::IntLiteralExpression>(), loc,
-                ErrorCode::InvalidAttribute,
-                "@workgroup value must be a const i32 or u32");
-    EXPECT_TRUE(!z && z->Is<ast::IntLiteralExpression>(), loc,
-                ErrorCode::InvalidAttribute,
-                "@workgroup value must be a const i32 or u32");
-    const auto xval = x->TryGetConstValueAs<int64_t>();
-    const auto yval = y ? y->TryGetConstValueAs<int64_t>() : 0;
-    const auto zval = z ? z->TryGetConstValueAs<int64_t>() : 0;
-    return program_->Allocate<ast::WorkgroupAttribute>(loc, *xval, *yval,
-                                                       *zval);
+    // The omitted sizes are 1
+    int64_t size[3] = {1, 1, 1};
+    const ast::Expression* exprs[3] = {x, y, z};
+    for (int i = 0; i < 3; ++i) {
+        if (i > 0 && !exprs[i]) {
+            continue;
+        }
+        const auto value = GetConstInt(exprs[i]);
+        EXPECT_TRUE(value && *value > 0, loc, ErrorCode::InvalidAttribute,
+                    "@workgroup value must be a positive const i32 or u32");
+        size[i] = *value;
+    }
+    return program_->Allocate<ast::WorkgroupAttribute>(loc, size[0], size[1],
+                                                       size[2]);
 }
 
 Expected<const ast::Attribute*> ProgramBuilder::CreateAttribute(
@@ -784,11 +820,9 @@ Expected<const ast::Attribute*> ProgramBuilder::CreateAttribute(
     // AttributeName::ID:
     // AttributeName::Location:
     // AttributeName::Size:
-    EXPECT_TRUE(expr && expr->Is<ast::IntLiteralExpression>(), loc,
-                ErrorCode::InvalidAttribute,
+    const auto value = GetConstInt(expr);
+    EXPECT_TRUE(value, loc, ErrorCode::InvalidAttribute,
                 "@'{}' value must be a const i32 or u32", to_string(attr));
-    const auto value = expr->TryGetConstValueAs<int64_t>();
-    DASSERT(value);
     return program_->Allocate<ast::ScalarAttribute>(loc, attr, *value);
 }
 
@@ -852,12 +886,6 @@ Expected<const ast::Type*> ProgramBuilder::ResolveTypeName(
     return type;
 }
 
-// Expected<const ast::BuiltinFunction*> ProgramBuilder::ResolveBuiltinFunc(
-//     const Ident& symbol) {
-//     // TODO: Implement
-//     return std::unexpected(ErrorCode::Ok);
-// }
-
 Expected<const ast::Expression*> ProgramBuilder::ResolveArithmeticUnaryOp(
     SourceLoc loc,
     ast::OpCode op,
@@ -865,35 +893,18 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveArithmeticUnaryOp(
 
     DASSERT(arg);
     DASSERT(arg->type);
-    EXPECT_TRUE(arg->type->Is<ast::Scalar>(), loc, ErrorCode::InvalidArg,
-                "argument of '{}' should be a scalar", to_string(op));
-    const auto* argType = arg->type->As<ast::Scalar>();
+    EXPECT_TRUE(arg->type->Is<ast::Scalar>() || arg->type->Is<ast::Vec>(), loc,
+                ErrorCode::InvalidArg,
+                "argument of '{}' should be a scalar or a vector",
+                to_string(op));
+    const auto* argType = GetScalarType(arg->type);
     EXPECT_TRUE(argType->IsArithmetic(), loc, ErrorCode::InvalidArg,
                 "argument of '{}' should be of arithmetic type", to_string(op));
-
-    // Try evaluate if const
-    std::optional<EvalResult> value;
-    if (argType->IsFloat()) {
-        if (auto val = arg->TryGetConstValueAs<double>()) {
-            value = EvalResult(-*val);
-        }
-    } else if (argType->IsInteger()) {
-        if (auto val = arg->TryGetConstValueAs<int64_t>()) {
-            value = EvalResult(-*val);
-        }
-    }
-    // Create nodes
-    if (value) {
-        if (argType->IsInteger()) {
-            return program_->Allocate<ast::IntLiteralExpression>(
-                loc, argType, std::get<int64_t>(*value));
-        }
-        if (argType->IsFloat()) {
-            return program_->Allocate<ast::FloatLiteralExpression>(
-                loc, argType, std::get<double>(*value));
-        }
-    }
-    return program_->Allocate<UnaryExpression>(loc, arg->type, op, arg);
+    // No negation of u32 in the spec
+    EXPECT_TRUE(op != ast::OpCode::Negation || argType->IsSigned(), loc,
+                ErrorCode::InvalidArg, "argument of '{}' should be signed",
+                to_string(op));
+    return CreateUnaryNode(loc, op, arg);
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveLogicalUnaryOp(
@@ -911,16 +922,7 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveLogicalUnaryOp(
         return ReportError(loc, ErrorCode::InvalidArg,
                            "argument of '{}' should be bool", to_string(op));
     }
-    // Try evaluate if const
-    std::optional<EvalResult> value;
-    if (auto val = arg->TryGetConstValueAs<bool>()) {
-        value = EvalResult(!*val);
-    }
-    if (value) {
-        return program_->Allocate<ast::BoolLiteralExpression>(
-            loc, scalar, std::get<bool>(*value));
-    }
-    return program_->Allocate<UnaryExpression>(loc, scalar, op, arg);
+    return CreateUnaryNode(loc, op, arg);
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveBitwiseUnaryOp(
@@ -930,34 +932,18 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveBitwiseUnaryOp(
 
     DASSERT(arg);
     DASSERT(arg->type);
-    EXPECT_TRUE(arg->type->Is<ast::Scalar>(), loc, ErrorCode::InvalidArg,
-                "argument of '{}' should be a scalar", to_string(op));
-    const auto* scalar = arg->type->As<ast::Scalar>();
+    EXPECT_TRUE(arg->type->Is<ast::Scalar>() || arg->type->Is<ast::Vec>(), loc,
+                ErrorCode::InvalidArg,
+                "argument of '{}' should be a scalar or a vector",
+                to_string(op));
+    const auto* scalar = GetScalarType(arg->type);
     // Check type
     if (!scalar->IsInteger()) {
         return ReportError(loc, ErrorCode::InvalidArg,
-                           "argument of '{}' should be an integet",
+                           "argument of '{}' should be an integer",
                            to_string(op));
     }
-    // Try evaluate if const
-    std::optional<EvalResult> value;
-    if (auto val = arg->TryGetConstValueAs<int64_t>()) {
-        int64_t resultVal = 0;
-        if (scalar->IsSigned()) {
-            resultVal = ~*val;
-        } else {
-            EXPECT_OK(CheckOverflow(scalar, *val));
-            const auto val32 = ~(static_cast<uint32_t>(*val));
-            resultVal = static_cast<int64_t>(val32);
-        }
-        value = EvalResult(resultVal);
-    }
-    // Create node
-    if (value) {
-        return program_->Allocate<ast::IntLiteralExpression>(
-            loc, scalar, std::get<int64_t>(*value));
-    }
-    return program_->Allocate<UnaryExpression>(loc, scalar, op, arg);
+    return CreateUnaryNode(loc, op, arg);
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveArithmeticBinaryOp(
@@ -966,41 +952,16 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveArithmeticBinaryOp(
     const ast::Expression* lhs,
     const ast::Expression* rhs) {
 
-    const ast::Scalar* commonType = nullptr;
-    VALUE_ELSE_RET(commonType, ResolveBinaryExprTypes(loc, lhs, rhs));
+    const ast::Type* resultType = nullptr;
+    VALUE_ELSE_RET(resultType, ResolveBinaryExprTypes(loc, op, lhs, rhs));
+    const ast::Scalar* commonType = GetScalarType(resultType);
 
     if (!commonType->IsArithmetic()) {
         return ReportError(loc, ErrorCode::InvalidArg,
                            "arguments of '{}' should be of arithmetic type",
                            to_string(op));
     }
-    std::optional<EvalResult> value;
-    // Try evaluate if const
-    if (commonType->IsFloat()) {
-        value = EvalBinaryOp<double, double>(op, lhs, rhs);
-    } else if (commonType->IsInteger()) {
-        if (commonType->IsSigned()) {
-            if (value = EvalBinaryOp<int64_t, int64_t>(op, lhs, rhs)) {
-                EXPECT_OK(CheckOverflow(commonType, std::get<int64_t>(*value)));
-            }
-        } else {
-            if (value = EvalBinaryOp<uint64_t, int64_t>(op, lhs, rhs)) {
-                EXPECT_OK(CheckOverflow(commonType, std::get<int64_t>(*value)));
-            }
-        }
-    }
-    // Create node
-    if (value) {
-        if (commonType->IsInteger()) {
-            return program_->Allocate<ast::IntLiteralExpression>(
-                loc, commonType, std::get<int64_t>(*value));
-        }
-        if (commonType->IsFloat()) {
-            return program_->Allocate<ast::FloatLiteralExpression>(
-                loc, commonType, std::get<double>(*value));
-        }
-    }
-    return program_->Allocate<BinaryExpression>(loc, commonType, lhs, op, rhs);
+    return CreateBinaryNode(loc, op, commonType, resultType, lhs, rhs);
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveLogicalBinaryOp(
@@ -1009,27 +970,24 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveLogicalBinaryOp(
     const ast::Expression* lhs,
     const ast::Expression* rhs) {
 
-    const ast::Scalar* commonType = nullptr;
-    VALUE_ELSE_RET(commonType, ResolveBinaryExprTypes(loc, lhs, rhs));
-    const auto symbol = currentScope_.FindSymbol("bool");
-    DASSERT(symbol);
-    const ast::Scalar* returnType = symbol->As<ast::Scalar>();
-
-    std::optional<EvalResult> value;
-    // Try evaluate if const
-    if (commonType->IsFloat()) {
-        value = EvalBinaryOp<double, bool>(op, lhs, rhs);
-    } else if (commonType->IsInteger()) {
-        value = EvalBinaryOp<int64_t, bool>(op, lhs, rhs);
+    const ast::Type* operandType = nullptr;
+    VALUE_ELSE_RET(operandType, ResolveBinaryExprTypes(loc, op, lhs, rhs));
+    const ast::Scalar* commonType = GetScalarType(operandType);
+    const ast::Scalar* returnType =
+        BuiltinScope::Get().GetScalar(ScalarKind::Bool);
+
+    // There are no vectors of bool for the results
+    EXPECT_TRUE(operandType->Is<ast::Scalar>(), loc, ErrorCode::Unimplemented,
+                "vectors of bool are not implemented");
+    if (op == OpCode::LogAnd || op == OpCode::LogOr) {
+        EXPECT_TRUE(commonType->IsBool(), loc, ErrorCode::InvalidArg,
+                    "arguments of '{}' should be bool", to_string(op));
     } else if (commonType->IsBool()) {
-        value = EvalBinaryOp<bool, bool>(op, lhs, rhs);
-    }
-    // Create node
-    if (value) {
-        return program_->Allocate<ast::IntLiteralExpression>(
-            loc, returnType, std::get<bool>(*value));
+        EXPECT_TRUE(op == OpCode::Equal || op == OpCode::NotEqual, loc,
+                    ErrorCode::InvalidArg,
+                    "bool values may only be compared by '==' and '!='");
     }
-    return program_->Allocate<BinaryExpression>(loc, returnType, lhs, op, rhs);
+    return CreateBinaryNode(loc, op, commonType, returnType, lhs, rhs);
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveBitwiseBinaryOp(
@@ -1038,39 +996,60 @@ Expected<const ast::Expression*> ProgramBuilder::ResolveBitwiseBinaryOp(
     const ast::Expression* lhs,
     const ast::Expression* rhs) {
 
-    const ast::Scalar* commonType = nullptr;
-    VALUE_ELSE_RET(commonType, ResolveBinaryExprTypes(loc, lhs, rhs));
+    // The shifted value keeps its type: 1u << 3
+    if (op == OpCode::BitLsh || op == OpCode::BitRsh) {
+        const auto* lhsType = GetScalarType(lhs->type);
+        const auto* rhsType = GetScalarType(rhs->type);
+        EXPECT_TRUE(lhsType && rhsType && lhsType->IsInteger() &&
+                        rhsType->IsInteger() &&
+                        !lhs->type->Is<ast::Matrix>() &&
+                        IsSameShape(lhs->type, rhs->type),
+                    loc, ErrorCode::InvalidArg,
+                    "arguments of '{}' should be integers of the same shape",
+                    to_string(op));
+        return CreateBinaryNode(loc, op, lhsType, lhs->type, lhs, rhs);
+    }
+    const ast::Type* resultType = nullptr;
+    VALUE_ELSE_RET(resultType, ResolveBinaryExprTypes(loc, op, lhs, rhs));
+    const ast::Scalar* commonType = GetScalarType(resultType);
 
     if (!commonType->IsInteger()) {
         return ReportError(loc, ErrorCode::InvalidArg,
                            "arguments of '{}' should be of integer type",
                            to_string(op));
     }
-    std::optional<EvalResult> value;
-    // Try evaluate if const
-    if (commonType->IsInteger()) {
-        if (commonType->IsSigned()) {
-            if (value = EvalBinaryOp<int64_t, int64_t>(op, lhs, rhs)) {
-                EXPECT_OK(CheckOverflow(commonType, std::get<int64_t>(*value)));
-            }
-        } else {
-            if (value = EvalBinaryOp<uint64_t, int64_t>(op, lhs, rhs)) {
-                EXPECT_OK(CheckOverflow(commonType, std::get<int64_t>(*value)));
-            }
-        }
+    return CreateBinaryNode(loc, op, commonType, resultType, lhs, rhs);
+}
+
+Expected<const ast::Expression*> ProgramBuilder::CreateUnaryNode(
+    SourceLoc loc,
+    ast::OpCode op,
+    const ast::Expression* arg) {
+    auto* expr = program_->Allocate<UnaryExpression>(loc, arg->type, op, arg);
+    if (arg->constValue) {
+        VALUE_ELSE_RET(expr->constValue,
+                       CheckEval(loc, constEval_.Unary(op, arg->constValue)));
     }
-    // Create node
-    if (value) {
-        if (commonType->IsInteger()) {
-            return program_->Allocate<ast::IntLiteralExpression>(
-                loc, commonType, std::get<int64_t>(*value));
-        }
-        if (commonType->IsFloat()) {
-            return program_->Allocate<ast::FloatLiteralExpression>(
-                loc, commonType, std::get<double>(*value));
-        }
+    return expr;
+}
+
+Expected<const ast::Expression*> ProgramBuilder::CreateBinaryNode(
+    SourceLoc loc,
+    ast::OpCode op,
+    const ast::Scalar* operandType,
+    const ast::Type* resultType,
+    const ast::Expression* lhs,
+    const ast::Expression* rhs) {
+    auto* expr =
+        program_->Allocate<BinaryExpression>(loc, resultType, lhs, op, rhs);
+    if (lhs->constValue && rhs->constValue) {
+        VALUE_ELSE_RET(expr->constValue,
+                       CheckEval(loc, constEval_.Binary(op, operandType,
+                                                        resultType,
+                                                        lhs->constValue,
+                                                        rhs->constValue)));
     }
-    return program_->Allocate<BinaryExpression>(loc, commonType, lhs, op, rhs);
+    return expr;
 }
 
 // TODO: Implement dynamic arrays
@@ -1081,22 +1060,25 @@ Expected<const ast::Array*> ProgramBuilder::ResolveArray(const Ident& ident) {
                 "array type must have a value type and a size specified");
     EXPECT_TRUE(params[0]->Is<ast::IdentExpression>(), loc,
                 ErrorCode::InvalidTemplateParam, "expected a type specifier");
-    EXPECT_TRUE(params[1]->Is<ast::IntLiteralExpression>(), loc,
-                ErrorCode::InvalidTemplateParam, "expected a const value");
+    const auto arraySize = GetConstInt(params[1]);
+    EXPECT_TRUE(arraySize, loc, ErrorCode::InvalidTemplateParam,
+                "expected a const value");
 
     const auto* identExpr = params[0]->As<ast::IdentExpression>();
     EXPECT_TRUE(identExpr->symbol->Is<ast::Type>(), loc,
                 ErrorCode::InvalidTemplateParam, "expected a type specifier");
 
     const auto* valueType = identExpr->symbol->As<ast::Type>();
+    // Aliases name the same type: array<vec2f, 2> is array<vec2<f32>, 2>
+    while (const auto* alias = valueType->As<ast::Alias>()) {
+        valueType = alias->parent;
+    }
     const bool isInvalidType =
         valueType->Is<ast::Texture>() || valueType->Is<ast::Sampler>();
     EXPECT_TRUE(!isInvalidType, loc, ErrorCode::InvalidTemplateParam,
                 "array type may not be a texture, sampler or a dynamic array");
 
-    const auto* literal = params[1]->As<ast::IntLiteralExpression>();
-    const int64_t arraySize = literal->value;
-    EXPECT_TRUE(arraySize > 0, loc, ErrorCode::InvalidTemplateParam,
+    EXPECT_TRUE(*arraySize > 0, loc, ErrorCode::InvalidTemplateParam,
                 "array size must be positive");
     // An array element type must be one of:
     // - a scalar type
@@ -1106,26 +1088,29 @@ Expected<const ast::Array*> ProgramBuilder::ResolveArray(const Ident& ident) {
     // - an array type having a creation-fixed footprint
     // - a structure type having a creation-fixed footprint.
     // TODO: Struct and array types should be of fixed size
-    if (literal->value > std::numeric_limits<uint32_t>::max()) {
+    if (*arraySize > std::numeric_limits<uint32_t>::max()) {
         return ReportError(params[0]->GetLoc(), ErrorCode::InvalidArg,
                            "size of the static array is too large");
     }
-    const auto fullTypeName = program_->EmbedString(
-        std::format("array<{},{}>", valueType->name, arraySize));
-    // Create a symbol for a type
-    // Check if already defined
-    const ast::Symbol* symbol = currentScope_.FindSymbol(fullTypeName);
-    if (symbol && symbol->Is<ast::Array>()) {
-        return symbol->As<ast::Array>();
-    }
-    auto* type =
-        program_->Allocate<ast::Array>(valueType, arraySize, fullTypeName);
-    currentScope_.DeclareBuiltin(fullTypeName, type);
-    return type;
+    return GetArrayType(valueType, (uint32_t)*arraySize);
+}
+
+const ast::Array* ProgramBuilder::GetArrayType(const ast::Type* valueType,
+                                               uint32_t size) {
+    // The name is formatted once for diagnostics when the type is new
+    const auto key = Program::ArrayTypeKey{valueType, size};
+    auto [it, inserted] = program_->arrayTypes_.try_emplace(key, nullptr);
+    if (inserted) {
+        const auto typeName = program_->EmbedString(
+            std::format("array<{},{}>", valueType->name, size));
+        it->second =
+            program_->Allocate<ast::Array>(valueType, key.size, typeName);
+    }
+    return it->second;
 }
 
 Expected<const ast::Vec*> ProgramBuilder::ResolveVec(const Ident& ident,
-                                                     VecKind) {
+                                                     VecKind kind) {
     auto [loc, name, params] = ident;
     EXPECT_TRUE(params.size() == 1 && params[0]->Is<ast::IdentExpression>(),
                 loc, ErrorCode::InvalidTemplateParam,
@@ -1134,13 +1119,10 @@ Expected<const ast::Vec*> ProgramBuilder::ResolveVec(const Ident& ident,
     const auto* valueType = identExpr->symbol->As<ast::Scalar>();
     EXPECT_TRUE(valueType, loc, ErrorCode::InvalidTemplateParam,
                 "vec type param must be of scalar type");
-    const std::string fullName =
-        std::format("{}<{}>", ident.name, valueType->name);
-
-    // All vec types are predeclared
-    const ast::Symbol* symbol = currentScope_.FindSymbol(fullName);
-    DASSERT(symbol && symbol->Is<ast::Vec>());
-    return symbol->As<ast::Vec>();
+    const auto* type = BuiltinScope::Get().GetVec(kind, valueType->kind);
+    EXPECT_TRUE(type, loc, ErrorCode::Unimplemented,
+                "type '{}<{}>' is not implemented", name, valueType->name);
+    return type;
 }
 
 Expected<const ast::Matrix*> ProgramBuilder::ResolveMatrix(const Ident& ident) {
@@ -1154,99 +1136,300 @@ Expected<const ast::Matrix*> ProgramBuilder::ResolveMatrix(const Ident& ident) {
                 "matrix type must be f32 or f16");
     EXPECT_TRUE(valueType->IsFloat(), loc, ErrorCode::InvalidTemplateParam,
                 "matrix type must be f32 or f16");
-    const std::string fullName =
-        std::format("{}<{}>", ident.name, valueType->name);
-
-    // All matrix types are predeclared
-    const ast::Symbol* symbol = currentScope_.FindSymbol(fullName);
-    DASSERT(symbol && symbol->Is<ast::Vec>());
-    return symbol->As<ast::Matrix>();
+    const auto kind = MatrixKindFromString(name);
+    DASSERT(kind);
+    const auto* type = BuiltinScope::Get().GetMatrix(*kind, valueType->kind);
+    EXPECT_TRUE(type, loc, ErrorCode::Unimplemented,
+                "type '{}<{}>' is not implemented", name, valueType->name);
+    return type;
 }
 
 Expected<const ast::Expression*> ProgramBuilder::ResolveBuiltinFunc(
     const ast::BuiltinFunction* func,
     const Ident& ident,
     const ExpressionList& args) {
-    // Create input signature
-    std::vector<const ast::Type*> inputSig;
-    for (const ast::Expression* arg : args) {
-        inputSig.push_back(arg->type);
+    const SourceLoc loc = ident.loc;
+    EXPECT_TRUE(args.size() <= BuiltinScope::kMaxArgs, loc,
+                ErrorCode::InvalidArg,
+                "no overload of '{}' matches the arguments", func->name);
+    // Builtins are called in most shaders, the args are kept on the stack
+    std::array<const ast::Type*, BuiltinScope::kMaxArgs> argTypes{};
+    std::array<const ConstValue*, BuiltinScope::kMaxArgs> values{};
+    bool isConst = true;
+    for (size_t i = 0; i < args.size(); ++i) {
+        const ast::Expression* arg = args[i];
+        if (const ErrorCode code = CheckExpressionArg(arg->GetLoc(), arg);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+        argTypes[i] = arg->type;
+        values[i] = arg->constValue;
+        isConst = isConst && arg->constValue;
     }
+    const std::span types(argTypes.data(), args.size());
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    auto call = builtins.ResolveCall(func->type, types, isConst);
+    const ConstValue* value = nullptr;
+    if (call && call->isConst && isConst) {
+        const std::span argValues(values.data(), args.size());
+        const std::span paramTypes(call->paramTypes.data(), args.size());
+        auto result = constEval_.CallBuiltin(func->type, argValues,
+                                             paramTypes, call->returnType);
+        VALUE_ELSE_RET(value, CheckEval(loc, result));
+        DASSERT(!value || value->type == call->returnType);
+        // Not evaluated, the args are converted to the concrete types
+        if (!value) {
+            call = builtins.ResolveCall(func->type, types, false);
+        }
+    }
+    if (!call) {
+        switch (call.error()) {
+            case ErrorCode::Unimplemented:
+                return ReportError(loc, ErrorCode::Unimplemented,
+                                   "calls of '{}' are not implemented",
+                                   func->name);
+            case ErrorCode::AmbiguousCall:
+                return ReportError(
+                    loc, ErrorCode::AmbiguousCall,
+                    "more than one overload of '{}' matches the arguments",
+                    func->name);
+            default:
+                return ReportError(loc, ErrorCode::InvalidArg,
+                                   "no overload of '{}' matches the arguments",
+                                   func->name);
+        }
+    }
+    auto* expr = program_->Allocate<ast::CallExpression>(
+        loc, call->returnType, func,
+        ast::ArgumentList(args.begin(), args.end()));
+    expr->constValue = value;
+    return expr;
+}
 
-    // Algorithm outline:
-
-    // Input:
-    //   ident0 (ident1 : Type1, ident2 : Type2)
-    // Fn call:
-    //   fn ident0 (Type1, Type2) -> Type3
-    // Result:
-    //   result_type : Type3
-
-    // - Find the function by the name 'ident0'
-    struct FuncFamily {
-        struct Signature {
-            std::vector<ast::Type*> paramTypes;
-            ast::Type* retType;
-        };
-        struct Template {};
+Expected<const ast::Expression*> ProgramBuilder::ResolveConstructor(
+    const Ident& ident,
+    const ast::Type* type,
+    const ExpressionList& args) {
+    const SourceLoc loc = ident.loc;
+    bool isConst = true;
+    for (const ast::Expression* arg : args) {
+        if (const ErrorCode code = CheckExpressionArg(arg->GetLoc(), arg);
+            code != ErrorCode::Ok) {
+            return std::unexpected(code);
+        }
+        isConst = isConst && arg->constValue;
+    }
+    if (!type) {
+        VALUE_ELSE_RET(type, InferConstructorType(ident, args));
+    }
+    VOID_ELSE_RET(CheckConstructorArgs(loc, type, args));
+    const ConstValue* value = nullptr;
+    if (isConst) {
+        std::vector<const ConstValue*> values;
+        for (const ast::Expression* arg : args) {
+            values.push_back(arg->constValue);
+        }
+        auto result = constEval_.Construct(type, values);
+        VALUE_ELSE_RET(value, CheckEval(loc, result));
+    }
+    auto* expr = program_->Allocate<ast::CallExpression>(
+        loc, type, nullptr, ast::ArgumentList(args.begin(), args.end()));
+    expr->constValue = value;
+    return expr;
+}
 
-        std::string_view name;
-        std::vector<Signature> overloads;
+// The template of vec3(1.0) and array(1, 2u) from the args
+Expected<const ast::Type*> ProgramBuilder::InferConstructorType(
+    const Ident& ident,
+    const ExpressionList& args) {
+    const SourceLoc loc = ident.loc;
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    if (ident.name == "array") {
+        EXPECT_TRUE(!args.empty(), loc, ErrorCode::InvalidArg,
+                    "the element type of an empty array must be specified");
+        // The elements are converted to the common type
+        const ast::Type* valueType = args.front()->type;
+        for (const ast::Expression* arg : args) {
+            const ast::Scalar* lhs = GetScalarType(valueType);
+            const ast::Scalar* rhs = GetScalarType(arg->type);
+            const ast::Scalar* common =
+                lhs && rhs && IsSameShape(valueType, arg->type)
+                    ? GetCommonType(lhs, rhs)
+                    : nullptr;
+            if (common) {
+                valueType = builtins.GetWithComponents(valueType, common->kind);
+            }
+            EXPECT_TRUE(valueType && (common || arg->type == valueType),
+                        arg->GetLoc(), ErrorCode::TypeError,
+                        "array elements of types '{}' and '{}' have no "
+                        "common type",
+                        args.front()->type->name, arg->type->name);
+        }
+        return GetArrayType(valueType, (uint32_t)args.size());
+    }
+    // The common type of the components, vec3() is a vector of AbstractInt
+    const ast::Scalar* common = builtins.GetScalar(ScalarKind::Int);
+    for (const ast::Expression* arg : args) {
+        const ast::Scalar* scalar = GetScalarType(arg->type);
+        EXPECT_TRUE(scalar, arg->GetLoc(), ErrorCode::TypeError,
+                    "'{}' cannot be constructed from a value of type '{}'",
+                    ident.name, arg->type->name);
+        common = args.front() == arg ? scalar : GetCommonType(common, scalar);
+        EXPECT_TRUE(common, arg->GetLoc(), ErrorCode::TypeError,
+                    "the components of '{}' have no common type", ident.name);
+    }
+    if (const auto vecKind = VecKindFromString(ident.name)) {
+        const auto* type = builtins.GetVec(*vecKind, common->kind);
+        EXPECT_TRUE(type, loc, ErrorCode::Unimplemented,
+                    "type '{}<{}>' is not implemented", ident.name,
+                    common->name);
+        return type;
+    }
+    const auto matrixKind = MatrixKindFromString(ident.name);
+    DASSERT(matrixKind);
+    // mat2x2(1, 2, 3, 4) is a matrix of AbstractFloat
+    if (common->kind == ScalarKind::Int) {
+        common = builtins.GetScalar(ScalarKind::Float);
+    }
+    const auto* type = builtins.GetMatrix(*matrixKind, common->kind);
+    EXPECT_TRUE(type, loc, ErrorCode::TypeError,
+                "matrix components must be of a float type");
+    return type;
+}
 
-        bool Match(ast::Type* param0, ast::Type* param1) { return false; }
+ExpectedVoid ProgramBuilder::CheckConstructorArgs(SourceLoc loc,
+                                                  const ast::Type* type,
+                                                  const ExpressionList& args) {
+    // Zero value: vec3f(), MyStruct()
+    if (args.empty()) {
+        EXPECT_TRUE(GetScalarType(type) || type->Is<ast::Array>() ||
+                        type->Is<ast::Struct>(),
+                    loc, ErrorCode::TypeError,
+                    "type '{}' has no constructor", type->name);
+        return Void();
+    }
+    // Elements: array<f32, 2>(1, 2.0), MyStruct(1, vec2f())
+    const auto checkElement = [&](const ast::Expression* arg,
+                                  const ast::Type* elementType) {
+        return IsAutoConvertible(arg->type, elementType);
     };
+    if (const auto* array = type->As<ast::Array>()) {
+        EXPECT_TRUE(args.size() == array->size, loc, ErrorCode::InvalidArg,
+                    "'{}' expects {} elements, got {}", type->name,
+                    array->size, args.size());
+        for (const ast::Expression* arg : args) {
+            EXPECT_TRUE(checkElement(arg, array->valueType), arg->GetLoc(),
+                        ErrorCode::TypeError,
+                        "a value of type '{}' cannot be an element of '{}'",
+                        arg->type->name, type->name);
+        }
+        return Void();
+    }
+    if (const auto* structType = type->As<ast::Struct>()) {
+        EXPECT_TRUE(args.size() == structType->members.size(), loc,
+                    ErrorCode::InvalidArg, "'{}' expects {} members, got {}",
+                    type->name, structType->members.size(), args.size());
+        auto arg = args.begin();
+        for (const ast::Member* member : structType->members) {
+            EXPECT_TRUE(checkElement(*arg, member->type), (*arg)->GetLoc(),
+                        ErrorCode::TypeError,
+                        "a value of type '{}' cannot be assigned to the "
+                        "member '{}' of type '{}'",
+                        (*arg)->type->name, member->name, member->type->name);
+            ++arg;
+        }
+        return Void();
+    }
+    const ast::Scalar* valueType = GetScalarType(type);
+    EXPECT_TRUE(valueType, loc, ErrorCode::TypeError,
+                "type '{}' has no constructor", type->name);
+    // Conversion: f32(1i), vec3f(vec3i())
+    if (args.size() == 1 && GetScalarType(args[0]->type) &&
+        IsSameShape(args[0]->type, type)) {
+        return Void();
+    }
+    // Components: vec4f(v.xy, 0, 1), mat2x2f(1, 2, 3, 4), vec3f(1)
+    uint32_t numComponents = 0;
+    for (const ast::Expression* arg : args) {
+        const ast::Scalar* scalar = GetScalarType(arg->type);
+        EXPECT_TRUE(scalar && !arg->type->Is<ast::Matrix>() &&
+                        IsAutoConvertible(scalar, valueType),
+                    arg->GetLoc(), ErrorCode::TypeError,
+                    "a value of type '{}' cannot be a component of '{}'",
+                    arg->type->name, type->name);
+        numComponents += GetNumComponents(arg->type);
+    }
+    const bool isSplat = numComponents == 1 && type->Is<ast::Vec>();
+    EXPECT_TRUE(isSplat || numComponents == GetNumComponents(type), loc,
+                ErrorCode::InvalidArg, "'{}' expects {} components, got {}",
+                type->name, GetNumComponents(type), numComponents);
+    return Void();
+}
 
-    // - Create an input signature from arguments
-    //   (Type1, Type2)
-
-    // - Look for signatures that could match the input one
-    //   Rank them by the number of types matched and
-    //     a conversion rank for param types: Float -> f32 = 2
-
-    // - If have exact match:
-    //   Create a node with the funcion, return the function result type
-
-    // - If have partial match
-    //   For each partial match calculate conversion rank
-    //   Compare conversion ranks for all overloads
-    //   - If has an overload with the lowest rank:
-    //       select that overload
-    //   - Else:
-    //       report multiple overloads error
-
-    // - If no match:
-    //   Report error
+// Abstract types of values stored in variables: vec2(1, 2) -> vec2<i32>
+const ast::Type* ProgramBuilder::Concretize(const ast::Type* type) {
+    if (const auto* array = type->As<ast::Array>()) {
+        const ast::Type* valueType = Concretize(array->valueType);
+        return valueType == array->valueType
+                   ? type
+                   : GetArrayType(valueType, array->size);
+    }
+    const ast::Scalar* scalar = GetScalarType(type);
+    if (!scalar) {
+        return type;
+    }
+    const BuiltinScope& builtins = BuiltinScope::Get();
+    switch (scalar->kind) {
+        case ScalarKind::Int:
+            return builtins.GetWithComponents(type, ScalarKind::I32);
+        case ScalarKind::Float:
+            return builtins.GetWithComponents(type, ScalarKind::F32);
+        default: return type;
+    }
+}
 
-    return ReportError(func->GetLoc(), ErrorCode::Unimplemented);
+Expected<const ConstValue*> ProgramBuilder::CheckEval(
+    SourceLoc loc,
+    Expected<const ConstValue*> res) {
+    if (!res) {
+        return ReportError(loc, res.error());
+    }
+    return res;
 }
 
-Expected<const ast::Scalar*> ProgramBuilder::ResolveBinaryExprTypes(
+Expected<const ast::Type*> ProgramBuilder::ResolveBinaryExprTypes(
     SourceLoc loc,
+    ast::OpCode op,
     const ast::Expression* lhs,
     const ast::Expression* rhs) {
-    // Check binary op. I.e. "a + b", "7 + 1", "1.0f + 1"
+    // Check binary op. I.e. "a + b", "7 + 1", "1.0f + 1", "v * 2.0"
     DASSERT(lhs->type && rhs->type);
-    EXPECT_TRUE(lhs->type->Is<ast::Scalar>(), loc, ErrorCode::InvalidArg);
-    EXPECT_TRUE(rhs->type->Is<ast::Scalar>(), loc, ErrorCode::InvalidArg);
-    const auto* lhsType = lhs->type->As<ast::Scalar>();
-    const auto* rhsType = rhs->type->As<ast::Scalar>();
-
-    if (lhsType == rhsType) {
-        return lhsType->As<ast::Scalar>();
-    }
-    // Concrete
-    constexpr uint32_t kMax = std::numeric_limits<uint32_t>::max();
-    const auto lr = lhsType->GetConversionRankTo(rhsType);
-    const auto rl = rhsType->GetConversionRankTo(lhsType);
-    // Not convertible to each other
-    if (lr == kMax && rl == kMax) {
-        return ReportError(loc, ErrorCode::InvalidArg);
-    }
+    const auto* lhsType = GetScalarType(lhs->type);
+    const auto* rhsType = GetScalarType(rhs->type);
+    EXPECT_TRUE(lhsType && rhsType, loc, ErrorCode::InvalidArg,
+                "arguments of '{}' should be scalars, vectors or matrices",
+                to_string(op));
     // Find common type
-    auto* resultType = lhsType;
-    if (rl > lr) {
-        resultType = rhsType;
+    const ast::Scalar* commonType = GetCommonType(lhsType, rhsType);
+    // Not convertible to each other
+    EXPECT_TRUE(commonType, loc, ErrorCode::InvalidArg,
+                "types '{}' and '{}' are incompatible", lhs->type->name,
+                rhs->type->name);
+    // The shape of the result, a scalar is broadcast for arithmetic ops
+    const ast::Type* shape = nullptr;
+    if (lhs->type->Is<ast::Matrix>() || rhs->type->Is<ast::Matrix>()) {
+        shape = GetMatrixOpShape(op, lhs->type, rhs->type);
+    } else if (IsSameShape(lhs->type, rhs->type)) {
+        shape = lhs->type;
+    } else if (IsOpArithmetic(op)) {
+        shape = lhs->type->Is<ast::Scalar>() ? rhs->type : lhs->type;
     }
+    const ast::Type* resultType =
+        shape ? BuiltinScope::Get().GetWithComponents(shape, commonType->kind)
+              : nullptr;
+    EXPECT_TRUE(resultType, loc, ErrorCode::InvalidArg,
+                "operator '{}' cannot be applied to '{}' and '{}'",
+                to_string(op), lhs->type->name, rhs->type->name);
     return resultType;
 }
 
@@ -1281,23 +1464,19 @@ ExpectedVoid ProgramBuilder::CheckTypes(SourceLoc loc,
 
 ErrorCode ProgramBuilder::CheckExpressionArg(SourceLoc loc,
                                              const ast::Expression* arg) {
-    bool isLiteral = arg->Is<ast::LiteralExpression>();
-    bool isIdent = arg->Is<ast::IdentExpression>();
-    if (isLiteral) {
-        return ErrorCode::Ok;
-    }
-    if (isIdent) {
-        const auto* ident = arg->As<ast::IdentExpression>();
-        if (ident->symbol->Is<ast::Variable>()) {
-            return ErrorCode::Ok;
-        }
+    // Types and functions are not values
+    if (const auto* ident = arg->As<ast::IdentExpression>()) {
         if (ident->symbol->Is<ast::Type>()) {
             return ReportError(loc, ErrorCode::SymbolNotVariable,
                                "type names are not allowed")
                 .error();
         }
+        if (ident->symbol->Is<ast::Function>()) {
+            return ReportError(loc, ErrorCode::SymbolNotVariable,
+                               "function names are not allowed")
+                .error();
+        }
     }
-    FATAL("Expression arg could be Type | Variable | Literal");
     return ErrorCode::Ok;
 }
 
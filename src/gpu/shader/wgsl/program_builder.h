@@ -9,6 +9,7 @@
 #include "ast_statement.h"
 #include "ast_type.h"
 #include "ast_variable.h"
+#include "const_eval.h"
 
 #include "parser.h"
 #include "program.h"
@@ -20,14 +21,29 @@ namespace wgsl {
 class ProgramBuilder {
 public:
     ProgramBuilder();
+    // Builds into an existing program, see Program::ApplyEdit()
+    explicit ProgramBuilder(Program* program);
     ~ProgramBuilder();
 
     void Build(std::string_view code);
     std::unique_ptr<Program> Finalize();
 
+    // Parses the edited source of the program from |pos| after its live
+    // declarations. |candidates| are the declarations of the previous
+    // source which follow the edit, moved to the new offsets
+    void Reparse(uint32_t pos,
+                 std::vector<Program::DeclRecord>&& candidates,
+                 std::vector<size_t>&& changedNames);
+
 public:
     bool ShouldStopParsing();
 
+    // Top level declarations of an editable program
+    // Returns the end of a reused declaration at |offset| or 0
+    uint32_t TryReuseGlobalDecl(uint32_t offset, SourceLoc loc);
+    void BeginGlobalDecl(uint32_t offset, SourceLoc loc);
+    void EndGlobalDecl(uint32_t end);
+
     template <class... Args>
     std::unexpected<ErrorCode> ReportError(SourceLoc loc,
                                            ErrorCode code,
@@ -196,32 +212,52 @@ private:
         const Ident& ident,
         const ExpressionList& args);
 
+    // Value constructor: vec3f(1, 2, 3), MyStruct(a, b)
+    // A null |type| is inferred from the args: vec3(1.0), array(1, 2)
+    Expected<const ast::Expression*> ResolveConstructor(
+        const Ident& ident,
+        const ast::Type* type,
+        const ExpressionList& args);
+
+    Expected<const ast::Type*> InferConstructorType(
+        const Ident& ident,
+        const ExpressionList& args);
+
+    ExpectedVoid CheckConstructorArgs(SourceLoc loc,
+                                      const ast::Type* type,
+                                      const ExpressionList& args);
+
 private:
-    template <class T>
-    ErrorCode CheckOverflow(const ast::Scalar* type, T val) const {
-        if (type->kind == ast::ScalarKind::U32) {
-            if (val > std::numeric_limits<uint32_t>::max()) {
-                return ErrorCode::ConstOverflow;
-            }
-        }
-        if (type->kind == ast::ScalarKind::I32) {
-            if (val > std::numeric_limits<int32_t>::max()) {
-                return ErrorCode::ConstOverflow;
-            }
-        }
-        if (type->kind == ast::ScalarKind::F32) {
-            if (val > std::numeric_limits<float>::max()) {
-                return ErrorCode::ConstOverflow;
-            }
-        }
-        return ErrorCode::Ok;
-    }
+    // The operand type of a binary op converted to the common scalar:
+    // vec3<i32> + 1 -> vec3<i32>, 1 + 2.0f -> f32
+    Expected<const ast::Type*> ResolveBinaryExprTypes(
+        SourceLoc loc,
+        ast::OpCode op,
+        const ast::Expression* lhs,
+        const ast::Expression* rhs);
 
-    Expected<const ast::Scalar*> ResolveBinaryExprTypes(
+    // Allocate the nodes, and evaluate them if the operands are const
+    Expected<const ast::Expression*> CreateUnaryNode(
+        SourceLoc loc,
+        ast::OpCode op,
+        const ast::Expression* arg);
+    Expected<const ast::Expression*> CreateBinaryNode(
         SourceLoc loc,
+        ast::OpCode op,
+        const ast::Scalar* operandType,
+        const ast::Type* resultType,
         const ast::Expression* lhs,
         const ast::Expression* rhs);
 
+    // Interned by the program
+    const ast::Array* GetArrayType(const ast::Type* valueType, uint32_t size);
+
+    const ast::Type* Concretize(const ast::Type* type);
+
+    // Reports the error of an evaluation
+    Expected<const ConstValue*> CheckEval(SourceLoc loc,
+                                          Expected<const ConstValue*> res);
+
     ErrorCode CheckExpressionArg(SourceLoc loc, const ast::Expression* arg);
 
     // Checks that two types are compatible
@@ -229,7 +265,17 @@ private:
                             const ast::Type* lhs,
                             const ast::Type* rhs);
 
-    void CreateBuiltinSymbols();
+    // A child of the current scope table in the program arena
+    ast::SymbolTable* CreateSymbolTable();
+
+    // Names of the nodes point into the source, an edited source changes
+    // so the names are copied into the arena
+    std::string_view PersistName(std::string_view name) {
+        return incremental_ ? program_->EmbedString(name) : name;
+    }
+
+    // The parser passed the candidate, its symbols are changed
+    void DropCandidate(const Program::DeclRecord& decl);
 
     std::unexpected<ErrorCode> ReportErrorImpl(SourceLoc loc,
                                                ErrorCode code,
@@ -253,13 +299,19 @@ private:
             currentSymbols_ = global->symbolTable;
         }
 
+        // Records the names used by a top level declaration
+        void SetDeclRecord(Program::DeclRecord* record) { record_ = record; }
+
         ast::Symbol* FindSymbol(std::string_view name) {
+            if (record_) {
+                record_->names.push_back(Program::DeclRecord::HashName(name));
+            }
             return currentSymbols_->FindSymbol(name);
         }
 
         template <std::derived_from<ast::Symbol> T>
         T* FindSymbol(std::string_view name) {
-            if (auto res = currentSymbols_->FindSymbol(name)) {
+            if (auto res = FindSymbol(name)) {
                 return res->As<T>();
             }
             return nullptr;
@@ -269,6 +321,9 @@ private:
         void Declare(std::string_view name, ast::Symbol* symbol) {
             if (auto* global = currentNode_->As<ast::GlobalScope>()) {
                 global->Declare(name, symbol);
+                if (record_) {
+                    record_->symbols.emplace_back(name, symbol);
+                }
             } else if (auto* func = currentNode_->As<ast::ScopedStatement>()) {
                 func->symbols->InsertSymbol(name, symbol);
             } else {
@@ -276,24 +331,20 @@ private:
             }
         }
 
-        // Declare global builtin symbol
-        void DeclareBuiltin(std::string_view name, ast::Symbol* symbol) {
-            globalScope_->symbolTable->InsertSymbol(name, symbol);
-        }
-
         bool IsGlobal() const { return currentNode_->Is<ast::GlobalScope>(); }
 
         // Opens a new scope with a new symbol table
         void PushScope(ast::ScopedStatement* scope) {
-            parentNode_ = currentNode_;
+            parentNodes_.push_back(currentNode_);
             currentNode_ = scope;
             currentSymbols_ = scope->symbols;
         }
 
         // Closes the current scope
         void PopScope() {
-            DASSERT(parentNode_);
-            currentNode_ = parentNode_;
+            DASSERT(!parentNodes_.empty());
+            currentNode_ = parentNodes_.back();
+            parentNodes_.pop_back();
             if (auto* global = currentNode_->As<ast::GlobalScope>()) {
                 currentSymbols_ = global->symbolTable;
             } else if (auto* func = currentNode_->As<ast::ScopedStatement>()) {
@@ -316,14 +367,29 @@ private:
         ast::GlobalScope* globalScope_ = nullptr;
         ast::Node* currentNode_ = nullptr;
         ast::SymbolTable* currentSymbols_ = nullptr;
-        ast::Node* parentNode_ = nullptr;
+        // Enclosing scopes of the current one
+        std::vector<ast::Node*> parentNodes_;
+        Program::DeclRecord* record_ = nullptr;
     };
 
 private:
-    std::unique_ptr<Program> program_;
+    std::unique_ptr<Program> ownedProgram_;
+    Program* program_ = nullptr;
+    // Allocates the values in the program arena
+    ConstEval constEval_;
     Scope currentScope_;
     Parser* parser_ = nullptr;
     bool stopParsing_ = false;
+    // Parsing an edited source
+    bool incremental_ = false;
+    // Declarations of the previous source not passed by the parser yet
+    std::vector<Program::DeclRecord> candidates_;
+    size_t nextCandidate_ = 0;
+    // Hashes of the global names which could have changed since the
+    // previous source
+    std::vector<size_t> changedNames_;
+    // Last child of the global scope before the parsed declaration
+    ast::SymbolTable* prevTable_ = nullptr;
 };
 
 
@@ -0,0 +1,111 @@
+#include "program_cache.h"
+
+#include <format>
+#include <fstream>
+#include <random>
+
+#include "base/log.h"
+#include "base/sha256.h"
+#include "base/trace.h"
+#include "wgsl_build_id.h"
+
+namespace wgsl {
+
+namespace {
+
+// Files written by another compiler or build of the WGSL sources are
+// misses. The layout of the serialized nodes depends on the builtin tables
+// and the rules of the builder
+void HashBuildID(Sha256& hasher) {
+    hasher.Update(WGSL_BUILD_ID);
+    hasher.Update(std::string_view("\0", 1));
+}
+
+}  // namespace
+
+ProgramCache::ProgramCache(std::filesystem::path dir) : dir_(std::move(dir)) {
+    std::error_code ec;
+    std::filesystem::create_directories(dir_, ec);
+    if (ec) {
+        LOG_WARNING("Cannot create the shader cache directory {}: {}",
+                    dir_.string(), ec.message());
+    }
+}
+
+std::filesystem::path ProgramCache::GetPath(std::string_view code) const {
+    Sha256 hasher;
+    HashBuildID(hasher);
+    hasher.Update(code);
+    return dir_ / std::format("{}.v{}.wgslp", Sha256::ToHex(hasher.Finish()),
+                              Program::kSerializedVersion);
+}
+
+std::unique_ptr<Program> ProgramCache::GetOrCreate(std::string_view code) {
+    TRACE_SCOPE("ProgramCache::GetOrCreate");
+    const std::filesystem::path path = GetPath(code);
+    if (auto program = Load(path, code)) {
+        numHits_.fetch_add(1, std::memory_order_relaxed);
+        return program;
+    }
+    numMisses_.fetch_add(1, std::memory_order_relaxed);
+    auto program = Program::Create(code);
+    Store(path, *program);
+    return program;
+}
+
+std::unique_ptr<Program> ProgramCache::Load(const std::filesystem::path& path,
+                                            std::string_view code) {
+    std::error_code ec;
+    const auto fileSize = std::filesystem::file_size(path, ec);
+    if (ec) {
+        return nullptr;
+    }
+    std::vector<uint8_t> data(fileSize);
+    std::ifstream file(path, std::ios::binary);
+    file.read(reinterpret_cast<char*>(data.data()), data.size());
+    if (!file.good()) {
+        LOG_WARNING("Cannot read the cached shader {}", path.string());
+        return nullptr;
+    }
+    auto program = Program::Deserialize(data);
+    // Collision of the hashes or a stale file
+    if (!program || program->GetSource() != code) {
+        return nullptr;
+    }
+    return program;
+}
+
+void ProgramCache::Store(const std::filesystem::path& path,
+                         const Program& program) {
+    const std::vector<uint8_t> data = program.Serialize();
+    if (data.empty()) {
+        return;
+    }
+    // Readers never see a partial file. The name is unique per writer as
+    // the threads and processes sharing the directory could store the same
+    // program at once
+    thread_local std::mt19937_64 random(std::random_device{}());
+    std::filesystem::path tempPath = path;
+    tempPath += std::format(".{:016x}.tmp", random());
+    bool bWritten = false;
+    {
+        std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+        file.write(reinterpret_cast<const char*>(data.data()), data.size());
+        file.close();
+        bWritten = file.good();
+    }
+    std::error_code ec;
+    if (!bWritten) {
+        LOG_WARNING("Cannot write the cached shader {}", path.string());
+        std::filesystem::remove(tempPath, ec);
+        return;
+    }
+    std::filesystem::rename(tempPath, path, ec);
+    if (ec) {
+        LOG_WARNING("Cannot write the cached shader {}: {}", path.string(),
+                    ec.message());
+        std::filesystem::remove(tempPath, ec);
+    }
+}
+
+}  // namespace wgsl
@@ -0,0 +1,45 @@
+#pragma once
+#include "program.h"
+
+#include <atomic>
+#include <filesystem>
+
+namespace wgsl {
+
+// Disk cache of the serialized programs
+// A file per source text named by the SHA-256 of the source and the build
+// and by the format version. The file stores the source and it's compared
+// on load, so a hash collision is only a miss. A corrupted file is a miss
+// and gets replaced.
+// Could be used from multiple threads and processes at once.
+// Errors of the file system are logged and the program is created without
+// the cache.
+class ProgramCache {
+public:
+    explicit ProgramCache(std::filesystem::path dir);
+
+    // Loads the program of |code| from the cache, creates and stores it on
+    // a miss
+    std::unique_ptr<Program> GetOrCreate(std::string_view code);
+
+    std::filesystem::path GetPath(std::string_view code) const;
+
+    size_t GetNumHits() const {
+        return numHits_.load(std::memory_order_relaxed);
+    }
+    size_t GetNumMisses() const {
+        return numMisses_.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::unique_ptr<Program> Load(const std::filesystem::path& path,
+                                  std::string_view code);
+    void Store(const std::filesystem::path& path, const Program& program);
+
+private:
+    std::filesystem::path dir_;
+    std::atomic<size_t> numHits_ = 0;
+    std::atomic<size_t> numMisses_ = 0;
+};
+
+}  // namespace wgsl
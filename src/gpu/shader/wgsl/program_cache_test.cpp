@@ -0,0 +1,190 @@
+#include "program.h"
+#include "program_cache.h"
+
+#include "ast_function.h"
+#include "ast_scope.h"
+#include "ast_statement.h"
+#include "ast_type.h"
+#include "ast_variable.h"
+#include "builtin_scope.h"
+
+#include <doctest/doctest.h>
+
+#include <algorithm>
+#include <fstream>
+#include <thread>
+
+using namespace wgsl;
+
+namespace {
+
+constexpr std::string_view kShaders[] = {
+    R"(
+        struct Middle {
+            bottom : vec2f,
+        };
+
+        struct Top {
+            middle : array<Middle, 10>,
+        };
+
+        @binding(0) @group(0) var<storage, read_write> top : Top;
+        const scale = 2.0;
+
+        @compute @workgroup_size(64)
+        fn main(@builtin(global_invocation_id) id : vec3u) -> f32 {
+            var index : u32 = id.x;
+            var v : vec2f = top.middle[index].bottom.yx;
+            return v.x * scale;
+        }
+    )",
+    R"(
+        fn compare(a : u32, b : u32)-> i32 {
+            if (a > b) {
+                return 1;
+            } else if (!(a < b)) {
+                return 0;
+            } else {
+                return -1;
+            }
+        }
+    )",
+    // Diagnostics are kept
+    " struct S { a : vec2<bool>, }; ",
+    "",
+};
+
+// Round trip through a buffer, the source program is destroyed first
+std::unique_ptr<Program> RoundTrip(std::string_view code,
+                                   std::vector<uint8_t>& data) {
+    std::string diags;
+    {
+        auto program = Program::Create(code);
+        data = program->Serialize();
+        diags = program->GetDiagsAsString();
+    }
+    CHECK(!data.empty());
+    auto program = Program::Deserialize(data);
+    if (program) {
+        CHECK_EQ(program->GetSource(), code);
+        CHECK_EQ(program->GetDiagsAsString(), diags);
+    }
+    return program;
+}
+
+}  // namespace
+
+TEST_CASE("[WGSL] program serialization") {
+    for (std::string_view code : kShaders) {
+        std::vector<uint8_t> data;
+        auto program = RoundTrip(code, data);
+        REQUIRE(program);
+        // Deterministic and complete
+        CHECK(program->Serialize() == data);
+    }
+
+    std::vector<uint8_t> data;
+    auto program = RoundTrip(kShaders[0], data);
+    REQUIRE(program);
+    const auto& builtins = BuiltinScope::Get();
+    const auto* top = program->FindSymbol("top");
+    REQUIRE(top);
+    const auto* topType = top->As<ast::VarVariable>()->type;
+    REQUIRE(topType);
+    CHECK_EQ(topType, program->FindSymbol("Top"));
+    const auto& members = topType->As<ast::Struct>()->members;
+    REQUIRE_EQ(members.size(), 1);
+    const auto* array = members.front()->type->As<ast::Array>();
+    REQUIRE(array);
+    CHECK_EQ(array->valueType, program->FindSymbol("Middle"));
+    const auto* main = program->FindSymbol("main");
+    REQUIRE(main);
+    const auto* func = main->As<ast::Function>();
+    REQUIRE(func);
+    CHECK_EQ(func->attributes.size(), 2);
+    REQUIRE_EQ(func->parameters.size(), 1);
+    // Builtin nodes are shared, not copied
+    CHECK_EQ(func->parameters.front()->type,
+             builtins.GetVec(ast::VecKind::Vec3, ast::ScalarKind::U32));
+    REQUIRE_EQ(func->body->statements.size(), 1);
+    CHECK(func->body->statements.front()->Is<ast::ReturnStatement>());
+    CHECK(func->body->symbols->FindSymbol("index"));
+    CHECK_EQ(program->FindSymbol("index"), nullptr);
+}
+
+TEST_CASE("[WGSL] program deserialization errors") {
+    std::vector<uint8_t> data;
+    REQUIRE(RoundTrip(kShaders[1], data));
+    CHECK_EQ(Program::Deserialize({}), nullptr);
+    for (size_t size : {size_t(4), size_t(40), data.size() - 1}) {
+        CHECK_EQ(Program::Deserialize(std::span(data).first(size)), nullptr);
+    }
+    // Checksum
+    auto corrupted = data;
+    corrupted[corrupted.size() / 2] ^= 0x10;
+    CHECK_EQ(Program::Deserialize(corrupted), nullptr);
+    // Format version
+    corrupted = data;
+    corrupted[4] += 1;
+    CHECK_EQ(Program::Deserialize(corrupted), nullptr);
+    CHECK(Program::Deserialize(data));
+}
+
+TEST_CASE("[WGSL] program cache") {
+    const auto dir =
+        std::filesystem::temp_directory_path() / "wgsl_program_cache_test";
+    std::filesystem::remove_all(dir);
+    ProgramCache cache(dir);
+
+    for (int i = 0; i < 2; ++i) {
+        auto program = cache.GetOrCreate(kShaders[0]);
+        REQUIRE(program);
+        CHECK(program->GetDiags().empty());
+        CHECK(program->FindSymbol("Middle"));
+    }
+    CHECK_EQ(cache.GetNumMisses(), 1);
+    CHECK_EQ(cache.GetNumHits(), 1);
+
+    // A file of another source, e.g. a hash collision
+    std::filesystem::copy_file(cache.GetPath(kShaders[0]),
+                               cache.GetPath(kShaders[1]));
+    {
+        auto program = cache.GetOrCreate(kShaders[1]);
+        CHECK_EQ(program->GetSource(), kShaders[1]);
+        CHECK(program->FindSymbol("compare"));
+    }
+    CHECK_EQ(cache.GetNumMisses(), 2);
+
+    // Corrupted files are replaced
+    std::ofstream(cache.GetPath(kShaders[0]), std::ios::trunc) << "WGSP";
+    cache.GetOrCreate(kShaders[0]);
+    cache.GetOrCreate(kShaders[0]);
+    CHECK_EQ(cache.GetNumMisses(), 3);
+    CHECK_EQ(cache.GetNumHits(), 2);
+
+    // Writers of the same file don't share the temporary file
+    {
+        ProgramCache shared(dir / "shared");
+        bool results[4] = {};
+        std::vector<std::thread> threads;
+        for (bool& result : results) {
+            threads.emplace_back([&] {
+                auto program = shared.GetOrCreate(kShaders[1]);
+                result = program && program->FindSymbol("compare");
+            });
+        }
+        for (std::thread& thread : threads) {
+            thread.join();
+        }
+        CHECK(std::ranges::all_of(results, std::identity()));
+        CHECK_EQ(shared.GetNumHits() + shared.GetNumMisses(), 4);
+        for (const auto& entry :
+             std::filesystem::directory_iterator(dir / "shared")) {
+            CHECK_EQ(entry.path().extension(), ".wgslp");
+        }
+        CHECK(shared.GetOrCreate(kShaders[1]));
+        CHECK_GE(shared.GetNumHits(), 1);
+    }
+
+    std::filesystem::remove_all(dir);
+}
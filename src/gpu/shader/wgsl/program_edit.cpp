@@ -0,0 +1,270 @@
+#include "program.h"
+#include "program_builder.h"
+
+#include "ast_scope.h"
+#include "lexer_scan.h"
+
+#include "base/mem_tracker.h"
+#include "base/trace.h"
+
+// Incremental reparsing of an edited source
+// The top level declarations are parsed in order and a declaration may only
+// use the ones before it. So the declarations which end before the edit are
+// kept, and the parser continues after the last of them. At each top level
+// declaration the parser asks the builder for a declaration of the previous
+// source at the same moved offset. It's reused if none of the names it has
+// looked up or declared was changed by the parsed or dropped declarations.
+// The reused nodes are moved by the number of the added lines.
+
+namespace wgsl {
+
+void Program::ApplyEdit(const TextEdit& edit) {
+    TRACE_SCOPE("Program::ApplyEdit");
+    MEM_TAG(Shaders);
+    if (!edited_) {
+        editedSource_ = sourceCode_;
+        edited_ = true;
+    }
+    const uint32_t offset = edit.offset;
+    DASSERT(offset <= editedSource_.size() &&
+            edit.removed <= editedSource_.size() - offset);
+    const uint32_t oldEnd = offset + edit.removed;
+    const uint32_t newEnd = offset + (uint32_t)edit.text.size();
+    const int32_t delta = (int32_t)newEnd - (int32_t)oldEnd;
+    editedSource_.replace(offset, edit.removed, edit.text);
+
+    // The declarations are recorded by a full build
+    if (!editable_ || alloc_.GetAllocatedBytes() > 2 * builtBytes_) {
+        Rebuild();
+        return;
+    }
+    const size_t numLines = lineStarts_.size();
+    UpdateLineStarts(offset, oldEnd, newEnd);
+    const int32_t lineDelta = (int32_t)(lineStarts_.size() - numLines);
+
+    BuildScope buildScope(this);
+    size_t numKept = 0;
+    while (numKept < numLiveDecls_ &&
+           declRecords_[numKept].IsBefore(offset)) {
+        ++numKept;
+    }
+    // Parsing stopped at an error before the edit, the tree is the same
+    const bool stopped = numKept > 0 && declRecords_[numKept - 1].failed;
+    if (!stopped) {
+        for (size_t i = numLiveDecls_; i-- > numKept;) {
+            const DeclRecord& decl = declRecords_[i];
+            for (auto it = decl.symbols.rbegin(); it != decl.symbols.rend();
+                 ++it) {
+                DASSERT(globalScope_->decls.back() == it->second);
+                globalScope_->UndeclareLast(it->first);
+            }
+        }
+        ast::SymbolTable* lastTable = nullptr;
+        for (size_t i = numKept; i-- > 0 && !lastTable;) {
+            if (!declRecords_[i].tables.empty()) {
+                lastTable = declRecords_[i].tables.back();
+            }
+        }
+        globalScope_->symbolTable->TruncateChildren(lastTable);
+        numLiveDecls_ = numKept;
+        diags_.clear();
+    }
+    // The declarations after the edit are moved, the ones over it dropped
+    std::vector<size_t> changedNames;
+    size_t numDecls = numLiveDecls_;
+    for (size_t i = numLiveDecls_; i < declRecords_.size(); ++i) {
+        DeclRecord& decl = declRecords_[i];
+        if (decl.begin > oldEnd) {
+            decl.begin += delta;
+            decl.end += delta;
+            decl.loc.line += lineDelta;
+            decl.lineShift += lineDelta;
+        } else if (!decl.IsBefore(offset)) {
+            decl.AddSymbolNames(changedNames);
+            continue;
+        }
+        if (i != numDecls) {
+            declRecords_[numDecls] = std::move(decl);
+        }
+        ++numDecls;
+    }
+    declRecords_.resize(numDecls);
+    if (stopped) {
+        DropChangedDecls(declRecords_, numLiveDecls_, changedNames);
+        return;
+    }
+    std::vector<DeclRecord> candidates(
+        std::make_move_iterator(declRecords_.begin() + numKept),
+        std::make_move_iterator(declRecords_.end()));
+    declRecords_.resize(numKept);
+    const uint32_t pos = numKept ? declRecords_[numKept - 1].end : 0;
+    ProgramBuilder builder(this);
+    builder.Reparse(pos, std::move(candidates), std::move(changedNames));
+}
+
+void Program::Rebuild() {
+    TRACE_SCOPE("Program::Rebuild");
+    const std::string code = std::move(editedSource_);
+    editedSource_.clear();
+    edited_ = false;
+    editable_ = true;
+    declRecords_.clear();
+    numLiveDecls_ = 0;
+    diags_.clear();
+    arrayTypes_.clear();
+    alloc_ = BumpAllocator();
+    Init();
+    lineStarts_.assign(1, 0);
+    scan::CollectLineStarts(code, 0, code.size(), lineStarts_);
+
+    ProgramBuilder builder(this);
+    builder.Build(code);
+    builtBytes_ = alloc_.GetAllocatedBytes();
+}
+
+void Program::UpdateLineStarts(uint32_t offset,
+                               uint32_t oldEnd,
+                               uint32_t newEnd) {
+    // A line start depends on the char before it and on the char at it
+    // for \r\n, so the lines around the edit are collected again
+    const std::string_view text = editedSource_;
+    std::vector<uint32_t> lines;
+    scan::CollectLineStarts(text, std::max(offset, 1u) - 1,
+                            std::min<size_t>(newEnd + 1, text.size()), lines);
+    auto& starts = lineStarts_;
+    const auto keptEnd =
+        std::lower_bound(starts.begin() + 1, starts.end(), offset);
+    const auto movedBegin = std::lower_bound(keptEnd, starts.end(), oldEnd + 2);
+    for (auto it = movedBegin; it != starts.end(); ++it) {
+        *it += newEnd - oldEnd;
+    }
+    starts.insert(starts.erase(keptEnd, movedBegin), lines.begin(),
+                  lines.end());
+}
+
+void Program::DropChangedDecls(std::vector<DeclRecord>& decls,
+                               size_t first,
+                               std::vector<size_t>& changedNames) {
+    // A declaration may only depend on the ones before it
+    size_t numDecls = first;
+    for (size_t i = first; i < decls.size(); ++i) {
+        if (decls[i].DependsOn(changedNames)) {
+            decls[i].AddSymbolNames(changedNames);
+            continue;
+        }
+        if (i != numDecls) {
+            decls[numDecls] = std::move(decls[i]);
+        }
+        ++numDecls;
+    }
+    decls.resize(numDecls);
+}
+
+//===========================================================================//
+
+void ProgramBuilder::Reparse(uint32_t pos,
+                             std::vector<Program::DeclRecord>&& candidates,
+                             std::vector<size_t>&& changedNames) {
+    TRACE_SCOPE("ProgramBuilder::Reparse");
+    DASSERT(Program::GetCurrent() == program_);
+    incremental_ = true;
+    candidates_ = std::move(candidates);
+    changedNames_ = std::move(changedNames);
+    currentScope_.Init(program_->globalScope_);
+
+    const std::string_view code = program_->editedSource_;
+    auto parser = Parser(code, pos, program_->lineStarts_, this);
+    parser_ = &parser;
+    parser.Parse();
+
+    // The candidates after an error are parked for the next edits
+    auto& decls = program_->declRecords_;
+    const uint32_t parsedEnd =
+        stopParsing_ ? decls.back().end : (uint32_t)code.size();
+    for (size_t i = nextCandidate_; i < candidates_.size(); ++i) {
+        if (candidates_[i].begin < parsedEnd) {
+            DropCandidate(candidates_[i]);
+        } else {
+            decls.push_back(std::move(candidates_[i]));
+        }
+    }
+    Program::DropChangedDecls(decls, program_->numLiveDecls_, changedNames_);
+}
+
+uint32_t ProgramBuilder::TryReuseGlobalDecl(uint32_t offset, SourceLoc loc) {
+    while (nextCandidate_ < candidates_.size() &&
+           candidates_[nextCandidate_].begin < offset) {
+        DropCandidate(candidates_[nextCandidate_++]);
+    }
+    if (nextCandidate_ == candidates_.size()) {
+        return 0;
+    }
+    Program::DeclRecord& decl = candidates_[nextCandidate_];
+    // The column of the first line changes with the chars before it
+    if (decl.begin != offset || decl.failed || decl.loc.line != loc.line ||
+        decl.loc.col != loc.col || decl.DependsOn(changedNames_)) {
+        return 0;
+    }
+    ++nextCandidate_;
+    if (decl.lineShift) {
+        for (ast::Node* node : decl.nodes) {
+            node->ShiftLines(decl.lineShift);
+        }
+        decl.lineShift = 0;
+    }
+    ast::GlobalScope* global = program_->globalScope_;
+    for (const auto& [name, symbol] : decl.symbols) {
+        global->Declare(name, symbol);
+    }
+    for (ast::SymbolTable* table : decl.tables) {
+        global->symbolTable->AppendChild(table);
+    }
+    const uint32_t end = decl.end;
+    program_->declRecords_.push_back(std::move(decl));
+    ++program_->numLiveDecls_;
+    return end;
+}
+
+void ProgramBuilder::BeginGlobalDecl(uint32_t offset, SourceLoc loc) {
+    if (!program_->editable_) {
+        return;
+    }
+    auto& decl = program_->declRecords_.emplace_back();
+    decl.begin = offset;
+    decl.loc = loc;
+    prevTable_ = program_->globalScope_->symbolTable->GetLastChild();
+    program_->declNodes_ = &decl.nodes;
+    currentScope_.SetDeclRecord(&decl);
+}
+
+void ProgramBuilder::EndGlobalDecl(uint32_t end) {
+    if (!program_->editable_) {
+        return;
+    }
+    auto& decl = program_->declRecords_.back();
+    decl.end = end;
+    decl.failed = stopParsing_;
+    // The diags quote the line of the error
+    if (decl.failed) {
+        decl.end = (uint32_t)scan::FindLineBreak(program_->GetSource(), end);
+    }
+    program_->declNodes_ = nullptr;
+    currentScope_.SetDeclRecord(nullptr);
+    for (auto* table = program_->globalScope_->symbolTable->GetLastChild();
+         table != prevTable_; table = table->GetPrevSibling()) {
+        decl.tables.push_back(table);
+    }
+    std::ranges::reverse(decl.tables);
+    decl.AddSymbolNames(decl.names);
+    std::ranges::sort(decl.names);
+    const auto [first, last] = std::ranges::unique(decl.names);
+    decl.names.erase(first, last);
+    decl.AddSymbolNames(changedNames_);
+    ++program_->numLiveDecls_;
+}
+
+void ProgramBuilder::DropCandidate(const Program::DeclRecord& decl) {
+    decl.AddSymbolNames(changedNames_);
+}
+
+}  // namespace wgsl
@@ -0,0 +1,236 @@
+#include "program.h"
+
+#include "ast_expression.h"
+#include "ast_function.h"
+#include "ast_scope.h"
+#include "ast_statement.h"
+#include "ast_type.h"
+#include "ast_variable.h"
+
+#include <doctest/doctest.h>
+
+#include <format>
+#include <random>
+
+using namespace wgsl;
+
+namespace {
+
+constexpr std::string_view kShader = R"(
+struct Middle {
+    bottom : vec2f,
+};
+
+struct Top {
+    middle : array<Middle, 10>,
+};
+
+@binding(0) @group(0) var<storage, read_write> top : Top;
+const scale = 2.0;
+
+fn compare(a : u32, b : u32)-> i32 {
+    if (a > b) {
+        return 1;
+    } else {
+        return -1;
+    }
+}
+
+@compute @workgroup_size(64)
+fn main(@builtin(global_invocation_id) id : vec3u) -> f32 {
+    var index : u32 = id.x;
+    var v : vec2f = top.middle[index].bottom.yx;
+    return v.x * scale;
+}
+)";
+
+uint32_t Find(std::string_view code, std::string_view str) {
+    const size_t pos = code.find(str);
+    CHECK(pos != std::string_view::npos);
+    return (uint32_t)std::min(pos, code.size());
+}
+
+// Replaces the first |str| of the source
+Program::TextEdit Replace(std::string_view code,
+                          std::string_view str,
+                          std::string_view text) {
+    return {Find(code, str), (uint32_t)str.size(), text};
+}
+
+// Locations and names of the declarations and of the nodes in them
+void Dump(const ast::Node* node, std::string& out) {
+    if (!node) {
+        out += "-";
+        return;
+    }
+    const SourceLoc loc = node->GetLoc();
+    out += std::format("[{}:{}:{} ", loc.line, loc.col, loc.len);
+    if (const auto* func = node->As<ast::Function>()) {
+        out += func->name;
+        for (const ast::Parameter* param : func->parameters) {
+            Dump(param, out);
+        }
+        Dump(func->body, out);
+    } else if (const auto* type = node->As<ast::Struct>()) {
+        out += type->name;
+        for (const ast::Member* member : type->members) {
+            Dump(member, out);
+        }
+    } else if (const auto* member = node->As<ast::Member>()) {
+        out += member->name;
+    } else if (const auto* var = node->As<ast::Variable>()) {
+        out += var->ident;
+        Dump(var->initializer, out);
+    } else if (const auto* scope = node->As<ast::ScopedStatement>()) {
+        for (const ast::Statement* statement : scope->statements) {
+            Dump(statement, out);
+        }
+        if (const auto* clause = node->As<ast::IfStatement>()) {
+            Dump(clause->expr, out);
+            Dump(clause->next, out);
+        }
+    } else if (const auto* ret = node->As<ast::ReturnStatement>()) {
+        Dump(ret->expr, out);
+    }
+    out += "]";
+}
+
+std::string Dump(const Program& program) {
+    std::string out;
+    for (const ast::Symbol* decl : program.GetGlobalScope()->decls) {
+        Dump(decl, out);
+        out += "\n";
+    }
+    return out;
+}
+
+// The edited program should be the same as a new one of the edited source
+void CheckEdit(Program& program, Program::TextEdit edit) {
+    std::string code(program.GetSource());
+    code.replace(edit.offset, edit.removed, edit.text);
+    program.ApplyEdit(edit);
+    REQUIRE_EQ(program.GetSource(), code);
+    auto expected = Program::Create(code);
+    CHECK_EQ(program.GetDiagsAsString(), expected->GetDiagsAsString());
+    CHECK_EQ(Dump(program), Dump(*expected));
+    // Names of the reused nodes are in the previous source
+    const std::vector<uint8_t> data = program.Serialize();
+    auto loaded = Program::Deserialize(data);
+    REQUIRE(loaded);
+    CHECK_EQ(Dump(*loaded), Dump(*expected));
+}
+
+}  // namespace
+
+TEST_CASE("[WGSL] program edit") {
+    auto program = Program::Create(kShader);
+    REQUIRE(program->GetDiags().empty());
+    // Function body
+    CheckEdit(*program, Replace(kShader, "return 1;", "return 2;"));
+    // Lines above the declarations
+    CheckEdit(*program, {0, 0, "\n\n// Shader\n"});
+    CheckEdit(*program, {1, 1, ""});
+    // Between the declarations
+    CheckEdit(*program,
+              Replace(program->GetSource(), "const scale", "\nconst scale"));
+    CheckEdit(*program, {Find(program->GetSource(), "fn main"), 0, "   "});
+    // Renamed symbol is not found by the users of it
+    CheckEdit(*program, Replace(program->GetSource(), "scale =", "scales ="));
+    CHECK(!program->GetDiags().empty());
+    CheckEdit(*program, Replace(program->GetSource(), "scales =", "scale ="));
+    CHECK(program->GetDiags().empty());
+    // Declarations after an error are parsed again after the fix
+    CheckEdit(*program, Replace(program->GetSource(), "2.0", ""));
+    CheckEdit(*program, Replace(program->GetSource(), "-1", "-2"));
+    CheckEdit(*program, Replace(program->GetSource(), "= ;", "= 3.0;"));
+    CHECK(program->GetDiags().empty());
+    // Removed and added declarations
+    CheckEdit(*program, Replace(program->GetSource(), "const scale = 3.0;", ""));
+    CheckEdit(*program, {0, 0, "const scale = 1.0;"});
+    CheckEdit(*program, {(uint32_t)program->GetSource().size(), 0,
+                         "\nconst after = scale;"});
+    // Line breaks \r\n
+    CheckEdit(*program, Replace(program->GetSource(), "\n", "\r"));
+    CheckEdit(*program, Replace(program->GetSource(), "\r", "\r\n"));
+    CheckEdit(*program, Replace(program->GetSource(), "\r\n", "\n\r"));
+    // Whole source
+    CheckEdit(*program, {0, (uint32_t)program->GetSource().size(), ""});
+    CheckEdit(*program, {0, 0, kShader});
+    CHECK(program->GetDiags().empty());
+}
+
+TEST_CASE("[WGSL] program edit reuses declarations") {
+    auto program = Program::Create(kShader);
+    // The first edit records the declarations
+    program->ApplyEdit({0, 0, ""});
+    const auto* middle = program->FindSymbol("Middle");
+    const auto* top = program->FindSymbol("top");
+    const auto* compare = program->FindSymbol("compare");
+    const auto* main = program->FindSymbol("main");
+    REQUIRE((middle && top && compare && main));
+
+    CheckEdit(*program, Replace(kShader, "return 1;", "return 2;"));
+    CHECK_EQ(program->FindSymbol("Middle"), middle);
+    CHECK_EQ(program->FindSymbol("top"), top);
+    CHECK_NE(program->FindSymbol("compare"), compare);
+    CHECK_EQ(program->FindSymbol("main"), main);
+    compare = program->FindSymbol("compare");
+
+    // Moved by the lines
+    const uint32_t line = main->GetLoc().line;
+    CheckEdit(*program, {0, 0, "\n\n"});
+    CHECK_EQ(program->FindSymbol("main"), main);
+    CHECK_EQ(main->GetLoc().line, line + 2);
+
+    // The users of a changed symbol are parsed again
+    CheckEdit(*program, Replace(program->GetSource(), "2.0", "3.0"));
+    CHECK_EQ(program->FindSymbol("compare"), compare);
+    CHECK_NE(program->FindSymbol("main"), main);
+    main = program->FindSymbol("main");
+
+    // The declarations after an error are kept for the fix
+    CheckEdit(*program, Replace(program->GetSource(), "3.0", "3.0 +"));
+    CHECK_EQ(program->FindSymbol("compare"), nullptr);
+    CheckEdit(*program, Replace(program->GetSource(), "var index", "var i"));
+    CheckEdit(*program, Replace(program->GetSource(), "var i", "var index"));
+    CheckEdit(*program, Replace(program->GetSource(), "3.0 +", "3.0"));
+    CHECK(program->GetDiags().empty());
+    CHECK_EQ(program->FindSymbol("Middle"), middle);
+    CHECK_EQ(program->FindSymbol("compare"), compare);
+    CHECK_NE(program->FindSymbol("main"), main);
+}
+
+TEST_CASE("[WGSL] program edit of a loaded program") {
+    const std::vector<uint8_t> data = Program::Create(kShader)->Serialize();
+    auto program = Program::Deserialize(data);
+    REQUIRE(program);
+    CheckEdit(*program, Replace(kShader, "var index", "var i"));
+    CHECK(!program->GetDiags().empty());
+    CheckEdit(*program, Replace(program->GetSource(), "[index]", "[i]"));
+    CHECK(program->GetDiags().empty());
+}
+
+TEST_CASE("[WGSL] program random edits") {
+    // Pieces of tokens, comments and blank space
+    constexpr std::string_view kPieces[] = {
+        "a",   "1",  " ",      "\n",         "\r\n", ";", "{",
+        "}",   ",",  "(",      "/*",         "*/",   "//", "const x = 1;",
+        "fn ", "=",  "scale", "struct S {}", ".",    "<", ">",
+    };
+    std::mt19937 random(7);
+    auto program = Program::Create(kShader);
+    for (int i = 0; i < 400; ++i) {
+        if (i % 50 == 0) {
+            const auto size = (uint32_t)program->GetSource().size();
+            program->ApplyEdit({0, size, kShader});
+        }
+        const auto size = (uint32_t)program->GetSource().size();
+        const uint32_t offset = random() % (size + 1);
+        const uint32_t removed =
+            random() % 2 ? 0 : std::min<uint32_t>(random() % 4, size - offset);
+        const std::string_view text =
+            random() % 3 ? kPieces[random() % std::size(kPieces)] : "";
+        CAPTURE(i);
+        CheckEdit(*program, {offset, removed, text});
+    }
+}
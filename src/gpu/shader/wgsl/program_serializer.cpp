@@ -0,0 +1,978 @@
+#include "program.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "ast_attribute.h"
+#include "ast_expression.h"
+#include "ast_function.h"
+#include "ast_scope.h"
+#include "ast_statement.h"
+#include "ast_type.h"
+#include "ast_variable.h"
+#include "builtin_scope.h"
+#include "const_eval.h"
+
+#include "base/mem_tracker.h"
+#include "base/string_utils.h"
+#include "base/trace.h"
+
+// Layout of a serialized program, all integers are little endian:
+//   Header
+//   Source text
+//   Blob with the strings which are not in the source
+//   Symbol tables: parent of each table in pre-order
+//   Nodes in post-order, a node follows all the nodes it refers to,
+//   the values of const-expressions are inline after the fields
+//   Symbols of each table
+//   Global declarations
+//   Diagnostics
+//
+// Nodes and tables refer to each other by 1-based indices, strings by
+// offsets into the source or the blob. Nothing depends on the address the
+// data is loaded at. Loading is a single pass which allocates the nodes
+// in the arena of the new program, without lexing, parsing or resolving.
+namespace wgsl {
+
+using namespace ast;
+
+namespace {
+
+constexpr uint32_t kMagic = 0x50534757;  // "WGSP"
+
+constexpr uint32_t kNullRef = 0;
+// Nodes of the BuiltinScope by the index in BuiltinScope::GetTypes()
+constexpr uint32_t kBuiltinRefBit = 1u << 31;
+// Strings in the blob, otherwise in the source
+constexpr uint32_t kBlobRefBit = 1u << 31;
+// A value constructor call
+constexpr uint8_t kNoBuiltin = 0xFF;
+// Nesting of the values of arrays and structs
+constexpr uint32_t kMaxValueDepth = 64;
+
+// Concrete node classes created by the ProgramBuilder
+#define NODE_TAG_LIST(V)       \
+    V(Array)                   \
+    V(Struct)                  \
+    V(Member)                  \
+    V(Function)                \
+    V(Parameter)               \
+    V(VarVariable)             \
+    V(ConstVariable)           \
+    V(Attribute)               \
+    V(ScalarAttribute)         \
+    V(BuiltinAttribute)        \
+    V(WorkgroupAttribute)      \
+    V(ScopedStatement)         \
+    V(CompoundStatement)       \
+    V(IfStatement)             \
+    V(ReturnStatement)         \
+    V(AssignStatement)         \
+    V(UnaryExpression)         \
+    V(BinaryExpression)        \
+    V(IntLiteralExpression)    \
+    V(FloatLiteralExpression)  \
+    V(BoolLiteralExpression)   \
+    V(IdentExpression)         \
+    V(MemberAccessExpr)        \
+    V(SwizzleExpr)             \
+    V(ArrayIndexExpr)          \
+    V(CallExpression)
+
+enum class NodeTag : uint8_t {
+#define ENUM(NAME) NAME,
+    NODE_TAG_LIST(ENUM)
+#undef ENUM
+    _Max,
+};
+
+struct Header {
+    uint32_t magic;
+    uint32_t version;
+    // The builtins are referred to by the index
+    uint32_t numBuiltins;
+    uint32_t reserved;
+    // Of the data after the header
+    uint64_t size;
+    uint64_t checksum;
+};
+
+struct StrRef {
+    uint32_t offset;
+    uint32_t size;
+};
+
+uint64_t Checksum(std::span<const uint8_t> data) {
+    return string_hash::Fnv1a(
+        std::string_view((const char*)data.data(), data.size()));
+}
+
+class ProgramWriter {
+public:
+    explicit ProgramWriter(const Program& program)
+        : program_(program), source_(program.GetSource()) {
+        const auto builtins = BuiltinScope::Get().GetTypes();
+        for (uint32_t i = 0; i < builtins.size(); ++i) {
+            ids_.emplace(builtins[i], kBuiltinRefBit | i);
+        }
+    }
+
+    // Returns an empty vector if the program has nodes which can't be
+    // serialized
+    std::vector<uint8_t> Write() {
+        const ast::GlobalScope* global = program_.globalScope_;
+        // Tables first, the nodes refer to them
+        CollectTables(global->symbolTable);
+
+        // Nodes reachable from the declarations and the symbols
+        for (const Symbol* decl : global->decls) {
+            NodeRef(decl);
+        }
+        std::vector<std::vector<std::pair<std::string_view, uint32_t>>>
+            tableSymbols(tables_.size());
+        for (size_t i = 0; i < tables_.size(); ++i) {
+            tables_[i]->ForEachSymbol(
+                [&](std::string_view name, const Symbol* symbol) {
+                    tableSymbols[i].emplace_back(name, NodeRef(symbol));
+                });
+            // Slot order depends on the insertion order
+            std::ranges::sort(tableSymbols[i]);
+        }
+        if (failed_) {
+            return {};
+        }
+        // The table keys are copies in the arena, so in the blob
+        std::vector<StrRef> symbolNames;
+        for (const auto& symbols : tableSymbols) {
+            for (const auto& [name, ref] : symbols) {
+                symbolNames.push_back(MakeStr(name));
+            }
+        }
+
+        target_ = &out_;
+        out_.resize(sizeof(Header));
+        PutString(source_);
+        // The blob is complete after the nodes are written
+        Put((uint32_t)blob_.size());
+        out_.insert(out_.end(), blob_.begin(), blob_.end());
+
+        Put((uint32_t)tables_.size());
+        for (const ast::SymbolTable* table : tables_) {
+            Put(TableRef(table->GetParent()));
+        }
+
+        Put(numNodes_);
+        out_.insert(out_.end(), nodes_.begin(), nodes_.end());
+
+        auto nextName = symbolNames.begin();
+        for (const auto& symbols : tableSymbols) {
+            Put((uint32_t)symbols.size());
+            for (const auto& [name, ref] : symbols) {
+                Put(*nextName++);
+                Put(ref);
+            }
+        }
+
+        Put((uint32_t)global->decls.size());
+        for (const Symbol* decl : global->decls) {
+            Put(NodeRef(decl));
+        }
+
+        const auto& diags = program_.GetDiags();
+        Put((uint32_t)diags.size());
+        for (const Program::DiagMsg& diag : diags) {
+            Put((uint8_t)diag.type);
+            Put(diag.loc);
+            Put((uint32_t)diag.code);
+            PutString(diag.msg);
+        }
+
+        const Header header = {
+            .magic = kMagic,
+            .version = Program::kSerializedVersion,
+            .numBuiltins = (uint32_t)BuiltinScope::Get().GetTypes().size(),
+            .size = out_.size() - sizeof(Header),
+            .checksum =
+                Checksum(std::span(out_).subspan(sizeof(Header))),
+        };
+        std::memcpy(out_.data(), &header, sizeof(header));
+        return std::move(out_);
+    }
+
+private:
+    // Pre-order, a parent precedes its children
+    void CollectTables(const ast::SymbolTable* table) {
+        tables_.push_back(table);
+        tableIds_.emplace(table, (uint32_t)tables_.size());
+        table->ForEachChild(
+            [&](const ast::SymbolTable* child) { CollectTables(child); });
+    }
+
+    uint32_t TableRef(const ast::SymbolTable* table) {
+        if (!table) {
+            return kNullRef;
+        }
+        auto it = tableIds_.find(table);
+        if (it == tableIds_.end()) {
+            // The parent of the global table
+            DASSERT(table == BuiltinScope::Get().GetSymbolTable());
+            return kNullRef;
+        }
+        return it->second;
+    }
+
+    uint32_t NodeRef(const Node* node) {
+        if (!node) {
+            return kNullRef;
+        }
+        if (auto it = ids_.find(node); it != ids_.end()) {
+            // In progress nodes are a cycle, which is never created
+            if (it->second == kNullRef) {
+                failed_ = true;
+            }
+            return it->second;
+        }
+        ids_.emplace(node, kNullRef);
+        WriteNode(node);
+        ids_[node] = ++numNodes_;
+        return numNodes_;
+    }
+
+    template <class T>
+    uint32_t ListRef(const T& list, std::vector<uint32_t>& out) {
+        for (const Node* node : list) {
+            out.push_back(NodeRef(node));
+        }
+        return (uint32_t)out.size();
+    }
+
+    // Writes the referred nodes first
+    void WriteNode(const Node* node) {
+        std::vector<uint32_t> list;
+        std::vector<uint32_t> list2;
+        std::vector<uint32_t> list3;
+        const auto* expr = node->As<Expression>();
+        if (expr) {
+            RefValueTypes(expr->constValue);
+        }
+        if (auto* n = node->As<Array>()) {
+            const uint32_t valueType = NodeRef(n->valueType);
+            Begin(NodeTag::Array, n);
+            Put(valueType);
+            Put(n->size);
+            PutStr(n->name);
+        } else if (auto* n = node->As<Struct>()) {
+            ListRef(n->members, list);
+            Begin(NodeTag::Struct, n);
+            PutStr(n->name);
+            PutList(list);
+        } else if (auto* n = node->As<Member>()) {
+            const uint32_t type = NodeRef(n->type);
+            ListRef(n->attributes, list);
+            Begin(NodeTag::Member, n);
+            PutStr(n->name);
+            Put(type);
+            PutList(list);
+        } else if (auto* n = node->As<Function>()) {
+            ListRef(n->attributes, list);
+            ListRef(n->parameters, list2);
+            const uint32_t retType = NodeRef(n->retType);
+            ListRef(n->retAttributes, list3);
+            const uint32_t body = NodeRef(n->body);
+            Begin(NodeTag::Function, n);
+            PutStr(n->name);
+            PutList(list);
+            PutList(list2);
+            Put(retType);
+            PutList(list3);
+            Put(body);
+        } else if (auto* n = node->As<Parameter>()) {
+            const uint32_t type = NodeRef(n->type);
+            ListRef(n->attributes, list);
+            Begin(NodeTag::Parameter, n);
+            PutStr(n->ident);
+            Put(type);
+            PutList(list);
+        } else if (auto* n = node->As<VarVariable>()) {
+            const uint32_t type = NodeRef(n->type);
+            ListRef(n->attributes, list);
+            const uint32_t initializer = NodeRef(n->initializer);
+            Begin(NodeTag::VarVariable, n);
+            PutStr(n->ident);
+            Put((uint8_t)n->addressSpace);
+            Put((uint8_t)n->accessMode);
+            Put(type);
+            PutList(list);
+            Put(initializer);
+        } else if (auto* n = node->As<ConstVariable>()) {
+            const uint32_t type = NodeRef(n->type);
+            const uint32_t initializer = NodeRef(n->initializer);
+            RefValueTypes(n->value);
+            Begin(NodeTag::ConstVariable, n);
+            PutStr(n->ident);
+            Put(type);
+            Put(initializer);
+            PutValue(n->value);
+        } else if (auto* n = node->As<ScalarAttribute>()) {
+            Begin(NodeTag::ScalarAttribute, n);
+            Put((uint8_t)n->attr);
+            Put(n->value);
+        } else if (auto* n = node->As<BuiltinAttribute>()) {
+            Begin(NodeTag::BuiltinAttribute, n);
+            Put((uint8_t)n->value);
+        } else if (auto* n = node->As<WorkgroupAttribute>()) {
+            Begin(NodeTag::WorkgroupAttribute, n);
+            Put(n->x);
+            Put(n->y);
+            Put(n->z);
+        } else if (auto* n = node->As<Attribute>()) {
+            Begin(NodeTag::Attribute, n);
+            Put((uint8_t)n->attr);
+        } else if (auto* n = node->As<IfStatement>()) {
+            const uint32_t expr = NodeRef(n->expr);
+            const uint32_t next = NodeRef(n->next);
+            ListRef(n->statements, list);
+            Begin(NodeTag::IfStatement, n);
+            Put(expr);
+            Put(TableRef(n->symbols));
+            Put(next);
+            PutList(list);
+        } else if (auto* n = node->As<CompoundStatement>()) {
+            ListRef(n->statements, list);
+            Begin(NodeTag::CompoundStatement, n);
+            Put(TableRef(n->symbols));
+            PutList(list);
+        } else if (auto* n = node->As<ScopedStatement>()) {
+            ListRef(n->statements, list);
+            Begin(NodeTag::ScopedStatement, n);
+            Put(TableRef(n->symbols));
+            PutList(list);
+        } else if (auto* n = node->As<ReturnStatement>()) {
+            const uint32_t expr = NodeRef(n->expr);
+            Begin(NodeTag::ReturnStatement, n);
+            Put(expr);
+        } else if (auto* n = node->As<AssignStatement>()) {
+            const uint32_t var = NodeRef(n->var);
+            const uint32_t expr = NodeRef(n->expr);
+            Begin(NodeTag::AssignStatement, n);
+            Put(var);
+            Put(expr);
+        } else if (auto* n = node->As<UnaryExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            const uint32_t rhs = NodeRef(n->rhs);
+            Begin(NodeTag::UnaryExpression, n);
+            Put(type);
+            Put((uint8_t)n->op);
+            Put(rhs);
+        } else if (auto* n = node->As<BinaryExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            const uint32_t lhs = NodeRef(n->lhs);
+            const uint32_t rhs = NodeRef(n->rhs);
+            Begin(NodeTag::BinaryExpression, n);
+            Put(type);
+            Put(lhs);
+            Put((uint8_t)n->op);
+            Put(rhs);
+        } else if (auto* n = node->As<IntLiteralExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            Begin(NodeTag::IntLiteralExpression, n);
+            Put(type);
+            Put(n->value);
+        } else if (auto* n = node->As<FloatLiteralExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            Begin(NodeTag::FloatLiteralExpression, n);
+            Put(type);
+            Put(n->value);
+        } else if (auto* n = node->As<BoolLiteralExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            Begin(NodeTag::BoolLiteralExpression, n);
+            Put(type);
+            Put((uint8_t)n->value);
+        } else if (auto* n = node->As<IdentExpression>()) {
+            // The type follows from the symbol
+            const uint32_t symbol = NodeRef(n->symbol);
+            Begin(NodeTag::IdentExpression, n);
+            Put(symbol);
+        } else if (auto* n = node->As<MemberAccessExpr>()) {
+            const uint32_t expr = NodeRef(n->expr);
+            const uint32_t member = NodeRef(n->member);
+            Begin(NodeTag::MemberAccessExpr, n);
+            Put(expr);
+            Put(member);
+        } else if (auto* n = node->As<SwizzleExpr>()) {
+            const uint32_t type = NodeRef(n->type);
+            const uint32_t lhs = NodeRef(n->lhs);
+            Begin(NodeTag::SwizzleExpr, n);
+            Put(type);
+            Put(lhs);
+            Put(n->swizzle);
+        } else if (auto* n = node->As<ArrayIndexExpr>()) {
+            const uint32_t type = NodeRef(n->type);
+            const uint32_t array = NodeRef(n->array);
+            const uint32_t index = NodeRef(n->indexExpr);
+            Begin(NodeTag::ArrayIndexExpr, n);
+            Put(type);
+            Put(array);
+            Put(index);
+        } else if (auto* n = node->As<CallExpression>()) {
+            const uint32_t type = NodeRef(n->type);
+            ListRef(n->args, list);
+            Begin(NodeTag::CallExpression, n);
+            Put(type);
+            Put(n->builtin ? (uint8_t)n->builtin->type : kNoBuiltin);
+            PutList(list);
+        } else {
+            // E.g. a user alias, which the builder doesn't create yet
+            DASSERT_M(false, "Unsupported node");
+            failed_ = true;
+            return;
+        }
+        if (expr) {
+            PutValue(expr->constValue);
+        }
+    }
+
+    // The types of arrays and structs are nodes of the program
+    void RefValueTypes(const ConstValue* value) {
+        if (!value) {
+            return;
+        }
+        NodeRef(value->type);
+        for (const ConstValue* element : value->elements) {
+            RefValueTypes(element);
+        }
+    }
+
+    // Type, components and elements, or a null type
+    void PutValue(const ConstValue* value) {
+        if (!value) {
+            Put(kNullRef);
+            return;
+        }
+        Put(NodeRef(value->type));
+        Put((uint32_t)value->scalars.size());
+        for (const ConstScalar& scalar : value->scalars) {
+            Put(scalar);
+        }
+        Put((uint32_t)value->elements.size());
+        for (const ConstValue* element : value->elements) {
+            PutValue(element);
+        }
+    }
+
+    void Begin(NodeTag tag, const Node* node) {
+        Put(tag);
+        Put(node->GetLoc());
+    }
+
+    void PutList(std::span<const uint32_t> list) {
+        Put((uint32_t)list.size());
+        for (uint32_t ref : list) {
+            Put(ref);
+        }
+    }
+
+    // The string data is in the source or the blob
+    StrRef MakeStr(std::string_view str) {
+        const bool inSource = str.data() >= source_.data() &&
+                              str.data() + str.size() <=
+                                  source_.data() + source_.size();
+        if (inSource) {
+            return {(uint32_t)(str.data() - source_.data()),
+                    (uint32_t)str.size()};
+        }
+        auto [it, inserted] =
+            blobStrings_.try_emplace(str, (uint32_t)blob_.size());
+        if (inserted) {
+            blob_.insert(blob_.end(), str.begin(), str.end());
+        }
+        return {kBlobRefBit | it->second, (uint32_t)str.size()};
+    }
+
+    void PutStr(std::string_view str) { Put(MakeStr(str)); }
+
+    // Inline string
+    void PutString(std::string_view str) {
+        Put((uint32_t)str.size());
+        target_->insert(target_->end(), str.begin(), str.end());
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    void Put(const T& value) {
+        const size_t pos = target_->size();
+        target_->resize(pos + sizeof(T));
+        std::memcpy(target_->data() + pos, &value, sizeof(T));
+    }
+
+private:
+    const Program& program_;
+    std::string_view source_;
+    FlatHashMap<const Node*, uint32_t> ids_;
+    FlatHashMap<const ast::SymbolTable*, uint32_t> tableIds_;
+    std::vector<const ast::SymbolTable*> tables_;
+    uint32_t numNodes_ = 0;
+    // Node records, written before the final layout is known
+    std::vector<uint8_t> nodes_;
+    std::vector<uint8_t> blob_;
+    FlatHashMap<std::string_view, uint32_t> blobStrings_;
+    std::vector<uint8_t> out_;
+    std::vector<uint8_t>* target_ = &nodes_;
+    bool failed_ = false;
+};
+
+class ProgramReader {
+public:
+    ProgramReader(Program& program, std::span<const uint8_t> data)
+        : program_(program), data_(data) {}
+
+    // Returns false if the data is malformed or of another version
+    bool Read() {
+        Header header{};
+        if (!GetRaw(header) || header.magic != kMagic ||
+            header.version != Program::kSerializedVersion ||
+            header.numBuiltins != BuiltinScope::Get().GetTypes().size() ||
+            header.size != data_.size() - pos_ ||
+            header.checksum != Checksum(data_.subspan(pos_))) {
+            return false;
+        }
+        // The views into the source stay valid, it is never modified
+        if (!GetString(program_.sourceCode_)) {
+            return false;
+        }
+        source_ = program_.sourceCode_;
+
+        const uint32_t blobSize = Get<uint32_t>();
+        if (!Has(blobSize)) {
+            return false;
+        }
+        auto* blob = static_cast<char*>(program_.alloc_.Allocate(blobSize, 1));
+        std::memcpy(blob, data_.data() + pos_, blobSize);
+        blob_ = std::string_view(blob, blobSize);
+        pos_ += blobSize;
+
+        // The first table is the global one created by the program
+        const uint32_t numTables = Get<uint32_t>();
+        for (uint32_t i = 0; i < numTables && ok_; ++i) {
+            const uint32_t parent = Get<uint32_t>();
+            if (i == 0) {
+                ok_ &= parent == kNullRef;
+                tables_.push_back(program_.globalScope_->symbolTable);
+                continue;
+            }
+            ok_ &= parent != kNullRef && parent <= tables_.size();
+            if (ok_) {
+                tables_.push_back(program_.alloc_.Allocate<ast::SymbolTable>(
+                    tables_[parent - 1], program_.alloc_));
+            }
+        }
+
+        const uint32_t numNodes = Get<uint32_t>();
+        // Each node has at least a tag and a location
+        ok_ &= Has((size_t)numNodes * (1 + sizeof(SourceLoc)));
+        nodes_.reserve(ok_ ? numNodes : 0);
+        for (uint32_t i = 0; i < numNodes && ok_; ++i) {
+            nodes_.push_back(ReadNode());
+        }
+
+        for (uint32_t i = 0; i < numTables && ok_; ++i) {
+            const uint32_t numSymbols = Get<uint32_t>();
+            for (uint32_t j = 0; j < numSymbols && ok_; ++j) {
+                const std::string_view name = GetStr();
+                auto* symbol = GetNode<Symbol>();
+                ok_ &= symbol && tables_[i]->InsertSymbol(name, symbol);
+            }
+        }
+
+        const uint32_t numDecls = Get<uint32_t>();
+        for (uint32_t i = 0; i < numDecls && ok_; ++i) {
+            auto* decl = GetNode<Symbol>();
+            ok_ &= decl != nullptr;
+            program_.globalScope_->decls.push_back(decl);
+        }
+
+        const uint32_t numDiags = Get<uint32_t>();
+        for (uint32_t i = 0; i < numDiags && ok_; ++i) {
+            Program::DiagMsg& diag = program_.diags_.emplace_back();
+            diag.type = (Program::DiagMsg::Type)Get<uint8_t>();
+            diag.loc = Get<SourceLoc>();
+            diag.code = (ErrorCode)Get<uint32_t>();
+            ok_ &= GetString(diag.msg);
+        }
+        return ok_ && pos_ == data_.size();
+    }
+
+private:
+    Node* ReadNode() {
+        const auto tag = Get<NodeTag>();
+        const auto loc = Get<SourceLoc>();
+        Node* node = CreateNode(tag, loc);
+        if (auto* expr = node ? node->As<Expression>() : nullptr) {
+            expr->constValue = GetValue(0);
+        }
+        return node;
+    }
+
+    Node* CreateNode(NodeTag tag, SourceLoc loc) {
+        BumpAllocator& alloc = program_.alloc_;
+        switch (tag) {
+            case NodeTag::Array: {
+                auto* valueType = GetNode<Type>();
+                const auto size = Get<uint32_t>();
+                const auto name = GetStr();
+                if (!valueType) {
+                    break;
+                }
+                auto* type = alloc.Allocate<Array>(valueType, size, name);
+                program_.arrayTypes_.try_emplace({valueType, size}, type);
+                return type;
+            }
+            case NodeTag::Struct: {
+                const auto name = GetStr();
+                auto members = GetList<Member, MemberList>();
+                return alloc.Allocate<Struct>(loc, name, std::move(members));
+            }
+            case NodeTag::Member: {
+                const auto name = GetStr();
+                auto* type = GetNode<Type>();
+                auto attributes = GetList<Attribute, AttributeList>();
+                return alloc.Allocate<Member>(loc, name, type,
+                                          std::move(attributes));
+            }
+            case NodeTag::Function: {
+                const auto name = GetStr();
+                auto attributes = GetList<Attribute, AttributeList>();
+                auto params = GetList<Parameter, ParameterList>();
+                auto* retType = GetNode<Type>();
+                auto retAttributes = GetList<Attribute, AttributeList>();
+                auto* body = GetNode<ScopedStatement>();
+                return alloc.Allocate<Function>(
+                    loc, body, name, std::move(attributes), std::move(params),
+                    retType, std::move(retAttributes));
+            }
+            case NodeTag::Parameter: {
+                const auto ident = GetStr();
+                auto* type = GetNode<Type>();
+                auto attributes = GetList<Attribute, AttributeList>();
+                return alloc.Allocate<Parameter>(loc, ident, type,
+                                             std::move(attributes));
+            }
+            case NodeTag::VarVariable: {
+                const auto ident = GetStr();
+                const auto addressSpace = (AddressSpace)Get<uint8_t>();
+                const auto accessMode = (AccessMode)Get<uint8_t>();
+                auto* type = GetNode<Type>();
+                auto attributes = GetList<Attribute, AttributeList>();
+                auto* initializer = GetNode<Expression>();
+                return alloc.Allocate<VarVariable>(loc, ident, addressSpace,
+                                               accessMode, type,
+                                               std::move(attributes),
+                                               initializer);
+            }
+            case NodeTag::ConstVariable: {
+                const auto ident = GetStr();
+                auto* type = GetNode<Type>();
+                auto* initializer = GetNode<Expression>();
+                const ConstValue* value = GetValue(0);
+                return alloc.Allocate<ConstVariable>(loc, ident, type,
+                                                 initializer, value);
+            }
+            case NodeTag::Attribute: {
+                const auto attr = (AttributeName)Get<uint8_t>();
+                return alloc.Allocate<Attribute>(loc, attr);
+            }
+            case NodeTag::ScalarAttribute: {
+                const auto attr = (AttributeName)Get<uint8_t>();
+                const auto value = Get<int64_t>();
+                return alloc.Allocate<ScalarAttribute>(loc, attr, value);
+            }
+            case NodeTag::BuiltinAttribute: {
+                const auto value = (Builtin)Get<uint8_t>();
+                return alloc.Allocate<BuiltinAttribute>(loc, value);
+            }
+            case NodeTag::WorkgroupAttribute: {
+                const auto x = Get<uint32_t>();
+                const auto y = Get<uint32_t>();
+                const auto z = Get<uint32_t>();
+                return alloc.Allocate<WorkgroupAttribute>(loc, x, y, z);
+            }
+            case NodeTag::ScopedStatement:
+            case NodeTag::CompoundStatement: {
+                auto* symbols = GetTable();
+                if (!symbols) {
+                    break;
+                }
+                ScopedStatement* scope =
+                    tag == NodeTag::ScopedStatement
+                        ? alloc.Allocate<ScopedStatement>(loc, symbols)
+                        : alloc.Allocate<CompoundStatement>(loc, symbols);
+                scope->statements =
+                    GetList<Statement, ProgramList<Statement*>>();
+                return scope;
+            }
+            case NodeTag::IfStatement: {
+                auto* expr = GetNode<Expression>();
+                auto* symbols = GetTable();
+                auto* next = GetNode<ScopedStatement>();
+                if (!symbols) {
+                    break;
+                }
+                auto* clause = alloc.Allocate<IfStatement>(loc, expr, symbols);
+                if (next) {
+                    clause->AppendElse(next);
+                }
+                clause->statements =
+                    GetList<Statement, ProgramList<Statement*>>();
+                return clause;
+            }
+            case NodeTag::ReturnStatement: {
+                auto* expr = GetNode<Expression>();
+                return alloc.Allocate<ReturnStatement>(loc, expr);
+            }
+            case NodeTag::AssignStatement: {
+                auto* var = GetNode<VarVariable>();
+                auto* expr = GetNode<Expression>();
+                return alloc.Allocate<AssignStatement>(loc, var, expr);
+            }
+            case NodeTag::UnaryExpression: {
+                auto* type = GetNode<Type>();
+                const auto op = Get<OpCode>();
+                auto* rhs = GetNode<Expression>();
+                return alloc.Allocate<UnaryExpression>(loc, type, op, rhs);
+            }
+            case NodeTag::BinaryExpression: {
+                auto* type = GetNode<Type>();
+                auto* lhs = GetNode<Expression>();
+                const auto op = Get<OpCode>();
+                auto* rhs = GetNode<Expression>();
+                return alloc.Allocate<BinaryExpression>(loc, type, lhs, op,
+                                                        rhs);
+            }
+            case NodeTag::IntLiteralExpression: {
+                auto* type = GetNode<Type>();
+                const auto value = Get<int64_t>();
+                return alloc.Allocate<IntLiteralExpression>(loc, type, value);
+            }
+            case NodeTag::FloatLiteralExpression: {
+                auto* type = GetNode<Type>();
+                const auto value = Get<double>();
+                return alloc.Allocate<FloatLiteralExpression>(loc, type, value);
+            }
+            case NodeTag::BoolLiteralExpression: {
+                auto* type = GetNode<Type>();
+                const auto value = Get<uint8_t>() != 0;
+                return alloc.Allocate<BoolLiteralExpression>(loc, type, value);
+            }
+            case NodeTag::IdentExpression: {
+                auto* symbol = GetNode<Symbol>();
+                if (!symbol) {
+                    break;
+                }
+                if (auto* var = symbol->As<Variable>()) {
+                    return alloc.Allocate<IdentExpression>(loc, var);
+                }
+                if (auto* type = symbol->As<Type>()) {
+                    return alloc.Allocate<IdentExpression>(loc, type);
+                }
+                if (auto* func = symbol->As<Function>()) {
+                    return alloc.Allocate<IdentExpression>(loc, func);
+                }
+                break;
+            }
+            case NodeTag::MemberAccessExpr: {
+                auto* expr = GetNode<Expression>();
+                auto* member = GetNode<Member>();
+                if (!member) {
+                    break;
+                }
+                return alloc.Allocate<MemberAccessExpr>(loc, expr, member);
+            }
+            case NodeTag::SwizzleExpr: {
+                auto* type = GetNode<Type>();
+                auto* lhs = GetNode<Expression>();
+                const auto swizzle = Get<std::array<VecComponent, 4>>();
+                return alloc.Allocate<SwizzleExpr>(loc, type, lhs, swizzle[0],
+                                               swizzle[1], swizzle[2],
+                                               swizzle[3]);
+            }
+            case NodeTag::ArrayIndexExpr: {
+                auto* type = GetNode<Type>();
+                auto* array = GetNode<Expression>();
+                auto* index = GetNode<Expression>();
+                return alloc.Allocate<ArrayIndexExpr>(loc, type, array, index);
+            }
+            case NodeTag::CallExpression: {
+                auto* type = GetNode<Type>();
+                const auto fn = Get<uint8_t>();
+                const BuiltinFunction* builtin = nullptr;
+                if (fn != kNoBuiltin) {
+                    builtin = BuiltinScope::Get().GetFunction((BuiltinFn)fn);
+                    if (!builtin) {
+                        break;
+                    }
+                }
+                auto args = GetList<Expression, ArgumentList>();
+                return alloc.Allocate<CallExpression>(loc, type, builtin,
+                                                      std::move(args));
+            }
+            default: break;
+        }
+        ok_ = false;
+        return nullptr;
+    }
+
+    // Returns nullptr for a null type or an error
+    const ConstValue* GetValue(uint32_t depth) {
+        auto* type = GetNode<Type>();
+        if (!type) {
+            return nullptr;
+        }
+        const uint32_t numScalars = Get<uint32_t>();
+        ok_ &= numScalars == GetNumComponents(type) &&
+               Has((size_t)numScalars * sizeof(ConstScalar));
+        if (!ok_) {
+            return nullptr;
+        }
+        auto* scalars = static_cast<ConstScalar*>(program_.alloc_.Allocate(
+            numScalars * sizeof(ConstScalar), alignof(ConstScalar)));
+        for (uint32_t i = 0; i < numScalars; ++i) {
+            scalars[i] = Get<ConstScalar>();
+        }
+        // The elements of arrays and structs
+        const uint32_t numElements = Get<uint32_t>();
+        uint32_t expected = 0;
+        if (const auto* array = type->As<Array>()) {
+            expected = array->size;
+        } else if (const auto* structType = type->As<Struct>()) {
+            expected = (uint32_t)structType->members.size();
+        }
+        ok_ &= numElements == expected && depth < kMaxValueDepth &&
+               Has((size_t)numElements * sizeof(uint32_t));
+        if (!ok_) {
+            return nullptr;
+        }
+        auto* elements = static_cast<const ConstValue**>(
+            program_.alloc_.Allocate(numElements * sizeof(ConstValue*),
+                                     alignof(ConstValue*)));
+        for (uint32_t i = 0; i < numElements && ok_; ++i) {
+            elements[i] = GetValue(depth + 1);
+            ok_ &= elements[i] != nullptr;
+        }
+        return program_.alloc_.Allocate<ConstValue>(
+            type, std::span<const ConstScalar>(scalars, numScalars),
+            std::span<const ConstValue* const>(elements, numElements));
+    }
+
+    // Returns nullptr for a null reference or an error
+    template <class T>
+    T* GetNode() {
+        const uint32_t ref = Get<uint32_t>();
+        if (ref == kNullRef) {
+            return nullptr;
+        }
+        Node* node = nullptr;
+        if (ref & kBuiltinRefBit) {
+            const auto builtins = BuiltinScope::Get().GetTypes();
+            const uint32_t index = ref & ~kBuiltinRefBit;
+            node = index < builtins.size() ? builtins[index] : nullptr;
+        } else if (ref <= nodes_.size()) {
+            node = nodes_[ref - 1];
+        }
+        T* out = node ? node->As<T>() : nullptr;
+        ok_ &= out != nullptr;
+        return out;
+    }
+
+    template <class T, class List>
+    List GetList() {
+        List list;
+        const uint32_t size = Get<uint32_t>();
+        ok_ &= Has((size_t)size * sizeof(uint32_t));
+        for (uint32_t i = 0; i < size && ok_; ++i) {
+            list.push_back(GetNode<T>());
+        }
+        return list;
+    }
+
+    ast::SymbolTable* GetTable() {
+        const uint32_t ref = Get<uint32_t>();
+        ok_ &= ref != kNullRef && ref <= tables_.size();
+        return ok_ ? tables_[ref - 1] : nullptr;
+    }
+
+    std::string_view GetStr() {
+        const uint32_t offset = Get<uint32_t>();
+        const uint32_t size = Get<uint32_t>();
+        const std::string_view src =
+            offset & kBlobRefBit ? blob_ : source_;
+        const size_t begin = offset & ~kBlobRefBit;
+        if (begin > src.size() || size > src.size() - begin) {
+            ok_ = false;
+            return {};
+        }
+        return src.substr(begin, size);
+    }
+
+    bool GetString(std::string& out) {
+        const uint32_t size = Get<uint32_t>();
+        if (!Has(size)) {
+            return false;
+        }
+        out.assign((const char*)data_.data() + pos_, size);
+        pos_ += size;
+        return true;
+    }
+
+    bool Has(size_t size) const { return ok_ && data_.size() - pos_ >= size; }
+
+    template <class T>
+    bool GetRaw(T& out) {
+        if (!Has(sizeof(T))) {
+            ok_ = false;
+            return false;
+        }
+        std::memcpy(&out, data_.data() + pos_, sizeof(T));
+        pos_ += sizeof(T);
+        return true;
+    }
+
+    template <class T>
+        requires std::is_trivially_copyable_v<T>
+    T Get() {
+        T out{};
+        GetRaw(out);
+        return out;
+    }
+
+private:
+    Program& program_;
+    std::span<const uint8_t> data_;
+    size_t pos_ = 0;
+    bool ok_ = true;
+    std::string_view source_;
+    std::string_view blob_;
+    std::vector<ast::SymbolTable*> tables_;
+    std::vector<Node*> nodes_;
+};
+
+}  // namespace
+
+std::vector<uint8_t> Program::Serialize() const {
+    TRACE_SCOPE("Program::Serialize");
+    return ProgramWriter(*this).Write();
+}
+
+std::unique_ptr<Program> Program::Deserialize(std::span<const uint8_t> data) {
+    TRACE_SCOPE("Program::Deserialize");
+    MEM_TAG(Shaders);
+    auto program = std::unique_ptr<Program>(new Program());
+    {
+        BuildScope buildScope(program.get());
+        if (!ProgramReader(*program, data).Read()) {
+            return nullptr;
+        }
+    }
+    return program;
+}
+
+}  // namespace wgsl
@@ -0,0 +1,285 @@
+#pragma once
+#include "parser.h"
+
+#include <format>
+#include <map>
+#include <memory>
+
+namespace wgsl {
+
+// Writes the overload tables of the builtin functions, included by
+// builtin_scope.cpp as constexpr arrays
+// The templates of a signature are expanded into an overload per choice of
+// the template params:
+//   S = AbstractFloat, f32
+//   T = S, vecN<S>
+//   fn sqrt(e: T) -> T
+// -> sqrt(AbstractFloat), sqrt(vecN<AbstractFloat>), sqrt(f32),
+//    sqrt(vecN<f32>)
+// The sizes N, C and R are bound by the args of a call.
+class OverloadTableWriter {
+public:
+    // Returns an error message if the signature is not valid
+    std::optional<std::string> Add(const BuiltinFuncSignature& sig) {
+        const std::optional<ast::BuiltinFn> fn =
+            ast::BuiltinFnFromString(ast::BuiltinFnNameFromString(sig.name));
+        if (!fn) {
+            return std::format("'{}' is not a builtin function", sig.name);
+        }
+        Bindings bindings;
+        return Expand(sig, *fn, 0, bindings);
+    }
+
+    std::string Write() const {
+        std::string out;
+        out += "// Generated by wgsl_signature_parser from "
+               "builtin_functions.txt, do not edit\n"
+               "// Included by builtin_scope.cpp\n\n";
+        WriteConversionRanks(out);
+
+        size_t maxParams = 0;
+        for (const auto& [fn, overloads] : overloads_) {
+            for (const Overload& overload : overloads) {
+                maxParams = std::max(maxParams, overload.params.size());
+            }
+        }
+        out += std::format("constexpr size_t kMaxOverloadParams = {};\n\n",
+                           maxParams);
+
+        out += "constexpr OverloadType kOverloadParams[] = {\n";
+        for (const auto& [fn, overloads] : overloads_) {
+            out += std::format("    // {}\n", GetName(fn));
+            for (const Overload& overload : overloads) {
+                for (const std::string& param : overload.params) {
+                    out += std::format("    {},\n", param);
+                }
+            }
+        }
+        out += "};\n\n";
+
+        out += "constexpr Overload kOverloads[] = {\n";
+        size_t firstParam = 0;
+        for (const auto& [fn, overloads] : overloads_) {
+            out += std::format("    // {}\n", GetName(fn));
+            for (const Overload& overload : overloads) {
+                out += std::format("    {{{}, {}, {}, {}}},\n", firstParam,
+                                   overload.params.size(),
+                                   overload.isConst ? "true" : "false",
+                                   overload.ret);
+                firstParam += overload.params.size();
+            }
+        }
+        out += "};\n\n";
+
+        out += "// Indexed by BuiltinFn\n"
+               "constexpr OverloadRange kOverloadsByFn[] = {\n";
+#define COUNT(NAME) +1
+        constexpr size_t kNumFunctions = 0 BUILTIN_FUNC_LIST(COUNT);
+#undef COUNT
+        size_t first = 0;
+        for (size_t i = 0; i < kNumFunctions; ++i) {
+            const auto fn = (ast::BuiltinFn)i;
+            const auto it = overloads_.find(fn);
+            const size_t count =
+                it == overloads_.end() ? 0 : it->second.size();
+            out += std::format("    {{{}, {}}},  // {}\n", count ? first : 0,
+                               count, GetName(fn));
+            first += count;
+        }
+        out += "};\n";
+        return out;
+    }
+
+private:
+    // Template params and their choices: S -> f32
+    using Bindings = std::vector<std::pair<std::string_view, Type>>;
+
+    struct Overload {
+        // Initializers of OverloadType
+        std::vector<std::string> params;
+        std::string ret;
+        bool isConst = false;
+    };
+
+    std::optional<std::string> Expand(const BuiltinFuncSignature& sig,
+                                      ast::BuiltinFn fn,
+                                      size_t templateIndex,
+                                      Bindings& bindings) {
+        if (templateIndex < sig.templateParams.size()) {
+            const TemplateParam& param = sig.templateParams[templateIndex];
+            for (const Type& type : param.constraints) {
+                bindings.emplace_back(param.name, Substitute(type, bindings));
+                auto error = Expand(sig, fn, templateIndex + 1, bindings);
+                bindings.pop_back();
+                if (error) {
+                    return error;
+                }
+            }
+            return std::nullopt;
+        }
+        Overload overload;
+        overload.isConst = sig.isConst;
+        std::string boundSizes;
+        for (const Param& param : sig.params) {
+            const Type paramType = Substitute(param.type, bindings);
+            auto type = Encode(paramType);
+            if (!type) {
+                return std::format("{}: {}", sig.name, type.error());
+            }
+            overload.params.push_back(*type);
+            boundSizes += GetSizeNames(paramType);
+        }
+        const Type retType = Substitute(sig.ret, bindings);
+        auto ret = Encode(retType);
+        if (!ret) {
+            return std::format("{}: {}", sig.name, ret.error());
+        }
+        // The sizes of the return type are taken from the args of a call
+        for (char size : GetSizeNames(retType)) {
+            if (boundSizes.find(size) == std::string::npos) {
+                return std::format(
+                    "{}: the return size {} is not bound by the params",
+                    sig.name, size);
+            }
+        }
+        overload.ret = *ret;
+        overloads_[fn].push_back(std::move(overload));
+        return std::nullopt;
+    }
+
+    static Type Substitute(const Type& type, const Bindings& bindings) {
+        for (const auto& [name, choice] : bindings) {
+            if (type.name == name && type.templateParams.empty()) {
+                return choice;
+            }
+        }
+        Type out{type.name, {}};
+        for (const Type& param : type.templateParams) {
+            out.templateParams.push_back(Substitute(param, bindings));
+        }
+        return out;
+    }
+
+    // OverloadType initializer of a scalar, vector or matrix type:
+    // vecN<f32> -> {OverloadShape::Vec, ScalarKind::F32, kSizeN, 0}
+    static std::expected<std::string, std::string> Encode(const Type& type) {
+        if (auto scalar = GetScalarKind(type.name)) {
+            if (!type.templateParams.empty()) {
+                return std::unexpected(
+                    std::format("'{}' has no template params", type.name));
+            }
+            return std::format(
+                "{{OverloadShape::Scalar, ScalarKind::{}, 0, 0}}", *scalar);
+        }
+        std::string_view shape;
+        std::string_view columns;
+        std::string_view rows = "0";
+        const std::string_view name = type.name;
+        if (name.size() == 4 && name.starts_with("vec")) {
+            shape = "Vec";
+            columns = GetSize(name[3]);
+        } else if (name.size() == 6 && name.starts_with("mat") &&
+                   name[4] == 'x') {
+            shape = "Matrix";
+            columns = GetSize(name[3]);
+            rows = GetSize(name[5]);
+        }
+        if (shape.empty() || columns.empty() || rows.empty()) {
+            return std::unexpected(
+                std::format("type '{}' is not supported", name));
+        }
+        std::optional<std::string_view> scalar;
+        if (type.templateParams.size() == 1 &&
+            type.templateParams[0].templateParams.empty()) {
+            scalar = GetScalarKind(type.templateParams[0].name);
+        }
+        if (!scalar) {
+            return std::unexpected(
+                std::format("'{}' expects a scalar template param", name));
+        }
+        return std::format("{{OverloadShape::{}, ScalarKind::{}, {}, {}}}",
+                           shape, *scalar, columns, rows);
+    }
+
+    static std::optional<std::string_view> GetScalarKind(
+        std::string_view name) {
+        if (name == "AbstractInt") {
+            return "Int";
+        }
+        if (name == "AbstractFloat") {
+            return "Float";
+        }
+#define IF(NAME, STR)   \
+    if (name == STR) {  \
+        return #NAME;   \
+    }
+        SCALAR_KIND_LIST(IF)
+#undef IF
+        return std::nullopt;
+    }
+
+    // Sizes bound by the args: vecN<f32> -> "N", matCxR<f32> -> "CR"
+    static std::string GetSizeNames(const Type& type) {
+        const std::string_view name = type.name;
+        std::string sizes;
+        if (name.size() == 4 && name.starts_with("vec")) {
+            sizes += name[3];
+        } else if (name.size() == 6 && name.starts_with("mat") &&
+                   name[4] == 'x') {
+            sizes += name[3];
+            sizes += name[5];
+        }
+        std::erase_if(sizes, [](char c) { return c < 'A' || c > 'Z'; });
+        return sizes;
+    }
+
+    // Empty if not a size
+    static std::string_view GetSize(char c) {
+        switch (c) {
+            case '2': return "2";
+            case '3': return "3";
+            case '4': return "4";
+            case 'N': return "kSizeN";
+            case 'C': return "kSizeC";
+            case 'R': return "kSizeR";
+            default: return "";
+        }
+    }
+
+    static std::string_view GetName(ast::BuiltinFn fn) {
+        // "__abs" -> "abs"
+        return ast::to_string(fn).substr(2);
+    }
+
+    // Conversion ranks of the scalar kinds [from][to]
+    static void WriteConversionRanks(std::string& out) {
+        std::vector<std::unique_ptr<ast::Scalar>> scalars;
+#define SCALAR(NAME, STR) \
+    scalars.push_back(std::make_unique<ast::Scalar>(ast::ScalarKind::NAME));
+        SCALAR_KIND_LIST(SCALAR)
+#undef SCALAR
+        out += std::format(
+            "// https://www.w3.org/TR/WGSL/#conversion-rank\n"
+            "constexpr uint8_t kConversionRank[{0}][{0}] = {{\n",
+            scalars.size());
+        constexpr uint32_t kMax = std::numeric_limits<uint32_t>::max();
+        for (const auto& from : scalars) {
+            out += "    {";
+            for (const auto& to : scalars) {
+                const uint32_t rank = from->GetConversionRankTo(to.get());
+                out += rank == kMax ? "kNoConversion"
+                                    : std::format("{}", rank);
+                out += to == scalars.back() ? "" : ", ";
+            }
+            out += std::format("}},  // {}\n", from->name);
+        }
+        out += "};\n\n";
+    }
+
+private:
+    // Sorted by BuiltinFn, the overloads of a function are in the order of
+    // the signatures
+    std::map<ast::BuiltinFn, std::vector<Overload>> overloads_;
+};
+
+}  // namespace wgsl
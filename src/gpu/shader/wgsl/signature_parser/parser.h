@@ -9,16 +9,6 @@
 
 namespace wgsl {
 
-struct Writer {
-    std::string* str;
-    Writer(std::string* str) : str(str) {}
-    Writer& operator<<(std::string_view s) {
-        str->append(s);
-        return *this;
-    }
-};
-
-
 // A type name
 struct Type {
     std::string_view name;
@@ -43,69 +33,14 @@ struct Param {
 // T = float, int, i32, u32, f32, bool
 // @const @must_use fn i32(e: T)-> i32
 struct BuiltinFuncSignature {
-    bool mustUse;
-    bool isConst;
+    bool mustUse = false;
+    bool isConst = false;
     std::string name;
     std::vector<TemplateParam> templateParams;
     std::vector<Param> params;
     Type ret;
 };
 
-// Writes a static declaraion in the format:
-//
-//   static auto f = BuiltinFuncSignature{
-//       .mustUse = false,
-//       .isConst = false,
-//       .name = "abs",
-//       .templateParams = {{"T", {{"vecN", "i32"}, {"i32", ""}}}},
-//       .params = {{"e", {"i32", ""}}, {"r", "T"}},
-//       .ret = {"vecN", "T"},
-//   };
-//
-// struct SignatureWriter {
-//     static void Write(const BuiltinFuncSignature& sig, Writer& s) {
-//         s << "static auto k" << sig.name << " = BuiltinFuncSignature {\n";
-//         s << "  .mustUse = " << (sig.mustUse ? "true" : "false") << ",\n";
-//         s << "  .isConst = " << (sig.isConst ? "true" : "false") << ",\n";
-//         s << "  .name = \"" << sig.name << "\",\n";
-//         WriteTemplate(sig, s);
-//         WriteParams(sig, s);
-//         s << "  .ret = ";
-//         WriteType(sig.ret, s);
-//         s << ",\n";
-//         s << "};\n";
-//     }
-
-// private:
-//     static void WriteTemplate(const BuiltinFuncSignature& sig, Writer& s) {
-//         s << "  .templateParams = {";
-//         for (const auto [param, types] : sig.templateParams) {
-//             s << "{\"" << param << "\", {";
-//             for (const auto type : types) {
-//                 WriteType(type, s);
-//                 s << ", ";
-//             }
-//             s << "}},";
-//         }
-//         s << "},\n";
-//     }
-
-//     static void WriteParams(const BuiltinFuncSignature& sig, Writer& s) {
-//         s << "  .params = {";
-//         for (const auto [param, type] : sig.params) {
-//             s << "{\"" << param << "\", ";
-//             WriteType(type, s);
-//             s << "}, ";
-//         }
-//         s << "},\n";
-//     }
-
-//     static void WriteType(const BuiltinFuncSignature::Type& type, Writer& s)
-//     {
-//         s << "{\"" << type.name << "\", \"" << type.nestedName << "\"}";
-//     }
-// };
-
 class SignatureBuilder {
 public:
     void SetMustUse() { sig.mustUse = true; }
@@ -202,6 +137,7 @@ private:
                 Expect("or");
                 continue;
             } else if (Match(Token::Kind::Ident) || Match(Token::Kind::Attr) ||
+                       Match(Token::Kind::Keyword) ||
                        Expect(Token::Kind::Semicolon)) {
                 // Start of next line: ident @ fn ;
                 break;
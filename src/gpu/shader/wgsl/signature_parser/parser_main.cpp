@@ -1,3 +1,4 @@
+#include "overload_table_writer.h"
 #include "parser.h"
 
 #include <filesystem>
@@ -22,13 +23,14 @@ void PrintError(std::format_string<Args...> fmt, Args&&... args) {
               << '\n';
 }
 
-// An empty line
-constexpr std::string_view kDataSeparator = "\r\n\r\n";
-
-std::vector<wgsl::BuiltinFuncSignature> signatures;
+// Blocks of signatures are separated by an empty line
+constexpr std::string_view kDataSeparator = "\n\n";
 
+// Converts the signatures of builtin functions into the overload tables of
+// BuiltinScope
+//   wgsl_signature_parser <signatures.txt> <output.inl>
 int main(int argv, char* argc[]) {
-    VERIFY(argv == 2, -1, "expected a path to a txt file");
+    VERIFY(argv == 3, -1, "expected a path to a txt file and an output path");
     const auto filename =
         (std::filesystem::path(argc[0]).parent_path() / argc[1]).string();
     VERIFY(std::filesystem::exists(filename), -1,
@@ -41,22 +43,21 @@ int main(int argv, char* argc[]) {
         std::string buf;
         buf.resize(fileSize);
         file.read(buf.data(), fileSize);
+        // Line breaks \r\n -> \n
+        std::erase(buf, '\r');
         return std::move(buf);
     }();
     VERIFY(!file.empty(), -1, "file '{}' is empty", filename);
     // Parse file
+    auto writer = wgsl::OverloadTableWriter();
+    size_t numSignatures = 0;
     size_t offset = 0;
-    for (;;) {
+    while (offset < file.size()) {
         const size_t start = offset;
-        const size_t end = file.find(kDataSeparator, start);
-
-        if (end == file.npos || offset > file.size()) {
-            break;
-        }
-
-        const size_t size = end - start;
-        const auto block = std::string_view(&file[start], size);
-        offset += size + kDataSeparator.size();
+        const size_t end = std::min(file.find(kDataSeparator, start),
+                                    file.size());
+        const auto block = std::string_view(&file[start], end - start);
+        offset = end + kDataSeparator.size();
 
         // Parse block
         auto parser = wgsl::SignatureParser();
@@ -65,37 +66,19 @@ int main(int argv, char* argc[]) {
                res.error().loc.line, res.error().loc.col, res.error().msg,
                block);
         // An empty, probably a comment or empty line
-        if(res.value().name.empty()) {
+        if (res.value().name.empty()) {
             continue;
         }
-        PrintInfo("parsed signature: '{}'", res.value().name);
-        signatures.push_back(res.value());
+        const auto error = writer.Add(res.value());
+        VERIFY(!error, -1, "invalid signature: {}\n Sig: \n{}", *error, block);
+        ++numSignatures;
     }
-    if(signatures.empty()) {
-        PrintError("file {} does not contain valid signatures data", filename);
-    } else {
-        PrintInfo("successfully parsed {} signatures", signatures.size());
-    }
-    // std::string buf;
-    // auto writer = wgsl::Writer(&buf);
-    // wgsl::SignatureWriter::Write(res.value(), writer);
+    VERIFY(numSignatures > 0, -1,
+           "file {} does not contain valid signatures data", filename);
+    PrintInfo("successfully parsed {} signatures", numSignatures);
+
+    auto out = std::ofstream(argc[2], std::ios::binary);
+    VERIFY(out.is_open(), -1, "cannot open file '{}'", argc[2]);
+    out << writer.Write();
     return 0;
 }
-
-// For each param:
-//   If param is a concrete type:
-//     It should match the arg type exactly
-//   Else a template param:
-//     Try resolve the template param:
-//       If already resolved;
-//         If resolved try match the resolved type with the arg type
-//           If not matched -> type error
-//       Else:
-//         Match the outer arg type param then recursively inner types
-//         For each nested param in the arg type:
-//           Get a template declaration for that name
-//           Try match the arg type with the types in the declaration
-//           If has a match:
-//             Register that template param with that type
-//               E.g T -> i32, [fn (T, T)-> T] -> [fn (i32, i32)-> i32]
-//           Else: type error
@@ -1,4 +1,5 @@
 #include "task_executor.h"
+#include "base/trace.h"
 
 thread_local TaskExecutor* currentThreadExecutor{};
 
@@ -9,14 +10,12 @@ TaskExecutor* TaskExecutor::GetForCurrentThread() {
 void TaskExecutor::RegisterTaskSource(std::shared_ptr<TaskSource> taskSource) {
     {
         std::scoped_lock _(lock_);
-        auto it = std::ranges::find_if(
-            sources_, 
-            [&](auto&& e) { return e.get() == taskSource.get(); }
-        );
-        if(it != sources_.end()) {
+        // The handle could be of another executor
+        const auto* registered = sources_.get(taskSource->executorSlot_);
+        if(registered && *registered == taskSource) {
             return;
         }
-        sources_.push_back(taskSource);
+        taskSource->executorSlot_ = sources_.insert(taskSource);
         taskSource->OnExecutorSet(this);
     }
     if(!taskSource->Empty()) {
@@ -24,20 +23,31 @@ void TaskExecutor::RegisterTaskSource(std::shared_ptr<TaskSource> taskSource) {
     }
 }
 
+void TaskExecutor::UnregisterTaskSource(TaskSource* taskSource) {
+    std::scoped_lock _(lock_);
+    DASSERT_F(sources_.contains(taskSource->executorSlot_),
+              "Invalid task source");
+    std::erase(readyQueue_, taskSource);
+    sources_.erase(taskSource->executorSlot_);
+    taskSource->executorSlot_ = {};
+}
+
 void TaskExecutor::NotifyHasWork(TaskSource* source) {
     DASSERT(source);
-    {
-        std::scoped_lock _(lock_);
-        auto it = std::ranges::find_if(
-            sources_, 
-            [&](const std::shared_ptr<TaskSource>& e) { 
-                return e.get() == source; 
-            }
-        );
-        DASSERT_F(it != sources_.end(), "Invalid task source");
+    // Safe without the lock, rejects unregistered sources early
+    if(!sources_.contains(source->executorSlot_)) {
+        DASSERT_M(false, "Invalid task source");
+        return;
     }
     {
         std::scoped_lock _(lock_);
+        // The slot could be reused by another source after this one is
+        // unregistered
+        const auto* registered = sources_.get(source->executorSlot_);
+        if(!registered || registered->get() != source) {
+            DASSERT_M(false, "Invalid task source");
+            return;
+        }
         auto it = std::ranges::find_if(
             readyQueue_,
             [&](const TaskSource* e) { return e == source; }
@@ -54,7 +64,8 @@ void TaskExecutor::ScheduleTaskSourceLocked(TaskSource* source) {
         std::scoped_lock _(lock_);
         readyQueue_.push_back(source);
     }
-    semaphore_.release();
+    // Parallel sources could keep multiple threads busy
+    semaphore_.release((std::ptrdiff_t)source->GetMaxConcurrency());
 }
 
 TaskSource::Handle TaskExecutor::TryOpenHandle() {
@@ -104,6 +115,7 @@ void TaskExecutor::WorkerMain(bool canSleep) {
         if(!handle) {
             if(canSleep) {
                 // Wait for signal
+                TRACE_SCOPE("Idle");
                 semaphore_.acquire();
                 continue;
             } else {
@@ -117,7 +129,10 @@ void TaskExecutor::WorkerMain(bool canSleep) {
             Task::MetaInfo info = task->GetMetaInfo();
             tracker_->OnTaskStart(info);
 
-            std::move(*task).Run();
+            {
+                TRACE_SCOPE("Task");
+                std::move(*task).Run();
+            }
             tracker_->OnTaskFinish(info);
         }
         handle.Close();
@@ -191,6 +206,10 @@ void ThreadPool::RegisterTaskSource(std::shared_ptr<TaskSource> taskSource) {
     executor_->RegisterTaskSource(taskSource);
 }
 
+void ThreadPool::UnregisterTaskSource(TaskSource* taskSource) {
+    executor_->UnregisterTaskSource(taskSource);
+}
+
 void ThreadPool::WorkerMain(bool canSleep) {
     threadsStartedEvent_->count_down();
     executor_->RunUntilStopped(canSleep);
@@ -28,6 +28,10 @@ public:
     // internal tasks
     void RegisterTaskSource(std::shared_ptr<TaskSource> taskSource);
 
+    // Removes a task source which has no open handles, e.g. a finished
+    // TaskGenerator
+    void UnregisterTaskSource(TaskSource* taskSource);
+
     // Stops work scheduling based on TaskProvider's TaskShutdownPolicy
     void Stop();
 
@@ -59,7 +63,7 @@ private:
     std::shared_ptr<TaskTracker> tracker_;
     std::mutex lock_;
     // All task sources, some could be empty at the moment
-    std::vector<std::shared_ptr<TaskSource>> sources_;
+    SlotMap<std::shared_ptr<TaskSource>> sources_;
     // Task sources ready to be processed
     std::deque<TaskSource*> readyQueue_;
 };
@@ -94,6 +98,9 @@ public:
     // Mostly for testing
     void WaitUntilStarted();
     void RegisterTaskSource(std::shared_ptr<TaskSource> taskSource);
+    void UnregisterTaskSource(TaskSource* taskSource);
+
+    uint64_t GetThreadNum() const { return threadNum_; }
 
 private:
     void WorkerMain(bool canSleep = true) override;
@@ -62,3 +62,56 @@ bool EventLoop::Empty() const {
     std::scoped_lock _(lock_);
     return tasks_.empty();
 }
+
+
+/*============================ TASK GENERATOR ============================*/
+TaskGenerator::TaskGenerator(size_t count,
+                             size_t maxConcurrency,
+                             Func&& func,
+                             std::source_location location)
+    : func_(std::move(func))
+    , count_(count)
+    , maxConcurrency_(std::max<size_t>(maxConcurrency, 1))
+    , location_(location) {
+    DASSERT(func_);
+}
+
+void TaskGenerator::Wait() {
+    std::unique_lock lock(lock_);
+    idle_.wait(lock, [this] {
+        return numUsers_ == 0 &&
+               nextIndex_.load(std::memory_order_relaxed) >= count_;
+    });
+}
+
+TaskSource::Handle TaskGenerator::OpenHandle() {
+    std::scoped_lock _(lock_);
+    if(nextIndex_.load(std::memory_order_relaxed) >= count_ ||
+       numUsers_ >= maxConcurrency_) {
+        return {};
+    }
+    ++numUsers_;
+    return CreateHandle();
+}
+
+bool TaskGenerator::Empty() const {
+    return nextIndex_.load(std::memory_order_relaxed) >= count_;
+}
+
+Task TaskGenerator::TakeTask() {
+    // Claimed without the lock, the handles are used concurrently
+    const size_t index = nextIndex_.fetch_add(1, std::memory_order_relaxed);
+    if(index >= count_) {
+        return {};
+    }
+    return Task(location_, [this, index] { func_(index); });
+}
+
+void TaskGenerator::CloseHandle() {
+    std::scoped_lock _(lock_);
+    DASSERT(numUsers_);
+    --numUsers_;
+    if(numUsers_ == 0 && nextIndex_.load(std::memory_order_relaxed) >= count_) {
+        idle_.notify_all();
+    }
+}
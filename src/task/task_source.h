@@ -2,10 +2,12 @@
 #include "task.h"
 #include "future.h"
 
+#include "base/slot_map.h"
 #include "base/threading.h"
 
 #include <queue>
 #include <coroutine>
+#include <condition_variable>
 
 class TaskExecutor;
 class TaskTracker;
@@ -82,6 +84,10 @@ public:
     virtual void OnExecutorSet(TaskExecutor* executor) = 0;
     virtual bool Empty() const = 0;
 
+    // Number of threads which could process the source at once
+    // The executor wakes up as many when the source gets work
+    virtual size_t GetMaxConcurrency() const { return 1; }
+
 protected:
     Handle CreateHandle() { return {this}; }
 
@@ -93,6 +99,11 @@ private:
 
     virtual void CloseHandle() = 0;
     virtual Task TakeTask() = 0;
+
+private:
+    friend class TaskExecutor;
+    // Registration in the executor, checked without a search
+    SlotHandle executorSlot_;
 };
 
 // Checks whether a Callback can be called with the Func result
@@ -230,6 +241,53 @@ private:
 
 
 
+// Tasks of a parallel loop: func(index) for each index in [0, count)
+// Processed by up to maxConcurrency threads at once, in no particular order
+// Usage:
+//   auto generator = std::make_shared<TaskGenerator>(count, threadNum, func);
+//   pool.RegisterTaskSource(generator);
+//   generator->Wait();
+//   pool.UnregisterTaskSource(generator.get());
+class TaskGenerator final: public TaskSource {
+public:
+    using Func = std::function<void(size_t)>;
+
+    TaskGenerator(size_t count,
+                  size_t maxConcurrency,
+                  Func&& func,
+                  std::source_location location = std::source_location::current());
+
+    // Blocks until all tasks are finished and no thread holds a handle
+    // Shouldn't be called by a thread of the executor
+    void Wait();
+
+    Handle OpenHandle() override;
+    bool Empty() const override;
+    size_t GetMaxConcurrency() const override { return maxConcurrency_; }
+
+public:
+    TaskGenerator(const TaskGenerator&) = delete;
+    TaskGenerator& operator=(const TaskGenerator&) = delete;
+    ~TaskGenerator() { DASSERT(!numUsers_); }
+
+private:
+    Task TakeTask() override;
+    void CloseHandle() override;
+    void OnExecutorSet(TaskExecutor* executor) override {}
+
+private:
+    const Func                  func_;
+    const size_t                count_;
+    const size_t                maxConcurrency_;
+    const std::source_location  location_;
+    std::atomic<size_t>         nextIndex_ = 0;
+    mutable std::mutex          lock_;
+    std::condition_variable     idle_;
+    size_t                      numUsers_ = 0;
+};
+
+
+
 template<class T>
 struct EventLoopCoroutine;
 
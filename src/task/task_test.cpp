@@ -6,6 +6,8 @@
 #include "task_executor.h"
 #include "task_source.h"
 
+#include <set>
+
 namespace {
 
 class DummyTracker: public TaskTracker {
@@ -475,3 +477,31 @@ TEST_CASE_FIXTURE(EventLoopsWithCoroutine, "[Task] EventLoop with void coroutine
     workDoneSemaphore.acquire();
     CHECK_EQ(result, kExpectedResult);
 }
+
+TEST_CASE_FIXTURE(ThreadPoolTest, "[Task] TaskGenerator") {
+    constexpr size_t kCount = 1000;
+    std::vector<int> visits(kCount);
+    std::mutex threadsLock;
+    std::set<std::thread::id> threads;
+
+    auto generator = std::make_shared<TaskGenerator>(
+        kCount,
+        kThreadNum,
+        [&](size_t index) {
+            // Each index is processed once
+            ++visits[index];
+            std::scoped_lock _(threadsLock);
+            threads.insert(std::this_thread::get_id());
+        }
+    );
+    pool->RegisterTaskSource(generator);
+    generator->Wait();
+    pool->UnregisterTaskSource(generator.get());
+
+    CHECK(generator->Empty());
+    CHECK(std::ranges::all_of(visits, [](int v) { return v == 1; }));
+    CHECK_LE(threads.size(), kThreadNum);
+    // The pool is still usable
+    eventLoop1->PostTask([]() { workDoneSemaphore.release(); });
+    workDoneSemaphore.acquire();
+}
@@ -54,7 +54,7 @@ std::optional<size_t> LogTaskTracker::FindIndexByID(TaskID id) {
         }
     );
     if(it != executedTasks.end()) {
-        size_t index = std::distance(it, executedTasks.begin());
+        size_t index = std::distance(executedTasks.begin(), it);
         return {index};
     }
     return {};
@@ -183,7 +183,7 @@ private:
     ContainerBuilder container_;
     std::string text_;
     std::string tooltipText_;
-    StringID styleClass_ = "Button";
+    StringID styleClass_ = "Button"_sid;
     std::unique_ptr<Widget> child_;
 };
 
@@ -5,8 +5,12 @@
 
 #include "gfx_legacy/native_window.h"
 #include "gfx_legacy/ui_renderer.h"
+#include "base/mem_tracker.h"
+#include "base/property_writer.h"
+#include "base/trace.h"
 #include "base/util.h"
 
+#include <optional>
 #include <stack>
 
 
@@ -43,7 +47,6 @@ class TimerList {
 public:
     using TimerCallback = std::function<bool()>;
     using TimePoint = std::chrono::high_resolution_clock::time_point;
-    using TimerHandle = void*;
 
     struct Timer {
         WeakPtr<Object> object;
@@ -56,49 +59,52 @@ public:
     TimerHandle AddTimer(Object* object,
                          const TimerCallback& callback,
                          uint64_t periodMs) {
-        timers_.emplace_back(
+        return timers_.emplace(
             Timer(object->GetWeak(), callback, periodMs, Now()));
-        return (TimerHandle)&timers_.back();
     }
 
-    void RemoveTimer(TimerHandle handle) {
-        for (auto it = timers_.begin(); it != timers_.end(); ++it) {
-            if (&*it == handle) {
-                timers_.erase(it);
-                break;
-            }
-        }
-    }
+    // Stale handles of the finished timers are ignored
+    void RemoveTimer(TimerHandle handle) { timers_.erase(handle); }
 
     // Ticks timers and calls callbacks
+    // Callbacks could add and remove timers, so the timers are looked up
+    // by their handles after each call
     void Tick() {
         if (timers_.empty())
             return;
 
         const auto now = Now();
-        std::vector<std::list<Timer>::const_iterator> pendingDelete;
-
-        for (auto it = timers_.begin(); it != timers_.end(); ++it) {
-            auto& timer = *it;
+        pendingTick_.clear();
+        for (size_t i = 0; i < timers_.size(); ++i) {
+            pendingTick_.push_back(timers_.handle_at(i));
+        }
 
-            if (!timer.object) {
-                pendingDelete.push_back(it);
+        for (TimerHandle handle : pendingTick_) {
+            Timer* timer = timers_.get(handle);
+            if (!timer) {
                 continue;
             }
-
-            if (DurationMs(timer.timePoint, now) >= timer.periodMs) {
-                const auto shouldContinue = timer.callback();
-
-                if (shouldContinue) {
-                    timer.timePoint = now;
-                } else {
-                    pendingDelete.push_back(it);
-                }
+            if (!timer->object) {
+                timers_.erase(handle);
+                continue;
             }
-        }
+            if (DurationMs(timer->timePoint, now) < timer->periodMs) {
+                continue;
+            }
+            // Moved out as the storage could grow during the call
+            TimerCallback callback = std::move(timer->callback);
+            const bool shouldContinue = callback();
 
-        for (auto& it : pendingDelete) {
-            timers_.erase(it);
+            timer = timers_.get(handle);
+            if (!timer) {
+                continue;
+            }
+            if (shouldContinue) {
+                timer->callback = std::move(callback);
+                timer->timePoint = now;
+            } else {
+                timers_.erase(handle);
+            }
         }
     }
 
@@ -117,7 +123,9 @@ private:
     TimePoint Now() { return std::chrono::high_resolution_clock::now(); }
 
 private:
-    std::list<Timer> timers_;
+    SlotMap<Timer> timers_;
+    // Handles of the timers before the tick
+    std::vector<TimerHandle> pendingTick_;
 };
 
 
@@ -814,6 +822,10 @@ public:
             modifiersState_[CapsLock] = !modifiersState_[CapsLock];
 
         if (button == KeyCode::KEY_P && bPressed) {
+            if (modifiersState_[LeftShift] || modifiersState_[RightShift]) {
+                DumpWidgetTree("widget_tree.json");
+                return;
+            }
             for (auto& [window, layer] : std::views::reverse(widgetStack_)) {
                 LogWidgetTree(window.get());
             }
@@ -841,6 +853,11 @@ public:
             LOGF(Info, "{}", PrintContext());
             return;
         }
+
+        if (button == KeyCode::KEY_M && bPressed) {
+            LogMemoryUsage();
+            return;
+        }
     }
 
     void DispatchMouseScrollEvent(float scroll) {
@@ -899,109 +916,63 @@ public:
         sb.Line();
 
         for (auto it = widgetStack_.rbegin(); it != widgetStack_.rend(); ++it) {
-            PropertyArchive archive;
-            DebugLogEvent onDebugLog;
-            onDebugLog.archive = &archive;
-
-            it->widget->OnEvent(&onDebugLog);
-
-            std::deque<PropertyArchive::ObjectID> parentIDStack;
-            std::stringstream ss;
-
-            auto printIndent = [&](size_t indent) {
-                if (!indent)
-                    return;
-                ss << "    ";
-                --indent;
-
-                for (; indent; --indent) {
-                    ss << "|   ";
-                }
-            };
-
-            auto visitor = [&](PropertyArchive::Object& object) -> bool {
-                const auto parentID =
-                    object.parent_ ? object.parent_->objectID_ : 0;
-
-                if (!parentID) {
-                    parentIDStack.clear();
-                } else if (parentID != parentIDStack.back()) {
-                    // Unwind intil the parent is found
-                    for (auto stackParentID = parentIDStack.back();
-                         stackParentID != parentID; parentIDStack.pop_back(),
-                              stackParentID = parentIDStack.back())
-                        ;
-                }
-                parentIDStack.push_back(object.objectID_);
-                auto indent = parentIDStack.size();
-
-                printIndent(indent);
-                ss << '\n';
-                printIndent(indent - 1);
-                ss << "|-> " << object.debugName_ << ":\n";
-
-                for (auto& property : object.properties_) {
-                    printIndent(indent);
-                    ss << std::format("{}: {}", property.Name, property.Value)
-                       << '\n';
-                }
-                return true;
-            };
-            archive.VisitRecursively(visitor);
-            sb.Line(ss.str());
+            sb.Line(PrintWidgetTree(it->widget.get()));
             sb.Line();
         }
         return out;
     }
 
-    void LogWidgetTree(Widget* window) {
-        PropertyArchive archive;
+    // Streams the widgets into the writer without building a tree
+    void SerializeWidgetTree(Widget* window, PropertySink* writer) {
+        PropertyArchive archive(writer);
         DebugLogEvent onDebugLog;
         onDebugLog.archive = &archive;
-
         window->OnEvent(&onDebugLog);
+        archive.Finish();
+    }
 
-        std::deque<PropertyArchive::ObjectID> parentIDStack;
-        std::stringstream ss;
-
-        auto printIndent = [&](size_t indent) {
-            if (!indent)
-                return;
-            ss << "    ";
-            --indent;
+    std::string PrintWidgetTree(Widget* window) {
+        std::string out;
+        {
+            BufferedWriter buffer(BufferedWriter::ToString(&out));
+            TextPropertyWriter writer(&buffer);
+            SerializeWidgetTree(window, &writer);
+        }
+        return out;
+    }
 
-            for (; indent; --indent) {
-                ss << "|   ";
-            }
-        };
-        archive.VisitRecursively([&](PropertyArchive::Object& object) -> bool {
-            const auto parentID =
-                object.parent_ ? object.parent_->objectID_ : 0;
-
-            if (!parentID) {
-                parentIDStack.clear();
-            } else if (parentID != parentIDStack.back()) {
-                // Unwind intil the parent is found
-                for (auto stackParentID = parentIDStack.back();
-                     stackParentID != parentID; parentIDStack.pop_back(),
-                          stackParentID = parentIDStack.back());
-            }
-            parentIDStack.push_back(object.objectID_);
-            auto indent = parentIDStack.size();
+    // Logs the memory by tag and the change since the previous call
+    void LogMemoryUsage() {
+        const mem::Snapshot snapshot = mem::TakeSnapshot();
+        std::string out = mem::FormatSnapshot(snapshot);
+        if (memSnapshot_) {
+            out += mem::FormatDiff(*memSnapshot_, snapshot);
+        }
+        memSnapshot_ = snapshot;
+        LOGF(Info, "{}", out);
+    }
 
-            printIndent(indent);
-            ss << '\n';
-            printIndent(indent - 1);
-            ss << "|-> " << object.debugName_ << ":\n";
+    void LogWidgetTree(Widget* window) {
+        LOGF(Info, "Widget tree: \n{}", PrintWidgetTree(window));
+    }
 
-            for (auto& property : object.properties_) {
-                printIndent(indent);
-                ss << std::format("{}: {}", property.Name, property.Value)
-                   << '\n';
+    // Writes the windows as json. Large trees are written in chunks
+    void DumpWidgetTree(const std::filesystem::path& path) {
+        std::FILE* file = std::fopen(path.string().c_str(), "wb");
+        if (!file) {
+            LOG_ERROR("Failed to open the widget tree dump file {}",
+                      path.string());
+            return;
+        }
+        {
+            BufferedWriter buffer(BufferedWriter::ToFile(file));
+            JsonPropertyWriter writer(&buffer, 2);
+            for (auto& [window, layer] : std::views::reverse(widgetStack_)) {
+                SerializeWidgetTree(window.get(), &writer);
             }
-            return true;
-        });
-        LOGF(Info, "Widget tree: \n{}", ss.str());
+        }
+        std::fclose(file);
+        LOGF(Info, "Widget tree dumped to {}", path.string());
     }
 
     std::string PrintAncestors(Widget* widget) {
@@ -1426,6 +1397,8 @@ public:
     }
 
     bool Tick() {
+        TRACE_FRAME();
+        TRACE_SCOPE("Tick");
         const auto frameStartTimePoint =
             std::chrono::high_resolution_clock::now();
         // Rebuild fonts if needed for different size
@@ -1436,11 +1409,17 @@ public:
             bResetState_ = false;
         }
 
-        if (!nativeWindow->PollEvents()) {
-            return false;
+        {
+            TRACE_SCOPE("PollEvents");
+            if (!nativeWindow->PollEvents()) {
+                return false;
+            }
         }
         timers_.Tick();
-        RebuildDirtyWidgets();
+        {
+            TRACE_SCOPE("RebuildDirtyWidgets");
+            RebuildDirtyWidgets();
+        }
 
         // Update layout
         // Copy because widgets can request rebuild in OnPostLayout()
@@ -1448,22 +1427,32 @@ public:
         auto pendingUpdateLayout = dirtyWidgets_;
         dirtyWidgets_.clear();
 
-        for (auto& widget : pendingUpdateLayout) {
-            if (widget) {
-                UpdateLayout(widget.Get());
+        {
+            TRACE_SCOPE("UpdateLayout");
+            TRACE_COUNTER("Dirty widgets", pendingUpdateLayout.size());
+            for (auto& widget : pendingUpdateLayout) {
+                if (widget) {
+                    UpdateLayout(widget.Get());
+                }
             }
         }
         // Update hittest
-        DispatchMouseMoveEvent(mousePosGlobal_);
+        {
+            TRACE_SCOPE("HitTest");
+            DispatchMouseMoveEvent(mousePosGlobal_);
+        }
 
         UpdateDebugOverlay();
 
         // Draw
-        renderer->ResetDrawLists();
-        auto* frameDrawList = renderer->GetFrameDrawList();
-        frameDrawList->PushFont(theme_->GetDefaultFont(), kFontSizeDefault);
-        for (auto& [window, layer] : widgetStack_) {
-            DrawWindow(window.get(), frameDrawList, theme_.get());
+        {
+            TRACE_SCOPE("Draw");
+            renderer->ResetDrawLists();
+            auto* frameDrawList = renderer->GetFrameDrawList();
+            frameDrawList->PushFont(theme_->GetDefaultFont(), kFontSizeDefault);
+            for (auto& [window, layer] : widgetStack_) {
+                DrawWindow(window.get(), frameDrawList, theme_.get());
+            }
         }
 
         const auto frameEndTimePoint =
@@ -1478,6 +1467,7 @@ public:
         // Kick actual rendering
         // TODO: make async with two contexts
         // so that we can start updating next frame while previous is rendering
+        TRACE_SCOPE("RenderFrame");
         renderer->RenderFrame(true);
         return true;
     }
@@ -1647,6 +1637,9 @@ private:
     bool bDrawDebugLayout_ = false;
     bool bDrawDebugClipRects_ = false;
 
+    // Previous snapshot logged by LogMemoryUsage()
+    std::optional<mem::Snapshot> memSnapshot_;
+
     // Stack of windows, bottom are background windows and top are overlay
     // windows Other windows in the middle
     struct RootWidget {
@@ -3,6 +3,9 @@
 #include <ranges>
 
 #include "base/common.h"
+#include "base/mem_tracker.h"
+#include "base/slot_map.h"
+#include "base/small_vector.h"
 #include "base/util.h"
 #include "base/ref_counted.h"
 #include "base/tree_printer.h"
@@ -101,7 +104,7 @@ enum KeyModifiers {
 using KeyModifiersArray = std::array<bool, (int)KeyModifiers::Count>;
 
 using TimerCallback = std::function<bool()>;
-using TimerHandle = void*;
+using TimerHandle = SlotHandle;
 
 
 enum class AxisMode {
@@ -529,6 +532,19 @@ public:
     // [MyWidgetClassName: <4 bytes of adress> "MyObjectID"]
     std::string GetDebugID() const;
 
+    // Widgets and states are reported to the UI memory tag
+    // The destructor is virtual so the size is of the derived class
+    static void* operator new(size_t size) {
+        void* ptr = ::operator new(size);
+        mem::RecordAlloc(size, mem::Tag::UI);
+        return ptr;
+    }
+
+    static void operator delete(void* ptr, size_t size) {
+        mem::RecordFree(size, mem::Tag::UI);
+        ::operator delete(ptr, size);
+    }
+
 protected:
     Object() = default;
     Object(const Object&) = delete;
@@ -1345,7 +1361,8 @@ protected:
     auto end() const { return children_.end(); }
 
 private:
-    std::vector<std::unique_ptr<Widget>> children_;
+    // Most containers have a few children
+    SmallVector<std::unique_ptr<Widget>, 4> children_;
 };
 
 
@@ -3,10 +3,10 @@
 
 #include "base/string_utils.h"
 #include "base/common.h"
+#include "base/flat_hash_map.h"
 #include "base/util.h"
 #include "base/vector_types.h"
 
-#include <map>
 #include <set>
 #include <variant>
 
@@ -391,7 +391,8 @@ public:
 	// Creates default styles with selector "" using default font "ImGuiInternal"
 	void CreateDefaults(uint8_t fontSize) {
 		// Create default fallback styles
-		auto& fallback = styles_.emplace("", StyleClass("")).first->second;
+		auto [it, isCreated] = styles_.try_emplace(StringID(), std::make_unique<StyleClass>(""));
+		auto& fallback = *it->second;
 		fallback.Add<LayoutStyle>();
 		// Purple color
 		fallback.Add<BoxStyle>().FillColor("#FF00EE");
@@ -419,8 +420,11 @@ public:
 			parent = Find(parentName);
 			DASSERT_F(parent, "Cannot find parent style with the name {}", inParentStyle);
 		}
-		auto [it, isCreated] = styles_.emplace(name, StyleClass(name, parent));
-		return it->second;
+		auto [it, isCreated] = styles_.try_emplace(name);
+		if(isCreated) {
+			it->second = std::make_unique<StyleClass>(name, parent);
+		}
+		return *it->second;
 	}
 
 	// Gathers all fonts from styles and try to load them
@@ -429,7 +433,7 @@ public:
 	void RasterizeFonts(std::vector<Font*>* outFonts) {
 		// Load fonts
 		for(auto& [selector, styleClass]: styles_) {
-			for(auto& style: styleClass.styles_) {
+			for(auto& style: styleClass->styles_) {
 				if(auto* textStyle = style->As<TextStyle>()) {
 
 					if(textStyle->font) {
@@ -467,12 +471,13 @@ public:
 			LOGF(Verbose, "Style with the name {} not found. Using fallback style.", inStyleClass);
 			return fallback_;
 		}
-		return it != styles_.end() ? &it->second : nullptr;
+		return it->second.get();
 	}
 
 private:
 	StyleClass*                    fallback_;
-	std::map<StringID, StyleClass> styles_;
+	// Boxed, the classes point to their parents
+	FlatHashMap<StringID, std::unique_ptr<StyleClass>> styles_;
 	// All fonts used by this theme
 	std::vector<std::unique_ptr<Font>> fonts_;
 };
@@ -40,7 +40,7 @@ struct TextTooltipBuilder {
     }
 
 private:
-    StringID styleClass_ = "Tooltip";
+    StringID styleClass_ = "Tooltip"_sid;
     std::string text_;
     bool bClipText_ = false;
 };
@@ -71,7 +71,7 @@ public:
 
     void DebugSerialize(PropertyArchive& ar) override {
         MouseRegion::DebugSerialize(ar);
-        ar.PushProperty("Timer", (uintptr_t)sharedState.timerHandle);
+        ar.PushProperty("Timer", sharedState.timerHandle.ToBits());
         ar.PushProperty("Tooltip", sharedState.widget
                                        ? sharedState.widget->GetDebugID()
                                        : "null");